@@ -0,0 +1,407 @@
+#include "BatchKernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define C11NHF_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace BatchKernels {
+
+    typedef void (*Kernel)(double *, const double *, std::size_t);
+
+    typedef void (*FloatKernel)(float *, const float *, std::size_t);
+
+    typedef double (*HornerKernel)(const double *, std::size_t, double);
+
+    typedef void (*HornerBlockKernel)(const double *, std::size_t, const double *, double *, std::size_t);
+
+    typedef HornerKernel ClenshawKernel;
+
+    typedef HornerBlockKernel ClenshawBlockKernel;
+
+    /**
+     * The kernels of one instruction set level.
+     */
+    struct KernelTable {
+        SimdLevel level;
+        Kernel add, sub, mul, div;
+        FloatKernel add_float, sub_float, mul_float, div_float;
+        HornerKernel horner;
+        HornerBlockKernel horner_block;
+        ClenshawKernel clenshaw;
+        ClenshawBlockKernel clenshaw_block;
+    };
+
+/**
+ * Defines the scalar, and where available the SSE2 and AVX implementations of one element-wise operation.
+ * The vector loops handle the tail with the scalar operation, so every element is computed by the same
+ * IEEE operation whichever path is taken.
+ */
+#define C11NHF_SCALAR_KERNEL(name, type, op)                                   \
+    static void name##_scalar(type *lhs, const type *rhs, std::size_t n) {     \
+        for (std::size_t i = 0; i < n; i++)                                    \
+            lhs[i] = lhs[i] op rhs[i];                                         \
+    }
+
+#define C11NHF_X86_KERNEL(name, op, sse_intrinsic, avx_intrinsic)                          \
+    __attribute__((target("sse2")))                                                       \
+    static void name##_sse2(double *lhs, const double *rhs, std::size_t n) {              \
+        std::size_t i = 0;                                                                \
+        for (; i + 2 <= n; i += 2)                                                        \
+            _mm_storeu_pd(lhs + i, sse_intrinsic(_mm_loadu_pd(lhs + i), _mm_loadu_pd(rhs + i))); \
+        for (; i < n; i++)                                                                \
+            lhs[i] = lhs[i] op rhs[i];                                                    \
+    }                                                                                     \
+    __attribute__((target("avx")))                                                        \
+    static void name##_avx(double *lhs, const double *rhs, std::size_t n) {               \
+        std::size_t i = 0;                                                                \
+        for (; i + 8 <= n; i += 8) {                                                      \
+            __m256d a = avx_intrinsic(_mm256_loadu_pd(lhs + i), _mm256_loadu_pd(rhs + i)); \
+            __m256d b = avx_intrinsic(_mm256_loadu_pd(lhs + i + 4), _mm256_loadu_pd(rhs + i + 4)); \
+            _mm256_storeu_pd(lhs + i, a);                                                 \
+            _mm256_storeu_pd(lhs + i + 4, b);                                             \
+        }                                                                                 \
+        for (; i + 4 <= n; i += 4)                                                        \
+            _mm256_storeu_pd(lhs + i, avx_intrinsic(_mm256_loadu_pd(lhs + i), _mm256_loadu_pd(rhs + i))); \
+        for (; i < n; i++)                                                                \
+            lhs[i] = lhs[i] op rhs[i];                                                    \
+    }
+
+/**
+ * The same for floats, twice as many of them in a vector.
+ */
+#define C11NHF_X86_FLOAT_KERNEL(name, op, sse_intrinsic, avx_intrinsic)                    \
+    __attribute__((target("sse2")))                                                       \
+    static void name##_sse2(float *lhs, const float *rhs, std::size_t n) {                \
+        std::size_t i = 0;                                                                \
+        for (; i + 4 <= n; i += 4)                                                        \
+            _mm_storeu_ps(lhs + i, sse_intrinsic(_mm_loadu_ps(lhs + i), _mm_loadu_ps(rhs + i))); \
+        for (; i < n; i++)                                                                \
+            lhs[i] = lhs[i] op rhs[i];                                                    \
+    }                                                                                     \
+    __attribute__((target("avx")))                                                        \
+    static void name##_avx(float *lhs, const float *rhs, std::size_t n) {                 \
+        std::size_t i = 0;                                                                \
+        for (; i + 16 <= n; i += 16) {                                                    \
+            __m256 a = avx_intrinsic(_mm256_loadu_ps(lhs + i), _mm256_loadu_ps(rhs + i)); \
+            __m256 b = avx_intrinsic(_mm256_loadu_ps(lhs + i + 8), _mm256_loadu_ps(rhs + i + 8)); \
+            _mm256_storeu_ps(lhs + i, a);                                                 \
+            _mm256_storeu_ps(lhs + i + 8, b);                                             \
+        }                                                                                 \
+        for (; i + 8 <= n; i += 8)                                                        \
+            _mm256_storeu_ps(lhs + i, avx_intrinsic(_mm256_loadu_ps(lhs + i), _mm256_loadu_ps(rhs + i))); \
+        for (; i < n; i++)                                                                \
+            lhs[i] = lhs[i] op rhs[i];                                                    \
+    }
+
+    C11NHF_SCALAR_KERNEL(add, double, +)
+    C11NHF_SCALAR_KERNEL(sub, double, -)
+    C11NHF_SCALAR_KERNEL(mul, double, *)
+    C11NHF_SCALAR_KERNEL(div, double, /)
+    C11NHF_SCALAR_KERNEL(add_float, float, +)
+    C11NHF_SCALAR_KERNEL(sub_float, float, -)
+    C11NHF_SCALAR_KERNEL(mul_float, float, *)
+    C11NHF_SCALAR_KERNEL(div_float, float, /)
+
+#ifdef C11NHF_X86_KERNELS
+    C11NHF_X86_KERNEL(add, +, _mm_add_pd, _mm256_add_pd)
+    C11NHF_X86_KERNEL(sub, -, _mm_sub_pd, _mm256_sub_pd)
+    C11NHF_X86_KERNEL(mul, *, _mm_mul_pd, _mm256_mul_pd)
+    C11NHF_X86_KERNEL(div, /, _mm_div_pd, _mm256_div_pd)
+    C11NHF_X86_FLOAT_KERNEL(add_float, +, _mm_add_ps, _mm256_add_ps)
+    C11NHF_X86_FLOAT_KERNEL(sub_float, -, _mm_sub_ps, _mm256_sub_ps)
+    C11NHF_X86_FLOAT_KERNEL(mul_float, *, _mm_mul_ps, _mm256_mul_ps)
+    C11NHF_X86_FLOAT_KERNEL(div_float, /, _mm_div_ps, _mm256_div_ps)
+#endif
+
+    /**
+     * Horner's method with a separate multiplication and addition, the reference every non-FMA level matches.
+     */
+    static double horner_scalar(const double *coefficients, std::size_t count, double x) {
+        double acc = coefficients[count - 1];
+        for (std::size_t k = count - 1; k-- > 0;)
+            acc = acc * x + coefficients[k];
+        return acc;
+    }
+
+    static void horner_block_scalar(const double *coefficients, std::size_t count, const double *xs, double *out,
+                                    std::size_t n) {
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = horner_scalar(coefficients, count, xs[i]);
+    }
+
+    /**
+     * Clenshaw's recurrence b(k) = 2t * b(k+1) - b(k+2) + c(k) with separate operations, the reference every
+     * non-FMA level matches.
+     */
+    static double clenshaw_scalar(const double *coefficients, std::size_t count, double t) {
+        double t2 = 2 * t, b1 = 0.0, b2 = 0.0;
+        for (std::size_t k = count - 1; k > 0; k--) {
+            double b0 = t2 * b1 - b2 + coefficients[k];
+            b2 = b1;
+            b1 = b0;
+        }
+        return t * b1 - b2 + coefficients[0];
+    }
+
+    static void clenshaw_block_scalar(const double *coefficients, std::size_t count, const double *ts, double *out,
+                                      std::size_t n) {
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = clenshaw_scalar(coefficients, count, ts[i]);
+    }
+
+#ifdef C11NHF_X86_KERNELS
+/**
+ * Defines the AVX Horner block kernel of a level. Horner's method is a chain of dependent steps, so four vectors
+ * are evaluated side by side to keep the pipeline busy; the tail uses the scalar kernel of the same level.
+ */
+#define C11NHF_HORNER_KERNEL(name, isa, step, scalar)                                                         \
+    __attribute__((target(isa)))                                                                             \
+    static void name(const double *coefficients, std::size_t count, const double *xs, double *out,           \
+                     std::size_t n) {                                                                        \
+        __m256d top = _mm256_set1_pd(coefficients[count - 1]);                                               \
+        std::size_t i = 0;                                                                                   \
+        for (; i + 16 <= n; i += 16) {                                                                       \
+            __m256d x0 = _mm256_loadu_pd(xs + i), x1 = _mm256_loadu_pd(xs + i + 4);                          \
+            __m256d x2 = _mm256_loadu_pd(xs + i + 8), x3 = _mm256_loadu_pd(xs + i + 12);                     \
+            __m256d a0 = top, a1 = top, a2 = top, a3 = top;                                                  \
+            for (std::size_t k = count - 1; k-- > 0;) {                                                      \
+                __m256d c = _mm256_set1_pd(coefficients[k]);                                                 \
+                a0 = step(a0, x0, c);                                                                        \
+                a1 = step(a1, x1, c);                                                                        \
+                a2 = step(a2, x2, c);                                                                        \
+                a3 = step(a3, x3, c);                                                                        \
+            }                                                                                                \
+            _mm256_storeu_pd(out + i, a0);                                                                   \
+            _mm256_storeu_pd(out + i + 4, a1);                                                               \
+            _mm256_storeu_pd(out + i + 8, a2);                                                               \
+            _mm256_storeu_pd(out + i + 12, a3);                                                              \
+        }                                                                                                    \
+        for (; i + 4 <= n; i += 4) {                                                                         \
+            __m256d x0 = _mm256_loadu_pd(xs + i), a0 = top;                                                  \
+            for (std::size_t k = count - 1; k-- > 0;)                                                        \
+                a0 = step(a0, x0, _mm256_set1_pd(coefficients[k]));                                          \
+            _mm256_storeu_pd(out + i, a0);                                                                   \
+        }                                                                                                    \
+        for (; i < n; i++)                                                                                   \
+            out[i] = scalar(coefficients, count, xs[i]);                                                     \
+    }
+
+    __attribute__((target("avx")))
+    static inline __m256d horner_step_avx(__m256d acc, __m256d x, __m256d c) {
+        return _mm256_add_pd(_mm256_mul_pd(acc, x), c);
+    }
+
+    __attribute__((target("avx2,fma")))
+    static inline __m256d horner_step_fma(__m256d acc, __m256d x, __m256d c) {
+        return _mm256_fmadd_pd(acc, x, c);
+    }
+
+    /**
+     * Horner's method with fused multiply-adds, the reference of the FMA level.
+     */
+    __attribute__((target("avx2,fma")))
+    static double horner_fma(const double *coefficients, std::size_t count, double x) {
+        __m128d vx = _mm_set_sd(x);
+        __m128d acc = _mm_set_sd(coefficients[count - 1]);
+        for (std::size_t k = count - 1; k-- > 0;)
+            acc = _mm_fmadd_sd(acc, vx, _mm_set_sd(coefficients[k]));
+        return _mm_cvtsd_f64(acc);
+    }
+
+    C11NHF_HORNER_KERNEL(horner_block_avx, "avx", horner_step_avx, horner_scalar)
+    C11NHF_HORNER_KERNEL(horner_block_fma, "avx2,fma", horner_step_fma, horner_fma)
+
+/**
+ * Defines the AVX Clenshaw block kernel of a level, four vectors side by side like the Horner kernels.
+ * step(t2, b1, b2, c) computes 2t * b1 - b2 + c, the last step being step(t, b1, b2, c0).
+ */
+#define C11NHF_CLENSHAW_KERNEL(name, isa, step, scalar)                                                       \
+    __attribute__((target(isa)))                                                                             \
+    static void name(const double *coefficients, std::size_t count, const double *ts, double *out,           \
+                     std::size_t n) {                                                                        \
+        const __m256d zero = _mm256_setzero_pd(), c0 = _mm256_set1_pd(coefficients[0]);                     \
+        std::size_t i = 0;                                                                                   \
+        for (; i + 16 <= n; i += 16) {                                                                       \
+            __m256d t0 = _mm256_loadu_pd(ts + i), t1 = _mm256_loadu_pd(ts + i + 4);                          \
+            __m256d t2 = _mm256_loadu_pd(ts + i + 8), t3 = _mm256_loadu_pd(ts + i + 12);                     \
+            __m256d d0 = _mm256_add_pd(t0, t0), d1 = _mm256_add_pd(t1, t1);                                  \
+            __m256d d2 = _mm256_add_pd(t2, t2), d3 = _mm256_add_pd(t3, t3);                                  \
+            __m256d a0 = zero, a1 = zero, a2 = zero, a3 = zero, b0 = zero, b1 = zero, b2 = zero, b3 = zero;  \
+            for (std::size_t k = count - 1; k > 0; k--) {                                                    \
+                __m256d c = _mm256_set1_pd(coefficients[k]);                                                 \
+                __m256d n0 = step(d0, a0, b0, c), n1 = step(d1, a1, b1, c);                                  \
+                __m256d n2 = step(d2, a2, b2, c), n3 = step(d3, a3, b3, c);                                  \
+                b0 = a0, b1 = a1, b2 = a2, b3 = a3;                                                          \
+                a0 = n0, a1 = n1, a2 = n2, a3 = n3;                                                          \
+            }                                                                                                \
+            _mm256_storeu_pd(out + i, step(t0, a0, b0, c0));                                                 \
+            _mm256_storeu_pd(out + i + 4, step(t1, a1, b1, c0));                                             \
+            _mm256_storeu_pd(out + i + 8, step(t2, a2, b2, c0));                                             \
+            _mm256_storeu_pd(out + i + 12, step(t3, a3, b3, c0));                                            \
+        }                                                                                                    \
+        for (; i + 4 <= n; i += 4) {                                                                         \
+            __m256d t0 = _mm256_loadu_pd(ts + i), d0 = _mm256_add_pd(t0, t0), a0 = zero, b0 = zero;          \
+            for (std::size_t k = count - 1; k > 0; k--) {                                                    \
+                __m256d next = step(d0, a0, b0, _mm256_set1_pd(coefficients[k]));                            \
+                b0 = a0;                                                                                     \
+                a0 = next;                                                                                   \
+            }                                                                                                \
+            _mm256_storeu_pd(out + i, step(t0, a0, b0, c0));                                                 \
+        }                                                                                                    \
+        for (; i < n; i++)                                                                                   \
+            out[i] = scalar(coefficients, count, ts[i]);                                                     \
+    }
+
+    __attribute__((target("avx")))
+    static inline __m256d clenshaw_step_avx(__m256d t2, __m256d b1, __m256d b2, __m256d c) {
+        return _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(t2, b1), b2), c);
+    }
+
+    /**
+     * The FMA step subtracts b2 from the coefficient first, so only the fused multiply-add is on the dependency
+     * chain of b1.
+     */
+    __attribute__((target("avx2,fma")))
+    static inline __m256d clenshaw_step_fma(__m256d t2, __m256d b1, __m256d b2, __m256d c) {
+        return _mm256_fmadd_pd(t2, b1, _mm256_sub_pd(c, b2));
+    }
+
+    /**
+     * Clenshaw's recurrence with fused multiply-adds, the reference of the FMA level.
+     */
+    __attribute__((target("avx2,fma")))
+    static double clenshaw_fma(const double *coefficients, std::size_t count, double t) {
+        __m128d vt = _mm_set_sd(t), t2 = _mm_add_sd(vt, vt), b1 = _mm_setzero_pd(), b2 = _mm_setzero_pd();
+        for (std::size_t k = count - 1; k > 0; k--) {
+            __m128d b0 = _mm_fmadd_sd(t2, b1, _mm_sub_sd(_mm_set_sd(coefficients[k]), b2));
+            b2 = b1;
+            b1 = b0;
+        }
+        return _mm_cvtsd_f64(_mm_fmadd_sd(vt, b1, _mm_sub_sd(_mm_set_sd(coefficients[0]), b2)));
+    }
+
+    C11NHF_CLENSHAW_KERNEL(clenshaw_block_avx, "avx", clenshaw_step_avx, clenshaw_scalar)
+    C11NHF_CLENSHAW_KERNEL(clenshaw_block_fma, "avx2,fma", clenshaw_step_fma, clenshaw_fma)
+#endif
+
+    /**
+     * Builds the kernel table of a level.
+     * @param level instruction set level, must be supported by the processor
+     * @return table of the kernels
+     */
+    static KernelTable make_table(SimdLevel level) {
+        switch (level) {
+#ifdef C11NHF_X86_KERNELS
+            case SimdLevel::FMA:
+                return KernelTable{level, add_avx, sub_avx, mul_avx, div_avx, add_float_avx, sub_float_avx,
+                                   mul_float_avx, div_float_avx, horner_fma, horner_block_fma, clenshaw_fma,
+                                   clenshaw_block_fma};
+            case SimdLevel::AVX:
+                return KernelTable{level, add_avx, sub_avx, mul_avx, div_avx, add_float_avx, sub_float_avx,
+                                   mul_float_avx, div_float_avx, horner_scalar, horner_block_avx, clenshaw_scalar,
+                                   clenshaw_block_avx};
+            case SimdLevel::SSE2:
+                return KernelTable{level, add_sse2, sub_sse2, mul_sse2, div_sse2, add_float_sse2, sub_float_sse2,
+                                   mul_float_sse2, div_float_sse2, horner_scalar, horner_block_scalar,
+                                   clenshaw_scalar, clenshaw_block_scalar};
+#endif
+            default:
+                return KernelTable{SimdLevel::SCALAR, add_scalar, sub_scalar, mul_scalar, div_scalar,
+                                   add_float_scalar, sub_float_scalar, mul_float_scalar, div_float_scalar,
+                                   horner_scalar, horner_block_scalar, clenshaw_scalar, clenshaw_block_scalar};
+        }
+    }
+
+    /**
+     * Returns the active kernel table, selecting the detected level on first use.
+     */
+    static KernelTable &table() {
+        static KernelTable active = make_table(detect_level());
+        return active;
+    }
+
+    SimdLevel detect_level() {
+#ifdef C11NHF_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return SimdLevel::FMA;
+        if (__builtin_cpu_supports("avx"))
+            return SimdLevel::AVX;
+        if (__builtin_cpu_supports("sse2"))
+            return SimdLevel::SSE2;
+#endif
+        return SimdLevel::SCALAR;
+    }
+
+    SimdLevel active_level() {
+        return table().level;
+    }
+
+    void set_level(SimdLevel level) {
+        if (level > detect_level())
+            level = detect_level();
+        table() = make_table(level);
+    }
+
+    const char *level_name(SimdLevel level) {
+        switch (level) {
+            case SimdLevel::FMA:
+                return "AVX2+FMA";
+            case SimdLevel::AVX:
+                return "AVX";
+            case SimdLevel::SSE2:
+                return "SSE2";
+            default:
+                return "scalar";
+        }
+    }
+
+    void add(double *lhs, const double *rhs, std::size_t n) {
+        table().add(lhs, rhs, n);
+    }
+
+    void sub(double *lhs, const double *rhs, std::size_t n) {
+        table().sub(lhs, rhs, n);
+    }
+
+    void mul(double *lhs, const double *rhs, std::size_t n) {
+        table().mul(lhs, rhs, n);
+    }
+
+    void div(double *lhs, const double *rhs, std::size_t n) {
+        table().div(lhs, rhs, n);
+    }
+
+    void add(float *lhs, const float *rhs, std::size_t n) {
+        table().add_float(lhs, rhs, n);
+    }
+
+    void sub(float *lhs, const float *rhs, std::size_t n) {
+        table().sub_float(lhs, rhs, n);
+    }
+
+    void mul(float *lhs, const float *rhs, std::size_t n) {
+        table().mul_float(lhs, rhs, n);
+    }
+
+    void div(float *lhs, const float *rhs, std::size_t n) {
+        table().div_float(lhs, rhs, n);
+    }
+
+    double horner(const double *coefficients, std::size_t count, double x) {
+        return table().horner(coefficients, count, x);
+    }
+
+    void horner_block(const double *coefficients, std::size_t count, const double *xs, double *out, std::size_t n) {
+        table().horner_block(coefficients, count, xs, out, n);
+    }
+
+    double clenshaw(const double *coefficients, std::size_t count, double t) {
+        return table().clenshaw(coefficients, count, t);
+    }
+
+    void clenshaw_block(const double *coefficients, std::size_t count, const double *ts, double *out, std::size_t n) {
+        table().clenshaw_block(coefficients, count, ts, out, n);
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef C11NHF_BATCHKERNELS_H
+#define C11NHF_BATCHKERNELS_H
+#include <cstddef>
+
+/**
+ * Element-wise kernels used by the batch evaluation of the expressions.
+ * Every kernel computes lhs[i] = lhs[i] op rhs[i] for i < n. The implementation is chosen once at runtime
+ * from the instruction sets the processor supports, each of them giving bit-identical results.
+ * The Horner and Clenshaw kernels are the exception: on the FMA level every step is a fused multiply-add, rounded
+ * once instead of twice, so they are more accurate there. The scalar and the block kernels of a level always agree.
+ */
+namespace BatchKernels {
+
+    /**
+     * Instruction set levels the kernels are available for.
+     */
+    enum class SimdLevel {
+        SCALAR,
+        SSE2,
+        AVX,
+        FMA /**< AVX2 and FMA3 */
+    };
+
+    /**
+     * Returns the best level supported by the processor this program runs on.
+     * @return detected instruction set level
+     */
+    SimdLevel detect_level();
+
+    /**
+     * Returns the level the kernels currently dispatch to.
+     * @return active instruction set level
+     */
+    SimdLevel active_level();
+
+    /**
+     * Forces the kernels to a given level, e.g. for benchmarking. Levels the processor doesn't support are
+     * lowered to the detected one. Not thread-safe, call it before starting any evaluation.
+     * @param level requested instruction set level
+     */
+    void set_level(SimdLevel level);
+
+    /**
+     * Returns a printable name of the level.
+     * @param level instruction set level
+     * @return name of the level
+     */
+    const char *level_name(SimdLevel level);
+
+    void add(double *lhs, const double *rhs, std::size_t n);
+
+    void sub(double *lhs, const double *rhs, std::size_t n);
+
+    void mul(double *lhs, const double *rhs, std::size_t n);
+
+    void div(double *lhs, const double *rhs, std::size_t n);
+
+    /**
+     * The element-wise kernels for single precision, processing twice as many elements per vector.
+     */
+    void add(float *lhs, const float *rhs, std::size_t n);
+
+    void sub(float *lhs, const float *rhs, std::size_t n);
+
+    void mul(float *lhs, const float *rhs, std::size_t n);
+
+    void div(float *lhs, const float *rhs, std::size_t n);
+
+    /**
+     * Evaluates a polynomial by Horner's method.
+     * @param coefficients coefficients in ascending order of degree, coefficients[0] being the constant term
+     * @param count number of coefficients, at least 1
+     * @param x place to evaluate at
+     * @return value of the polynomial
+     */
+    double horner(const double *coefficients, std::size_t count, double x);
+
+    /**
+     * Evaluates a polynomial by Horner's method at n places, giving the same results as horner() for each.
+     * @see horner()
+     */
+    void horner_block(const double *coefficients, std::size_t count, const double *xs, double *out, std::size_t n);
+
+    /**
+     * Evaluates a Chebyshev series by Clenshaw's recurrence.
+     * @param coefficients coefficients of T0, T1, ... in this order
+     * @param count number of coefficients, at least 1
+     * @param t place to evaluate at, normally in [-1, 1]
+     * @return value of the series
+     */
+    double clenshaw(const double *coefficients, std::size_t count, double t);
+
+    /**
+     * Evaluates a Chebyshev series by Clenshaw's recurrence at n places, giving the same results as clenshaw() for
+     * each.
+     * @see clenshaw()
+     */
+    void clenshaw_block(const double *coefficients, std::size_t count, const double *ts, double *out, std::size_t n);
+}
+
+#endif //C11NHF_BATCHKERNELS_H
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <math.h>
+#include "BatchRunner.h"
+#include "Parser.h"
+#include "PolynomialDetector.h"
+#include "StrengthReduction.h"
+#include "ThreadPool.h"
+
+const std::size_t BatchRunner::CHUNK_LINES;
+const std::size_t BatchRunner::WINDOW_PER_THREAD;
+
+/**
+ * A chunk of lines and its results. Chunks are recycled, so their strings keep their capacity between uses.
+ */
+struct BatchChunk {
+    std::size_t count = 0;
+    std::size_t numbers[BatchRunner::CHUNK_LINES];
+    std::string texts[BatchRunner::CHUNK_LINES];
+    std::string output;
+    std::string errors;
+    std::size_t failed = 0;
+    bool done = false;
+};
+
+static void appendBinary(std::string &output, const void *data, std::size_t size) {
+    output.append(static_cast<const char *>(data), size);
+}
+
+static void appendCsv(std::string &output, double value) {
+    char buffer[32];
+    int length = snprintf(buffer, sizeof buffer, "%.17g", value);
+    output.append(buffer, std::size_t(length));
+}
+
+/**
+ * Evaluates the formulas of a chunk and formats their results.
+ * @param values scratch array of xs.size() values
+ */
+static void processChunk(BatchChunk &chunk, const BatchOptions &options, const std::vector<double> &xs,
+                         std::vector<double> &values) {
+    chunk.output.clear();
+    chunk.errors.clear();
+    chunk.failed = 0;
+    StrengthReduction reduction{options.fast_math};
+    for (std::size_t i = 0; i < chunk.count; i++) {
+        try {
+            std::unique_ptr<Expression> exp = parseExpression(chunk.texts[i])->simplify();
+            PolynomialDetector().run(exp);
+            reduction.run(exp);
+            exp->evaluate_batch(xs.data(), values.data(), xs.size());
+        } catch (ParseError &err) {
+            std::fill(values.begin(), values.end(), NAN);
+            chunk.failed++;
+            chunk.errors += "line " + std::to_string(chunk.numbers[i]) + ", column " +
+                            std::to_string(err.get_position() + 1) + ": " + err.what() + "\n";
+        } catch (std::exception &err) {
+            std::fill(values.begin(), values.end(), NAN);
+            chunk.failed++;
+            chunk.errors += "line " + std::to_string(chunk.numbers[i]) + ": " + err.what() + "\n";
+        } catch (...) {   /* a registered function may throw anything, it must not end the task of the pool */
+            std::fill(values.begin(), values.end(), NAN);
+            chunk.failed++;
+            chunk.errors += "line " + std::to_string(chunk.numbers[i]) + ": unknown exception\n";
+        }
+        if (options.format == BatchOptions::CSV) {
+            chunk.output += std::to_string(chunk.numbers[i]);
+            for (double value : values) {
+                chunk.output += ',';
+                appendCsv(chunk.output, value);
+            }
+            chunk.output += '\n';
+        } else {
+            std::uint64_t number = chunk.numbers[i];
+            appendBinary(chunk.output, &number, sizeof number);
+            appendBinary(chunk.output, values.data(), values.size() * sizeof(double));
+        }
+    }
+}
+
+BatchRunner::BatchRunner(const BatchOptions &options) : options(options) {
+    if (options.samples == 0 || (options.samples > 1 && !(options.x_min < options.x_max)))
+        throw std::invalid_argument("Invalid range or number of samples for a batch run");
+}
+
+BatchStats BatchRunner::run(std::istream &in, std::ostream &out, std::ostream *errors) const {
+    std::vector<double> xs(options.samples);
+    double step = options.samples > 1 ? (options.x_max - options.x_min) / double(options.samples - 1) : 0.0;
+    for (std::size_t i = 0; i < xs.size(); i++)
+        xs[i] = options.x_min + step * double(i);
+    std::string header;
+    if (options.format == BatchOptions::CSV) {
+        header = "line";
+        for (double x : xs) {
+            header += ',';
+            appendCsv(header, x);
+        }
+        header += '\n';
+    } else {
+        std::uint64_t n = xs.size();
+        appendBinary(header, &n, sizeof n);
+        appendBinary(header, xs.data(), xs.size() * sizeof(double));
+    }
+    out.write(header.data(), std::streamsize(header.size()));
+
+    BatchStats stats{0, 0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::deque<std::unique_ptr<BatchChunk>> flight;
+    std::vector<std::unique_ptr<BatchChunk>> spare;
+    ThreadPool pool{options.threads};
+    std::size_t window = WINDOW_PER_THREAD * pool.size();
+
+    auto write_oldest = [&]() {
+        BatchChunk &chunk = *flight.front();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&chunk]() { return chunk.done; });
+        }
+        out.write(chunk.output.data(), std::streamsize(chunk.output.size()));
+        if (errors)
+            errors->write(chunk.errors.data(), std::streamsize(chunk.errors.size()));
+        stats.formulas += chunk.count;
+        stats.failed += chunk.failed;
+        spare.push_back(std::move(flight.front()));
+        flight.pop_front();
+    };
+    auto dispatch = [&](std::unique_ptr<BatchChunk> chunk) {
+        if (flight.size() >= window)
+            write_oldest();
+        BatchChunk *raw = chunk.get();
+        raw->done = false;
+        flight.push_back(std::move(chunk));
+        pool.submit([&, raw]() {
+            std::vector<double> values(xs.size());
+            processChunk(*raw, options, xs, values);
+            std::lock_guard<std::mutex> lock(mutex);
+            raw->done = true;
+            finished.notify_all();
+        });
+    };
+    auto take_spare = [&]() {
+        std::unique_ptr<BatchChunk> chunk;
+        if (spare.empty()) {
+            chunk.reset(new BatchChunk);
+        } else {
+            chunk = std::move(spare.back());
+            spare.pop_back();
+        }
+        chunk->count = 0;
+        return chunk;
+    };
+
+    std::unique_ptr<BatchChunk> current = take_spare();
+    std::string line;
+    std::size_t number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        std::size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        current->numbers[current->count] = number;
+        current->texts[current->count].assign(line);
+        if (++current->count == CHUNK_LINES) {
+            dispatch(std::move(current));
+            current = take_spare();
+        }
+    }
+    if (current->count > 0)
+        dispatch(std::move(current));
+    while (!flight.empty())
+        write_oldest();
+    return stats;
+}
@@ -0,0 +1,93 @@
+#ifndef C11NHF_BATCHRUNNER_H
+#define C11NHF_BATCHRUNNER_H
+#include <cstddef>
+#include <istream>
+#include <ostream>
+
+/**
+ * Settings of a BatchRunner.
+ */
+struct BatchOptions {
+    /**
+     * Format of the results.
+     * CSV: a header row "line,x0,x1,...", then a row "line,y0,y1,..." per formula, with 17 significant digits.
+     * BINARY: a uint64 n and the n places as doubles, then a record per formula: its uint64 line number and its n
+     * values as doubles, all in the byte order of the machine.
+     */
+    enum Format {
+        CSV,
+        BINARY
+    };
+
+    double x_min = -10.0;
+    double x_max = 10.0;
+
+    /**
+     * Number of evenly spaced places of [x_min, x_max] every formula is evaluated at, both ends included.
+     */
+    std::size_t samples = 101;
+
+    Format format = CSV;
+
+    /**
+     * Number of worker threads, the number of processors if 0.
+     */
+    unsigned threads = 0;
+
+    /**
+     * Whether StrengthReduction may turn divisions by constants into multiplications.
+     */
+    bool fast_math = false;
+};
+
+/**
+ * Totals of a BatchRunner::run() call.
+ */
+struct BatchStats {
+    std::size_t formulas;
+    std::size_t failed;
+};
+
+/**
+ * Headless evaluation of a stream of formulas, one per line. Every formula is parsed, simplified, optimized like
+ * the interactive plot's (PolynomialDetector, StrengthReduction) and evaluated over the places of the options.
+ * Blank lines and lines starting with '#' are skipped.
+ * The lines are read in chunks of CHUNK_LINES and handed to a pool of worker threads, which also format the
+ * results; the calling thread reads and writes. At most WINDOW_PER_THREAD chunks per worker are in flight: when
+ * the window is full, the reader waits for the oldest chunk and writes it, so the results come out in input order
+ * and the memory used doesn't depend on the length of the input.
+ */
+class BatchRunner {
+public:
+    /**
+     * Number of lines in a chunk, the unit of work of the workers.
+     */
+    static const std::size_t CHUNK_LINES = 64;
+
+    /**
+     * Number of chunks in flight per worker, so a worker finds queued work while the writer is busy.
+     */
+    static const std::size_t WINDOW_PER_THREAD = 4;
+
+    /**
+     * @param options places, output format and threads
+     * @throws std::invalid_argument if there are no samples, or a range of several samples is not x_min < x_max
+     */
+    explicit BatchRunner(const BatchOptions &options);
+
+    /**
+     * Evaluates every formula of a stream.
+     * @param in formulas, one per line
+     * @param out receives the results, in input order
+     * @param errors receives a line for every formula that fails, in input order, if not nullptr: "line N, column C:
+     *        message" if it can't be parsed, "line N: message" if simplifying or evaluating it throws; the values of
+     *        such formulas are NaN
+     * @return number of formulas, and of the ones that failed
+     */
+    BatchStats run(std::istream &in, std::ostream &out, std::ostream *errors = nullptr) const;
+
+private:
+    BatchOptions options;
+};
+
+#endif //C11NHF_BATCHRUNNER_H
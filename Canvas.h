@@ -0,0 +1,75 @@
+#ifndef C11NHF_CANVAS_H
+#define C11NHF_CANVAS_H
+#include <cstddef>
+
+/**
+ * An RGBA color.
+ */
+struct Color {
+    unsigned char r, g, b, a;
+};
+
+/**
+ * A pixel position, x growing to the right and y downwards. It may lie outside the canvas.
+ */
+struct CanvasPoint {
+    int x, y;
+};
+
+/**
+ * Surface the Plotter draws on. Implementations are a window (SdlCanvas) and an in-memory image (ImageCanvas).
+ */
+class Canvas {
+public:
+    virtual ~Canvas() = default;
+
+    /**
+     * Returns the current width of the drawable area, it may change between frames, e.g. when a window is resized.
+     * @return width in pixels
+     */
+    virtual int get_width() const = 0;
+
+    /**
+     * Returns the current height of the drawable area.
+     * @return height in pixels
+     */
+    virtual int get_height() const = 0;
+
+    /**
+     * Fills the whole canvas with a color.
+     * @param color fill color
+     */
+    virtual void clear(Color color) = 0;
+
+    /**
+     * Draws a connected line through the points, clipped to the canvas.
+     * @param points vertices of the line
+     * @param count number of vertices, at least 2
+     * @param color line color
+     */
+    virtual void draw_lines(const CanvasPoint *points, std::size_t count, Color color) = 0;
+
+    /**
+     * Draws separate segments, points[2 * i] to points[2 * i + 1], clipped to the canvas, all in one call.
+     * @param points ends of the segments
+     * @param count number of points, even
+     * @param color line color
+     */
+    virtual void draw_segments(const CanvasPoint *points, std::size_t count, Color color) = 0;
+
+    /**
+     * Draws an image with its top left corner at the top left corner of the canvas, the parts beyond the canvas are
+     * dropped. Pixels are copied as they are, alpha included.
+     * @param pixels width * height colors, row by row from the top
+     * @param width width of the image in pixels
+     * @param height height of the image in pixels
+     */
+    virtual void draw_image(const Color *pixels, int width, int height) = 0;
+
+    /**
+     * Shows what has been drawn since the last call.
+     */
+    virtual void present() = 0;
+};
+
+#endif //C11NHF_CANVAS_H
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include "ChebyshevProxy.h"
+#include "BatchKernels.h"
+
+const int ChebyshevProxy::MAX_DEGREE;
+const int ChebyshevProxy::MAX_SPLITS;
+
+static const double PI = 3.14159265358979323846;
+
+ChebyshevProxy::ChebyshevProxy(const Expression &exp, double a, double b, double tolerance) :
+        exact{exp.clone()}, a{a}, b{b}, tolerance{tolerance}, max_error{0.0} {
+    if (!(a < b) || !isfinite(a) || !isfinite(b) || !(tolerance > 0.0))
+        throw std::invalid_argument("Invalid range or tolerance for a Chebyshev proxy");
+    std::vector<int> depths;
+    fit(a, b, 0, depths);
+    int finest = *std::max_element(depths.begin(), depths.end());
+    cells.resize(std::size_t(1) << finest);
+    std::size_t cell = 0;
+    for (std::size_t i = 0; i < pieces.size(); i++) {
+        std::size_t count = std::size_t(1) << (finest - depths[i]);
+        std::fill(cells.begin() + cell, cells.begin() + cell + count, unsigned(i));
+        cell += count;
+    }
+    cells_per_unit = double(cells.size()) / (b - a);
+}
+
+ChebyshevProxy::ChebyshevProxy(const ChebyshevProxy &other) :
+        exact{other.exact->clone()}, a{other.a}, b{other.b}, tolerance{other.tolerance}, max_error{other.max_error},
+        pieces(other.pieces), cells(other.cells), cells_per_unit{other.cells_per_unit} { }
+
+void ChebyshevProxy::fit(double lo, double hi, int depth, std::vector<int> &depths) {
+    const int n = MAX_DEGREE + 1, checks = 4 * MAX_DEGREE + 1;
+    double xs[checks], ys[checks];
+    double mid = (lo + hi) / 2, half = (hi - lo) / 2;
+    for (int j = 0; j < n; j++)   /* the Chebyshev points of the first kind */
+        xs[j] = mid + half * cos(PI * (j + 0.5) / n);
+    exact->evaluate_batch(xs, ys, n);
+    bool finite = true;
+    for (int j = 0; j < n; j++)
+        finite = finite && isfinite(ys[j]);
+
+    Piece piece{lo, hi, std::vector<double>{}};
+    double error = INFINITY;
+    if (finite) {
+        std::vector<double> c(n);
+        for (int k = 0; k < n; k++) {
+            double sum = 0.0;
+            for (int j = 0; j < n; j++)
+                sum += ys[j] * cos(PI * k * (j + 0.5) / n);
+            c[k] = sum * 2.0 / n;
+        }
+        c[0] /= 2;
+        /* the last two coefficients (one of each parity) estimate what the series still misses */
+        if (fabs(c[n - 1]) + fabs(c[n - 2]) <= tolerance / 8) {
+            int degree = n - 1;
+            double dropped = 0.0;
+            while (degree > 0 && dropped + fabs(c[degree]) <= tolerance / 4)
+                dropped += fabs(c[degree--]);
+            c.resize(degree + 1);
+            piece.coefficients = std::move(c);
+            for (int i = 0; i < checks; i++)
+                xs[i] = lo + (hi - lo) * i / (checks - 1);
+            exact->evaluate_batch(xs, ys, checks);
+            error = 0.0;
+            for (int i = 0; i < checks; i++)
+                error = std::max(error, isfinite(ys[i]) ? fabs(clenshaw(piece, xs[i]) - ys[i]) : INFINITY);
+        }
+    }
+
+    if (error <= tolerance) {
+        max_error = std::max(max_error, error);
+    } else if (depth < MAX_SPLITS) {
+        fit(lo, mid, depth + 1, depths);
+        fit(mid, hi, depth + 1, depths);
+        return;
+    } else {
+        piece.coefficients.clear();
+    }
+    pieces.push_back(std::move(piece));
+    depths.push_back(depth);
+}
+
+std::size_t ChebyshevProxy::locate(double x) const {
+    if (!(x >= a && x <= b))
+        return pieces.size();
+    std::size_t cell = std::size_t((x - a) * cells_per_unit);
+    return cells[std::min(cell, cells.size() - 1)];
+}
+
+double ChebyshevProxy::clenshaw(const Piece &piece, double x) {
+    double t = (2 * x - piece.lo - piece.hi) * (1.0 / (piece.hi - piece.lo));
+    return BatchKernels::clenshaw(piece.coefficients.data(), piece.coefficients.size(), t);
+}
+
+double ChebyshevProxy::evaluate(double x) const {
+    std::size_t i = locate(x);
+    if (i == pieces.size() || pieces[i].coefficients.empty())
+        return exact->evaluate(x);
+    return clenshaw(pieces[i], x);
+}
+
+void ChebyshevProxy::evaluate_block(const double *xs, double *out, std::size_t n) const {
+    double ts[BATCH_BLOCK];
+    std::size_t i = 0;
+    while (i < n) {
+        std::size_t index = locate(xs[i]), end = i + 1;
+        while (end < n && locate(xs[end]) == index)
+            end++;
+        if (index == pieces.size() || pieces[index].coefficients.empty()) {
+            exact->evaluate_block(xs + i, out + i, end - i);
+        } else {   /* the places of a piece are evaluated together, mapped the same way as in clenshaw() */
+            const Piece &piece = pieces[index];
+            double scale = 1.0 / (piece.hi - piece.lo);
+            for (std::size_t k = i; k < end; k++)
+                ts[k - i] = (2 * xs[k] - piece.lo - piece.hi) * scale;
+            BatchKernels::clenshaw_block(piece.coefficients.data(), piece.coefficients.size(), ts, out + i, end - i);
+        }
+        i = end;
+    }
+}
+
+Dual ChebyshevProxy::evaluate_with_derivative(double x) const {
+    return Dual{evaluate(x), exact->evaluate_with_derivative(x).derivative};
+}
+
+Interval ChebyshevProxy::evaluate_interval(double lo, double hi) const {
+    return exact->evaluate_interval(lo, hi) + Interval{-max_error, max_error};
+}
+
+std::unique_ptr<Expression> ChebyshevProxy::differentiate() const {
+    return exact->differentiate();
+}
+
+void ChebyshevProxy::print(std::ostream &os) const {
+    exact->print(os);
+}
+
+ChebyshevProxy *ChebyshevProxy::clone() const {
+    return new ChebyshevProxy{*this};
+}
+
+double ChebyshevProxy::get_max_error() const {
+    return max_error;
+}
+
+const std::vector<ChebyshevProxy::Piece> &ChebyshevProxy::get_pieces() const {
+    return pieces;
+}
+
+const Expression &ChebyshevProxy::get_exact() const {
+    return *exact;
+}
@@ -0,0 +1,145 @@
+#ifndef C11NHF_CHEBYSHEVPROXY_H
+#define C11NHF_CHEBYSHEVPROXY_H
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "Expressions.h"
+
+/**
+ * Piecewise Chebyshev approximation of an expression over [a, b], standing in for the expression where it is
+ * evaluated many times. The range is halved recursively until the expression fits a Chebyshev series of at most
+ * MAX_DEGREE on every piece within the tolerance; the series of a piece is interpolated at the Chebyshev points,
+ * then cut after the last coefficient that matters, so smooth pieces get low degrees. A fit is accepted after
+ * comparing it with the expression on a grid of 4 * MAX_DEGREE + 1 places of the piece.
+ * Pieces that can't be fitted even after MAX_SPLITS halvings, like the ones around the poles of tan(X), jumps or
+ * places where the expression isn't finite, are evaluated by the exact tree, and so are places outside [a, b].
+ *
+ * The series are evaluated by Clenshaw's recurrence with the BatchKernels::clenshaw() kernels. evaluate_block()
+ * hands all consecutive places of the same piece to the block kernel at once, so sweeps over the range are
+ * vectorized.
+ */
+class ChebyshevProxy final : public Expression {
+public:
+    /**
+     * Highest degree of the series of a piece.
+     */
+    static const int MAX_DEGREE = 16;
+
+    /**
+     * Number of halvings of the range at most, giving pieces of (b - a) / 4096.
+     */
+    static const int MAX_SPLITS = 12;
+
+    /**
+     * A piece of the range with its series.
+     */
+    struct Piece {
+        double lo, hi;
+
+        /**
+         * Chebyshev coefficients in the variable mapped from [lo, hi] to [-1, 1], the constant term first.
+         * Empty if the piece is evaluated by the exact tree.
+         */
+        std::vector<double> coefficients;
+    };
+
+    /**
+     * Fits the expression over [a, b].
+     * @param exp expression to approximate, cloned
+     * @param a lower end of the range
+     * @param b upper end of the range
+     * @param tolerance largest absolute error allowed on the fitted pieces
+     * @throws std::invalid_argument if a < b or tolerance > 0 doesn't hold
+     */
+    ChebyshevProxy(const Expression &exp, double a, double b, double tolerance);
+
+    ChebyshevProxy(const ChebyshevProxy &other);
+
+    /**
+     * Returns the largest error of the fitted pieces found on their check grids. Between the grid places the error
+     * may be slightly larger.
+     * @return largest absolute difference from the expression
+     */
+    double get_max_error() const;
+
+    /**
+     * Returns the pieces, from left to right.
+     * @return pieces covering [a, b]
+     */
+    const std::vector<Piece> &get_pieces() const;
+
+    /**
+     * Returns the exact expression the proxy stands in for.
+     * @return the cloned expression
+     */
+    const Expression &get_exact() const;
+
+    /**
+     * @see Expression::evaluate()
+     */
+    virtual double evaluate(double x) const override;
+
+    /**
+     * @see Expression::evaluate_block()
+     */
+    virtual void evaluate_block(const double *xs, double *out, std::size_t n) const override;
+
+    /**
+     * The derivative is that of the exact expression, the value that of the proxy.
+     * @see Expression::evaluate_with_derivative()
+     */
+    virtual Dual evaluate_with_derivative(double x) const override;
+
+    /**
+     * Encloses the values of the exact expression, widened by the largest error of the fit.
+     * @see Expression::evaluate_interval()
+     */
+    virtual Interval evaluate_interval(double lo, double hi) const override;
+
+    /**
+     * Differentiates the exact expression.
+     * @see Expression::differentiate()
+     */
+    virtual std::unique_ptr<Expression> differentiate() const override;
+
+    /**
+     * Prints the exact expression.
+     * @see Expression::print()
+     */
+    virtual void print(std::ostream &os) const override;
+
+    /**
+     * @see Expression::clone()
+     */
+    virtual ChebyshevProxy *clone() const override;
+
+private:
+    std::unique_ptr<Expression> exact;
+    double a, b, tolerance, max_error;
+    std::vector<Piece> pieces;
+
+    /**
+     * Index of the piece of every cell, the cells dividing [a, b] evenly at the finest halving used.
+     */
+    std::vector<unsigned> cells;
+    double cells_per_unit;
+
+    /**
+     * Fits [lo, hi], or halves it and fits the halves, appending the pieces.
+     * @param depth number of halvings so far
+     * @param depths receives the depth of every piece appended
+     */
+    void fit(double lo, double hi, int depth, std::vector<int> &depths);
+
+    /**
+     * Returns the index of the piece of a place, pieces.size() if it is outside [a, b].
+     */
+    std::size_t locate(double x) const;
+
+    /**
+     * Evaluates the series of a fitted piece at a place, mapping it to [-1, 1] first.
+     */
+    static double clenshaw(const Piece &piece, double x);
+};
+
+#endif //C11NHF_CHEBYSHEVPROXY_H
@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <math.h>
+#include "CompactExpression.h"
+#include "BatchKernels.h"
+#include "FastMath.h"
+
+CompactExpression::CompactExpression(std::shared_ptr<Symbols> symbols) : symbols{std::move(symbols)}, depth{0} { }
+
+CompactExpression::CompactExpression(const Expression &exp) : symbols{std::make_shared<Symbols>()}, depth{0} {
+    append(exp);
+    measure();
+}
+
+std::uint32_t CompactExpression::append_node(OpCode op, std::uint32_t left, std::uint32_t right) {
+    ops.push_back(op);
+    lhs.push_back(left);
+    rhs.push_back(right);
+    return std::uint32_t(ops.size() - 1);
+}
+
+std::uint32_t CompactExpression::append_constant(double value) {
+    constants.push_back(value);
+    return append_node(CONSTANT, std::uint32_t(constants.size() - 1), 0);
+}
+
+/**
+ * Returns the opcode of an operator node, OTHER if it is not one of the operators of Expressions.h.
+ */
+static CompactExpression::OpCode operatorCode(const TwoOperand &op) {
+    switch (op.get_operator()) {
+        case '+':
+            return CompactExpression::SUM;
+        case '-':
+            return CompactExpression::DIF;
+        case '*':
+            return CompactExpression::PROD;
+        case '/':
+            return CompactExpression::DIV;
+        case '^':
+            return CompactExpression::EXP;
+        default:
+            return CompactExpression::OTHER;
+    }
+}
+
+std::uint32_t CompactExpression::append(const Expression &exp) {
+    /* postfix walk with an explicit stack, so trees of any depth can be converted: an operator or function is taken
+       once to push its operands, and once more, with its opcode, to append it after them; roots holds the indices
+       of the subtrees appended and not yet taken by their parent */
+    struct Step {
+        const Expression *node;
+        OpCode code;
+        bool operands_appended;
+    };
+    std::vector<Step> walk;
+    std::vector<std::uint32_t> roots;
+    walk.push_back(Step{&exp, OTHER, false});
+    while (!walk.empty()) {
+        Step step = walk.back();
+        walk.pop_back();
+        const Expression *node = step.node;
+        if (step.operands_appended) {
+            if (step.code == FUNCTION) {
+                const Function *func = static_cast<const Function *>(node);
+                std::vector<FunctionTarget> &functions = symbols->functions;
+                std::size_t index = 0;
+                while (index < functions.size() && functions[index].entry->name != func->entry->name)
+                    index++;
+                if (index == functions.size())
+                    functions.push_back(FunctionTarget{*func});
+                roots.back() = append_node(FUNCTION, roots.back(), std::uint32_t(index));
+            } else {
+                std::uint32_t right = roots.back();
+                roots.pop_back();
+                roots.back() = append_node(step.code, roots.back(), right);
+            }
+            continue;
+        }
+        Expression::Shape shape = node->shape();
+        if (shape == Expression::Shape::BINARY) {
+            const TwoOperand *op = static_cast<const TwoOperand *>(node);
+            OpCode code = operatorCode(*op);
+            if (code != OTHER) {
+                walk.push_back(Step{node, code, true});
+                walk.push_back(Step{op->rhs.get(), OTHER, false});
+                walk.push_back(Step{op->lhs.get(), OTHER, false});
+                continue;
+            }
+        } else if (shape == Expression::Shape::CALL) {
+            walk.push_back(Step{node, FUNCTION, true});
+            walk.push_back(Step{static_cast<const Function *>(node)->arg.get(), OTHER, false});
+            continue;
+        } else if (const Constant *cons = dynamic_cast<const Constant *>(node)) {
+            roots.push_back(append_constant(cons->get_value()));
+            continue;
+        } else if (const Variable *var = dynamic_cast<const Variable *>(node)) {
+            std::vector<std::string> &names = symbols->variable_names;
+            if (var->slot >= names.size())
+                names.resize(var->slot + 1);
+            names[var->slot] = var->name;
+            roots.push_back(append_node(VARIABLE, var->slot, 0));
+            continue;
+        }
+        symbols->others.push_back(std::unique_ptr<Expression>(node->clone()));
+        roots.push_back(append_node(OTHER, 0, std::uint32_t(symbols->others.size() - 1)));
+    }
+    return roots.back();
+}
+
+void CompactExpression::measure() {
+    std::size_t height = 0;
+    depth = 0;
+    for (OpCode op : ops) {
+        if (op == CONSTANT || op == VARIABLE || op == OTHER)
+            depth = std::max(depth, ++height);
+        else if (op != FUNCTION)
+            height--;
+    }
+}
+
+std::unique_ptr<Expression> CompactExpression::to_expression() const {
+    std::vector<std::unique_ptr<Expression>> stack;
+    stack.reserve(depth);
+    for (std::size_t i = 0; i < ops.size(); i++) {
+        if (ops[i] >= SUM && ops[i] <= EXP) {
+            std::unique_ptr<Expression> right = std::move(stack.back());
+            stack.pop_back();
+            std::unique_ptr<Expression> left = std::move(stack.back());
+            Expression *node;
+            switch (ops[i]) {
+                case SUM:
+                    node = new Sum{std::move(left), std::move(right)};
+                    break;
+                case DIF:
+                    node = new Dif{std::move(left), std::move(right)};
+                    break;
+                case PROD:
+                    node = new Prod{std::move(left), std::move(right)};
+                    break;
+                case DIV:
+                    node = new Div{std::move(left), std::move(right)};
+                    break;
+                default:
+                    node = new Exp{std::move(left), std::move(right)};
+                    break;
+            }
+            stack.back().reset(node);
+        } else if (ops[i] == FUNCTION) {
+            std::unique_ptr<Expression> &arg = stack.back();
+            arg = symbols->functions[rhs[i]].call(std::move(arg));
+        } else if (ops[i] == CONSTANT) {
+            stack.push_back(std::unique_ptr<Expression>(new Constant{constants[lhs[i]]}));
+        } else if (ops[i] == VARIABLE) {
+            stack.push_back(std::unique_ptr<Expression>(new Variable{lhs[i], symbols->variable_names[lhs[i]]}));
+        } else {
+            stack.push_back(std::unique_ptr<Expression>(symbols->others[rhs[i]]->clone()));
+        }
+    }
+    return std::move(stack.back());
+}
+
+double CompactExpression::evaluate(double x) const {
+    thread_local std::vector<double> stack;
+    if (stack.size() < depth)
+        stack.resize(depth);
+    double *s = stack.data();
+    std::size_t top = 0;   /* number of values on the stack */
+    for (std::size_t i = 0; i < ops.size(); i++) {
+        switch (ops[i]) {
+            case CONSTANT:
+                s[top++] = constants[lhs[i]];
+                break;
+            case VARIABLE:
+                s[top++] = lhs[i] == 0 ? x : NAN;
+                break;
+            case SUM:
+                top--;
+                s[top - 1] = s[top - 1] + s[top];
+                break;
+            case DIF:
+                top--;
+                s[top - 1] = s[top - 1] - s[top];
+                break;
+            case PROD:
+                top--;
+                s[top - 1] = s[top - 1] * s[top];
+                break;
+            case DIV:
+                top--;
+                s[top - 1] = s[top - 1] / s[top];
+                break;
+            case EXP:
+                top--;
+                s[top - 1] = pow(s[top - 1], s[top]);
+                break;
+            case FUNCTION:
+                s[top - 1] = symbols->functions[rhs[i]].apply(s[top - 1]);
+                break;
+            case OTHER:
+                s[top++] = symbols->others[rhs[i]]->evaluate(x);
+                break;
+        }
+    }
+    return s[0];
+}
+
+void CompactExpression::evaluate_batch(const double *xs, double *out, std::size_t n) const {
+    const std::size_t block = Expression::BATCH_BLOCK;
+    thread_local std::vector<double> stack;
+    if (stack.size() < depth * block)
+        stack.resize(depth * block);
+    for (std::size_t start = 0; start < n; start += block) {
+        std::size_t count = std::min(block, n - start);
+        const double *places = xs + start;
+        double *top = stack.data();   /* the free block above the stack */
+        for (std::size_t i = 0; i < ops.size(); i++) {
+            double *left = top - 2 * block, *right = top - block;
+            switch (ops[i]) {
+                case CONSTANT:
+                    std::fill(top, top + count, constants[lhs[i]]);
+                    top += block;
+                    break;
+                case VARIABLE:
+                    if (lhs[i] == 0)
+                        std::copy(places, places + count, top);
+                    else
+                        std::fill(top, top + count, NAN);
+                    top += block;
+                    break;
+                case SUM:
+                    BatchKernels::add(left, right, count);
+                    top -= block;
+                    break;
+                case DIF:
+                    BatchKernels::sub(left, right, count);
+                    top -= block;
+                    break;
+                case PROD:
+                    BatchKernels::mul(left, right, count);
+                    top -= block;
+                    break;
+                case DIV:
+                    BatchKernels::div(left, right, count);
+                    top -= block;
+                    break;
+                case EXP:
+                    FastMath::pow_block(left, right, count);
+                    top -= block;
+                    break;
+                case FUNCTION:
+                    symbols->functions[rhs[i]].apply_block(right, count);
+                    break;
+                case OTHER:
+                    symbols->others[rhs[i]]->evaluate_block(places, top, count);
+                    top += block;
+                    break;
+            }
+        }
+        std::copy(stack.data(), stack.data() + count, out + start);
+    }
+}
+
+void CompactExpression::print(std::ostream &os) const {
+    static const char OPERATORS[] = {0, 0, '+', '-', '*', '/', '^'};
+    /* nodes being printed, with the number of their operands printed so far */
+    std::vector<std::pair<std::uint32_t, unsigned>> walk;
+    walk.push_back(std::make_pair(std::uint32_t(ops.size() - 1), 0u));
+    while (!walk.empty()) {
+        std::uint32_t i = walk.back().first;
+        unsigned done = walk.back().second++;
+        switch (ops[i]) {
+            case CONSTANT:
+                os << constants[lhs[i]];
+                walk.pop_back();
+                break;
+            case VARIABLE:
+                os << symbols->variable_names[lhs[i]];
+                walk.pop_back();
+                break;
+            case OTHER:
+                symbols->others[rhs[i]]->print(os);
+                walk.pop_back();
+                break;
+            case FUNCTION:
+                if (done == 0) {
+                    os << symbols->functions[rhs[i]].entry->name << '(';
+                    walk.push_back(std::make_pair(lhs[i], 0u));
+                } else {
+                    os << ')';
+                    walk.pop_back();
+                }
+                break;
+            default:
+                if (done == 0) {
+                    os << '(';
+                    walk.push_back(std::make_pair(lhs[i], 0u));
+                } else if (done == 1) {
+                    os << OPERATORS[ops[i]];
+                    walk.push_back(std::make_pair(rhs[i], 0u));
+                } else {
+                    os << ')';
+                    walk.pop_back();
+                }
+                break;
+        }
+    }
+}
+
+CompactExpression CompactExpression::simplify() const {
+    CompactExpression out{symbols};
+    out.ops.reserve(ops.size());
+    out.lhs.reserve(ops.size());
+    out.rhs.reserve(ops.size());
+    /* the node of out every node stands for */
+    std::vector<std::uint32_t> result(ops.size());
+    for (std::size_t i = 0; i < ops.size(); i++) {
+        OpCode op = ops[i];
+        if (op == CONSTANT) {
+            result[i] = out.append_constant(constants[lhs[i]]);
+            continue;
+        }
+        if (op == VARIABLE || op == OTHER) {
+            result[i] = out.append_node(op, lhs[i], rhs[i]);
+            continue;
+        }
+        std::uint32_t a = result[lhs[i]];
+        bool a_constant = out.ops[a] == CONSTANT;
+        double *va = a_constant ? &out.constants[out.lhs[a]] : nullptr;
+        if (op == FUNCTION) {
+            if (a_constant) {   /* f(c) = C */
+                *va = symbols->functions[rhs[i]].apply(*va);
+                result[i] = a;
+            } else {
+                result[i] = out.append_node(FUNCTION, a, rhs[i]);
+            }
+            continue;
+        }
+        std::uint32_t b = result[rhs[i]];
+        bool b_constant = out.ops[b] == CONSTANT;
+        double *vb = b_constant ? &out.constants[out.lhs[b]] : nullptr;
+        std::uint32_t node = std::uint32_t(-1);
+        switch (op) {
+            case SUM:
+                if (b_constant && *vb == 0.0)   /* a + 0 = a */
+                    node = a;
+                else if (a_constant && *va == 0.0)   /* 0 + a = a */
+                    node = b;
+                else if (a_constant && b_constant)
+                    *va = *va + *vb, node = a;
+                break;
+            case DIF:
+                if (b_constant && *vb == 0.0)   /* a - 0 = a */
+                    node = a;
+                else if (a_constant && b_constant)
+                    *va = *va - *vb, node = a;
+                break;
+            case PROD:
+                if (a_constant && *va == 0.0)   /* 0 * a = 0 */
+                    node = a;
+                else if (b_constant && *vb == 0.0)   /* a * 0 = 0 */
+                    node = b;
+                else if (b_constant && *vb == 1.0)   /* a * 1 = a */
+                    node = a;
+                else if (a_constant && *va == 1.0)   /* 1 * a = a */
+                    node = b;
+                else if (a_constant && b_constant)
+                    *va = *va * *vb, node = a;
+                break;
+            case DIV:
+                if (a_constant && *va == 0.0)   /* 0 / a = 0 */
+                    node = a;
+                else if (b_constant && *vb == 0.0)   /* a / 0 = ERR */
+                    throw std::runtime_error("Division by 0!");
+                else if (b_constant && *vb == 1.0)   /* a / 1 = a */
+                    node = a;
+                else if (a_constant && b_constant)
+                    *va = *va / *vb, node = a;
+                break;
+            default:
+                if (a_constant && *va == 1.0)   /* 1 ^ a = 1 */
+                    node = a;
+                else if (b_constant && *vb == 1.0)   /* a ^ 1 = a */
+                    node = a;
+                else if (b_constant && *vb == 0.0)   /* a ^ 0 = 1 */
+                    *vb = 1.0, node = b;
+                else if (a_constant && b_constant)
+                    *va = pow(*va, *vb), node = a;
+                break;
+        }
+        result[i] = node != std::uint32_t(-1) ? node : out.append_node(op, a, b);
+    }
+
+    /* drop the nodes the rules made unreachable; the others keep their order, which stays postfix */
+    std::size_t count = out.ops.size();
+    std::vector<std::uint32_t> renumbered(count, 0);
+    std::vector<char> reachable(count, 0);
+    reachable[result.back()] = 1;
+    for (std::size_t i = count; i-- > 0;) {
+        if (!reachable[i])
+            continue;
+        if (out.ops[i] >= SUM && out.ops[i] <= FUNCTION)
+            reachable[out.lhs[i]] = 1;
+        if (out.ops[i] >= SUM && out.ops[i] <= EXP)
+            reachable[out.rhs[i]] = 1;
+    }
+    std::size_t kept = 0, kept_constants = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        if (!reachable[i])
+            continue;
+        OpCode op = out.ops[i];
+        std::uint32_t left = out.lhs[i], right = out.rhs[i];
+        if (op == CONSTANT) {
+            out.constants[kept_constants] = out.constants[left];
+            left = std::uint32_t(kept_constants++);
+        } else if (op >= SUM && op <= FUNCTION) {
+            left = renumbered[left];
+            if (op != FUNCTION)
+                right = renumbered[right];
+        }
+        out.ops[kept] = op;
+        out.lhs[kept] = left;
+        out.rhs[kept] = right;
+        renumbered[i] = std::uint32_t(kept++);
+    }
+    out.ops.resize(kept);
+    out.lhs.resize(kept);
+    out.rhs.resize(kept);
+    out.constants.resize(kept_constants);
+    out.ops.shrink_to_fit();
+    out.lhs.shrink_to_fit();
+    out.rhs.shrink_to_fit();
+    out.constants.shrink_to_fit();
+    out.measure();
+    return out;
+}
+
+std::size_t CompactExpression::size() const {
+    return ops.size();
+}
+
+std::size_t CompactExpression::node_bytes() const {
+    return ops.size() * (sizeof(OpCode) + 2 * sizeof(std::uint32_t)) + constants.size() * sizeof(double);
+}
+
+const std::vector<CompactExpression::OpCode> &CompactExpression::get_ops() const {
+    return ops;
+}
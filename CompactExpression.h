@@ -0,0 +1,140 @@
+#ifndef C11NHF_COMPACTEXPRESSION_H
+#define C11NHF_COMPACTEXPRESSION_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Expressions.h"
+
+/**
+ * Compact, struct-of-arrays form of an Expression tree, for very large generated expressions. A node is an opcode
+ * byte and two 32-bit operands, 9 bytes, where a tree node costs a vtable pointer, two unique_ptrs and a heap block
+ * of its own, and a Function node a std::function and a std::string more. Constants are kept in an array of their
+ * own, functions and variable names in a symbol table interned by name and shared by the copies and the simplified
+ * forms of the expression.
+ * The nodes are stored in postfix order, the operands of a node right before it and the root last, so evaluation,
+ * conversion back to a tree and simplification are single linear scans with an explicit stack, and printing is a
+ * walk with an explicit stack; none of them recurses.
+ * Conversion is lossless: to_expression() rebuilds a tree that prints and evaluates the same as the original, node
+ * types without an opcode (Polynomial, ChebyshevProxy, ...) being kept as copies in the symbol table. Values are
+ * bit-identical to those of the tree: evaluate() to Expression::evaluate(), evaluate_batch() to
+ * Expression::evaluate_batch(), so to Expression::evaluate() as well in the EXACT precision of FastMath only.
+ */
+class CompactExpression {
+public:
+    /**
+     * Operation of a node, and the meaning of its operands.
+     */
+    enum OpCode : std::uint8_t {
+        CONSTANT, /**< lhs is the index of the value in the constant array */
+        VARIABLE, /**< lhs is the slot of the variable */
+        SUM,      /**< lhs and rhs are the indices of the operands */
+        DIF,
+        PROD,
+        DIV,
+        EXP,
+        FUNCTION, /**< lhs is the argument, rhs the index of the function in the symbol table */
+        OTHER     /**< rhs is the index of the copy of the node in the symbol table */
+    };
+
+    /**
+     * Builds the compact form of a tree.
+     * @param exp expression tree, it is not referenced after the constructor returns
+     */
+    explicit CompactExpression(const Expression &exp);
+
+    /**
+     * Builds the tree form, equal to the tree the expression was made of.
+     * @return the tree
+     */
+    std::unique_ptr<Expression> to_expression() const;
+
+    /**
+     * Evaluates the expression at place x.
+     * @see Expression::evaluate()
+     */
+    double evaluate(double x) const;
+
+    /**
+     * Evaluates the expression at n places, a block of Expression::BATCH_BLOCK places at a time.
+     * @see Expression::evaluate_batch()
+     */
+    void evaluate_batch(const double *xs, double *out, std::size_t n) const;
+
+    /**
+     * Prints the expression exactly as Expression::print() prints its tree.
+     * @param os stream to print to
+     */
+    void print(std::ostream &os) const;
+
+    /**
+     * Simplifies the expression in one scan, applying the local rules of Expression::simplify() bottom-up: the
+     * operations and functions of constants are computed, and a+0, 0+a, a-0, a*1, 1*a, a/1, a*0, 0*a, 0/a, a^1,
+     * a^0 and 1^a are reduced. Chains of + and * are not reordered as Simplifier does; convert to a tree and back
+     * for that.
+     * @return the simplified expression, sharing the symbol table
+     * @throws std::runtime_error on a division by a constant 0
+     */
+    CompactExpression simplify() const;
+
+    /**
+     * Returns the number of nodes.
+     * @return number of nodes
+     */
+    std::size_t size() const;
+
+    /**
+     * Returns the memory taken by the nodes and the constants, without the symbol table.
+     * @return bytes of the arrays
+     */
+    std::size_t node_bytes() const;
+
+    /**
+     * Returns the opcodes of the nodes, in postfix order.
+     * @return the opcode array
+     */
+    const std::vector<OpCode> &get_ops() const;
+
+private:
+    /**
+     * Functions, variable names and copied nodes, shared by the expressions derived from the same tree.
+     */
+    struct Symbols {
+        std::vector<FunctionTarget> functions;
+        std::vector<std::string> variable_names;
+        std::vector<std::unique_ptr<Expression>> others;
+    };
+
+    std::vector<OpCode> ops;
+    std::vector<std::uint32_t> lhs;
+    std::vector<std::uint32_t> rhs;
+    std::vector<double> constants;
+    std::shared_ptr<Symbols> symbols;
+
+    /**
+     * Largest number of values on the evaluation stack.
+     */
+    std::size_t depth;
+
+    explicit CompactExpression(std::shared_ptr<Symbols> symbols);
+
+    /**
+     * Appends the nodes of a tree in postfix order, walking it with an explicit stack so its depth is not limited.
+     * @return index of the root of the appended nodes
+     */
+    std::uint32_t append(const Expression &exp);
+
+    std::uint32_t append_node(OpCode op, std::uint32_t left, std::uint32_t right);
+
+    std::uint32_t append_constant(double value);
+
+    /**
+     * Computes the depth of the evaluation stack.
+     */
+    void measure();
+};
+
+#endif //C11NHF_COMPACTEXPRESSION_H
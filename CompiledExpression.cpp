@@ -0,0 +1,177 @@
+#include <math.h>
+#include "CompiledExpression.h"
+
+CompiledExpression::CompiledExpression(const Expression &exp) : max_depth{0} {
+    compile(exp, 0);
+}
+
+/**
+ * Maps the signature character of a TwoOperand to its instruction.
+ * @param op operator character, as returned by TwoOperand::get_operator()
+ * @return matching opcode, EVAL if the operator has no dedicated instruction
+ */
+static CompiledExpression::OpCode opcode_of(char op) {
+    switch (op) {
+        case '+':
+            return CompiledExpression::ADD;
+        case '-':
+            return CompiledExpression::SUB;
+        case '*':
+            return CompiledExpression::MUL;
+        case '/':
+            return CompiledExpression::DIV;
+        case '^':
+            return CompiledExpression::POW;
+        default:
+            return CompiledExpression::EVAL;
+    }
+}
+
+void CompiledExpression::emit(OpCode op, unsigned index, double value, unsigned depth) {
+    Instruction instruction;
+    instruction.op = op;
+    instruction.index = index;
+    instruction.value = value;
+    code.push_back(instruction);
+    if (depth > max_depth)
+        max_depth = depth;
+}
+
+/**
+ * Returns whether the node is the variable X. The variables of other slots are evaluated by their nodes.
+ */
+static bool is_x(const Expression *exp) {
+    const Variable *var = dynamic_cast<const Variable *>(exp);
+    return var && var->slot == 0;
+}
+
+void CompiledExpression::compile(const Expression &exp, unsigned depth) {
+    if (const Constant *cons = dynamic_cast<const Constant *>(&exp)) {
+        emit(PUSH_CONST, 0, cons->get_value(), depth + 1);
+    } else if (is_x(&exp)) {
+        emit(PUSH_VAR, 0, 0.0, depth + 1);
+    } else if (const TwoOperand *op = dynamic_cast<const TwoOperand *>(&exp)) {
+        OpCode code_op = opcode_of(op->get_operator());
+        if (code_op == EVAL) {
+            nodes.push_back(std::unique_ptr<Expression>(exp.clone()));
+            emit(EVAL, nodes.size() - 1, 0.0, depth + 1);
+            return;
+        }
+        compile(*op->lhs, depth);
+        if (const Constant *rhs_cons = dynamic_cast<const Constant *>(op->rhs.get())) {
+            emit(OpCode(code_op + (ADD_CONST - ADD)), 0, rhs_cons->get_value(), depth + 1);
+        } else if (is_x(op->rhs.get())) {
+            emit(OpCode(code_op + (ADD_VAR - ADD)), 0, 0.0, depth + 1);
+        } else {
+            compile(*op->rhs, depth + 1);
+            emit(code_op, 0, 0.0, depth + 1);
+        }
+    } else if (const Function *func = dynamic_cast<const Function *>(&exp)) {
+        compile(*func->arg, depth);
+        if (func->builtin != FunctionRegistry::CUSTOM) {
+            emit(CALL_BUILTIN, func->builtin, 0.0, depth + 1);
+        } else {
+            functions.push_back(func->entry->scalar);
+            emit(CALL, functions.size() - 1, 0.0, depth + 1);
+        }
+    } else {
+        nodes.push_back(std::unique_ptr<Expression>(exp.clone()));
+        emit(EVAL, nodes.size() - 1, 0.0, depth + 1);
+    }
+}
+
+double CompiledExpression::evaluate(double x) const {
+    double local[LOCAL_STACK];
+    std::unique_ptr<double[]> heap;
+    double *stack = local;
+    if (max_depth > LOCAL_STACK) {
+        heap.reset(new double[max_depth]);
+        stack = heap.get();
+    }
+    double top = 0.0;
+    unsigned sp = 0;
+    for (const Instruction *ip = code.data(), *end = ip + code.size(); ip != end; ++ip) {
+        switch (ip->op) {
+            case PUSH_CONST:
+                stack[sp++] = top;
+                top = ip->value;
+                break;
+            case PUSH_VAR:
+                stack[sp++] = top;
+                top = x;
+                break;
+            case ADD:
+                top = stack[--sp] + top;
+                break;
+            case SUB:
+                top = stack[--sp] - top;
+                break;
+            case MUL:
+                top = stack[--sp] * top;
+                break;
+            case DIV:
+                top = stack[--sp] / top;
+                break;
+            case POW:
+                top = pow(stack[--sp], top);
+                break;
+            case ADD_CONST:
+                top = top + ip->value;
+                break;
+            case SUB_CONST:
+                top = top - ip->value;
+                break;
+            case MUL_CONST:
+                top = top * ip->value;
+                break;
+            case DIV_CONST:
+                top = top / ip->value;
+                break;
+            case POW_CONST:
+                top = pow(top, ip->value);
+                break;
+            case ADD_VAR:
+                top = top + x;
+                break;
+            case SUB_VAR:
+                top = top - x;
+                break;
+            case MUL_VAR:
+                top = top * x;
+                break;
+            case DIV_VAR:
+                top = top / x;
+                break;
+            case POW_VAR:
+                top = pow(top, x);
+                break;
+            case CALL:
+                top = functions[ip->index](top);
+                break;
+            case CALL_BUILTIN:
+                top = FunctionRegistry::evaluate(FunctionRegistry::Builtin(ip->index), top);
+                break;
+            case EVAL:
+                stack[sp++] = top;
+                top = nodes[ip->index]->evaluate(x);
+                break;
+        }
+    }
+    return top;
+}
+
+const std::vector<CompiledExpression::Instruction> &CompiledExpression::get_code() const {
+    return code;
+}
+
+const std::function<double(double)> &CompiledExpression::get_function(unsigned index) const {
+    return functions[index];
+}
+
+const Expression &CompiledExpression::get_node(unsigned index) const {
+    return *nodes[index];
+}
+
+unsigned CompiledExpression::get_max_depth() const {
+    return max_depth;
+}
@@ -0,0 +1,117 @@
+#ifndef C11NHF_COMPILEDEXPRESSION_H
+#define C11NHF_COMPILEDEXPRESSION_H
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Expressions.h"
+
+/**
+ * Flat, postfix (Reverse Polish) form of an Expression tree, evaluated by a small stack machine.
+ * The tree is walked once at construction time; evaluation is then a single loop over a contiguous
+ * instruction array, without virtual calls or pointer chasing. Results are bit-identical to
+ * Expression::evaluate(), as every instruction performs exactly the operation of the node it came from.
+ * Binary operations whose right hand side is a constant or the variable get a fused instruction form,
+ * and the top of the stack is kept in a register while running.
+ */
+class CompiledExpression {
+public:
+    /**
+     * Operation codes of the stack machine.
+     */
+    enum OpCode : unsigned char {
+        PUSH_CONST, /**< pushes the inline constant of the instruction */
+        PUSH_VAR,   /**< pushes the variable */
+        ADD,        /**< pops rhs and lhs, pushes lhs + rhs */
+        SUB,        /**< pops rhs and lhs, pushes lhs - rhs */
+        MUL,        /**< pops rhs and lhs, pushes lhs * rhs */
+        DIV,        /**< pops rhs and lhs, pushes lhs / rhs */
+        POW,        /**< pops rhs and lhs, pushes pow(lhs, rhs) */
+        ADD_CONST,  /**< top = top + value, the rhs being a constant leaf */
+        SUB_CONST,  /**< top = top - value */
+        MUL_CONST,  /**< top = top * value */
+        DIV_CONST,  /**< top = top / value */
+        POW_CONST,  /**< top = pow(top, value) */
+        ADD_VAR,    /**< top = top + x, the rhs being the variable */
+        SUB_VAR,    /**< top = top - x */
+        MUL_VAR,    /**< top = top * x */
+        DIV_VAR,    /**< top = top / x */
+        POW_VAR,    /**< top = pow(top, x) */
+        CALL,       /**< replaces the top of the stack with functions[index](top) */
+        CALL_BUILTIN, /**< top = f(top), index being the FunctionRegistry::Builtin f, inlined by a switch */
+        EVAL        /**< pushes nodes[index]->evaluate(x), for node types the compiler does not know */
+    };
+
+    /**
+     * One instruction of the program. Constants are stored inline, so PUSH_CONST needs no indirection.
+     */
+    struct Instruction {
+        OpCode op;
+        unsigned index;
+        double value;
+    };
+
+    /**
+     * Compiles the expression as it is. Call Expression::simplify() first to get constant folding.
+     * @param exp expression tree to compile, it is not referenced after the constructor returns
+     */
+    explicit CompiledExpression(const Expression &exp);
+
+    /**
+     * Evaluates the program at place x.
+     * @param x place to evaluate the expression at
+     * @return value of the expression, bit-identical to Expression::evaluate(x)
+     */
+    double evaluate(double x) const;
+
+    /**
+     * Returns the instructions of the program in execution order.
+     * @return postfix instruction array
+     */
+    const std::vector<Instruction> &get_code() const;
+
+    /**
+     * Returns a function called by a CALL instruction.
+     * @param index index of the instruction
+     * @return the functor of the compiled Function node
+     */
+    const std::function<double(double)> &get_function(unsigned index) const;
+
+    /**
+     * Returns a node evaluated by an EVAL instruction.
+     * @param index index of the instruction
+     * @return the node the compiler had no instruction for
+     */
+    const Expression &get_node(unsigned index) const;
+
+    /**
+     * Returns the number of stack slots the program needs at most.
+     * @return maximal stack depth
+     */
+    unsigned get_max_depth() const;
+
+private:
+    /**
+     * Programs needing at most this many stack slots run on the native stack.
+     */
+    static const unsigned LOCAL_STACK = 64;
+
+    std::vector<Instruction> code;
+    std::vector<std::function<double(double)>> functions;
+    std::vector<std::unique_ptr<Expression>> nodes;
+    unsigned max_depth;
+
+    /**
+     * Appends the postfix code of exp to the program.
+     * @param exp subtree to compile
+     * @param depth stack depth before the subtree is executed
+     */
+    void compile(const Expression &exp, unsigned depth);
+
+    /**
+     * Appends one instruction and keeps track of the maximal stack depth.
+     * @param depth stack depth after the instruction is executed
+     */
+    void emit(OpCode op, unsigned index, double value, unsigned depth);
+};
+
+#endif //C11NHF_COMPILEDEXPRESSION_H
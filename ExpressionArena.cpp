@@ -0,0 +1,96 @@
+#include <new>
+#include "ExpressionArena.h"
+#include "Expressions.h"
+
+/**
+ * Every node is preceded by a word telling which arena it came from, nullptr standing for the heap.
+ * The word is as wide as the strictest alignment expression nodes have, so the nodes stay aligned.
+ */
+static const std::size_t HEADER = alignof(double) > sizeof(void *) ? alignof(double) : sizeof(void *);
+
+/**
+ * Arena the nodes of the current thread are allocated from, nullptr for the heap.
+ */
+static thread_local ExpressionArena *current_arena = nullptr;
+
+void *Expression::operator new(std::size_t size) {
+    return ExpressionArena::allocate_node(size);
+}
+
+void Expression::operator delete(void *node) noexcept {
+    ExpressionArena::free_node(node);
+}
+
+ExpressionArena::Scope::Scope(ExpressionArena &arena) : previous{current_arena} {
+    current_arena = &arena;
+}
+
+ExpressionArena::Scope::~Scope() {
+    current_arena = previous;
+}
+
+ExpressionArena::ExpressionArena(std::size_t first_chunk) : next_chunk{first_chunk}, cursor{nullptr},
+                                                            limit{nullptr}, used{0} { }
+
+ExpressionArena::~ExpressionArena() {
+    for (Chunk &chunk : chunks)
+        ::operator delete(chunk.memory);
+}
+
+void ExpressionArena::reset() {
+    if (chunks.empty())
+        return;
+    /* the last chunk is the largest one */
+    Chunk keep = chunks.back();
+    chunks.pop_back();
+    for (Chunk &chunk : chunks)
+        ::operator delete(chunk.memory);
+    chunks.assign(1, keep);
+    cursor = keep.memory;
+    limit = keep.memory + keep.size;
+    used = 0;
+}
+
+std::size_t ExpressionArena::bytes_used() const {
+    return used;
+}
+
+std::size_t ExpressionArena::bytes_reserved() const {
+    std::size_t total = 0;
+    for (const Chunk &chunk : chunks)
+        total += chunk.size;
+    return total;
+}
+
+char *ExpressionArena::allocate(std::size_t bytes) {
+    if (std::size_t(limit - cursor) < bytes) {
+        std::size_t size = next_chunk;
+        while (size < bytes)
+            size *= 2;
+        Chunk chunk{static_cast<char *>(::operator new(size)), size};
+        chunks.push_back(chunk);
+        next_chunk = size * 2;
+        cursor = chunk.memory;
+        limit = chunk.memory + size;
+    }
+    char *memory = cursor;
+    cursor += bytes;
+    used += bytes;
+    return memory;
+}
+
+void *ExpressionArena::allocate_node(std::size_t size) {
+    std::size_t bytes = HEADER + (size + HEADER - 1) / HEADER * HEADER;
+    ExpressionArena *arena = current_arena;
+    char *memory = arena ? arena->allocate(bytes) : static_cast<char *>(::operator new(bytes));
+    *reinterpret_cast<ExpressionArena **>(memory) = arena;
+    return memory + HEADER;
+}
+
+void ExpressionArena::free_node(void *node) noexcept {
+    if (!node)
+        return;
+    char *memory = static_cast<char *>(node) - HEADER;
+    if (!*reinterpret_cast<ExpressionArena **>(memory))
+        ::operator delete(memory);
+}
@@ -0,0 +1,106 @@
+#ifndef C11NHF_EXPRESSIONARENA_H
+#define C11NHF_EXPRESSIONARENA_H
+#include <cstddef>
+#include <vector>
+
+/**
+ * Region allocator for expression nodes. While a Scope of the arena is active on a thread, every Expression node
+ * created by that thread (by new, clone() or simplify()) is carved out of large contiguous chunks owned by the arena
+ * instead of being a separate heap allocation. Deleting such a node runs its destructor but gives no memory back;
+ * all of it is released at once by reset() or by the destructor of the arena.
+ *
+ * Trees allocated in the arena must not outlive it, but they need not be destroyed before it: dropping them with
+ * unique_ptr::release() skips the whole destruction walk. Some nodes hold heap memory outside the arena, though,
+ * which is released only if the node is destroyed, so it leaks if their tree is dropped that way:
+ *  - Function built from a bare functor: its share of the entry made for the functor;
+ *  - Variable: its name, usually stored inline;
+ *  - Polynomial: its coefficients;
+ *  - ChebyshevProxy: its pieces and cell table, and what the nodes of its copy of the exact tree hold.
+ * Constant, the operator nodes and the calls of functions of the FunctionRegistry hold none, so only trees made of
+ * them alone are safe to drop with release().
+ * An arena is not thread-safe, it may be used by one thread at a time.
+ */
+class ExpressionArena {
+public:
+    /**
+     * Makes an arena the allocation target of the current thread for its lifetime, restoring the previous target
+     * (another arena or the heap) when it ends.
+     */
+    class Scope {
+    public:
+        explicit Scope(ExpressionArena &arena);
+
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        ExpressionArena *previous;
+    };
+
+    /**
+     * Creates an empty arena. No memory is reserved until the first allocation.
+     * @param first_chunk size of the first chunk in bytes, later chunks double in size
+     */
+    explicit ExpressionArena(std::size_t first_chunk = 64 * 1024);
+
+    ~ExpressionArena();
+
+    ExpressionArena(const ExpressionArena &) = delete;
+
+    ExpressionArena &operator=(const ExpressionArena &) = delete;
+
+    /**
+     * Releases every node allocated from the arena at once. The largest chunk is kept for reuse.
+     */
+    void reset();
+
+    /**
+     * Returns the number of bytes handed out since the last reset.
+     * @return bytes used by nodes, including the ones already deleted
+     */
+    std::size_t bytes_used() const;
+
+    /**
+     * Returns the number of bytes held in chunks.
+     * @return bytes reserved from the heap
+     */
+    std::size_t bytes_reserved() const;
+
+    /**
+     * Allocates storage for a node from the arena of the current thread, or from the heap if there is none.
+     * Used by Expression::operator new.
+     * @param size size of the node
+     * @return storage for the node
+     */
+    static void *allocate_node(std::size_t size);
+
+    /**
+     * Releases the storage of a node allocated by allocate_node(). Used by Expression::operator delete.
+     * @param node storage of the node, may be nullptr
+     */
+    static void free_node(void *node) noexcept;
+
+private:
+    struct Chunk {
+        char *memory;
+        std::size_t size;
+    };
+
+    std::vector<Chunk> chunks;
+    std::size_t next_chunk;
+    char *cursor;
+    char *limit;
+    std::size_t used;
+
+    /**
+     * Carves bytes out of the current chunk, starting a new one when it is full.
+     * @param bytes number of bytes, a multiple of the node alignment
+     * @return the allocated memory
+     */
+    char *allocate(std::size_t bytes);
+};
+
+#endif //C11NHF_EXPRESSIONARENA_H
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <cstring>
+#include <math.h>
+#include "ExpressionDag.h"
+#include "BatchKernels.h"
+#include "FastMath.h"
+
+bool ExpressionDag::Key::operator==(const Key &other) const {
+    return kind == other.kind && lhs == other.lhs && rhs == other.rhs && bits == other.bits;
+}
+
+std::size_t ExpressionDag::KeyHash::operator()(const Key &key) const {
+    std::uint64_t h = key.bits * 0x9E3779B97F4A7C15ULL;
+    h ^= (std::uint64_t(key.lhs) << 32 | key.rhs) + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+    h ^= std::uint64_t(key.kind) * 0xC2B2AE3D27D4EB4FULL;
+    return std::size_t(h ^ (h >> 29));
+}
+
+ExpressionDag::ExpressionDag(const Expression &exp) {
+    add(exp);
+}
+
+unsigned ExpressionDag::intern(Kind kind, unsigned lhs, unsigned rhs, double value) {
+    if ((kind == SUM || kind == PROD) && rhs < lhs)
+        std::swap(lhs, rhs);
+    Key key{kind, lhs, rhs, 0};
+    std::memcpy(&key.bits, &value, sizeof value);
+    auto found = index.find(key);
+    if (found != index.end())
+        return found->second;
+    unsigned id = unsigned(nodes.size());
+    nodes.push_back(Node{kind, lhs, rhs, value});
+    if (kind != OTHER)
+        index.emplace(key, id);
+    return id;
+}
+
+unsigned ExpressionDag::intern_function(const Function &func) {
+    for (unsigned i = 0; i < functions.size(); i++)
+        if (functions[i].entry->name == func.entry->name)
+            return i;
+    functions.push_back(FunctionTarget{func});
+    return unsigned(functions.size() - 1);
+}
+
+unsigned ExpressionDag::add(const Expression &exp) {
+    root = intern_tree(exp);
+    collect_program();
+    return root;
+}
+
+unsigned ExpressionDag::intern_tree(const Expression &exp) {
+    unsigned id;
+    if (const Constant *cons = dynamic_cast<const Constant *>(&exp)) {
+        id = intern(CONSTANT, 0, 0, cons->get_value());
+    } else if (const Variable *var = dynamic_cast<const Variable *>(&exp)) {
+        if (var->slot >= variable_names.size())
+            variable_names.resize(var->slot + 1);
+        variable_names[var->slot] = var->name;
+        id = intern(VARIABLE, 0, var->slot, 0.0);
+    } else if (const TwoOperand *op = dynamic_cast<const TwoOperand *>(&exp)) {
+        Kind kind;
+        switch (op->get_operator()) {
+            case '+':
+                kind = SUM;
+                break;
+            case '-':
+                kind = DIF;
+                break;
+            case '*':
+                kind = PROD;
+                break;
+            case '/':
+                kind = DIV;
+                break;
+            case '^':
+                kind = EXP;
+                break;
+            default:
+                kind = OTHER;
+                break;
+        }
+        if (kind == OTHER) {
+            others.push_back(std::unique_ptr<Expression>(exp.clone()));
+            id = intern(OTHER, 0, unsigned(others.size() - 1), 0.0);
+        } else {
+            unsigned lhs = intern_tree(*op->lhs);
+            unsigned rhs = intern_tree(*op->rhs);
+            id = intern(kind, lhs, rhs, 0.0);
+        }
+    } else if (const Function *func = dynamic_cast<const Function *>(&exp)) {
+        unsigned arg = intern_tree(*func->arg);
+        id = intern(FUNCTION, arg, intern_function(*func), 0.0);
+    } else {
+        others.push_back(std::unique_ptr<Expression>(exp.clone()));
+        id = intern(OTHER, 0, unsigned(others.size() - 1), 0.0);
+    }
+    return id;
+}
+
+/**
+ * Returns whether the lhs of a node of the kind is the index of a child.
+ */
+static bool hasLhsChild(ExpressionDag::Kind kind) {
+    return (kind >= ExpressionDag::SUM && kind <= ExpressionDag::EXP) || kind == ExpressionDag::FUNCTION;
+}
+
+/**
+ * Returns whether the rhs of a node of the kind is the index of a child.
+ */
+static bool hasRhsChild(ExpressionDag::Kind kind) {
+    return kind >= ExpressionDag::SUM && kind <= ExpressionDag::EXP;
+}
+
+void ExpressionDag::collect_program() {
+    /* children have smaller indices than their parents, so the reached indices in ascending order are topological */
+    std::unordered_map<unsigned, unsigned> position{{root, 0}};
+    std::vector<unsigned> reached{root}, pending{root};
+    while (!pending.empty()) {
+        const Node &node = nodes[pending.back()];
+        pending.pop_back();
+        if (hasLhsChild(node.kind) && position.emplace(node.lhs, 0).second) {
+            reached.push_back(node.lhs);
+            pending.push_back(node.lhs);
+        }
+        if (hasRhsChild(node.kind) && position.emplace(node.rhs, 0).second) {
+            reached.push_back(node.rhs);
+            pending.push_back(node.rhs);
+        }
+    }
+    std::sort(reached.begin(), reached.end());
+    program.clear();
+    for (unsigned id : reached) {
+        Node node = nodes[id];
+        if (hasLhsChild(node.kind))
+            node.lhs = position[node.lhs];
+        if (hasRhsChild(node.kind))
+            node.rhs = position[node.rhs];
+        position[id] = unsigned(program.size());
+        program.push_back(node);
+    }
+}
+
+double ExpressionDag::evaluate(double x) const {
+    thread_local std::vector<double> scratch;
+    if (scratch.size() < program.size())
+        scratch.resize(program.size());
+    double *values = scratch.data();
+    for (std::size_t i = 0; i < program.size(); i++) {
+        const Node &node = program[i];
+        switch (node.kind) {
+            case CONSTANT:
+                values[i] = node.value;
+                break;
+            case VARIABLE:
+                values[i] = node.rhs == 0 ? x : NAN;
+                break;
+            case SUM:
+                values[i] = values[node.lhs] + values[node.rhs];
+                break;
+            case DIF:
+                values[i] = values[node.lhs] - values[node.rhs];
+                break;
+            case PROD:
+                values[i] = values[node.lhs] * values[node.rhs];
+                break;
+            case DIV:
+                values[i] = values[node.lhs] / values[node.rhs];
+                break;
+            case EXP:
+                values[i] = pow(values[node.lhs], values[node.rhs]);
+                break;
+            case FUNCTION:
+                values[i] = functions[node.rhs].apply(values[node.lhs]);
+                break;
+            case OTHER:
+                values[i] = others[node.rhs]->evaluate(x);
+                break;
+        }
+    }
+    return values[program.size() - 1];
+}
+
+void ExpressionDag::evaluate_nodes(const double *xs, std::size_t n, double *values) const {
+    evaluate_list(nodes, xs, n, values);
+}
+
+void ExpressionDag::evaluate_list(const std::vector<Node> &list, const double *xs, std::size_t n,
+                                  double *values) const {
+    for (std::size_t i = 0; i < list.size(); i++) {
+        const Node &node = list[i];
+        double *out = values + i * n;
+        const double *lhs = values + node.lhs * n;
+        const double *rhs = values + node.rhs * n;
+        switch (node.kind) {
+            case CONSTANT:
+                std::fill(out, out + n, node.value);
+                break;
+            case VARIABLE:
+                if (node.rhs == 0)
+                    std::copy(xs, xs + n, out);
+                else
+                    std::fill(out, out + n, NAN);
+                break;
+            case SUM:
+                std::copy(lhs, lhs + n, out);
+                BatchKernels::add(out, rhs, n);
+                break;
+            case DIF:
+                std::copy(lhs, lhs + n, out);
+                BatchKernels::sub(out, rhs, n);
+                break;
+            case PROD:
+                std::copy(lhs, lhs + n, out);
+                BatchKernels::mul(out, rhs, n);
+                break;
+            case DIV:
+                std::copy(lhs, lhs + n, out);
+                BatchKernels::div(out, rhs, n);
+                break;
+            case EXP:
+                std::copy(lhs, lhs + n, out);
+                FastMath::pow_block(out, rhs, n);
+                break;
+            case FUNCTION:
+                std::copy(lhs, lhs + n, out);
+                functions[node.rhs].apply_block(out, n);
+                break;
+            case OTHER:
+                others[node.rhs]->evaluate_block(xs, out, n);
+                break;
+        }
+    }
+}
+
+void ExpressionDag::evaluate_batch(const double *xs, double *out, std::size_t n) const {
+    const std::size_t block = Expression::BATCH_BLOCK;
+    thread_local std::vector<double> scratch;
+    if (scratch.size() < program.size() * block)
+        scratch.resize(program.size() * block);
+    for (std::size_t i = 0; i < n; i += block) {
+        std::size_t count = std::min(block, n - i);
+        evaluate_list(program, xs + i, count, scratch.data());
+        const double *result = scratch.data() + (program.size() - 1) * count;
+        std::copy(result, result + count, out + i);
+    }
+}
+
+std::unique_ptr<Expression> ExpressionDag::to_expression(unsigned id) const {
+    const Node &node = nodes[id];
+    switch (node.kind) {
+        case CONSTANT:
+            return std::unique_ptr<Expression>(new Constant{node.value});
+        case VARIABLE:
+            return std::unique_ptr<Expression>(new Variable{node.rhs, variable_names[node.rhs]});
+        case SUM:
+            return std::unique_ptr<Expression>(new Sum{to_expression(node.lhs), to_expression(node.rhs)});
+        case DIF:
+            return std::unique_ptr<Expression>(new Dif{to_expression(node.lhs), to_expression(node.rhs)});
+        case PROD:
+            return std::unique_ptr<Expression>(new Prod{to_expression(node.lhs), to_expression(node.rhs)});
+        case DIV:
+            return std::unique_ptr<Expression>(new Div{to_expression(node.lhs), to_expression(node.rhs)});
+        case EXP:
+            return std::unique_ptr<Expression>(new Exp{to_expression(node.lhs), to_expression(node.rhs)});
+        case FUNCTION:
+            return functions[node.rhs].call(to_expression(node.lhs));
+        default:
+            return std::unique_ptr<Expression>(others[node.rhs]->clone());
+    }
+}
+
+std::size_t ExpressionDag::size() const {
+    return nodes.size();
+}
+
+const std::vector<ExpressionDag::Node> &ExpressionDag::get_nodes() const {
+    return nodes;
+}
+
+const FunctionTarget &ExpressionDag::get_function(unsigned index) const {
+    return functions[index];
+}
+
+const Expression &ExpressionDag::get_other(unsigned index) const {
+    return *others[index];
+}
@@ -0,0 +1,170 @@
+#ifndef C11NHF_EXPRESSIONDAG_H
+#define C11NHF_EXPRESSIONDAG_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Expressions.h"
+
+/**
+ * Hash-consed form of one or more Expression trees. Structurally identical subtrees (same node type, operator,
+ * constant and function name, same children) are interned into a single node, so the trees become a DAG in which
+ * every distinct subexpression appears once. The operands of the commutative + and * are put in a canonical order,
+ * so X+sin(X) and sin(X)+X are shared as well.
+ * The nodes are stored in topological order, children first; evaluation is a single pass over them, computing
+ * every unique subexpression once per place. evaluate() and evaluate_batch() only pass over the nodes the last added
+ * tree reaches, and keep their values in a scratch buffer per thread, so they allocate nothing once it has grown.
+ */
+class ExpressionDag {
+public:
+    /**
+     * Type of a node.
+     */
+    enum Kind : unsigned char {
+        CONSTANT,
+        VARIABLE, /**< rhs is the slot of the variable */
+        SUM,
+        DIF,
+        PROD,
+        DIV,
+        EXP,
+        FUNCTION, /**< lhs is the argument, rhs the index of the function */
+        OTHER     /**< node type without a dedicated kind, rhs is the index of its copy; never shared */
+    };
+
+    /**
+     * One interned node. Children are referred to by their index, which is always smaller than the node's own.
+     */
+    struct Node {
+        Kind kind;
+        unsigned lhs;
+        unsigned rhs;
+        double value;
+    };
+
+    ExpressionDag() = default;
+
+    /**
+     * Builds the DAG of a single expression.
+     * @param exp expression tree, it is not referenced after the constructor returns
+     */
+    explicit ExpressionDag(const Expression &exp);
+
+    /**
+     * Interns an expression tree, sharing its subtrees with everything added before.
+     * @param exp expression tree, it is not referenced after the call
+     * @return index of the node representing the whole tree
+     */
+    unsigned add(const Expression &exp);
+
+    /**
+     * Evaluates the last added tree at place x.
+     * @param x place to evaluate the expression at
+     * @return value of the expression, bit-identical to Expression::evaluate(x)
+     */
+    double evaluate(double x) const;
+
+    /**
+     * Evaluates the last added tree at n places.
+     * @see Expression::evaluate_batch()
+     */
+    void evaluate_batch(const double *xs, double *out, std::size_t n) const;
+
+    /**
+     * Computes the value of every node for a block of places.
+     * @param xs places to evaluate at
+     * @param n number of places, at most Expression::BATCH_BLOCK
+     * @param values size() * n values, node i writing the range [i * n, (i + 1) * n)
+     */
+    void evaluate_nodes(const double *xs, std::size_t n, double *values) const;
+
+    /**
+     * Builds an ordinary Expression tree from a node, duplicating the shared subtrees again.
+     * @param index index of the node
+     * @return the expanded tree
+     */
+    std::unique_ptr<Expression> to_expression(unsigned index) const;
+
+    /**
+     * Returns the number of unique nodes.
+     * @return number of nodes
+     */
+    std::size_t size() const;
+
+    /**
+     * Returns the nodes in topological order.
+     * @return interned nodes
+     */
+    const std::vector<Node> &get_nodes() const;
+
+    /**
+     * Returns a function of the function table.
+     * @param index rhs of a FUNCTION node
+     * @return the function
+     */
+    const FunctionTarget &get_function(unsigned index) const;
+
+    /**
+     * Returns the copy of a node without a dedicated kind.
+     * @param index rhs of an OTHER node
+     * @return the copied expression
+     */
+    const Expression &get_other(unsigned index) const;
+
+private:
+    /**
+     * Identity of a node for interning: its kind, children and payload bits.
+     */
+    struct Key {
+        Kind kind;
+        unsigned lhs;
+        unsigned rhs;
+        std::uint64_t bits;
+
+        bool operator==(const Key &other) const;
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key &key) const;
+    };
+
+    std::vector<Node> nodes;
+    std::unordered_map<Key, unsigned, KeyHash> index;
+    std::vector<FunctionTarget> functions;
+    std::vector<std::string> variable_names;
+    std::vector<std::unique_ptr<Expression>> others;
+    unsigned root = 0;
+    /** nodes reachable from root, in topological order, their children referred to by their index in this list */
+    std::vector<Node> program;
+
+    /**
+     * Interns an expression tree without touching root and program.
+     */
+    unsigned intern_tree(const Expression &exp);
+
+    /**
+     * Rebuilds program from the nodes reachable from root.
+     */
+    void collect_program();
+
+    /**
+     * Computes the value of every node of a list for a block of places.
+     * @see evaluate_nodes()
+     */
+    void evaluate_list(const std::vector<Node> &list, const double *xs, std::size_t n, double *values) const;
+
+    /**
+     * Returns the index of the node, adding it if no identical node exists yet.
+     */
+    unsigned intern(Kind kind, unsigned lhs, unsigned rhs, double value);
+
+    /**
+     * Returns the index of a function in the function table, adding it if its name is new.
+     */
+    unsigned intern_function(const Function &func);
+};
+
+#endif //C11NHF_EXPRESSIONDAG_H
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <math.h>
+#include "ExpressionSet.h"
+#include "BatchKernels.h"
+#include "FastMath.h"
+
+const unsigned ExpressionSet::PLACES;
+
+ExpressionSet::ExpressionSet(const std::vector<const Expression *> &exps) {
+    for (const Expression *exp : exps)
+        roots.push_back(dag.add(*exp));
+    build();
+}
+
+std::size_t ExpressionSet::add(const Expression &exp) {
+    roots.push_back(dag.add(exp));
+    build();
+    return roots.size() - 1;
+}
+
+void ExpressionSet::build() {
+    const std::vector<ExpressionDag::Node> &nodes = dag.get_nodes();
+    std::size_t count = nodes.size();
+    /* the last step reading every node, its own step if only a column reads it */
+    std::vector<std::size_t> last_use(count);
+    for (std::size_t i = 0; i < count; i++) {
+        last_use[i] = i;
+        const ExpressionDag::Node &node = nodes[i];
+        if (node.kind >= ExpressionDag::SUM && node.kind <= ExpressionDag::EXP) {
+            last_use[node.lhs] = i;
+            last_use[node.rhs] = i;
+        } else if (node.kind == ExpressionDag::FUNCTION) {
+            last_use[node.lhs] = i;
+        }
+    }
+    std::vector<std::vector<unsigned>> rooted(count);
+    for (std::size_t k = 0; k < roots.size(); k++)
+        rooted[roots[k]].push_back(unsigned(k));
+
+    steps.clear();
+    outputs.clear();
+    constants.clear();
+    buffers = 0;
+    std::vector<unsigned> buffer_of(count), released;
+    std::vector<char> reusable(count, 0);
+    for (std::size_t i = 0; i < count; i++) {
+        const ExpressionDag::Node &node = nodes[i];
+        Step step{node.kind, 0, PLACES, node.rhs, unsigned(outputs.size()), unsigned(rooted[i].size())};
+        if (node.kind == ExpressionDag::CONSTANT ||
+            (node.kind == ExpressionDag::VARIABLE && node.rhs != 0)) {   /* variables other than X are NaN */
+            step.out = buffers++;
+            constants.push_back(std::make_pair(node.kind == ExpressionDag::CONSTANT ? node.value : NAN, step.out));
+        } else if (node.kind == ExpressionDag::VARIABLE) {
+            step.out = PLACES;
+        } else {
+            if (released.empty()) {
+                step.out = buffers++;
+            } else {
+                step.out = released.back();
+                released.pop_back();
+            }
+            reusable[i] = 1;
+            if (node.kind != ExpressionDag::OTHER)
+                step.lhs = buffer_of[node.lhs];
+            if (node.kind >= ExpressionDag::SUM && node.kind <= ExpressionDag::EXP)
+                step.rhs = buffer_of[node.rhs];
+        }
+        buffer_of[i] = step.out;
+        /* constants and X only need a step if they are the value of an expression */
+        if (reusable[i] || step.output_count > 0) {
+            steps.push_back(step);
+            outputs.insert(outputs.end(), rooted[i].begin(), rooted[i].end());
+        }
+        /* the buffers of the values read for the last time here are free for the next steps */
+        unsigned children[3] = {unsigned(i), node.lhs, node.rhs};
+        std::size_t read = node.kind >= ExpressionDag::SUM && node.kind <= ExpressionDag::EXP ? 3
+                           : node.kind == ExpressionDag::FUNCTION ? 2 : 1;
+        for (std::size_t c = 0; c < read; c++) {
+            unsigned child = children[c];
+            if (reusable[child] && last_use[child] == i) {
+                released.push_back(buffer_of[child]);
+                reusable[child] = 0;
+            }
+        }
+    }
+}
+
+std::size_t ExpressionSet::size() const {
+    return roots.size();
+}
+
+std::size_t ExpressionSet::node_count() const {
+    return dag.size();
+}
+
+std::size_t ExpressionSet::buffer_count() const {
+    return buffers;
+}
+
+void ExpressionSet::evaluate(double x, double *out) const {
+    std::vector<double *> columns(roots.size());
+    for (std::size_t k = 0; k < roots.size(); k++)
+        columns[k] = out + k;
+    evaluate_batch(&x, 1, columns.data());
+}
+
+void ExpressionSet::evaluate_batch(const double *xs, std::size_t n, double *const *columns) const {
+    const std::size_t block = Expression::BATCH_BLOCK;
+    std::vector<double> memory(std::size_t(buffers) * block);
+    for (const std::pair<double, unsigned> &constant : constants)
+        std::fill(memory.begin() + constant.second * block, memory.begin() + (constant.second + 1) * block,
+                  constant.first);
+    for (std::size_t i = 0; i < n; i += block) {
+        std::size_t count = std::min(block, n - i);
+        const double *places = xs + i;
+        for (const Step &step : steps) {
+            double *out = step.out == PLACES ? nullptr : &memory[step.out * block];
+            const double *lhs = step.lhs == PLACES ? places : memory.data() + step.lhs * block;
+            const double *rhs = step.rhs == PLACES ? places : memory.data() + step.rhs * block;
+            switch (step.kind) {
+                case ExpressionDag::SUM:
+                    std::copy(lhs, lhs + count, out);
+                    BatchKernels::add(out, rhs, count);
+                    break;
+                case ExpressionDag::DIF:
+                    std::copy(lhs, lhs + count, out);
+                    BatchKernels::sub(out, rhs, count);
+                    break;
+                case ExpressionDag::PROD:
+                    std::copy(lhs, lhs + count, out);
+                    BatchKernels::mul(out, rhs, count);
+                    break;
+                case ExpressionDag::DIV:
+                    std::copy(lhs, lhs + count, out);
+                    BatchKernels::div(out, rhs, count);
+                    break;
+                case ExpressionDag::EXP:
+                    std::copy(lhs, lhs + count, out);
+                    FastMath::pow_block(out, rhs, count);
+                    break;
+                case ExpressionDag::FUNCTION:
+                    std::copy(lhs, lhs + count, out);
+                    dag.get_function(step.rhs).apply_block(out, count);
+                    break;
+                case ExpressionDag::OTHER:
+                    dag.get_other(step.rhs).evaluate_block(places, out, count);
+                    break;
+                default:   /* constants are filled in already, X is read from the places */
+                    break;
+            }
+            const double *value = out ? out : places;
+            for (unsigned o = step.first_output; o < step.first_output + step.output_count; o++)
+                std::copy(value, value + count, columns[outputs[o]] + i);
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef C11NHF_EXPRESSIONSET_H
+#define C11NHF_EXPRESSIONSET_H
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "Expressions.h"
+#include "ExpressionDag.h"
+
+/**
+ * Several expressions evaluated together over the same places, e.g. a family of related formulas plotted or
+ * tabulated over one x range. The trees are merged into one ExpressionDag, so a subexpression shared by several of
+ * them, like sin(X) used in ten formulas, is computed once per place, and the DAG is turned into a program of
+ * block operations run in a single pass over every block of places.
+ * The program keeps a block of values only while a later step still needs it: the buffers of the values no longer
+ * needed are reused, so the working set is the largest number of values alive at once rather than the size of the
+ * DAG, and stays in cache even for large sets. Constants are filled in once per evaluate_batch() call and X is read
+ * from the places directly. The values are bit-identical to evaluating every expression on its own with
+ * Expression::evaluate_batch(), in either precision of FastMath.
+ */
+class ExpressionSet {
+public:
+    ExpressionSet() = default;
+
+    /**
+     * Builds a set of expressions.
+     * @param exps expressions to add, in the order of their columns; they are not referenced after the call
+     */
+    explicit ExpressionSet(const std::vector<const Expression *> &exps);
+
+    /**
+     * Adds an expression, sharing its subexpressions with the ones added before.
+     * @param exp expression to add, it is not referenced after the call
+     * @return index of the expression's column
+     */
+    std::size_t add(const Expression &exp);
+
+    /**
+     * Returns the number of expressions.
+     * @return number of columns
+     */
+    std::size_t size() const;
+
+    /**
+     * Returns the number of unique subexpressions of the set.
+     * @return number of DAG nodes
+     */
+    std::size_t node_count() const;
+
+    /**
+     * Returns the number of blocks of values the program keeps at most, constants included.
+     * @return number of buffers
+     */
+    std::size_t buffer_count() const;
+
+    /**
+     * Evaluates every expression at a place.
+     * @param x place to evaluate at
+     * @param out array of size() values receiving the results
+     */
+    void evaluate(double x, double *out) const;
+
+    /**
+     * Evaluates every expression at n places, in blocks of Expression::BATCH_BLOCK places.
+     * @param xs places to evaluate at
+     * @param n number of places
+     * @param columns size() arrays of n values, columns[k] receiving the values of expression k
+     */
+    void evaluate_batch(const double *xs, std::size_t n, double *const *columns) const;
+
+private:
+    /**
+     * Buffer standing for the places themselves.
+     */
+    static const unsigned PLACES = ~0u;
+
+    /**
+     * One block operation: node kind, the buffer it writes and the buffers of its operands; the function index,
+     * the other-expression index or the slot of VARIABLE nodes in rhs. The columns of the expressions rooted at
+     * the step are outputs[first_output, first_output + output_count).
+     */
+    struct Step {
+        ExpressionDag::Kind kind;
+        unsigned out, lhs, rhs;
+        unsigned first_output, output_count;
+    };
+
+    ExpressionDag dag;
+    std::vector<unsigned> roots;
+    std::vector<Step> steps;
+    std::vector<unsigned> outputs;
+
+    /**
+     * Constants and the buffers they are filled into.
+     */
+    std::vector<std::pair<double, unsigned>> constants;
+    unsigned buffers = 0;
+
+    /**
+     * Rebuilds the program after the DAG has changed.
+     */
+    void build();
+};
+
+#endif //C11NHF_EXPRESSIONSET_H
@@ -1,9 +1,568 @@
 #include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
 #include <math.h>
 #include "Expressions.h"
+#include "BatchKernels.h"
+#include "FastMath.h"
+#include "NativeStack.h"
+#include "Simplifier.h"
+#include "Parser.h"
+
+/**
+ * Per-thread pool of BATCH_BLOCK sized buffers for the right hand side operands of the batch evaluation, of doubles
+ * or floats. Every TwoOperand level of the tree borrows one buffer for the duration of its evaluate_block(), so deep
+ * trees don't keep whole blocks on the native stack.
+ */
+template<typename T>
+class BlockScratch {
+public:
+    BlockScratch() : buffer{acquire()} { }
+
+    ~BlockScratch() {
+        --pool().depth;
+    }
+
+    BlockScratch(const BlockScratch &) = delete;
+
+    BlockScratch &operator=(const BlockScratch &) = delete;
+
+    T *get() const {
+        return buffer;
+    }
+
+private:
+    struct Pool {
+        std::vector<std::unique_ptr<T[]>> buffers;
+        std::size_t depth = 0;
+    };
+
+    T *buffer;
+
+    static Pool &pool() {
+        static thread_local Pool instance;
+        return instance;
+    }
+
+    static T *acquire() {
+        Pool &p = pool();
+        if (p.depth == p.buffers.size())
+            p.buffers.push_back(std::unique_ptr<T[]>(new T[Expression::BATCH_BLOCK]));
+        return p.buffers[p.depth++].get();
+    }
+};
+
+/**
+ * Stack of the traversals that walk a tree without recursing. The first N entries are kept in the object, on the
+ * native stack of the traversal, so trees of normal depth need no allocation; deeper ones grow it on the heap.
+ */
+template<typename T, std::size_t N>
+class TraversalStack {
+public:
+    TraversalStack() : items{local}, count{0}, capacity{N} { }
+
+    TraversalStack(const TraversalStack &) = delete;
+
+    TraversalStack &operator=(const TraversalStack &) = delete;
+
+    void push(const T &item) {
+        if (count == capacity)
+            grow();
+        items[count++] = item;
+    }
+
+    T pop() {
+        return items[--count];
+    }
+
+    T &top() {
+        return items[count - 1];
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+private:
+    T local[N];
+    std::unique_ptr<T[]> heap;
+    T *items;
+    std::size_t count, capacity;
+
+    void grow() {
+        std::unique_ptr<T[]> larger{new T[2 * capacity]};
+        std::copy(items, items + count, larger.get());
+        heap = std::move(larger);
+        items = heap.get();
+        capacity *= 2;
+    }
+};
+
+/**
+ * Native stack evaluate(), the block and interval evaluations, print(), the copy constructors and the destructors
+ * leave free. Trees are walked recursively, the fastest way, until less than this is left on the stack of the thread;
+ * deeper subtrees are walked by evaluateTree(), evaluateBlockTree(), evaluateIntervalTree(), printTree(), cloneTree()
+ * and destroyOperands(), which need little stack whatever the depth of the tree, and the reserve is left for the
+ * functions they call.
+ */
+static const std::uintptr_t STACK_RESERVE = 128 * 1024;
+
+/**
+ * Tells whether a recursive call has used up its stack. The lowest address the recursion may reach is computed once
+ * per thread from the limits of its stack, so a level of recursion costs a load and a comparison and no store. Where
+ * the limits can't be determined, nothing recurses and every tree is walked with the explicit stack.
+ */
+static bool stackExhausted() {
+    static thread_local std::uintptr_t floor = 0;
+    char marker;
+    std::uintptr_t here = reinterpret_cast<std::uintptr_t>(&marker);
+    if (floor == 0) {
+        std::uintptr_t lowest = NativeStack::lowest_address();
+        floor = lowest != 0 ? lowest + STACK_RESERVE : UINTPTR_MAX;
+    }
+    return here < floor;
+}
+
+/**
+ * Computes the function of a Function node at a value, without evaluating its argument.
+ */
+static double callFunction(const Function &func, double value) {
+    return func.builtin != FunctionRegistry::CUSTOM ? FunctionRegistry::evaluate(func.builtin, value) :
+           func.entry->scalar(value);
+}
+
+/**
+ * Applies a function to a block of values in place: builtins by the loop of the switch, other functions by the batch
+ * implementation of their entry, which calls a bare functor one value at a time.
+ */
+static void applyFunction(FunctionRegistry::Builtin builtin, const FunctionRegistry::Entry *entry, double *values,
+                          std::size_t n) {
+    if (builtin != FunctionRegistry::CUSTOM)
+        FunctionRegistry::evaluate_block(builtin, values, n);
+    else
+        entry->batch(values, values, n);
+}
+
+/**
+ * Applies a function to a block of floats in place, as applyFunction() does to doubles.
+ */
+static void applyFunction(FunctionRegistry::Builtin builtin, const FunctionRegistry::Entry *entry, float *values,
+                          std::size_t n) {
+    if (builtin != FunctionRegistry::CUSTOM) {
+        FunctionRegistry::evaluate_block(builtin, values, n);
+    } else {
+        for (std::size_t i = 0; i < n; i++)
+            values[i] = float(entry->scalar(values[i]));
+    }
+}
+
+/**
+ * Evaluates a tree with an explicit stack. Left operands and arguments are descended into right away; right
+ * operands, and the operators and functions waiting for their operands, are kept on the stack.
+ */
+static double evaluateTree(const Expression &root, double x) {
+    enum Action : unsigned char {
+        VISIT, APPLY_OPERATOR, APPLY_FUNCTION
+    };
+    struct Step {
+        const Expression *node;
+        Action action;
+    };
+    TraversalStack<Step, 64> steps;
+    TraversalStack<double, 64> values;
+    const Expression *node = &root;
+    for (;;) {
+        for (;;) {
+            Expression::Shape shape = node->shape();
+            if (shape == Expression::Shape::BINARY) {
+                const TwoOperand *op = static_cast<const TwoOperand *>(node);
+                steps.push(Step{node, APPLY_OPERATOR});
+                steps.push(Step{op->rhs.get(), VISIT});
+                node = op->lhs.get();
+            } else if (shape == Expression::Shape::CALL) {
+                steps.push(Step{node, APPLY_FUNCTION});
+                node = static_cast<const Function *>(node)->arg.get();
+            } else {
+                values.push(node->evaluate(x));
+                break;
+            }
+        }
+        for (;;) {
+            if (steps.empty())
+                return values.top();
+            Step step = steps.pop();
+            if (step.action == VISIT) {
+                node = step.node;
+                break;
+            }
+            if (step.action == APPLY_OPERATOR) {
+                double rhs = values.pop();
+                values.top() = static_cast<const TwoOperand *>(step.node)->do_operator(values.top(), rhs);
+            } else {
+                values.top() = callFunction(*static_cast<const Function *>(step.node), values.top());
+            }
+        }
+    }
+}
+
+/**
+ * Evaluates a leaf of a tree for evaluateBlockTree(), by the block evaluation its input calls for: places of X in
+ * double or single precision, or the columns of the variables.
+ */
+static void evaluateLeaf(const Expression &leaf, const double *xs, double *out, std::size_t n) {
+    leaf.evaluate_block(xs, out, n);
+}
+
+static void evaluateLeaf(const Expression &leaf, const float *xs, float *out, std::size_t n) {
+    leaf.evaluate_block_float(xs, out, n);
+}
+
+static void evaluateLeaf(const Expression &leaf, const double *const *columns, double *out, std::size_t n) {
+    leaf.evaluate_block_slots(columns, out, n);
+}
+
+static void applyOperator(const TwoOperand &op, double *lhs, const double *rhs, std::size_t n) {
+    op.do_operator_block(lhs, rhs, n);
+}
+
+static void applyOperator(const TwoOperand &op, float *lhs, const float *rhs, std::size_t n) {
+    op.do_operator_block_float(lhs, rhs, n);
+}
+
+/**
+ * Evaluates a block of a tree with an explicit stack, like evaluateTree() with blocks of n values in place of
+ * values. An operator whose left operand is a leaf and whose right one isn't descends to the right first, so the
+ * right-deep chains of ^ or of nested parentheses hold a block or two at a time rather than one per level.
+ */
+template<typename Input, typename T>
+static void evaluateBlockTree(const Expression &root, Input input, T *out, std::size_t n) {
+    enum Action : unsigned char {
+        VISIT, APPLY_OPERATOR, APPLY_REVERSED, APPLY_FUNCTION
+    };
+    struct Step {
+        const Expression *node;
+        Action action;
+    };
+    TraversalStack<Step, 64> steps;
+    TraversalStack<T *, 64> values;
+    std::vector<std::unique_ptr<T[]>> buffers;
+    std::vector<T *> unused;
+    auto acquire = [&buffers, &unused]() {
+        if (unused.empty()) {
+            buffers.push_back(std::unique_ptr<T[]>(new T[Expression::BATCH_BLOCK]));
+            return buffers.back().get();
+        }
+        T *buffer = unused.back();
+        unused.pop_back();
+        return buffer;
+    };
+    const Expression *node = &root;
+    for (;;) {
+        for (;;) {
+            Expression::Shape shape = node->shape();
+            if (shape == Expression::Shape::BINARY) {
+                const TwoOperand *op = static_cast<const TwoOperand *>(node);
+                if (op->lhs->shape() == Expression::Shape::LEAF && op->rhs->shape() != Expression::Shape::LEAF) {
+                    steps.push(Step{node, APPLY_REVERSED});
+                    steps.push(Step{op->lhs.get(), VISIT});
+                    node = op->rhs.get();
+                } else {
+                    steps.push(Step{node, APPLY_OPERATOR});
+                    steps.push(Step{op->rhs.get(), VISIT});
+                    node = op->lhs.get();
+                }
+            } else if (shape == Expression::Shape::CALL) {
+                steps.push(Step{node, APPLY_FUNCTION});
+                node = static_cast<const Function *>(node)->arg.get();
+            } else {
+                T *block = acquire();
+                evaluateLeaf(*node, input, block, n);
+                values.push(block);
+                break;
+            }
+        }
+        for (;;) {
+            if (steps.empty()) {
+                std::copy(values.top(), values.top() + n, out);
+                return;
+            }
+            Step step = steps.pop();
+            if (step.action == VISIT) {
+                node = step.node;
+                break;
+            }
+            if (step.action == APPLY_FUNCTION) {
+                const Function *func = static_cast<const Function *>(step.node);
+                applyFunction(func->builtin, func->entry, values.top(), n);
+                continue;
+            }
+            T *second = values.pop();
+            T *first = values.top();
+            bool reversed = step.action == APPLY_REVERSED;
+            T *lhs = reversed ? second : first, *rhs = reversed ? first : second;
+            applyOperator(*static_cast<const TwoOperand *>(step.node), lhs, rhs, n);
+            values.top() = lhs;
+            unused.push_back(rhs);
+        }
+    }
+}
+
+/**
+ * Encloses the values of a tree over [lo, hi] with an explicit stack, like evaluateTree().
+ */
+static Interval evaluateIntervalTree(const Expression &root, double lo, double hi) {
+    enum Action : unsigned char {
+        VISIT, APPLY_OPERATOR, APPLY_FUNCTION
+    };
+    struct Step {
+        const Expression *node;
+        Action action;
+    };
+    TraversalStack<Step, 64> steps;
+    TraversalStack<Interval, 64> values;
+    const Expression *node = &root;
+    for (;;) {
+        for (;;) {
+            Expression::Shape shape = node->shape();
+            if (shape == Expression::Shape::BINARY) {
+                const TwoOperand *op = static_cast<const TwoOperand *>(node);
+                steps.push(Step{node, APPLY_OPERATOR});
+                steps.push(Step{op->rhs.get(), VISIT});
+                node = op->lhs.get();
+            } else if (shape == Expression::Shape::CALL) {
+                steps.push(Step{node, APPLY_FUNCTION});
+                node = static_cast<const Function *>(node)->arg.get();
+            } else {
+                values.push(node->evaluate_interval(lo, hi));
+                break;
+            }
+        }
+        for (;;) {
+            if (steps.empty())
+                return values.top();
+            Step step = steps.pop();
+            if (step.action == VISIT) {
+                node = step.node;
+                break;
+            }
+            if (step.action == APPLY_OPERATOR) {
+                Interval rhs = values.pop();
+                values.top() = static_cast<const TwoOperand *>(step.node)->do_operator_interval(values.top(), rhs);
+            } else {
+                const Function *func = static_cast<const Function *>(step.node);
+                values.top() = func->entry->interval ? func->entry->interval(values.top()) : Interval::entire();
+            }
+        }
+    }
+}
+
+/**
+ * Prints a tree with an explicit stack, exactly as the print() of its nodes would recursively.
+ */
+static void printTree(const Expression &root, std::ostream &os) {
+    enum Action : unsigned char {
+        VISIT, OPERATOR, CLOSE
+    };
+    struct Step {
+        const Expression *node;
+        Action action;
+    };
+    TraversalStack<Step, 64> steps;
+    steps.push(Step{&root, VISIT});
+    while (!steps.empty()) {
+        Step step = steps.pop();
+        if (step.action == OPERATOR) {
+            os << static_cast<const TwoOperand *>(step.node)->get_operator();
+            continue;
+        }
+        if (step.action == CLOSE) {
+            os << ')';
+            continue;
+        }
+        switch (step.node->shape()) {
+            case Expression::Shape::BINARY: {
+                const TwoOperand *op = static_cast<const TwoOperand *>(step.node);
+                os << '(';
+                steps.push(Step{op, CLOSE});
+                steps.push(Step{op->rhs.get(), VISIT});
+                steps.push(Step{op, OPERATOR});
+                steps.push(Step{op->lhs.get(), VISIT});
+                break;
+            }
+            case Expression::Shape::CALL: {
+                const Function *func = static_cast<const Function *>(step.node);
+                os << func->entry->name << '(';
+                steps.push(Step{func, CLOSE});
+                steps.push(Step{func->arg.get(), VISIT});
+                break;
+            }
+            default:
+                step.node->print(os);
+                break;
+        }
+    }
+}
+
+/**
+ * Creates an operator node of the same type as op, without operands; nullptr if op is not one of the operators of
+ * this file.
+ */
+static TwoOperand *emptyOperator(const TwoOperand &op) {
+    switch (op.get_operator()) {
+        case '+':
+            return new Sum{nullptr, nullptr};
+        case '-':
+            return new Dif{nullptr, nullptr};
+        case '*':
+            return new Prod{nullptr, nullptr};
+        case '/':
+            return new Div{nullptr, nullptr};
+        case '^':
+            return new Exp{nullptr, nullptr};
+        default:
+            return nullptr;
+    }
+}
+
+/**
+ * Deep copies a tree with an explicit stack: every node is copied without its operands first, and the copies of
+ * the operands are filled in as they are taken from the stack.
+ */
+static std::unique_ptr<Expression> cloneTree(const Expression &root) {
+    struct Step {
+        const Expression *source;
+        std::unique_ptr<Expression> *target;
+    };
+    TraversalStack<Step, 64> steps;
+    std::unique_ptr<Expression> copy;
+    steps.push(Step{&root, &copy});
+    while (!steps.empty()) {
+        Step step = steps.pop();
+        switch (step.source->shape()) {
+            case Expression::Shape::BINARY: {
+                const TwoOperand &op = static_cast<const TwoOperand &>(*step.source);
+                TwoOperand *node = emptyOperator(op);
+                if (!node) {   /* an operator of its own, copied by its clone() */
+                    step.target->reset(op.clone());
+                    break;
+                }
+                step.target->reset(node);
+                steps.push(Step{op.rhs.get(), &node->rhs});
+                steps.push(Step{op.lhs.get(), &node->lhs});
+                break;
+            }
+            case Expression::Shape::CALL: {
+                const Function &func = static_cast<const Function &>(*step.source);
+                Function *node = new Function{nullptr, func};
+                step.target->reset(node);
+                steps.push(Step{func.arg.get(), &node->arg});
+                break;
+            }
+            default:
+                step.target->reset(step.source->clone());
+                break;
+        }
+    }
+    return copy;
+}
+
+/**
+ * Copies an operand in a copy constructor: recursively while the stack allows it, with cloneTree() below.
+ */
+static std::unique_ptr<Expression> cloneOperand(const Expression &operand) {
+    return stackExhausted() ? cloneTree(operand) : std::unique_ptr<Expression>(operand.clone());
+}
+
+/**
+ * Moves the operands of a node that are not leaves to a list.
+ */
+static void detachOperands(Expression &node, std::vector<std::unique_ptr<Expression>> &detached) {
+    std::unique_ptr<Expression> *operands[2] = {nullptr, nullptr};
+    switch (node.shape()) {
+        case Expression::Shape::BINARY:
+            operands[0] = &static_cast<TwoOperand &>(node).lhs;
+            operands[1] = &static_cast<TwoOperand &>(node).rhs;
+            break;
+        case Expression::Shape::CALL:
+            operands[0] = &static_cast<Function &>(node).arg;
+            break;
+        default:
+            return;
+    }
+    for (std::unique_ptr<Expression> *operand : operands)
+        if (operand && *operand && (*operand)->shape() != Expression::Shape::LEAF)
+            detached.push_back(std::move(*operand));
+}
+
+/**
+ * Destroys the operands of a node with an explicit stack. The operands of every node taken from the stack are
+ * moved to the stack before the node is destroyed, so no destructor goes deeper than the leaves below it.
+ */
+static void destroyOperands(Expression &node) {
+    std::vector<std::unique_ptr<Expression>> detached;
+    detachOperands(node, detached);
+    while (!detached.empty()) {
+        std::unique_ptr<Expression> next = std::move(detached.back());
+        detached.pop_back();
+        detachOperands(*next, detached);
+    }
+}
+
+const std::size_t Expression::BATCH_BLOCK;
+
+Expression::Shape Expression::shape() const {
+    return Shape::LEAF;
+}
 
 std::unique_ptr<Expression> Expression::simplify() const {
-    return std::unique_ptr<Expression>(clone());
+    static thread_local Simplifier simplifier;
+    std::unique_ptr<Expression> simplified{clone()};
+    simplifier.run(simplified);
+    return simplified;
+}
+
+void Expression::evaluate_batch(const double *xs, double *out, std::size_t n) const {
+    for (std::size_t i = 0; i < n; i += BATCH_BLOCK)
+        evaluate_block(xs + i, out + i, std::min(BATCH_BLOCK, n - i));
+}
+
+void Expression::evaluate_block(const double *xs, double *out, std::size_t n) const {
+    for (std::size_t i = 0; i < n; i++)
+        out[i] = evaluate(xs[i]);
+}
+
+float Expression::evaluate_float(float x) const {
+    return float(evaluate(x));
+}
+
+void Expression::evaluate_batch(const float *xs, float *out, std::size_t n) const {
+    for (std::size_t i = 0; i < n; i += BATCH_BLOCK)
+        evaluate_block_float(xs + i, out + i, std::min(BATCH_BLOCK, n - i));
+}
+
+void Expression::evaluate_block_float(const float *xs, float *out, std::size_t n) const {
+    for (std::size_t i = 0; i < n; i++)
+        out[i] = evaluate_float(xs[i]);
+}
+
+double Expression::evaluate_slots(const double *values) const {
+    return evaluate(values[0]);
+}
+
+void Expression::evaluate_block_slots(const double *const *columns, double *out, std::size_t n) const {
+    evaluate_block(columns[0], out, n);
+}
+
+std::unique_ptr<Expression> Expression::derive() const {
+    return differentiate()->simplify();
+}
+
+/**
+ * Shorthand for a new constant node.
+ */
+static std::unique_ptr<Expression> constant(double value) {
+    return std::unique_ptr<Expression>(new Constant{value});
 }
 Constant::Constant(double inC) : c{inC} { }
 
@@ -11,6 +570,26 @@ double Constant::evaluate(double x) const {
     return c;
 }
 
+void Constant::evaluate_block(const double *xs, double *out, std::size_t n) const {
+    std::fill(out, out + n, c);
+}
+
+float Constant::evaluate_float(float x) const {
+    return float(c);
+}
+
+void Constant::evaluate_block_float(const float *xs, float *out, std::size_t n) const {
+    std::fill(out, out + n, float(c));
+}
+
+double Constant::evaluate_slots(const double *values) const {
+    return c;
+}
+
+void Constant::evaluate_block_slots(const double *const *columns, double *out, std::size_t n) const {
+    std::fill(out, out + n, c);
+}
+
 void Constant::print(std::ostream &os) const {
     os << c;
 }
@@ -19,16 +598,68 @@ Constant* Constant::clone() const{
     return new Constant{*this};
 }
 
+Dual Constant::evaluate_with_derivative(double x) const {
+    return Dual{c, 0.0};
+}
+
+Interval Constant::evaluate_interval(double lo, double hi) const {
+    return Interval{c, c};
+}
+
+std::unique_ptr<Expression> Constant::differentiate() const {
+    return constant(0.0);
+}
+
+Variable::Variable(unsigned slot, std::string name) : slot{slot}, name{std::move(name)} { }
+
 double Variable::evaluate(double x) const {
-    return x;
+    return slot == 0 ? x : NAN;
+}
+
+void Variable::evaluate_block(const double *xs, double *out, std::size_t n) const {
+    if (slot == 0)
+        std::copy(xs, xs + n, out);
+    else
+        std::fill(out, out + n, NAN);
+}
+
+float Variable::evaluate_float(float x) const {
+    return slot == 0 ? x : NAN;
+}
+
+void Variable::evaluate_block_float(const float *xs, float *out, std::size_t n) const {
+    if (slot == 0)
+        std::copy(xs, xs + n, out);
+    else
+        std::fill(out, out + n, NAN);
+}
+
+double Variable::evaluate_slots(const double *values) const {
+    return values[slot];
+}
+
+void Variable::evaluate_block_slots(const double *const *columns, double *out, std::size_t n) const {
+    std::copy(columns[slot], columns[slot] + n, out);
 }
 
 void Variable::print(std::ostream &os) const {
-    os << 'x';
+    os << name;
 }
 
 Variable* Variable::clone() const{
-    return new Variable();
+    return new Variable{*this};
+}
+
+Dual Variable::evaluate_with_derivative(double x) const {
+    return slot == 0 ? Dual{x, 1.0} : Dual{NAN, 0.0};
+}
+
+Interval Variable::evaluate_interval(double lo, double hi) const {
+    return slot == 0 ? Interval{lo, hi} : Interval::entire();
+}
+
+std::unique_ptr<Expression> Variable::differentiate() const {
+    return constant(slot == 0 ? 1.0 : 0.0);
 }
 
 std::ostream &operator<<(std::ostream &os, Expression const &e) {
@@ -38,125 +669,235 @@ std::ostream &operator<<(std::ostream &os, Expression const &e) {
 
 TwoOperand::TwoOperand(std::unique_ptr<Expression>&& inLhs, std::unique_ptr<Expression>&& inRhs) : lhs{std::move(inLhs)}, rhs{std::move(inRhs)} {}
 
-TwoOperand::TwoOperand(TwoOperand const& other): lhs{other.lhs->clone()}, rhs{other.rhs->clone()} {}
+TwoOperand::TwoOperand(TwoOperand const& other): lhs{cloneOperand(*other.lhs)}, rhs{cloneOperand(*other.rhs)} {}
+
+TwoOperand::~TwoOperand() {
+    if (stackExhausted())
+        destroyOperands(*this);
+}
+
+Expression::Shape TwoOperand::shape() const {
+    return Shape::BINARY;
+}
+
+/**
+ * Evaluates an operator node, recursively while the stack allows it. Called with the final operator classes, the call
+ * of do_operator() is bound statically and inlined, saving an indirect call per node.
+ */
+template<typename Op>
+static double evaluateOperator(const Op &op, double x) {
+    if (stackExhausted())
+        return evaluateTree(op, x);
+    return op.do_operator(op.lhs->evaluate(x), op.rhs->evaluate(x));
+}
 
 double TwoOperand::evaluate(double x) const {
-    return do_operator(lhs->evaluate(x), rhs->evaluate(x));
+    return evaluateOperator(*this, x);
+}
+
+void TwoOperand::evaluate_block(const double *xs, double *out, std::size_t n) const {
+    if (stackExhausted())
+        return evaluateBlockTree(*this, xs, out, n);
+    BlockScratch<double> rhs_values;
+    lhs->evaluate_block(xs, out, n);
+    rhs->evaluate_block(xs, rhs_values.get(), n);
+    do_operator_block(out, rhs_values.get(), n);
+}
+
+float TwoOperand::evaluate_float(float x) const {
+    return do_operator_float(lhs->evaluate_float(x), rhs->evaluate_float(x));
+}
+
+void TwoOperand::evaluate_block_float(const float *xs, float *out, std::size_t n) const {
+    if (stackExhausted())
+        return evaluateBlockTree(*this, xs, out, n);
+    BlockScratch<float> rhs_values;
+    lhs->evaluate_block_float(xs, out, n);
+    rhs->evaluate_block_float(xs, rhs_values.get(), n);
+    do_operator_block_float(out, rhs_values.get(), n);
+}
+
+double TwoOperand::evaluate_slots(const double *values) const {
+    return do_operator(lhs->evaluate_slots(values), rhs->evaluate_slots(values));
+}
+
+void TwoOperand::evaluate_block_slots(const double *const *columns, double *out, std::size_t n) const {
+    if (stackExhausted())
+        return evaluateBlockTree(*this, columns, out, n);
+    BlockScratch<double> rhs_values;
+    lhs->evaluate_block_slots(columns, out, n);
+    rhs->evaluate_block_slots(columns, rhs_values.get(), n);
+    do_operator_block(out, rhs_values.get(), n);
+}
+
+void TwoOperand::do_operator_block(double *lhs, const double *rhs, std::size_t n) const {
+    for (std::size_t i = 0; i < n; i++)
+        lhs[i] = do_operator(lhs[i], rhs[i]);
+}
+
+float TwoOperand::do_operator_float(float lhs, float rhs) const {
+    return float(do_operator(lhs, rhs));
+}
+
+void TwoOperand::do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const {
+    for (std::size_t i = 0; i < n; i++)
+        lhs[i] = do_operator_float(lhs[i], rhs[i]);
+}
+
+Dual TwoOperand::evaluate_with_derivative(double x) const {
+    return do_operator_dual(lhs->evaluate_with_derivative(x), rhs->evaluate_with_derivative(x));
+}
+
+Interval TwoOperand::evaluate_interval(double lo, double hi) const {
+    if (stackExhausted())
+        return evaluateIntervalTree(*this, lo, hi);
+    return do_operator_interval(lhs->evaluate_interval(lo, hi), rhs->evaluate_interval(lo, hi));
 }
 
 void TwoOperand::print(std::ostream &os) const {
+    if (stackExhausted())
+        return printTree(*this, os);
     os << '(' << *lhs << get_operator() << *rhs << ')';
 }
 
+double Sum::evaluate(double x) const {
+    return evaluateOperator(*this, x);
+}
+
 double Sum::do_operator(double lhs, double rhs) const {
     return lhs + rhs;
 }
 
+void Sum::do_operator_block(double *lhs, const double *rhs, std::size_t n) const {
+    BatchKernels::add(lhs, rhs, n);
+}
+
+void Sum::do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const {
+    BatchKernels::add(lhs, rhs, n);
+}
+
 char Sum::get_operator() const {
     return '+';
 }
 
+Dual Sum::do_operator_dual(Dual lhs, Dual rhs) const {
+    return Dual{lhs.value + rhs.value, lhs.derivative + rhs.derivative};
+}
+
+Interval Sum::do_operator_interval(Interval lhs, Interval rhs) const {
+    return lhs + rhs;
+}
+
+std::unique_ptr<Expression> Sum::differentiate() const {
+    return std::unique_ptr<Expression>(new Sum{lhs->differentiate(), rhs->differentiate()});
+}
+
 Sum * Sum::clone() const {
     return new Sum{*this};;
 };
 
-std::unique_ptr<Expression> Sum::simplify() const {
-    std::unique_ptr<Expression> lhs_simpl {lhs->simplify()};
-    std::unique_ptr<Expression> rhs_simpl {rhs->simplify()};
-    std::unique_ptr<Constant> lhs_cons{dynamic_cast<Constant *>(lhs_simpl->clone())};
-    std::unique_ptr<Constant> rhs_cons{dynamic_cast<Constant *>(rhs_simpl->clone())};
-    if (lhs_cons && lhs_cons->get_value() == 0.0) {  /* 0 + a = a */
-        return std::unique_ptr<Expression>(rhs_simpl.release());
-    }
-    if (rhs_cons != nullptr && rhs_cons->get_value() == 0.0) {  /* a + 0 = a */
-        return std::unique_ptr<Expression>(lhs_simpl.release());
-    }
-    if (lhs_cons != nullptr && rhs_cons != nullptr) {   /* c + c = c */
-        double new_value = lhs_cons->get_value() + rhs_cons->get_value();
-        return std::unique_ptr<Expression>(new Constant{new_value});
-    }
-    return std::unique_ptr<Expression>(new Sum{std::move(lhs_simpl), std::move(rhs_simpl)});
-};
+double Prod::evaluate(double x) const {
+    return evaluateOperator(*this, x);
+}
 
 double Prod::do_operator(double lhs, double rhs) const {
     return lhs * rhs;
 }
 
+void Prod::do_operator_block(double *lhs, const double *rhs, std::size_t n) const {
+    BatchKernels::mul(lhs, rhs, n);
+}
+
+void Prod::do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const {
+    BatchKernels::mul(lhs, rhs, n);
+}
+
 char Prod::get_operator() const {
     return '*';
 }
 
-std::unique_ptr<Expression> Prod::simplify() const {
-    std::unique_ptr<Expression> lhs_simpl {lhs->simplify()};
-    std::unique_ptr<Expression> rhs_simpl {rhs->simplify()};
-    std::unique_ptr<Constant> lhs_cons{dynamic_cast<Constant *>(lhs_simpl->clone())};
-    std::unique_ptr<Constant> rhs_cons{dynamic_cast<Constant *>(rhs_simpl->clone())};
-    if (lhs_cons && lhs_cons->get_value() == 1.0) {  /* 1 * a = a */
-        return std::unique_ptr<Expression>(rhs_simpl.release());
-    }
-    if ((rhs_cons && rhs_cons->get_value()==0.0) || (lhs_cons && lhs_cons->get_value() == 0.0)) {  /* 0 * a = 0 || a * 0 = 0 */
-        return std::unique_ptr<Expression>(new Constant{0});
-    }
-    if (rhs_cons && rhs_cons->get_value() == 1.0) {  /* a + 1 = a */
-        return std::unique_ptr<Expression>(lhs_simpl.release());
-    }
-    if (lhs_cons && rhs_cons ) {   /* c * c = C */
-        double new_value = lhs_cons->get_value() * rhs_cons->get_value();
-        return std::unique_ptr<Expression>(new Constant{new_value});
-    }
-    return std::unique_ptr<Expression>(new Prod{std::move(lhs_simpl), std::move(rhs_simpl)});
+Dual Prod::do_operator_dual(Dual lhs, Dual rhs) const {
+    return Dual{lhs.value * rhs.value, lhs.derivative * rhs.value + lhs.value * rhs.derivative};
+}
+
+Interval Prod::do_operator_interval(Interval lhs, Interval rhs) const {
+    return lhs * rhs;
+}
+
+std::unique_ptr<Expression> Prod::differentiate() const {   /* (u*v)' = u'*v + u*v' */
+    std::unique_ptr<Expression> left{new Prod{lhs->differentiate(), std::unique_ptr<Expression>(rhs->clone())}};
+    std::unique_ptr<Expression> right{new Prod{std::unique_ptr<Expression>(lhs->clone()), rhs->differentiate()}};
+    return std::unique_ptr<Expression>(new Sum{std::move(left), std::move(right)});
+}
+
+double Dif::evaluate(double x) const {
+    return evaluateOperator(*this, x);
 }
 
 double Dif::do_operator(double lhs, double rhs) const {
     return lhs - rhs;
 }
 
+void Dif::do_operator_block(double *lhs, const double *rhs, std::size_t n) const {
+    BatchKernels::sub(lhs, rhs, n);
+}
+
+void Dif::do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const {
+    BatchKernels::sub(lhs, rhs, n);
+}
+
 char Dif::get_operator() const {
     return '-';
 }
 
-std::unique_ptr<Expression> Dif::simplify() const {
-    std::unique_ptr<Expression> lhs_simpl {lhs->simplify()};
-    std::unique_ptr<Expression> rhs_simpl {rhs->simplify()};
-    std::unique_ptr<Constant> lhs_cons{dynamic_cast<Constant *>(lhs_simpl->clone())};
-    std::unique_ptr<Constant> rhs_cons{dynamic_cast<Constant *>(rhs_simpl->clone())};
-    if (lhs_cons && lhs_cons->get_value() == 0.0) {  /* 0 - a = -1 * a */
-        return std::unique_ptr<Expression>(new Prod{std::move(rhs_simpl),std::unique_ptr<Expression>(new Constant{-1.0})});
-    }
-    if (rhs_cons  && rhs_cons->get_value() == 0.0) {  /* a - 0  = a */
-        return std::unique_ptr<Expression>(lhs_simpl.release());
-    }
-    if (lhs_cons && rhs_cons ) {   /* c - c = C */
-        double new_value = lhs_cons->get_value() - rhs_cons->get_value();
-        return std::unique_ptr<Expression>(new Constant{new_value});
-    }
-    return std::unique_ptr<Expression>(new Dif{std::move(lhs_simpl), std::move(rhs_simpl)});
+Dual Dif::do_operator_dual(Dual lhs, Dual rhs) const {
+    return Dual{lhs.value - rhs.value, lhs.derivative - rhs.derivative};
+}
+
+Interval Dif::do_operator_interval(Interval lhs, Interval rhs) const {
+    return lhs - rhs;
+}
+
+std::unique_ptr<Expression> Dif::differentiate() const {
+    return std::unique_ptr<Expression>(new Dif{lhs->differentiate(), rhs->differentiate()});
+}
+
+double Div::evaluate(double x) const {
+    return evaluateOperator(*this, x);
 }
 
 double Div::do_operator(double lhs, double rhs) const {
     return lhs / rhs;
 }
 
+void Div::do_operator_block(double *lhs, const double *rhs, std::size_t n) const {
+    BatchKernels::div(lhs, rhs, n);
+}
+
+void Div::do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const {
+    BatchKernels::div(lhs, rhs, n);
+}
+
 char Div::get_operator() const {
     return '/';
 }
 
-std::unique_ptr<Expression> Div::simplify() const {
-    std::unique_ptr<Expression> lhs_simpl {lhs->simplify()};
-    std::unique_ptr<Expression> rhs_simpl {rhs->simplify()};
-    std::unique_ptr<Constant> lhs_cons{dynamic_cast<Constant *>(lhs_simpl->clone())};
-    std::unique_ptr<Constant> rhs_cons{dynamic_cast<Constant *>(rhs_simpl->clone())};
-    if (lhs_cons && lhs_cons->get_value() == 0.0) {  /* 0 / a = 0 */
-        return std::unique_ptr<Expression>(new Constant{0.0});
-    }
-    if (rhs_cons && rhs_cons->get_value() == 0.0) {  /* a / 0  = ERR */
-        throw std::runtime_error("Division by 0!");
-    }
-    if (lhs_cons && rhs_cons ) {   /* c / c = C */
-        double new_value = lhs_cons->get_value() / rhs_cons->get_value();
-        return std::unique_ptr<Expression>(new Constant{new_value});
-    }
-    return std::unique_ptr<Expression>(new Div{std::move(lhs_simpl), std::move(rhs_simpl)});
+Dual Div::do_operator_dual(Dual lhs, Dual rhs) const {
+    return Dual{lhs.value / rhs.value,
+                (lhs.derivative * rhs.value - lhs.value * rhs.derivative) / (rhs.value * rhs.value)};
+}
+
+Interval Div::do_operator_interval(Interval lhs, Interval rhs) const {
+    return lhs / rhs;
+}
+
+std::unique_ptr<Expression> Div::differentiate() const {   /* (u/v)' = (u'*v - u*v') / (v*v) */
+    std::unique_ptr<Expression> left{new Prod{lhs->differentiate(), std::unique_ptr<Expression>(rhs->clone())}};
+    std::unique_ptr<Expression> right{new Prod{std::unique_ptr<Expression>(lhs->clone()), rhs->differentiate()}};
+    std::unique_ptr<Expression> square{new Prod{std::unique_ptr<Expression>(rhs->clone()),
+                                                std::unique_ptr<Expression>(rhs->clone())}};
+    return std::unique_ptr<Expression>(new Div{std::unique_ptr<Expression>(new Dif{std::move(left), std::move(right)}),
+                                               std::move(square)});
 }
 
 Prod *Prod::clone() const {
@@ -175,57 +916,270 @@ double Constant::get_value() const {
     return c;
 }
 
+double Exp::evaluate(double x) const {
+    return evaluateOperator(*this, x);
+}
+
 double Exp::do_operator(double lhs, double rhs) const {
     return pow(lhs,rhs);
 }
 
+void Exp::do_operator_block(double *lhs, const double *rhs, std::size_t n) const {
+    FastMath::pow_block(lhs, rhs, n);
+}
+
+float Exp::do_operator_float(float lhs, float rhs) const {
+    return powf(lhs, rhs);
+}
+
+void Exp::do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const {
+    for (std::size_t i = 0; i < n; i++)
+        lhs[i] = powf(lhs[i], rhs[i]);
+}
+
 char Exp::get_operator() const {
     return '^';
 }
 
+Dual Exp::do_operator_dual(Dual lhs, Dual rhs) const {
+    double value = pow(lhs.value, rhs.value);
+    double derivative = 0.0;
+    if (lhs.derivative != 0.0) {   /* (u^c)' = c * u^(c-1) * u' */
+        /* u^(c-1) = u^c / u saves the second pow, unless the division would over- or underflow */
+        double lowered = isnormal(value) && isnormal(lhs.value) ? value / lhs.value : pow(lhs.value, rhs.value - 1.0);
+        derivative += rhs.value * lowered * lhs.derivative;
+    }
+    if (rhs.derivative != 0.0)   /* (c^v)' = c^v * ln(c) * v' */
+        derivative += value * log(lhs.value) * rhs.derivative;
+    return Dual{value, derivative};
+}
+
+Interval Exp::do_operator_interval(Interval lhs, Interval rhs) const {
+    return intervalPow(lhs, rhs);
+}
+
+std::unique_ptr<Expression> Exp::differentiate() const {   /* (u^v)' = v * u^(v-1) * u' + u^v * ln(u) * v' */
+    std::unique_ptr<Expression> u{lhs->clone()}, v{rhs->clone()};
+    std::unique_ptr<Expression> lowered{new Dif{std::unique_ptr<Expression>(rhs->clone()), constant(1.0)}};
+    std::unique_ptr<Expression> power{new Exp{std::move(u), std::move(lowered)}};
+    std::unique_ptr<Expression> base_part{new Prod{std::unique_ptr<Expression>(new Prod{std::move(v), std::move(power)}),
+                                                   lhs->differentiate()}};
+    if (dynamic_cast<const Constant *>(rhs.get()))
+        return base_part;
+    std::unique_ptr<Expression> log_base{new Function{std::unique_ptr<Expression>(lhs->clone()),
+                                                      FunctionRegistry::global().get(FunctionRegistry::LOG)}};
+    std::unique_ptr<Expression> scaled{new Prod{std::unique_ptr<Expression>(clone()), std::move(log_base)}};
+    std::unique_ptr<Expression> exponent_part{new Prod{std::move(scaled), rhs->differentiate()}};
+    return std::unique_ptr<Expression>(new Sum{std::move(base_part), std::move(exponent_part)});
+}
+
 Exp *Exp::clone() const {
     return new Exp{*this};
 }
 
-std::unique_ptr<Expression> Exp::simplify() const {
-    std::unique_ptr<Expression> lhs_simpl {lhs->simplify()};
-    std::unique_ptr<Expression> rhs_simpl {rhs->simplify()};
-    std::unique_ptr<Constant> lhs_cons{dynamic_cast<Constant *>(lhs_simpl->clone())};
-    std::unique_ptr<Constant> rhs_cons{dynamic_cast<Constant *>(rhs_simpl->clone())};
-    if (lhs_cons && lhs_cons->get_value() == 1.0) {  /* 1 ^ a = 1 */
-        return std::unique_ptr<Expression>(lhs_simpl.release());
-    }
-    if (rhs_cons && rhs_cons->get_value() == 1.0) {  /* a ^ 1 = a */
-        return std::unique_ptr<Expression>(lhs_simpl.release());
-    }
-    if (rhs_cons && rhs_cons->get_value() == 0.0) {  /* a ^ 0 = 1 */
-        return std::unique_ptr<Expression>(new Constant{1});
+/**
+ * Looks up the derivative of a function, returning an empty function object if it is not known.
+ */
+static std::function<double(double)> lookupDerivative(const std::string &name) {
+    try {
+        return parseFunctionDerivative(name);
+    } catch (const std::invalid_argument &) {
+        return std::function<double(double)>{};
     }
-    if (lhs_cons && rhs_cons) {   /* c * c = C */
-        double new_value = pow(lhs_cons->get_value(),rhs_cons->get_value());
-        return std::unique_ptr<Expression>(new Constant{new_value});
+}
+
+/**
+ * Looks up the interval extension of a function, returning an empty function object if it is not known.
+ */
+static std::function<Interval(Interval)> lookupInterval(const std::string &name) {
+    try {
+        return parseFunctionInterval(name);
+    } catch (const std::invalid_argument &) {
+        return std::function<Interval(Interval)>{};
     }
-    return std::unique_ptr<Expression>(new Exp{std::move(lhs_simpl), std::move(rhs_simpl)});
 }
 
-Function::Function(std::unique_ptr<Expression>&& inArg, std::function<double(double)> func, std::string name) : arg{std::move(inArg)},functor{func}, name{name}{}
+Function::Function(std::unique_ptr<Expression> &&inArg, const FunctionRegistry::Entry &entry) : arg{std::move(inArg)}, builtin{entry.builtin}, entry{&entry} { }
+
+/**
+ * Makes the entry of a bare functor, with the derivative and interval extension known for its name.
+ */
+static std::shared_ptr<const FunctionRegistry::Entry> bareEntry(std::function<double(double)> &&func,
+                                                                std::string &&name) {
+    FunctionRegistry::BatchFunction batch = FunctionRegistry::scalar_batch(func);
+    std::function<double(double)> derivative = lookupDerivative(name);
+    std::function<Interval(Interval)> interval = lookupInterval(name);
+    return std::make_shared<const FunctionRegistry::Entry>(FunctionRegistry::Entry{
+            FunctionRegistry::CUSTOM, std::move(name), std::move(func), std::move(batch), nullptr,
+            std::move(derivative), std::move(interval)});
+}
+
+Function::Function(std::unique_ptr<Expression>&& inArg, std::function<double(double)> func, std::string name) : Function{std::move(inArg), bareEntry(std::move(func), std::move(name))} {}
+
+Function::Function(std::unique_ptr<Expression> &&inArg, std::shared_ptr<const FunctionRegistry::Entry> bare) : arg{std::move(inArg)}, builtin{bare->builtin}, entry{bare.get()}, bare_entry{std::move(bare)} { }
+
+Function::Function(const Function &in) : arg{cloneOperand(*in.arg)}, builtin{in.builtin}, entry{in.entry}, bare_entry{in.bare_entry} { }
+
+Function::Function(std::unique_ptr<Expression> &&inArg, const Function &call) : arg{std::move(inArg)}, builtin{call.builtin}, entry{call.entry}, bare_entry{call.bare_entry} { }
+
+Function::~Function() {
+    if (stackExhausted())
+        destroyOperands(*this);
+}
 
-Function::Function(const Function &in) : arg{in.arg->clone()},functor{in.functor}, name{in.name} { }
+Expression::Shape Function::shape() const {
+    return Shape::CALL;
+}
 
 double Function::evaluate(double x) const {
-    return functor(arg->evaluate(x));
+    if (stackExhausted())
+        return evaluateTree(*this, x);
+    return callFunction(*this, arg->evaluate(x));
+}
+
+void Function::evaluate_block(const double *xs, double *out, std::size_t n) const {
+    if (stackExhausted())
+        return evaluateBlockTree(*this, xs, out, n);
+    arg->evaluate_block(xs, out, n);
+    applyFunction(builtin, entry, out, n);
+}
+
+float Function::evaluate_float(float x) const {
+    float value = arg->evaluate_float(x);
+    return builtin != FunctionRegistry::CUSTOM ? FunctionRegistry::evaluate(builtin, value) :
+           float(entry->scalar(value));
+}
+
+void Function::evaluate_block_float(const float *xs, float *out, std::size_t n) const {
+    if (stackExhausted())
+        return evaluateBlockTree(*this, xs, out, n);
+    arg->evaluate_block_float(xs, out, n);
+    applyFunction(builtin, entry, out, n);
+}
+
+double Function::evaluate_slots(const double *values) const {
+    double value = arg->evaluate_slots(values);
+    return builtin != FunctionRegistry::CUSTOM ? FunctionRegistry::evaluate(builtin, value) : entry->scalar(value);
+}
+
+void Function::evaluate_block_slots(const double *const *columns, double *out, std::size_t n) const {
+    if (stackExhausted())
+        return evaluateBlockTree(*this, columns, out, n);
+    arg->evaluate_block_slots(columns, out, n);
+    applyFunction(builtin, entry, out, n);
 }
 
 void Function::print(std::ostream &os) const {
-    os<<name <<'(' <<*arg <<')';
+    if (stackExhausted())
+        return printTree(*this, os);
+    os << entry->name << '(' << *arg << ')';
 }
 
 Expression *Function::clone() const {
     return new Function{*this};
 }
 
-std::unique_ptr<Expression> Function::simplify() const {
-    return std::unique_ptr<Expression>(new Function(std::move(arg->simplify()),functor,name));
+Dual Function::evaluate_with_derivative(double x) const {
+    if (!entry->derivative)
+        throw std::invalid_argument("No derivative known for function: " + entry->name);
+    Dual inner = arg->evaluate_with_derivative(x);
+    double value = builtin != FunctionRegistry::CUSTOM ? FunctionRegistry::evaluate(builtin, inner.value) :
+                   entry->scalar(inner.value);
+    return Dual{value, entry->derivative(inner.value) * inner.derivative};
+}
+
+Interval Function::evaluate_interval(double lo, double hi) const {
+    if (stackExhausted())
+        return evaluateIntervalTree(*this, lo, hi);
+    if (!entry->interval)
+        return Interval::entire();
+    return entry->interval(arg->evaluate_interval(lo, hi));
+}
+
+std::unique_ptr<Expression> Function::differentiate() const {   /* f(u)' = f'(u) * u' */
+    return std::unique_ptr<Expression>(new Prod{buildFunctionDerivative(entry->name, std::unique_ptr<Expression>(arg->clone())),
+                                                arg->differentiate()});
+}
+
+FunctionTarget::FunctionTarget(const Function &func) : builtin{func.builtin}, entry{func.entry}, bare_entry{func.bare_entry} { }
+
+double FunctionTarget::apply(double x) const {
+    return builtin != FunctionRegistry::CUSTOM ? FunctionRegistry::evaluate(builtin, x) : entry->scalar(x);
+}
+
+void FunctionTarget::apply_block(double *values, std::size_t n) const {
+    applyFunction(builtin, entry, values, n);
+}
+
+std::unique_ptr<Expression> FunctionTarget::call(std::unique_ptr<Expression> &&arg) const {
+    if (bare_entry)
+        return std::unique_ptr<Expression>(new Function{std::move(arg), bare_entry});
+    return std::unique_ptr<Expression>(new Function{std::move(arg), *entry});
 }
 
+Polynomial::Polynomial(std::vector<double> coefficients) : coefficients{std::move(coefficients)} { }
+
+std::size_t Polynomial::degree() const {
+    return coefficients.size() - 1;
+}
+
+double Polynomial::evaluate(double x) const {
+    return BatchKernels::horner(coefficients.data(), coefficients.size(), x);
+}
 
+void Polynomial::evaluate_block(const double *xs, double *out, std::size_t n) const {
+    BatchKernels::horner_block(coefficients.data(), coefficients.size(), xs, out, n);
+}
+
+/**
+ * Horner's method in float, with the coefficients rounded to float.
+ */
+static float hornerFloat(const std::vector<double> &coefficients, float x) {
+    float acc = float(coefficients.back());
+    for (std::size_t k = coefficients.size() - 1; k-- > 0;)
+        acc = acc * x + float(coefficients[k]);
+    return acc;
+}
+
+float Polynomial::evaluate_float(float x) const {
+    return hornerFloat(coefficients, x);
+}
+
+void Polynomial::evaluate_block_float(const float *xs, float *out, std::size_t n) const {
+    for (std::size_t i = 0; i < n; i++)
+        out[i] = hornerFloat(coefficients, xs[i]);
+}
+
+void Polynomial::print(std::ostream &os) const {
+    os << '(' << coefficients[0];
+    for (std::size_t k = 1; k < coefficients.size(); k++)
+        os << "+x*(" << coefficients[k];
+    os << std::string(coefficients.size(), ')');
+}
+
+Polynomial *Polynomial::clone() const {
+    return new Polynomial{*this};
+}
+
+Dual Polynomial::evaluate_with_derivative(double x) const {
+    double derivative = 0.0;
+    for (std::size_t k = coefficients.size() - 1; k > 0; k--)
+        derivative = derivative * x + double(k) * coefficients[k];
+    return Dual{evaluate(x), derivative};
+}
+
+Interval Polynomial::evaluate_interval(double lo, double hi) const {
+    Interval x{lo, hi}, result{coefficients.back(), coefficients.back()};
+    for (std::size_t k = coefficients.size() - 1; k > 0; k--)
+        result = result * x + Interval{coefficients[k - 1], coefficients[k - 1]};
+    return result;
+}
+
+std::unique_ptr<Expression> Polynomial::differentiate() const {
+    if (coefficients.size() <= 2)
+        return constant(coefficients.size() == 2 ? coefficients[1] : 0.0);
+    std::vector<double> derivative(coefficients.size() - 1);
+    for (std::size_t k = 1; k < coefficients.size(); k++)
+        derivative[k - 1] = double(k) * coefficients[k];
+    return std::unique_ptr<Expression>(new Polynomial{std::move(derivative)});
+}
@@ -6,11 +6,61 @@
 #define C11NHF_EXPRESSIONS_H
 #include <iostream>
 #include <memory>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "Interval.h"
+#include "FunctionRegistry.h"
+
+/**
+ * Value of an expression together with its derivative with respect to X, a dual number.
+ */
+struct Dual {
+    double value;
+    double derivative;
+};
+
 /**
  * Abstract expression base class, Expression implementations inherit from this.
+ * The const member functions may be called on one tree from several threads at once: the nodes hold no mutable
+ * state, the scratch buffers of the batch evaluation are per thread, and the functors of the builtin functions are
+ * stateless. A Function built with a functor of its own is as thread-safe as the functor.
+ * evaluate(), the block evaluation (evaluate_batch(), its single precision and several variable forms),
+ * evaluate_interval(), print(), clone() and the destruction of a tree recurse, which is fastest, while the native
+ * stack of the thread has room, and continue deeper subtrees with an explicit stack; simplify() always uses one. So
+ * they handle trees of any depth, like the left-deep chain of a generated sum of a million terms; the other
+ * traversals recurse, one native stack frame per level.
  */
 class Expression {
 public:
+    /**
+     * What a node is for the traversals with an explicit stack.
+     */
+    enum class Shape : unsigned char {
+        LEAF,   /**< no operands; evaluated, printed and cloned by its own member functions */
+        BINARY, /**< a TwoOperand */
+        CALL    /**< a Function */
+    };
+
+    /**
+     * Number of places evaluate_block() handles at most in one call.
+     */
+    static const std::size_t BATCH_BLOCK = 256;
+
+    virtual ~Expression() = default;
+
+    /**
+     * Allocates nodes from the ExpressionArena active on the current thread, or from the heap if there is none.
+     * @see ExpressionArena
+     */
+    static void *operator new(std::size_t size);
+
+    /**
+     * Releases a node allocated by operator new. Nodes of an arena are only released together with the arena.
+     */
+    static void operator delete(void *node) noexcept;
+
     /**
      * Returns with the value of the Expression at place X.
      * @param x place to evaluate expression at.
@@ -18,6 +68,116 @@ public:
      */
     virtual double evaluate(double x) const = 0;
 
+    /**
+     * Evaluates the expression at n places. The places are split into blocks, and every node processes a whole
+     * block at once, so the tree is traversed once per block instead of once per place.
+     * In the EXACT precision of FastMath the results are bit-identical to calling evaluate() for every place; in the
+     * FAST precision sin, cos, tan, exp, log and ^ use its approximations, whose errors FastMath.h lists.
+     * @param xs places to evaluate the expression at
+     * @param out array of n values receiving the results, must not overlap xs
+     * @param n number of places
+     */
+    void evaluate_batch(const double *xs, double *out, std::size_t n) const;
+
+    /**
+     * Evaluates the expression at a block of at most BATCH_BLOCK places.
+     * The default implementation calls evaluate() for every place.
+     * @see Expression::evaluate_batch()
+     */
+    virtual void evaluate_block(const double *xs, double *out, std::size_t n) const;
+
+    /**
+     * Returns the value of the Expression at place X computed in single precision: the operators work on floats
+     * and the builtin functions are the float functions of libm, so values are correct to a few float ulps per
+     * operation, and errors grow where the expression cancels. Use checkFloatPrecision() to decide whether that is
+     * good enough for an expression over a range.
+     * The default implementation rounds evaluate() to float, so node types without a float implementation are
+     * computed in double precision.
+     * @param x place to evaluate expression at.
+     * @return value of the expression
+     */
+    virtual float evaluate_float(float x) const;
+
+    /**
+     * Evaluates the expression at n places in single precision, in blocks like evaluate_batch(const double *,
+     * double *, std::size_t); the element-wise kernels process twice as many floats as doubles per vector. The
+     * results are bit-identical to calling evaluate_float() for every place.
+     * @param xs places to evaluate the expression at
+     * @param out array of n values receiving the results, must not overlap xs
+     * @param n number of places
+     */
+    void evaluate_batch(const float *xs, float *out, std::size_t n) const;
+
+    /**
+     * Evaluates the expression at a block of at most BATCH_BLOCK places in single precision.
+     * The default implementation calls evaluate_float() for every place.
+     * @see Expression::evaluate_batch(const float *, float *, std::size_t)
+     */
+    virtual void evaluate_block_float(const float *xs, float *out, std::size_t n) const;
+
+    /**
+     * Evaluates the expression in the precision of T, for code templated on the scalar type: evaluate() for
+     * double, evaluate_float() for float. The batch form is the evaluate_batch() overload of the type.
+     * @param x place to evaluate expression at.
+     * @return value of the expression
+     */
+    template<typename T>
+    T evaluate_as(T x) const;
+
+    /**
+     * Returns with the value of the Expression with its variables taking their values from an array, for
+     * expressions of several variables. evaluate(x) is the special case of a single variable, X, in slot 0.
+     * The default implementation is for expressions of X alone, it returns evaluate(values[0]).
+     * @param values values of the variables, indexed by their slots; must have an entry for every slot used
+     * @return value of the expression
+     */
+    virtual double evaluate_slots(const double *values) const;
+
+    /**
+     * Evaluates the expression at a block of at most BATCH_BLOCK points of several variables, the value of the
+     * variable in slot k at point i being columns[k][i]. In the EXACT precision of FastMath the results are
+     * bit-identical to calling evaluate_slots() for every point, @see evaluate_batch(). The default implementation
+     * is for expressions of X alone, it calls evaluate_block(columns[0], out, n).
+     * @param columns values of the variables, indexed by their slots; must have a column for every slot used
+     * @param out array of n values receiving the results, must not overlap the columns
+     * @param n number of points
+     */
+    virtual void evaluate_block_slots(const double *const *columns, double *out, std::size_t n) const;
+
+    /**
+     * Returns the value and the derivative of the Expression at place X in a single pass, by forward mode automatic
+     * differentiation: every node computes its value and derivative from those of its children.
+     * @param x place to evaluate expression at.
+     * @return value and derivative of the expression, the value being the same as evaluate(x) returns
+     * @throws std::invalid_argument if the expression calls a function without a known derivative
+     */
+    virtual Dual evaluate_with_derivative(double x) const = 0;
+
+    /**
+     * Encloses the values of the Expression over a range of places by interval arithmetic: every node computes the
+     * interval of its values from the intervals of its children, so the result contains evaluate(x) for every x in
+     * [lo, hi] where that is finite. The enclosure may be wider than the true range, never narrower.
+     * @param lo lower end of the range of places
+     * @param hi upper end of the range of places
+     * @return enclosure of the values
+     * @see Interval
+     */
+    virtual Interval evaluate_interval(double lo, double hi) const = 0;
+
+    /**
+     * Builds the derivative of the expression symbolically, without simplifying it.
+     * @return new tree of the derivative
+     * @throws std::invalid_argument if the expression calls a function without a known derivative
+     */
+    virtual std::unique_ptr<Expression> differentiate() const = 0;
+
+    /**
+     * Builds the derivative of the expression symbolically, and simplifies it.
+     * @return new, simplified tree of the derivative
+     * @throws std::invalid_argument if the expression calls a function without a known derivative
+     */
+    std::unique_ptr<Expression> derive() const;
+
     /**
      * Prints the signature of the expression to os;
      * @param os ostream object, where the function prints the signature
@@ -31,11 +191,20 @@ public:
     virtual Expression * clone() const = 0 ;
 
     /**
-     * If the expression can be simplified, returns a new, simplified version
+     * If the expression can be simplified, returns a new, simplified version.
+     * The tree is cloned once and rewritten in place by the Simplifier.
+     * @see Simplifier
      * @return simplified expression
      */
     virtual std::unique_ptr<Expression> simplify() const;
 
+    /**
+     * Returns what the node is for the traversals with an explicit stack, which cast it to TwoOperand or Function
+     * accordingly. The default implementation returns LEAF.
+     * @return shape of the node
+     */
+    virtual Shape shape() const;
+
 };
 
 /**
@@ -51,6 +220,46 @@ public:
      */
     virtual double evaluate(double x) const override;
 
+    /**
+     * @see Expression::evaluate_block()
+     */
+    virtual void evaluate_block(const double *xs, double *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_float()
+     */
+    virtual float evaluate_float(float x) const override;
+
+    /**
+     * @see Expression::evaluate_block_float()
+     */
+    virtual void evaluate_block_float(const float *xs, float *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_slots()
+     */
+    virtual double evaluate_slots(const double *values) const override;
+
+    /**
+     * @see Expression::evaluate_block_slots()
+     */
+    virtual void evaluate_block_slots(const double *const *columns, double *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_with_derivative()
+     */
+    virtual Dual evaluate_with_derivative(double x) const override;
+
+    /**
+     * @see Expression::evaluate_interval()
+     */
+    virtual Interval evaluate_interval(double lo, double hi) const override;
+
+    /**
+     * @see Expression::differentiate()
+     */
+    virtual std::unique_ptr<Expression> differentiate() const override;
+
     /**
      * @see Expression::print()
      */
@@ -69,16 +278,69 @@ public:
 };
 
 /**
- * Expression representing a variable.
+ * Expression representing a variable. The variable in slot 0 is X, the one the single-variable evaluation,
+ * differentiation and interval functions are meant in; the variables of the other slots are only given values by
+ * evaluate_slots() and evaluate_block_slots(), the rest see them as NaN, constant with respect to X.
  */
 class Variable final : public Expression {
 public:
+    /**
+     * Index of the value of the variable in the arrays of evaluate_slots().
+     */
+    unsigned slot;
+
+    /**
+     * Name the variable is printed with.
+     */
+    std::string name;
+
+    Variable(unsigned slot = 0, std::string name = "x");
 
     /**
      * @see Expression::evaluate()
      */
     virtual double evaluate(double x) const override;
 
+    /**
+     * @see Expression::evaluate_block()
+     */
+    virtual void evaluate_block(const double *xs, double *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_float()
+     */
+    virtual float evaluate_float(float x) const override;
+
+    /**
+     * @see Expression::evaluate_block_float()
+     */
+    virtual void evaluate_block_float(const float *xs, float *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_slots()
+     */
+    virtual double evaluate_slots(const double *values) const override;
+
+    /**
+     * @see Expression::evaluate_block_slots()
+     */
+    virtual void evaluate_block_slots(const double *const *columns, double *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_with_derivative()
+     */
+    virtual Dual evaluate_with_derivative(double x) const override;
+
+    /**
+     * @see Expression::evaluate_interval()
+     */
+    virtual Interval evaluate_interval(double lo, double hi) const override;
+
+    /**
+     * @see Expression::differentiate()
+     */
+    virtual std::unique_ptr<Expression> differentiate() const override;
+
     /**
      * @see Expression::print()
      */
@@ -105,6 +367,17 @@ public:
      */
     TwoOperand(TwoOperand const & other);
 
+    /**
+     * Destroys the operands, recursively while the native stack allows it and with an explicit stack below, so deep
+     * trees don't overflow the native stack.
+     */
+    virtual ~TwoOperand();
+
+    /**
+     * @see Expression::shape()
+     */
+    virtual Shape shape() const override;
+
     /**
      * Executes the operator represented by the class on two values.
      * @param lhs left hand side argument of the operation
@@ -113,11 +386,87 @@ public:
      */
     virtual double do_operator(double lhs, double rhs) const =0;
 
+    /**
+     * Executes the operator element-wise on two blocks of values, storing the results in lhs.
+     * The default implementation calls do_operator() for every element.
+     * @param lhs left hand side arguments, overwritten with the results
+     * @param rhs right hand side arguments
+     * @param n number of elements
+     */
+    virtual void do_operator_block(double *lhs, const double *rhs, std::size_t n) const;
+
+    /**
+     * Executes the operator on two floats. The default implementation rounds do_operator() to float, which for
+     * + - * and / is the correctly rounded float operation, double having more than twice the digits of float.
+     * @param lhs left hand side argument of the operation
+     * @param rhs right hand side argument of the operator
+     * @return result of the operation
+     */
+    virtual float do_operator_float(float lhs, float rhs) const;
+
+    /**
+     * Executes the operator element-wise on two blocks of floats, storing the results in lhs, with the same results
+     * as do_operator_float(). The default implementation calls do_operator_float() for every element.
+     * @see TwoOperand::do_operator_block()
+     */
+    virtual void do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const;
+
     /**
      * @see Expression::evaluate()
      */
     virtual double evaluate(double x) const override;
 
+    /**
+     * @see Expression::evaluate_block()
+     */
+    virtual void evaluate_block(const double *xs, double *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_float()
+     */
+    virtual float evaluate_float(float x) const override;
+
+    /**
+     * @see Expression::evaluate_block_float()
+     */
+    virtual void evaluate_block_float(const float *xs, float *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_slots()
+     */
+    virtual double evaluate_slots(const double *values) const override;
+
+    /**
+     * @see Expression::evaluate_block_slots()
+     */
+    virtual void evaluate_block_slots(const double *const *columns, double *out, std::size_t n) const override;
+
+    /**
+     * Executes the operator on two dual numbers, applying the differentiation rule of the operator.
+     * @param lhs left hand side value and derivative
+     * @param rhs right hand side value and derivative
+     * @return value and derivative of the result
+     */
+    virtual Dual do_operator_dual(Dual lhs, Dual rhs) const = 0;
+
+    /**
+     * Executes the operator on the enclosures of the two arguments.
+     * @param lhs left hand side enclosure
+     * @param rhs right hand side enclosure
+     * @return enclosure of the result
+     */
+    virtual Interval do_operator_interval(Interval lhs, Interval rhs) const = 0;
+
+    /**
+     * @see Expression::evaluate_with_derivative()
+     */
+    virtual Dual evaluate_with_derivative(double x) const override;
+
+    /**
+     * @see Expression::evaluate_interval()
+     */
+    virtual Interval evaluate_interval(double lo, double hi) const override;
+
     /**
      * Return the signature character representing the operation.
      * @return char representing the operation
@@ -133,11 +482,6 @@ public:
      * @see Expression::clone()
      */
     virtual TwoOperand* clone() const =0;
-
-    /**
-     * @see Expression::simplify()
-     */
-    virtual std::unique_ptr<Expression> simplify() const = 0;
 };
 
 /**
@@ -147,12 +491,42 @@ class Sum final: public TwoOperand{
 public:
     Sum(std::unique_ptr<Expression>&& inLhs, std::unique_ptr<Expression>&& inRhs)  : TwoOperand(std::move(inLhs), std::move(inRhs)) {}
 
+    /**
+     * @see Expression::evaluate()
+     */
+    virtual double evaluate(double x) const override;
+
     /**
      * Adds the two arguments together and returns the result.
      * @see TwoOperand::do_operator()
      */
     virtual double do_operator(double lhs, double rhs) const override;
 
+    /**
+     * @see TwoOperand::do_operator_block()
+     */
+    virtual void do_operator_block(double *lhs, const double *rhs, std::size_t n) const override;
+
+    /**
+     * @see TwoOperand::do_operator_block_float()
+     */
+    virtual void do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const override;
+
+    /**
+     * @see TwoOperand::do_operator_dual()
+     */
+    virtual Dual do_operator_dual(Dual lhs, Dual rhs) const override;
+
+    /**
+     * @see TwoOperand::do_operator_interval()
+     */
+    virtual Interval do_operator_interval(Interval lhs, Interval rhs) const override;
+
+    /**
+     * @see Expression::differentiate()
+     */
+    virtual std::unique_ptr<Expression> differentiate() const override;
+
     /**
      * @see TwoOperand::get_operator()
      */
@@ -163,11 +537,6 @@ public:
      */
     virtual Sum *clone() const override;
 
-    /**
-     * @see Expression::simplify()
-     */
-    virtual std::unique_ptr<Expression> simplify() const override;
-
 };
 
 /**
@@ -177,12 +546,42 @@ class Prod final: public TwoOperand{
 public:
     Prod(std::unique_ptr<Expression>&& inLhs,std::unique_ptr<Expression>&& inRhs) : TwoOperand(std::move(inLhs), std::move(inRhs)) { }
 
+    /**
+     * @see Expression::evaluate()
+     */
+    virtual double evaluate(double x) const override;
+
     /**
      * Multiplies the two arguments together and returns the result.
      * @see TwoOperand::do_operator()
      */
     virtual double do_operator(double lhs, double rhs) const override;
 
+    /**
+     * @see TwoOperand::do_operator_block()
+     */
+    virtual void do_operator_block(double *lhs, const double *rhs, std::size_t n) const override;
+
+    /**
+     * @see TwoOperand::do_operator_block_float()
+     */
+    virtual void do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const override;
+
+    /**
+     * @see TwoOperand::do_operator_dual()
+     */
+    virtual Dual do_operator_dual(Dual lhs, Dual rhs) const override;
+
+    /**
+     * @see TwoOperand::do_operator_interval()
+     */
+    virtual Interval do_operator_interval(Interval lhs, Interval rhs) const override;
+
+    /**
+     * @see Expression::differentiate()
+     */
+    virtual std::unique_ptr<Expression> differentiate() const override;
+
     /**
      * @see TwoOperand::get_operator()
      */
@@ -193,11 +592,6 @@ public:
      */
     virtual Prod *clone() const override;
 
-    /**
-     * @see Expression::simplify()
-     */
-    virtual std::unique_ptr<Expression> simplify() const override;
-
 };
 
 /**
@@ -208,12 +602,42 @@ public:
 
     Dif(std::unique_ptr<Expression>&& inLhs, std::unique_ptr<Expression>&& inRhs) : TwoOperand(std::move(inLhs), std::move(inRhs)) { }
 
+    /**
+     * @see Expression::evaluate()
+     */
+    virtual double evaluate(double x) const override;
+
     /**
      * Substracts the rhs from the lhs and returns the result.
      * @see TwoOperand::do_operator()
      */
     virtual double do_operator(double lhs, double rhs) const override;
 
+    /**
+     * @see TwoOperand::do_operator_block()
+     */
+    virtual void do_operator_block(double *lhs, const double *rhs, std::size_t n) const override;
+
+    /**
+     * @see TwoOperand::do_operator_block_float()
+     */
+    virtual void do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const override;
+
+    /**
+     * @see TwoOperand::do_operator_dual()
+     */
+    virtual Dual do_operator_dual(Dual lhs, Dual rhs) const override;
+
+    /**
+     * @see TwoOperand::do_operator_interval()
+     */
+    virtual Interval do_operator_interval(Interval lhs, Interval rhs) const override;
+
+    /**
+     * @see Expression::differentiate()
+     */
+    virtual std::unique_ptr<Expression> differentiate() const override;
+
     /**
      * @see TwoOperands::get_operator()
      */
@@ -223,11 +647,6 @@ public:
      * @see Expression::clone()
      */
     virtual Dif *clone() const override;
-
-    /**
-     * @see Expression::simplify()
-     */
-    virtual std::unique_ptr<Expression> simplify() const override;
 };
 
 /**
@@ -238,12 +657,42 @@ public:
 
     Div(std::unique_ptr<Expression>&& inLhs,std::unique_ptr<Expression>&& inRhs) : TwoOperand(std::move(inLhs), std::move(inRhs)) { }
 
+    /**
+     * @see Expression::evaluate()
+     */
+    virtual double evaluate(double x) const override;
+
     /**
      * Divides the lhs with the rhs and returns the result.
      * @see TwoOperand::do_operator()
      */
     virtual double do_operator(double lhs, double rhs) const override;
 
+    /**
+     * @see TwoOperand::do_operator_block()
+     */
+    virtual void do_operator_block(double *lhs, const double *rhs, std::size_t n) const override;
+
+    /**
+     * @see TwoOperand::do_operator_block_float()
+     */
+    virtual void do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const override;
+
+    /**
+     * @see TwoOperand::do_operator_dual()
+     */
+    virtual Dual do_operator_dual(Dual lhs, Dual rhs) const override;
+
+    /**
+     * @see TwoOperand::do_operator_interval()
+     */
+    virtual Interval do_operator_interval(Interval lhs, Interval rhs) const override;
+
+    /**
+     * @see Expression::differentiate()
+     */
+    virtual std::unique_ptr<Expression> differentiate() const override;
+
     /**
     * @see TwoOperands::get_operator()
     */
@@ -253,10 +702,6 @@ public:
     * @see Expression::clone()
     */
     virtual Div* clone() const override;
-    /**
-     * @see Expression::simplify()
-     */
-    virtual std::unique_ptr<Expression> simplify() const override;
 };
 
 /**
@@ -266,12 +711,48 @@ class Exp final: public TwoOperand{
 public:
     Exp(std::unique_ptr<Expression>&& inLhs,std::unique_ptr<Expression>&& inRhs) : TwoOperand(std::move(inLhs), std::move(inRhs)) { }
 
+    /**
+     * @see Expression::evaluate()
+     */
+    virtual double evaluate(double x) const override;
+
     /**
      * Places lhs to the rhs-th power.
      * @see TwoOperand::do_operator()
      */
     virtual double do_operator(double lhs, double rhs) const override;
 
+    /**
+     * Computes powf(), pow() being several times slower.
+     * @see TwoOperand::do_operator_float()
+     */
+    virtual float do_operator_float(float lhs, float rhs) const override;
+
+    /**
+     * @see TwoOperand::do_operator_block()
+     */
+    virtual void do_operator_block(double *lhs, const double *rhs, std::size_t n) const override;
+
+    /**
+     * @see TwoOperand::do_operator_block_float()
+     */
+    virtual void do_operator_block_float(float *lhs, const float *rhs, std::size_t n) const override;
+
+    /**
+     * @see TwoOperand::do_operator_dual()
+     */
+    virtual Dual do_operator_dual(Dual lhs, Dual rhs) const override;
+
+    /**
+     * @see TwoOperand::do_operator_interval()
+     */
+    virtual Interval do_operator_interval(Interval lhs, Interval rhs) const override;
+
+    /**
+     * @see Expression::differentiate()
+     */
+    virtual std::unique_ptr<Expression> differentiate() const override;
+
     /**
     * @see TwoOperands::get_operator()
     */
@@ -281,30 +762,118 @@ public:
     * @see Expression::clone()
     */
     virtual Exp *clone() const override;
-
-    virtual std::unique_ptr<Expression> simplify() const override;
 };
 
 /**
  * Class implementing a function with double(double) signature.
+ * The node refers to the function by its entry in the FunctionRegistry, so it holds no copy of the std::function
+ * objects and the name, and copying it copies pointers besides the argument.
  */
 class Function : public Expression{
 public:
-    std::function<double(double)> functor;
-
     std::unique_ptr<Expression> arg;
 
-    std::string name;
+    /**
+     * Builtin the node calls, evaluated by a switch without going through the entry; CUSTOM for other functions.
+     */
+    FunctionRegistry::Builtin builtin;
+
+    /**
+     * The function: its name, scalar and batch implementation, derivative and interval extension. An entry of the
+     * registry, or the one in bare_entry; never nullptr.
+     */
+    const FunctionRegistry::Entry *entry;
+
+    /**
+     * Entry made for a bare functor, owned together with the copies of the node; empty for the functions of the
+     * registry.
+     */
+    std::shared_ptr<const FunctionRegistry::Entry> bare_entry;
+
+    /**
+     * Creates a call of a function of the FunctionRegistry.
+     * @param inArg argument of the call
+     * @param entry the function, it must outlive the node, as the entries of the registry do
+     */
+    Function(std::unique_ptr<Expression>&& inArg, const FunctionRegistry::Entry &entry);
 
+    /**
+     * Creates a call of a bare functor, evaluated through the std::function. Its derivative and interval extension
+     * are looked up by name.
+     */
     Function(std::unique_ptr<Expression>&& inArg,std::function<double(double)> func, std::string name );
 
+    /**
+     * Creates a call of a function made for a bare functor, sharing it with the calls it was made for.
+     * @param inArg argument of the call
+     * @param bare the function
+     */
+    Function(std::unique_ptr<Expression>&& inArg, std::shared_ptr<const FunctionRegistry::Entry> bare);
+
     Function(const Function& in);
 
+    /**
+     * Creates a call of the same function as another call, with another argument.
+     * @param inArg argument of the new call
+     * @param call call to copy everything else from
+     */
+    Function(std::unique_ptr<Expression>&& inArg, const Function &call);
+
+    /**
+     * Destroys the argument like ~TwoOperand() destroys the operands.
+     */
+    virtual ~Function();
+
+    /**
+     * @see Expression::shape()
+     */
+    virtual Shape shape() const override;
+
     /**
      * @see Expression::evaluate()
      */
     virtual double evaluate(double x) const override;
 
+    /**
+     * @see Expression::evaluate_block()
+     */
+    virtual void evaluate_block(const double *xs, double *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_float()
+     */
+    virtual float evaluate_float(float x) const override;
+
+    /**
+     * @see Expression::evaluate_block_float()
+     */
+    virtual void evaluate_block_float(const float *xs, float *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_slots()
+     */
+    virtual double evaluate_slots(const double *values) const override;
+
+    /**
+     * @see Expression::evaluate_block_slots()
+     */
+    virtual void evaluate_block_slots(const double *const *columns, double *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_with_derivative()
+     */
+    virtual Dual evaluate_with_derivative(double x) const override;
+
+    /**
+     * @see Expression::evaluate_interval()
+     */
+    virtual Interval evaluate_interval(double lo, double hi) const override;
+
+    /**
+     * @see Expression::differentiate()
+     */
+    virtual std::unique_ptr<Expression> differentiate() const override;
+
     /**
      * @see Expression::print()
      */
@@ -314,10 +883,122 @@ public:
      * @see Expression::clone()
      */
     virtual Expression *clone() const override;
+};
+
+/**
+ * The function a Function node calls, without its argument, for the function tables of other representations of
+ * expressions. Calls builtins through the FunctionRegistry switch like the node does.
+ */
+struct FunctionTarget {
+    FunctionRegistry::Builtin builtin;
+
+    /**
+     * @see Function::entry
+     */
+    const FunctionRegistry::Entry *entry;
+
+    /**
+     * @see Function::bare_entry
+     */
+    std::shared_ptr<const FunctionRegistry::Entry> bare_entry;
+
+    explicit FunctionTarget(const Function &func);
+
+    /**
+     * Computes the function at a value.
+     * @param x argument
+     * @return value of the function
+     */
+    double apply(double x) const;
+
+    /**
+     * Applies the function to n values in place.
+     * @param values the arguments, receiving the results
+     * @param n number of values
+     */
+    void apply_block(double *values, std::size_t n) const;
 
     /**
-     * @see Expression::simplify()
+     * Builds a Function node calling the function.
+     * @param arg argument of the call
+     * @return the node
      */
-    virtual std::unique_ptr<Expression> simplify() const override;
+    std::unique_ptr<Expression> call(std::unique_ptr<Expression> &&arg) const;
 };
+
+/**
+ * Polynomial of the variable, evaluated by Horner's method with the BatchKernels::horner() kernels.
+ * Built by PolynomialDetector from subtrees that only contain X, constants, + - * and integer powers.
+ */
+class Polynomial final : public Expression {
+public:
+    /**
+     * Coefficients in ascending order of degree, coefficients[0] being the constant term. Never empty.
+     */
+    std::vector<double> coefficients;
+
+    Polynomial(std::vector<double> coefficients);
+
+    /**
+     * Returns the degree of the polynomial.
+     * @return index of the highest coefficient
+     */
+    std::size_t degree() const;
+
+    /**
+     * @see Expression::evaluate()
+     */
+    virtual double evaluate(double x) const override;
+
+    /**
+     * @see Expression::evaluate_block()
+     */
+    virtual void evaluate_block(const double *xs, double *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_float()
+     */
+    virtual float evaluate_float(float x) const override;
+
+    /**
+     * @see Expression::evaluate_block_float()
+     */
+    virtual void evaluate_block_float(const float *xs, float *out, std::size_t n) const override;
+
+    /**
+     * @see Expression::evaluate_with_derivative()
+     */
+    virtual Dual evaluate_with_derivative(double x) const override;
+
+    /**
+     * @see Expression::evaluate_interval()
+     */
+    virtual Interval evaluate_interval(double lo, double hi) const override;
+
+    /**
+     * @see Expression::differentiate()
+     */
+    virtual std::unique_ptr<Expression> differentiate() const override;
+
+    /**
+     * Prints the polynomial in Horner form, (c0+x*(c1+x*(c2))).
+     * @see Expression::print()
+     */
+    virtual void print(std::ostream &os) const override;
+
+    /**
+     * @see Expression::clone()
+     */
+    virtual Polynomial *clone() const override;
+};
+template<>
+inline double Expression::evaluate_as<double>(double x) const {
+    return evaluate(x);
+}
+
+template<>
+inline float Expression::evaluate_as<float>(float x) const {
+    return evaluate_float(x);
+}
+
 #endif //C11NHF_EXPRESSIONS_H
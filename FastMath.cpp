@@ -0,0 +1,593 @@
+#include <cfloat>
+#include <cstring>
+#include <math.h>
+#include "BatchKernels.h"
+#include "FastMath.h"
+
+#ifdef __GNUC__
+#define C11NHF_FAST_KERNELS
+/* The helpers returning vectors are always inlined into the kernels of their level, so their ABI doesn't matter. */
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace FastMath {
+
+    static Precision active = Precision::EXACT;
+
+    Precision precision() {
+        return active;
+    }
+
+    void set_precision(Precision precision) {
+        active = precision;
+    }
+
+    typedef void (*UnaryKernel)(double *, std::size_t);
+
+    typedef void (*BinaryKernel)(double *, const double *, std::size_t);
+
+    /**
+     * The kernels of one instruction set level.
+     */
+    struct KernelTable {
+        UnaryKernel sin, cos, tan, exp, log;
+        BinaryKernel pow;
+    };
+
+#ifdef C11NHF_FAST_KERNELS
+
+    /**
+     * Vectors of 1, 2 and 4 doubles of the GCC vector extensions. The approximations are written once, as templates
+     * over the vector type, a vector of one double being the scalar case; the comparisons give vectors of 64-bit
+     * integers, all bits set where true, used as masks and for the bit manipulations.
+     */
+    typedef double Double1 __attribute__((vector_size(8)));
+    typedef double Double2 __attribute__((vector_size(16)));
+    typedef double Double4 __attribute__((vector_size(32)));
+
+    template<typename D>
+    struct Vector {
+        typedef decltype(D{} < D{}) Bits;
+        static const std::size_t WIDTH = sizeof(D) / sizeof(double);
+    };
+
+#define C11NHF_FAST inline __attribute__((always_inline))
+
+    /**
+     * 1.5 * 2^52: for |x| < 2^51, x + MAGIC rounds x to an integer, which is then the difference of the bits of
+     * x + MAGIC and MAGIC, and (x + MAGIC) - MAGIC is its value.
+     */
+    static const double MAGIC = 6755399441055744.0;
+
+    static const double LOG2E = 1.44269504088896338700e+00;
+    static const double LN2_HI = 6.93147180369123816490e-01;   /* 32 bits, k * LN2_HI is exact */
+    static const double LN2_LO = 1.90821492927058770002e-10;
+    static const double SQRT2 = 1.41421356237309504880e+00;
+
+    /**
+     * pi/2 split into three 33-bit parts and a tail, for reductions exact up to TRIG_LIMIT.
+     */
+    static const double TWO_OVER_PI = 6.36619772367581382433e-01;
+    static const double PIO2_1 = 1.57079632673412561417e+00;
+    static const double PIO2_2 = 6.07710050630396597660e-11;
+    static const double PIO2_3 = 2.02226624871116645580e-21;
+    static const double PIO2_3T = 8.47842766036889956997e-32;
+
+    /**
+     * Minimax polynomials of sin and cos on [-pi/4, pi/4], from fdlibm.
+     */
+    static const double S1 = -1.66666666666666324348e-01, S2 = 8.33333333332248946124e-03,
+            S3 = -1.98412698298579493134e-04, S4 = 2.75573137070700676789e-06, S5 = -2.50507602534068634195e-08,
+            S6 = 1.58969099521155010221e-10;
+    static const double C1 = 4.16666666666666019037e-02, C2 = -1.38888888888741095749e-03,
+            C3 = 2.48015872894767294178e-05, C4 = -2.75573143513906633035e-07, C5 = 2.08757232129817482790e-09,
+            C6 = -1.13596475577881948265e-11;
+
+    static const long long SIGN_BIT = -0x7fffffffffffffffLL - 1;   /* bit pattern 0x8000000000000000 */
+
+    template<typename D>
+    C11NHF_FAST D splat(double value) {
+        return D{} + value;
+    }
+
+    template<typename D>
+    C11NHF_FAST typename Vector<D>::Bits bits(const D &x) {
+        return (typename Vector<D>::Bits) x;
+    }
+
+    template<typename D>
+    C11NHF_FAST D from_bits(const typename Vector<D>::Bits &b) {
+        return (D) b;
+    }
+
+    template<typename D>
+    C11NHF_FAST D select(const typename Vector<D>::Bits &mask, const D &yes, const D &no) {
+        return from_bits<D>((bits(yes) & mask) | (bits(no) & ~mask));
+    }
+
+    template<typename D>
+    C11NHF_FAST D absolute(const D &x) {
+        return from_bits<D>(bits(x) & ~SIGN_BIT);
+    }
+
+    template<typename D>
+    C11NHF_FAST D load(const double *p) {
+        D x;
+        std::memcpy(&x, p, sizeof x);
+        return x;
+    }
+
+    template<typename D>
+    C11NHF_FAST void store(double *p, const D &x) {
+        std::memcpy(p, &x, sizeof x);
+    }
+
+    /**
+     * exp(x) = 2^k * exp(r), |r| <= ln2/2, exp(r) by its Taylor polynomial of degree 13. 2^k is applied as two
+     * factors, so neither overflows nor becomes subnormal before the result does.
+     */
+    template<typename D>
+    C11NHF_FAST D exp_pack(const D &arg) {
+        typedef typename Vector<D>::Bits B;
+        D x = select(arg > 710.0, splat<D>(710.0), arg);
+        x = select(x < -746.0, splat<D>(-746.0), x);
+        D t = x * LOG2E + MAGIC;
+        D k = t - MAGIC;
+        B n = bits(t) - bits(splat<D>(MAGIC));
+        D r = (x - k * LN2_HI) - k * LN2_LO;
+        D p = splat<D>(1.0 / 6227020800.0);
+        p = p * r + 1.0 / 479001600.0;
+        p = p * r + 1.0 / 39916800.0;
+        p = p * r + 1.0 / 3628800.0;
+        p = p * r + 1.0 / 362880.0;
+        p = p * r + 1.0 / 40320.0;
+        p = p * r + 1.0 / 5040.0;
+        p = p * r + 1.0 / 720.0;
+        p = p * r + 1.0 / 120.0;
+        p = p * r + 1.0 / 24.0;
+        p = p * r + 1.0 / 6.0;
+        p = p * r + 0.5;
+        p = p * r + 1.0;
+        p = p * r + 1.0;
+        B half = n >> 1;
+        return p * from_bits<D>((half + 1023) << 52) * from_bits<D>((n - half + 1023) << 52);
+    }
+
+    /**
+     * log(x) = e * ln2 + log(m), sqrt(1/2) <= m < sqrt(2), log(m) = 2 atanh(s), s = (m - 1) / (m + 1), by the series
+     * of atanh up to s^21.
+     */
+    template<typename D>
+    C11NHF_FAST D log_pack(const D &x) {
+        typedef typename Vector<D>::Bits B;
+        B subnormal = x < DBL_MIN;
+        D scaled = select(subnormal, x * 18014398509481984.0, x);   /* * 2^54 */
+        B e = ((bits(scaled) >> 52) & 0x7ff) - 1023 - (subnormal & 54);
+        D m = from_bits<D>((bits(scaled) & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+        B big = m > SQRT2;
+        m = select(big, m * 0.5, m);
+        e = e - big;
+        D f = m - 1.0;
+        D s = f / (f + 2.0);
+        D z = s * s;
+        D p = splat<D>(1.0 / 21.0);
+        p = p * z + 1.0 / 19.0;
+        p = p * z + 1.0 / 17.0;
+        p = p * z + 1.0 / 15.0;
+        p = p * z + 1.0 / 13.0;
+        p = p * z + 1.0 / 11.0;
+        p = p * z + 1.0 / 9.0;
+        p = p * z + 1.0 / 7.0;
+        p = p * z + 1.0 / 5.0;
+        p = p * z + 1.0 / 3.0;
+        D twice = s + s;
+        D log_m = twice + twice * (p * z);
+        D k = from_bits<D>(e + bits(splat<D>(MAGIC))) - MAGIC;
+        D result = k * LN2_HI + (log_m + k * LN2_LO);
+        result = select(x == INFINITY, x, result);
+        result = select(x == 0.0, splat<D>(-INFINITY), result);
+        return select((x < 0.0) | (x != x), splat<D>(NAN), result);
+    }
+
+    /**
+     * Reduces x to r in [-pi/4, pi/4] and the quadrant q, x = r + q * pi/2, and computes sin(r) and cos(r).
+     */
+    template<typename D>
+    C11NHF_FAST void sincos_pack(const D &x, D &s, D &c, typename Vector<D>::Bits &q) {
+        D t = x * TWO_OVER_PI + MAGIC;
+        D k = t - MAGIC;
+        q = bits(t) - bits(splat<D>(MAGIC));
+        D r = (((x - k * PIO2_1) - k * PIO2_2) - k * PIO2_3) - k * PIO2_3T;
+        D z = r * r;
+        D ps = splat<D>(S6);
+        ps = ps * z + S5;
+        ps = ps * z + S4;
+        ps = ps * z + S3;
+        ps = ps * z + S2;
+        ps = ps * z + S1;
+        s = r + r * z * ps;
+        D pc = splat<D>(C6);
+        pc = pc * z + C5;
+        pc = pc * z + C4;
+        pc = pc * z + C3;
+        pc = pc * z + C2;
+        pc = pc * z + C1;
+        c = (1.0 - 0.5 * z) + z * z * pc;
+    }
+
+    /**
+     * Mask of the lanes sincos_pack() doesn't reduce exactly, infinities and NaNs included.
+     */
+    template<typename D>
+    C11NHF_FAST typename Vector<D>::Bits trig_outside(const D &x) {
+        return ~(absolute(x) <= TRIG_LIMIT);
+    }
+
+    /**
+     * The approximations, as operations of the block loops: apply() computes a vector, exact() the lanes outside()
+     * marks.
+     */
+    struct SinOp {
+        template<typename D>
+        static C11NHF_FAST D apply(const D &x) {
+            typedef typename Vector<D>::Bits B;
+            D s, c;
+            B q;
+            sincos_pack(x, s, c, q);
+            D result = select<D>(-(q & 1), c, s);
+            result = from_bits<D>(bits(result) ^ ((q & 2) << 62));
+            return select(x == 0.0, x, result);   /* sin(-0) = -0 */
+        }
+
+        template<typename D>
+        static C11NHF_FAST typename Vector<D>::Bits outside(const D &x) {
+            return trig_outside(x);
+        }
+
+        static double exact(double x) {
+            return sin(x);
+        }
+    };
+
+    struct CosOp {
+        template<typename D>
+        static C11NHF_FAST D apply(const D &x) {
+            typedef typename Vector<D>::Bits B;
+            D s, c;
+            B q;
+            sincos_pack(x, s, c, q);
+            D result = select<D>(-(q & 1), s, c);
+            return from_bits<D>(bits(result) ^ (((q + 1) & 2) << 62));
+        }
+
+        template<typename D>
+        static C11NHF_FAST typename Vector<D>::Bits outside(const D &x) {
+            return trig_outside(x);
+        }
+
+        static double exact(double x) {
+            return cos(x);
+        }
+    };
+
+    struct TanOp {
+        template<typename D>
+        static C11NHF_FAST D apply(const D &x) {
+            typedef typename Vector<D>::Bits B;
+            D s, c;
+            B q;
+            sincos_pack(x, s, c, q);
+            B odd = -(q & 1);
+            D result = select(odd, c, s) / select(odd, s, c);   /* tan(r + pi/2) = -cos(r) / sin(r) */
+            result = from_bits<D>(bits(result) ^ (odd & SIGN_BIT));
+            return select(x == 0.0, x, result);
+        }
+
+        template<typename D>
+        static C11NHF_FAST typename Vector<D>::Bits outside(const D &x) {
+            return trig_outside(x);
+        }
+
+        static double exact(double x) {
+            return tan(x);
+        }
+    };
+
+    struct ExpOp {
+        template<typename D>
+        static C11NHF_FAST D apply(const D &x) {
+            return exp_pack(x);
+        }
+
+        template<typename D>
+        static C11NHF_FAST typename Vector<D>::Bits outside(const D &) {
+            return typename Vector<D>::Bits{};
+        }
+
+        static double exact(double x) {
+            return exp(x);
+        }
+    };
+
+    struct LogOp {
+        template<typename D>
+        static C11NHF_FAST D apply(const D &x) {
+            return log_pack(x);
+        }
+
+        template<typename D>
+        static C11NHF_FAST typename Vector<D>::Bits outside(const D &) {
+            return typename Vector<D>::Bits{};
+        }
+
+        static double exact(double x) {
+            return log(x);
+        }
+    };
+
+    /**
+     * pow(a, b) = exp(b * log|a|), negated for a negative base and an odd exponent, NaN for a negative base and a
+     * fractional exponent.
+     */
+    template<typename D>
+    C11NHF_FAST D pow_pack(const D &a, const D &b) {
+        typedef typename Vector<D>::Bits B;
+        D result = exp_pack(b * log_pack(absolute(a)));
+        D shifted = b + MAGIC;
+        B integral = shifted - MAGIC == b;
+        B negative = a < 0.0;
+        result = from_bits<D>(bits(result) ^ (negative & integral & ((bits(shifted) & 1) << 63)));
+        return select(negative & ~integral, splat<D>(NAN), result);
+    }
+
+    /**
+     * Mask of the lanes pow_pack() leaves to libm: zero, infinite or NaN operands, and large exponents.
+     */
+    template<typename D>
+    C11NHF_FAST typename Vector<D>::Bits pow_outside(const D &a, const D &b) {
+        D base = absolute(a);
+        return ~((base > 0.0) & (base <= DBL_MAX) & (absolute(b) < 2147483648.0));
+    }
+
+    /**
+     * Returns whether any of n values is outside the range of an operation, so some lanes need libm.
+     */
+    template<typename D, typename Op>
+    C11NHF_FAST bool any_outside(const double *values, std::size_t n) {
+        const std::size_t width = Vector<D>::WIDTH;
+        typename Vector<D>::Bits outside{};
+        std::size_t i = 0;
+        for (; i + width <= n; i += width)
+            outside |= Op::outside(load<D>(values + i));
+        bool any = false;
+        for (std::size_t j = 0; j < width; j++)
+            any = any || outside[j];
+        for (; i < n; i++)
+            any = any || Op::outside(load<Double1>(values + i))[0];
+        return any;
+    }
+
+    /**
+     * Applies an operation to n values, a vector of D at a time; the tail is computed with vectors of one double,
+     * which give the same results. The lanes are only checked for libm fallbacks if the block has any.
+     */
+    template<typename D, typename Op>
+    C11NHF_FAST void unary_loop(double *values, std::size_t n) {
+        const std::size_t width = Vector<D>::WIDTH;
+        std::size_t i = 0;
+        if (!any_outside<D, Op>(values, n)) {
+            for (; i + width <= n; i += width)
+                store(values + i, Op::apply(load<D>(values + i)));
+        } else {
+            for (; i + width <= n; i += width) {
+                D x = load<D>(values + i);
+                store(values + i, Op::apply(x));
+                typename Vector<D>::Bits outside = Op::outside(x);
+                for (std::size_t j = 0; j < width; j++)
+                    if (outside[j])
+                        values[i + j] = Op::exact(x[j]);
+            }
+        }
+        for (; i < n; i++) {
+            Double1 x = load<Double1>(values + i);
+            values[i] = Op::outside(x)[0] ? Op::exact(x[0]) : Op::apply(x)[0];
+        }
+    }
+
+    /**
+     * pow() a vector at a time, like unary_loop(). A block of squares, the most frequent power, is a product, which is
+     * the correctly rounded result libm gives too.
+     */
+    template<typename D>
+    C11NHF_FAST void pow_loop(double *lhs, const double *rhs, std::size_t n) {
+        const std::size_t width = Vector<D>::WIDTH;
+        typename Vector<D>::Bits outside{}, other{};
+        std::size_t i = 0;
+        for (; i + width <= n; i += width) {
+            D a = load<D>(lhs + i), b = load<D>(rhs + i);
+            outside |= pow_outside(a, b);
+            other |= b != 2.0;
+        }
+        for (std::size_t j = i; j < n; j++)
+            other[0] |= rhs[j] != 2.0 ? -1 : 0;
+        bool checked = false, squares = true;
+        for (std::size_t j = 0; j < width; j++) {
+            checked = checked || outside[j];
+            squares = squares && !other[j];
+        }
+        if (squares) {
+            for (i = 0; i < n; i++)
+                lhs[i] *= lhs[i];
+            return;
+        }
+        if (!checked) {
+            for (i = 0; i + width <= n; i += width)
+                store(lhs + i, pow_pack(load<D>(lhs + i), load<D>(rhs + i)));
+        } else {
+            for (i = 0; i + width <= n; i += width) {
+                D a = load<D>(lhs + i), b = load<D>(rhs + i);
+                store(lhs + i, pow_pack(a, b));
+                outside = pow_outside(a, b);
+                for (std::size_t j = 0; j < width; j++)
+                    if (outside[j])
+                        lhs[i + j] = pow(a[j], b[j]);
+            }
+        }
+        for (; i < n; i++) {
+            Double1 a = load<Double1>(lhs + i), b = load<Double1>(rhs + i);
+            lhs[i] = pow_outside(a, b)[0] ? pow(a[0], b[0]) : pow_pack(a, b)[0];
+        }
+    }
+
+/**
+ * Defines the kernels of one level, computing vectors of the given type with the given target attribute.
+ */
+#define C11NHF_FAST_LEVEL(level, type, target)                                                              \
+    target static void sin_##level(double *values, std::size_t n) { unary_loop<type, SinOp>(values, n); }  \
+    target static void cos_##level(double *values, std::size_t n) { unary_loop<type, CosOp>(values, n); }  \
+    target static void tan_##level(double *values, std::size_t n) { unary_loop<type, TanOp>(values, n); }  \
+    target static void exp_##level(double *values, std::size_t n) { unary_loop<type, ExpOp>(values, n); }  \
+    target static void log_##level(double *values, std::size_t n) { unary_loop<type, LogOp>(values, n); }  \
+    target static void pow_##level(double *lhs, const double *rhs, std::size_t n) { pow_loop<type>(lhs, rhs, n); } \
+    static const KernelTable level##_table = {sin_##level, cos_##level, tan_##level, exp_##level, log_##level,   \
+                                              pow_##level};
+
+    C11NHF_FAST_LEVEL(scalar, Double1, )
+
+#if defined(__x86_64__) || defined(__i386__)
+    C11NHF_FAST_LEVEL(sse2, Double2, __attribute__((target("sse2"))))
+    C11NHF_FAST_LEVEL(avx, Double4, __attribute__((target("avx"))))
+    /* AVX2 only adds the 256-bit integer operations; FMA is left out, so the results stay the same as on the other
+       levels. */
+    C11NHF_FAST_LEVEL(avx2, Double4, __attribute__((target("avx2"))))
+#endif
+
+    /**
+     * Returns the kernels of the level BatchKernels dispatches to.
+     */
+    static const KernelTable &fast_table() {
+        switch (BatchKernels::active_level()) {
+#if defined(__x86_64__) || defined(__i386__)
+            case BatchKernels::SimdLevel::FMA:
+                return avx2_table;
+            case BatchKernels::SimdLevel::AVX:
+                return avx_table;
+            case BatchKernels::SimdLevel::SSE2:
+                return sse2_table;
+#endif
+            default:
+                return scalar_table;
+        }
+    }
+
+#else
+
+    /* Without the vector extensions the fast kernels are the exact ones. */
+#define C11NHF_EXACT_KERNEL(name)                                \
+    static void name##_exact(double *values, std::size_t n) {   \
+        for (std::size_t i = 0; i < n; i++)                      \
+            values[i] = name(values[i]);                         \
+    }
+
+    C11NHF_EXACT_KERNEL(sin)
+    C11NHF_EXACT_KERNEL(cos)
+    C11NHF_EXACT_KERNEL(tan)
+    C11NHF_EXACT_KERNEL(exp)
+    C11NHF_EXACT_KERNEL(log)
+
+    static void pow_exact(double *lhs, const double *rhs, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++)
+            lhs[i] = pow(lhs[i], rhs[i]);
+    }
+
+    static const KernelTable &fast_table() {
+        static const KernelTable exact_table = {sin_exact, cos_exact, tan_exact, exp_exact, log_exact, pow_exact};
+        return exact_table;
+    }
+
+#endif
+
+    void sin_block(double *values, std::size_t n) {
+        if (active == Precision::FAST) {
+            fast_table().sin(values, n);
+            return;
+        }
+        for (std::size_t i = 0; i < n; i++)
+            values[i] = sin(values[i]);
+    }
+
+    void cos_block(double *values, std::size_t n) {
+        if (active == Precision::FAST) {
+            fast_table().cos(values, n);
+            return;
+        }
+        for (std::size_t i = 0; i < n; i++)
+            values[i] = cos(values[i]);
+    }
+
+    void tan_block(double *values, std::size_t n) {
+        if (active == Precision::FAST) {
+            fast_table().tan(values, n);
+            return;
+        }
+        for (std::size_t i = 0; i < n; i++)
+            values[i] = tan(values[i]);
+    }
+
+    void exp_block(double *values, std::size_t n) {
+        if (active == Precision::FAST) {
+            fast_table().exp(values, n);
+            return;
+        }
+        for (std::size_t i = 0; i < n; i++)
+            values[i] = exp(values[i]);
+    }
+
+    void log_block(double *values, std::size_t n) {
+        if (active == Precision::FAST) {
+            fast_table().log(values, n);
+            return;
+        }
+        for (std::size_t i = 0; i < n; i++)
+            values[i] = log(values[i]);
+    }
+
+    void pow_block(double *lhs, const double *rhs, std::size_t n) {
+        if (active == Precision::FAST) {
+            fast_table().pow(lhs, rhs, n);
+            return;
+        }
+        for (std::size_t i = 0; i < n; i++)
+            lhs[i] = pow(lhs[i], rhs[i]);
+    }
+
+    double fast_sin(double x) {
+        fast_table().sin(&x, 1);
+        return x;
+    }
+
+    double fast_cos(double x) {
+        fast_table().cos(&x, 1);
+        return x;
+    }
+
+    double fast_tan(double x) {
+        fast_table().tan(&x, 1);
+        return x;
+    }
+
+    double fast_exp(double x) {
+        fast_table().exp(&x, 1);
+        return x;
+    }
+
+    double fast_log(double x) {
+        fast_table().log(&x, 1);
+        return x;
+    }
+
+    double fast_pow(double a, double b) {
+        fast_table().pow(&a, &b, 1);
+        return a;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef C11NHF_FASTMATH_H
+#define C11NHF_FASTMATH_H
+#include <cstddef>
+
+/**
+ * Approximations of sin, cos, tan, exp, log and pow for the block evaluation of the expressions, selected by the
+ * precision mode. They are branch-free polynomial approximations computed a whole vector at a time on the
+ * instruction set level of BatchKernels::active_level(); every level performs the same IEEE operations, so the
+ * results are bit-identical on all of them, and equal to the scalar fast_...() functions.
+ * Maximum errors against libm measured by benchmark.cpp, benchFastMath(), over 10^6 arguments per function, half of
+ * them random bit patterns covering every exponent and half in the plot range |x| < 128; they are sampled, not
+ * proven, bounds:
+ *  - sin, cos: 2 ulp; tan: 3 ulp. Arguments are reduced with pi/2 split in four parts, exactly up to |x| =
+ *    TRIG_LIMIT; larger arguments, infinities and NaNs are computed with libm.
+ *  - exp: 1 ulp, subnormal results included.
+ *  - log: 2 ulp, subnormal arguments included.
+ *  - pow(a, b): computed as exp(b * log|a|), so the error of the logarithm is scaled by |b * log a|; measured for
+ *    a, b in [-20, 20], a third of them with integer b, the relative error is below (|b * log a| + 4) * 2^-51, at
+ *    most about 2^-41 for results that don't overflow. Negative bases
+ *    are handled for integer exponents; zero, infinite and NaN operands and exponents of 2^31 or more are computed
+ *    with libm. Blocks of squares are computed as products, correctly rounded.
+ * Special values (NaN, +-inf, +-0) give the same results as libm, up to the sign of NaNs.
+ */
+namespace FastMath {
+
+    /**
+     * Precision of the block evaluation of the transcendental functions and of ^.
+     */
+    enum class Precision {
+        EXACT, /**< libm */
+        FAST   /**< the approximations of this file */
+    };
+
+    /**
+     * Largest argument sin, cos and tan reduce themselves, beyond it they call libm.
+     */
+    const double TRIG_LIMIT = 1e5;
+
+    /**
+     * Returns the precision the block kernels currently use.
+     * @return active precision, EXACT unless set_precision() was called
+     */
+    Precision precision();
+
+    /**
+     * Selects the precision of the block kernels, so of Expression::evaluate_batch() and the evaluators built on
+     * it. Expression::evaluate() and the other scalar paths always use libm. Not thread-safe, call it before starting
+     * any evaluation.
+     * @param precision requested precision
+     */
+    void set_precision(Precision precision);
+
+    /**
+     * Block kernels of the current precision: values[i] = f(values[i]) for i < n.
+     */
+    void sin_block(double *values, std::size_t n);
+
+    void cos_block(double *values, std::size_t n);
+
+    void tan_block(double *values, std::size_t n);
+
+    void exp_block(double *values, std::size_t n);
+
+    void log_block(double *values, std::size_t n);
+
+    /**
+     * Block kernel of the current precision: lhs[i] = pow(lhs[i], rhs[i]) for i < n.
+     */
+    void pow_block(double *lhs, const double *rhs, std::size_t n);
+
+    /**
+     * The approximations at a single value, whatever the precision, e.g. to test them against libm.
+     */
+    double fast_sin(double x);
+
+    double fast_cos(double x);
+
+    double fast_tan(double x);
+
+    double fast_exp(double x);
+
+    double fast_log(double x);
+
+    double fast_pow(double a, double b);
+}
+
+#endif //C11NHF_FASTMATH_H
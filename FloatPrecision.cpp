@@ -0,0 +1,41 @@
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include "FloatPrecision.h"
+
+FloatPrecisionReport checkFloatPrecision(const Expression &exp, double lo, double hi, std::size_t samples,
+                                         double tolerance) {
+    samples = std::max<std::size_t>(samples, 2);
+    std::vector<double> xs(samples), values(samples);
+    std::vector<float> xs_float(samples), values_float(samples);
+    for (std::size_t i = 0; i < samples; i++) {
+        xs[i] = lo + (hi - lo) * double(i) / double(samples - 1);
+        xs_float[i] = float(xs[i]);
+    }
+    exp.evaluate_batch(xs.data(), values.data(), samples);
+    exp.evaluate_batch(xs_float.data(), values_float.data(), samples);
+
+    FloatPrecisionReport report{samples, 0, 0.0, 0.0, 0.0, false};
+    double min = INFINITY, max = -INFINITY, magnitude = 0.0;
+    for (std::size_t i = 0; i < samples; i++) {
+        bool finite = isfinite(values[i]), finite_float = isfinite(values_float[i]);
+        if (finite != finite_float) {
+            report.mismatches++;
+        } else if (finite) {
+            report.max_error = std::max(report.max_error, fabs(double(values_float[i]) - values[i]));
+        }
+        if (finite) {
+            min = std::min(min, values[i]);
+            max = std::max(max, values[i]);
+            magnitude = std::max(magnitude, fabs(values[i]));
+        }
+    }
+    if (max > min)
+        report.scale = max - min;
+    else
+        report.scale = magnitude;
+    report.relative_error = report.scale > 0.0 ? report.max_error / report.scale : 0.0;
+    report.safe = report.mismatches == 0 && (report.scale > 0.0 ? report.relative_error <= tolerance
+                                                                : report.max_error == 0.0);
+    return report;
+}
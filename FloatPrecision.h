@@ -0,0 +1,59 @@
+#ifndef C11NHF_FLOATPRECISION_H
+#define C11NHF_FLOATPRECISION_H
+#include <cstddef>
+#include "Expressions.h"
+
+/**
+ * Outcome of comparing the single precision evaluation of an expression with the double precision one over a range.
+ */
+struct FloatPrecisionReport {
+    /**
+     * Number of places compared.
+     */
+    std::size_t samples;
+
+    /**
+     * Places where one of the results is finite and the other is not: float overflowing, or a value that is defined
+     * in one precision only.
+     */
+    std::size_t mismatches;
+
+    /**
+     * Largest |float - double| over the places where both are finite.
+     */
+    double max_error;
+
+    /**
+     * What max_error is measured against: the spread (max - min) of the double values, as a plot shows them, or
+     * their largest magnitude for a constant expression. 0 if no value is finite.
+     */
+    double scale;
+
+    /**
+     * max_error / scale, 0 if scale is 0.
+     */
+    double relative_error;
+
+    /**
+     * The recommendation: true if there are no mismatches and relative_error is within the tolerance.
+     */
+    bool safe;
+};
+
+/**
+ * Evaluates an expression with Expression::evaluate_batch() in float and in double at evenly spaced places of
+ * [lo, hi], the float evaluation getting the places rounded to float, and recommends whether float is accurate
+ * enough there. Rounding of the places and cancellation in the expression are what make float unsafe: a curve
+ * over [1e6, 1e6 + 1] or the difference of two nearly equal terms loses most of the float digits.
+ * @param exp expression of X
+ * @param lo lower end of the range
+ * @param hi upper end of the range
+ * @param samples number of places, at least 2
+ * @param tolerance largest acceptable error relative to the scale of the values; the default, 1e-4, is a tenth of
+ *        a pixel on a thousand pixel high plot
+ * @return the comparison and the recommendation
+ */
+FloatPrecisionReport checkFloatPrecision(const Expression &exp, double lo, double hi, std::size_t samples = 4096,
+                                         double tolerance = 1e-4);
+
+#endif //C11NHF_FLOATPRECISION_H
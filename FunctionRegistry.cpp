@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include "FastMath.h"
+#include "FunctionRegistry.h"
+
+/**
+ * Plain function computing a builtin; the switch of FunctionRegistry::evaluate() is folded away.
+ */
+template<FunctionRegistry::Builtin B>
+static double native(double x) {
+    return FunctionRegistry::evaluate(B, x);
+}
+
+template<FunctionRegistry::Builtin B, typename T>
+static void applyBlock(T *values, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++)
+        values[i] = FunctionRegistry::evaluate(B, values[i]);
+}
+
+void FunctionRegistry::evaluate_block(Builtin builtin, double *values, std::size_t n) {
+    switch (builtin) {
+        case SIN:   FastMath::sin_block(values, n); break;
+        case COS:   FastMath::cos_block(values, n); break;
+        case TAN:   FastMath::tan_block(values, n); break;
+        case ABS:   applyBlock<ABS>(values, n); break;
+        case SQRT:  applyBlock<SQRT>(values, n); break;
+        case LOG:   FastMath::log_block(values, n); break;
+        case SIGN:  applyBlock<SIGN>(values, n); break;
+        case EXP:   FastMath::exp_block(values, n); break;
+        case ASIN:  applyBlock<ASIN>(values, n); break;
+        case ACOS:  applyBlock<ACOS>(values, n); break;
+        case ATAN:  applyBlock<ATAN>(values, n); break;
+        case SINH:  applyBlock<SINH>(values, n); break;
+        case COSH:  applyBlock<COSH>(values, n); break;
+        case TANH:  applyBlock<TANH>(values, n); break;
+        case FLOOR: applyBlock<FLOOR>(values, n); break;
+        case CEIL:  applyBlock<CEIL>(values, n); break;
+        default:    std::fill(values, values + n, NAN); break;
+    }
+}
+
+void FunctionRegistry::evaluate_block(Builtin builtin, float *values, std::size_t n) {
+    switch (builtin) {
+        case SIN:   applyBlock<SIN>(values, n); break;
+        case COS:   applyBlock<COS>(values, n); break;
+        case TAN:   applyBlock<TAN>(values, n); break;
+        case ABS:   applyBlock<ABS>(values, n); break;
+        case SQRT:  applyBlock<SQRT>(values, n); break;
+        case LOG:   applyBlock<LOG>(values, n); break;
+        case SIGN:  applyBlock<SIGN>(values, n); break;
+        case EXP:   applyBlock<EXP>(values, n); break;
+        case ASIN:  applyBlock<ASIN>(values, n); break;
+        case ACOS:  applyBlock<ACOS>(values, n); break;
+        case ATAN:  applyBlock<ATAN>(values, n); break;
+        case SINH:  applyBlock<SINH>(values, n); break;
+        case COSH:  applyBlock<COSH>(values, n); break;
+        case TANH:  applyBlock<TANH>(values, n); break;
+        case FLOOR: applyBlock<FLOOR>(values, n); break;
+        case CEIL:  applyBlock<CEIL>(values, n); break;
+        default:    std::fill(values, values + n, NAN); break;
+    }
+}
+
+/**
+ * Builds the entry of a builtin.
+ */
+template<FunctionRegistry::Builtin B>
+static FunctionRegistry::Entry builtinEntry(const char *name, std::function<double(double)> derivative,
+                                            std::function<Interval(Interval)> interval) {
+    FunctionRegistry::BatchFunction batch = [](const double *in, double *out, std::size_t n) {
+        if (in != out)
+            std::copy(in, in + n, out);
+        FunctionRegistry::evaluate_block(B, out, n);
+    };
+    return FunctionRegistry::Entry{B, name, native<B>, batch, native<B>, derivative, interval};
+}
+
+FunctionRegistry::FunctionRegistry() {
+    Entry table[] = {
+            builtinEntry<SIN>("sin", [](double x) { return cos(x); }, intervalSin),
+            builtinEntry<COS>("cos", [](double x) { return -sin(x); }, intervalCos),
+            builtinEntry<TAN>("tan", [](double x) { double t = tan(x); return 1.0 + t * t; }, intervalTan),
+            builtinEntry<ABS>("abs", [](double x) { return x > 0.0 ? 1.0 : x < 0.0 ? -1.0 : 0.0; }, intervalAbs),
+            builtinEntry<SQRT>("sqrt", [](double x) { return 0.5 / sqrt(x); }, intervalSqrt),
+            builtinEntry<LOG>("log", [](double x) { return 1.0 / x; }, intervalLog),
+            builtinEntry<SIGN>("sign", [](double) { return 0.0; }, intervalSign),
+            builtinEntry<EXP>("exp", [](double x) { return exp(x); }, intervalExp),
+            builtinEntry<ASIN>("asin", [](double x) { return 1.0 / sqrt(1.0 - x * x); }, intervalAsin),
+            builtinEntry<ACOS>("acos", [](double x) { return -1.0 / sqrt(1.0 - x * x); }, intervalAcos),
+            builtinEntry<ATAN>("atan", [](double x) { return 1.0 / (1.0 + x * x); }, intervalAtan),
+            builtinEntry<SINH>("sinh", [](double x) { return cosh(x); }, intervalSinh),
+            builtinEntry<COSH>("cosh", [](double x) { return sinh(x); }, intervalCosh),
+            builtinEntry<TANH>("tanh", [](double x) { double t = tanh(x); return 1.0 - t * t; }, intervalTanh),
+            builtinEntry<FLOOR>("floor", [](double) { return 0.0; }, intervalFloor),
+            builtinEntry<CEIL>("ceil", [](double) { return 0.0; }, intervalCeil)
+    };
+    for (Entry &entry : table) {
+        const Entry &inserted = insert(std::move(entry));
+        builtins[inserted.builtin] = &inserted;
+        builtin_names[inserted.name] = &inserted;
+    }
+}
+
+FunctionRegistry &FunctionRegistry::global() {
+    static FunctionRegistry registry;
+    return registry;
+}
+
+const FunctionRegistry::Entry *FunctionRegistry::find(const std::string &name) const {
+    auto builtin = builtin_names.find(name);
+    if (builtin != builtin_names.end())
+        return builtin->second;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = names.find(name);
+    return found == names.end() ? nullptr : found->second;
+}
+
+const FunctionRegistry::Entry &FunctionRegistry::get(Builtin builtin) const {
+    if (builtin >= CUSTOM)
+        throw std::invalid_argument("Not a builtin function");
+    return *builtins[builtin];
+}
+
+const FunctionRegistry::Entry &FunctionRegistry::add(const std::string &name, std::function<double(double)> scalar,
+                                                     BatchFunction batch, std::function<double(double)> derivative,
+                                                     std::function<Interval(Interval)> interval) {
+    bool valid = !name.empty() && isalpha(static_cast<unsigned char>(name[0])) && name != "x" && name != "X";
+    for (char c : name)
+        valid = valid && (isalnum(static_cast<unsigned char>(c)) || c == '_');
+    if (!valid || !scalar)
+        throw std::invalid_argument("Invalid function: " + name);
+    if (!batch)
+        batch = scalar_batch(scalar);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (names.count(name))
+        throw std::invalid_argument("Function already exists: " + name);
+    return insert(Entry{CUSTOM, name, std::move(scalar), std::move(batch), nullptr, std::move(derivative),
+                        std::move(interval)});
+}
+
+FunctionRegistry::BatchFunction FunctionRegistry::scalar_batch(std::function<double(double)> scalar) {
+    return [scalar](const double *in, double *out, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = scalar(in[i]);
+    };
+}
+
+const FunctionRegistry::Entry &FunctionRegistry::insert(Entry entry) {
+    entries.push_back(std::move(entry));
+    names[entries.back().name] = &entries.back();
+    return entries.back();
+}
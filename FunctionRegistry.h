@@ -0,0 +1,218 @@
+#ifndef C11NHF_FUNCTIONREGISTRY_H
+#define C11NHF_FUNCTIONREGISTRY_H
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <math.h>
+#include "Interval.h"
+
+/**
+ * The functions formulas can call, by name. The builtins are identified by a Builtin value, so evaluators switch on
+ * it and the compiler inlines the call, where a std::function costs an indirect call per value, and backends call
+ * the plain function pointer of the builtin. Further functions can be registered at run time with a scalar and a
+ * batch implementation; the batch one is called with whole blocks of values, so a registered function stays on the
+ * block evaluation path.
+ * Lookup by name is a hash map lookup. Entries are never removed or moved, so references to them stay valid for the
+ * life of the program, and lookup and registration may be called from several threads. The builtins are looked up
+ * without locking, so threads parsing formulas at once only contend for the names of registered functions.
+ */
+class FunctionRegistry {
+public:
+    /**
+     * The builtin functions. CUSTOM marks a registered function, called through its Entry.
+     */
+    enum Builtin : unsigned char {
+        SIN,
+        COS,
+        TAN,
+        ABS,
+        SQRT,
+        LOG,
+        SIGN,
+        EXP,
+        ASIN,
+        ACOS,
+        ATAN,
+        SINH,
+        COSH,
+        TANH,
+        FLOOR,
+        CEIL,
+        CUSTOM
+    };
+
+    /**
+     * Applies a function to n values in place, or from in to out; in may be equal to out.
+     */
+    typedef std::function<void(const double *in, double *out, std::size_t n)> BatchFunction;
+
+    typedef double (*NativeFunction)(double);
+
+    /**
+     * A function and what is known about it.
+     */
+    struct Entry {
+        Builtin builtin;
+        std::string name;
+        std::function<double(double)> scalar;
+
+        /**
+         * Block implementation, always set: the builtins' loop over the inlined function, a registered function's
+         * the one given to add(), or a loop over its scalar implementation if none was given.
+         */
+        BatchFunction batch;
+
+        /**
+         * Plain function pointer of a builtin, for backends calling it directly; nullptr for registered functions.
+         */
+        NativeFunction native;
+
+        /**
+         * Derivative, empty if it is not known.
+         */
+        std::function<double(double)> derivative;
+
+        /**
+         * Interval extension, empty if it is not known.
+         */
+        std::function<Interval(Interval)> interval;
+    };
+
+    /**
+     * Returns the registry used by the parser and the evaluators.
+     * @return the registry of the program
+     */
+    static FunctionRegistry &global();
+
+    /**
+     * Looks up a function.
+     * @param name name of the function
+     * @return the entry of the function, nullptr if there is none with that name
+     */
+    const Entry *find(const std::string &name) const;
+
+    /**
+     * Looks up a builtin.
+     * @param builtin any value but CUSTOM
+     * @return the entry of the builtin
+     */
+    const Entry &get(Builtin builtin) const;
+
+    /**
+     * Registers a function, making it callable from formulas parsed afterwards.
+     * @param name name of the function: letters, digits and underscores, starting with a letter
+     * @param scalar the function
+     * @param batch block implementation of the function, a loop over scalar if empty
+     * @param derivative derivative of the function, for Expression::evaluate_with_derivative()
+     * @param interval interval extension of the function, for Expression::evaluate_interval()
+     * @return the entry of the new function
+     * @throws std::invalid_argument if the name is not valid or is already taken
+     */
+    const Entry &add(const std::string &name, std::function<double(double)> scalar, BatchFunction batch = {},
+                     std::function<double(double)> derivative = {},
+                     std::function<Interval(Interval)> interval = {});
+
+    /**
+     * Makes a block implementation calling a scalar function for every value.
+     * @param scalar the function
+     * @return the block implementation
+     */
+    static BatchFunction scalar_batch(std::function<double(double)> scalar);
+
+    /**
+     * Computes a builtin at a value.
+     * @param builtin any value but CUSTOM
+     * @param x argument
+     * @return the value of the builtin, NaN for CUSTOM
+     */
+    static double evaluate(Builtin builtin, double x);
+
+    /**
+     * Computes a builtin at a value in single precision, with the float functions of libm.
+     * @see evaluate(Builtin, double)
+     */
+    static float evaluate(Builtin builtin, float x);
+
+    /**
+     * Applies a builtin to n values in place. sin, cos, tan, exp and log are computed with the block kernels of
+     * FastMath, so with its approximations in its FAST precision.
+     * @param builtin any value but CUSTOM
+     * @param values the arguments, receiving the results
+     * @param n number of values
+     */
+    static void evaluate_block(Builtin builtin, double *values, std::size_t n);
+
+    /**
+     * Applies a builtin to n floats in place, with evaluate(Builtin, float).
+     * @see evaluate_block(Builtin, double *, std::size_t)
+     */
+    static void evaluate_block(Builtin builtin, float *values, std::size_t n);
+
+private:
+    FunctionRegistry();
+
+    FunctionRegistry(const FunctionRegistry &) = delete;
+
+    FunctionRegistry &operator=(const FunctionRegistry &) = delete;
+
+    std::deque<Entry> entries;
+    std::unordered_map<std::string, const Entry *> names;
+
+    /**
+     * Entries of the builtins, indexed by Builtin and by name; filled in by the constructor, so read without locking.
+     */
+    const Entry *builtins[CUSTOM];
+    std::unordered_map<std::string, const Entry *> builtin_names;
+    mutable std::mutex mutex;
+
+    const Entry &insert(Entry entry);
+};
+
+inline double FunctionRegistry::evaluate(Builtin builtin, double x) {
+    switch (builtin) {
+        case SIN:   return sin(x);
+        case COS:   return cos(x);
+        case TAN:   return tan(x);
+        case ABS:   return fabs(x);
+        case SQRT:  return sqrt(x);
+        case LOG:   return log(x);
+        case SIGN:  return x > 0.0 ? 1.0 : x < 0.0 ? -1.0 : x;
+        case EXP:   return exp(x);
+        case ASIN:  return asin(x);
+        case ACOS:  return acos(x);
+        case ATAN:  return atan(x);
+        case SINH:  return sinh(x);
+        case COSH:  return cosh(x);
+        case TANH:  return tanh(x);
+        case FLOOR: return floor(x);
+        case CEIL:  return ceil(x);
+        default:    return NAN;
+    }
+}
+
+inline float FunctionRegistry::evaluate(Builtin builtin, float x) {
+    switch (builtin) {
+        case SIN:   return sinf(x);
+        case COS:   return cosf(x);
+        case TAN:   return tanf(x);
+        case ABS:   return fabsf(x);
+        case SQRT:  return sqrtf(x);
+        case LOG:   return logf(x);
+        case SIGN:  return x > 0.0f ? 1.0f : x < 0.0f ? -1.0f : x;
+        case EXP:   return expf(x);
+        case ASIN:  return asinf(x);
+        case ACOS:  return acosf(x);
+        case ATAN:  return atanf(x);
+        case SINH:  return sinhf(x);
+        case COSH:  return coshf(x);
+        case TANH:  return tanhf(x);
+        case FLOOR: return floorf(x);
+        case CEIL:  return ceilf(x);
+        default:    return NAN;
+    }
+}
+
+#endif //C11NHF_FUNCTIONREGISTRY_H
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <math.h>
+#include "ImageCanvas.h"
+
+ImageCanvas::ImageCanvas(int width, int height) : width{width}, height{height},
+                                                  pixels(std::size_t(width) * std::size_t(height) * 4, 0) { }
+
+int ImageCanvas::get_width() const {
+    return width;
+}
+
+int ImageCanvas::get_height() const {
+    return height;
+}
+
+void ImageCanvas::clear(Color color) {
+    if (pixels.empty())
+        return;
+    /* one row pixel by pixel, the others are copies of it */
+    std::size_t stride = std::size_t(width) * 4;
+    for (std::size_t i = 0; i < stride; i += 4) {
+        pixels[i] = color.r;
+        pixels[i + 1] = color.g;
+        pixels[i + 2] = color.b;
+        pixels[i + 3] = color.a;
+    }
+    for (std::size_t offset = stride; offset < pixels.size(); offset += stride)
+        std::memcpy(&pixels[offset], &pixels[0], stride);
+}
+
+void ImageCanvas::draw_lines(const CanvasPoint *points, std::size_t count, Color color) {
+    for (std::size_t i = 0; i + 1 < count; i++)
+        draw_line(points[i], points[i + 1], color);
+}
+
+void ImageCanvas::draw_segments(const CanvasPoint *points, std::size_t count, Color color) {
+    for (std::size_t i = 0; i + 1 < count; i += 2)
+        draw_line(points[i], points[i + 1], color);
+}
+
+void ImageCanvas::draw_image(const Color *image, int image_width, int image_height) {
+    static_assert(sizeof(Color) == 4, "Color must be 4 bytes, R, G, B, A");
+    int columns = std::min(width, image_width), rows = std::min(height, image_height);
+    if (columns <= 0)
+        return;
+    for (int y = 0; y < rows; y++)
+        std::memcpy(&pixels[std::size_t(y) * std::size_t(width) * 4], image + std::size_t(y) * std::size_t(image_width),
+                    std::size_t(columns) * 4);
+}
+
+void ImageCanvas::present() { }
+
+Color ImageCanvas::get_pixel(int x, int y) const {
+    const std::uint8_t *p = &pixels[(std::size_t(y) * std::size_t(width) + std::size_t(x)) * 4];
+    return Color{p[0], p[1], p[2], p[3]};
+}
+
+const std::vector<std::uint8_t> &ImageCanvas::get_pixels() const {
+    return pixels;
+}
+
+void ImageCanvas::draw_line(CanvasPoint p0, CanvasPoint p1, Color color) {
+    /* Liang-Barsky clipping to the pixel centres of the image */
+    double x0 = p0.x, y0 = p0.y, dx = double(p1.x) - p0.x, dy = double(p1.y) - p0.y;
+    double t0 = 0.0, t1 = 1.0;
+    double p[4] = {-dx, dx, -dy, dy};
+    double q[4] = {x0, width - 1 - x0, y0, height - 1 - y0};
+    for (int k = 0; k < 4; k++) {
+        if (p[k] == 0.0) {
+            if (q[k] < 0.0)
+                return;
+        } else {
+            double t = q[k] / p[k];
+            if (p[k] < 0.0)
+                t0 = std::max(t0, t);
+            else
+                t1 = std::min(t1, t);
+        }
+    }
+    if (t0 > t1)
+        return;
+    int x = int(lround(x0 + t0 * dx)), y = int(lround(y0 + t0 * dy));
+    int x1 = int(lround(x0 + t1 * dx)), y1 = int(lround(y0 + t1 * dy));
+    x = std::max(0, std::min(width - 1, x));
+    y = std::max(0, std::min(height - 1, y));
+    x1 = std::max(0, std::min(width - 1, x1));
+    y1 = std::max(0, std::min(height - 1, y1));
+
+    /* Bresenham */
+    int sx = x < x1 ? 1 : -1, sy = y < y1 ? 1 : -1;
+    int ex = std::abs(x1 - x), ey = -std::abs(y1 - y), error = ex + ey;
+    while (true) {
+        std::uint8_t *pixel = &pixels[(std::size_t(y) * std::size_t(width) + std::size_t(x)) * 4];
+        pixel[0] = color.r;
+        pixel[1] = color.g;
+        pixel[2] = color.b;
+        pixel[3] = color.a;
+        if (x == x1 && y == y1)
+            break;
+        int twice = 2 * error;
+        if (twice >= ey) {
+            error += ey;
+            x += sx;
+        }
+        if (twice <= ex) {
+            error += ex;
+            y += sy;
+        }
+    }
+}
+
+void ImageCanvas::write_ppm(const std::string &path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Can't open " + path);
+    file << "P6\n" << width << ' ' << height << "\n255\n";
+    std::vector<char> row(std::size_t(width) * 3);
+    for (int y = 0; y < height; y++) {
+        const std::uint8_t *source = &pixels[std::size_t(y) * std::size_t(width) * 4];
+        for (int x = 0; x < width; x++)
+            for (int c = 0; c < 3; c++)
+                row[std::size_t(x) * 3 + c] = char(source[x * 4 + c]);
+        file.write(row.data(), std::streamsize(row.size()));
+    }
+    if (!file)
+        throw std::runtime_error("Can't write " + path);
+}
+
+/**
+ * Computes the CRC-32 of PNG chunks.
+ */
+static std::uint32_t crc32(const std::uint8_t *data, std::size_t n, std::uint32_t crc = 0) {
+    static std::uint32_t table[256];
+    static bool ready = false;
+    if (!ready) {
+        for (std::uint32_t i = 0; i < 256; i++) {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        ready = true;
+    }
+    crc = ~crc;
+    for (std::size_t i = 0; i < n; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+/**
+ * Appends a 32 bit big-endian integer.
+ */
+static void put32(std::vector<std::uint8_t> &out, std::uint32_t value) {
+    out.push_back(std::uint8_t(value >> 24));
+    out.push_back(std::uint8_t(value >> 16));
+    out.push_back(std::uint8_t(value >> 8));
+    out.push_back(std::uint8_t(value));
+}
+
+/**
+ * Appends a PNG chunk: length, type, data and CRC.
+ */
+static void put_chunk(std::vector<std::uint8_t> &out, const char *type, const std::vector<std::uint8_t> &data) {
+    put32(out, std::uint32_t(data.size()));
+    std::size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put32(out, crc32(&out[start], out.size() - start));
+}
+
+void ImageCanvas::write_png(const std::string &path) const {
+    std::vector<std::uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<std::uint8_t> header;
+    put32(header, std::uint32_t(width));
+    put32(header, std::uint32_t(height));
+    header.insert(header.end(), {8, 6, 0, 0, 0});   /* 8 bit RGBA, no interlacing */
+    put_chunk(png, "IHDR", header);
+
+    /* scanlines with filter type 0, in a zlib stream of stored deflate blocks */
+    std::vector<std::uint8_t> raw;
+    std::size_t stride = std::size_t(width) * 4;
+    raw.reserve((stride + 1) * std::size_t(height));
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        const std::uint8_t *row = &pixels[std::size_t(y) * stride];
+        raw.insert(raw.end(), row, row + stride);
+    }
+    const std::size_t BLOCK = 65535;
+    std::vector<std::uint8_t> zlib = {0x78, 0x01};
+    zlib.reserve(raw.size() + raw.size() / BLOCK * 5 + 16);
+    std::size_t offset = 0;
+    do {
+        std::size_t length = std::min(BLOCK, raw.size() - offset);
+        zlib.push_back(offset + length == raw.size() ? 1 : 0);
+        zlib.push_back(std::uint8_t(length));
+        zlib.push_back(std::uint8_t(length >> 8));
+        zlib.push_back(std::uint8_t(~length));
+        zlib.push_back(std::uint8_t(~length >> 8));
+        zlib.insert(zlib.end(), &raw[offset], &raw[offset] + length);
+        offset += length;
+    } while (offset < raw.size());
+    std::uint32_t a = 1, b = 0;
+    for (std::uint8_t byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    put32(zlib, b << 16 | a);
+    put_chunk(png, "IDAT", zlib);
+    put_chunk(png, "IEND", std::vector<std::uint8_t>());
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Can't open " + path);
+    file.write(reinterpret_cast<const char *>(png.data()), std::streamsize(png.size()));
+    if (!file)
+        throw std::runtime_error("Can't write " + path);
+}
@@ -0,0 +1,96 @@
+#ifndef C11NHF_IMAGECANVAS_H
+#define C11NHF_IMAGECANVAS_H
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Canvas.h"
+
+/**
+ * Headless canvas rasterizing into an RGBA buffer in memory, for rendering without a display, e.g. in benchmarks
+ * and regression checks. Lines are one pixel wide, drawn with Bresenham's algorithm after clipping to the image.
+ */
+class ImageCanvas : public Canvas {
+public:
+    /**
+     * Creates a black, transparent image.
+     * @param width width in pixels
+     * @param height height in pixels
+     */
+    ImageCanvas(int width, int height);
+
+    /**
+     * @see Canvas::get_width()
+     */
+    int get_width() const override;
+
+    /**
+     * @see Canvas::get_height()
+     */
+    int get_height() const override;
+
+    /**
+     * @see Canvas::clear()
+     */
+    void clear(Color color) override;
+
+    /**
+     * @see Canvas::draw_lines()
+     */
+    void draw_lines(const CanvasPoint *points, std::size_t count, Color color) override;
+
+    /**
+     * @see Canvas::draw_segments()
+     */
+    void draw_segments(const CanvasPoint *points, std::size_t count, Color color) override;
+
+    /**
+     * @see Canvas::draw_image()
+     */
+    void draw_image(const Color *pixels, int width, int height) override;
+
+    /**
+     * Does nothing, the pixels are always up to date.
+     * @see Canvas::present()
+     */
+    void present() override;
+
+    /**
+     * Returns the color of a pixel.
+     * @param x column, in [0, width)
+     * @param y row, in [0, height)
+     * @return color of the pixel
+     */
+    Color get_pixel(int x, int y) const;
+
+    /**
+     * Returns the pixels, row by row from the top, 4 bytes (R, G, B, A) each.
+     * @return the pixel buffer
+     */
+    const std::vector<std::uint8_t> &get_pixels() const;
+
+    /**
+     * Saves the image as a binary PPM (P6), dropping the alpha channel.
+     * @param path file to write
+     * @throws std::runtime_error if the file can't be written
+     */
+    void write_ppm(const std::string &path) const;
+
+    /**
+     * Saves the image as an RGBA PNG. The image data is stored uncompressed, so writing is fast and needs no zlib.
+     * @param path file to write
+     * @throws std::runtime_error if the file can't be written
+     */
+    void write_png(const std::string &path) const;
+
+private:
+    int width;
+    int height;
+    std::vector<std::uint8_t> pixels;
+
+    /**
+     * Draws a segment, clipping it to the image.
+     */
+    void draw_line(CanvasPoint p0, CanvasPoint p1, Color color);
+};
+
+#endif //C11NHF_IMAGECANVAS_H
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <cfloat>
+#include <math.h>
+#include "FastMath.h"
+#include "Interval.h"
+
+static const double PI = 3.14159265358979323846;
+
+/**
+ * Ulps by which the results of sin, cos, tan, exp, log and ^ are widened in the FAST precision, twice the largest
+ * error of FastMath's approximations against libm measured by benchFastMath().
+ */
+static const int FAST_ULPS = 6;
+
+/**
+ * Relative error by which powers are widened in addition in the FAST precision, the bound of FastMath::fast_pow()
+ * for results that don't overflow, doubled.
+ */
+static const double FAST_POW_ERROR = 1.0 / 1099511627776.0;   /* 2^-40 */
+
+Interval Interval::entire() {
+    return Interval{-INFINITY, INFINITY};
+}
+
+Interval Interval::empty() {
+    return Interval{INFINITY, -INFINITY};
+}
+
+bool Interval::is_empty() const {
+    return !(lo <= hi);
+}
+
+bool Interval::contains(double value) const {
+    return lo <= value && value <= hi;
+}
+
+/**
+ * Builds a result from bounds computed with rounding to nearest, widening them by one ulp. A NaN bound, from
+ * inf - inf or the like, stands for an unbounded side.
+ */
+static Interval outward(double lo, double hi) {
+    return Interval{lo != lo ? -INFINITY : nextafter(lo, -INFINITY), hi != hi ? INFINITY : nextafter(hi, INFINITY)};
+}
+
+/**
+ * Widens a result of a function FastMath approximates by the error of the approximation when the block kernels use
+ * it, so the enclosure also holds the values Expression::evaluate_batch() computes. Relative is the error relative
+ * to the bounds on top of FAST_ULPS ulps.
+ */
+static Interval approximated(Interval result, double relative = 0.0) {
+    if (FastMath::precision() != FastMath::Precision::FAST || result.is_empty())
+        return result;
+    if (isfinite(result.lo))
+        result.lo -= fabs(result.lo) * relative;
+    if (isfinite(result.hi))
+        result.hi += fabs(result.hi) * relative;
+    for (int i = 0; i < FAST_ULPS; i++) {
+        result.lo = nextafter(result.lo, -INFINITY);
+        result.hi = nextafter(result.hi, INFINITY);
+    }
+    return result;
+}
+
+/**
+ * Undoes the widening across 0 of a result known not to change sign, so a later division sees a one-sided 0.
+ */
+static Interval keep_sign(Interval result, bool non_negative, bool non_positive) {
+    if (non_negative)
+        result.lo = std::max(result.lo, 0.0);
+    if (non_positive)
+        result.hi = std::min(result.hi, 0.0);
+    return result;
+}
+
+Interval operator+(Interval lhs, Interval rhs) {
+    if (lhs.is_empty() || rhs.is_empty())
+        return Interval::empty();
+    return outward(lhs.lo + rhs.lo, lhs.hi + rhs.hi);
+}
+
+Interval operator-(Interval lhs, Interval rhs) {
+    if (lhs.is_empty() || rhs.is_empty())
+        return Interval::empty();
+    return outward(lhs.lo - rhs.hi, lhs.hi - rhs.lo);
+}
+
+/**
+ * Multiplies two bounds, 0 times an unbounded side being 0.
+ */
+static double product(double a, double b) {
+    return a == 0.0 || b == 0.0 ? 0.0 : a * b;
+}
+
+Interval operator*(Interval lhs, Interval rhs) {
+    if (lhs.is_empty() || rhs.is_empty())
+        return Interval::empty();
+    double p[4] = {product(lhs.lo, rhs.lo), product(lhs.lo, rhs.hi), product(lhs.hi, rhs.lo),
+                   product(lhs.hi, rhs.hi)};
+    Interval result = outward(*std::min_element(p, p + 4), *std::max_element(p, p + 4));
+    return keep_sign(result, (lhs.lo >= 0.0 && rhs.lo >= 0.0) || (lhs.hi <= 0.0 && rhs.hi <= 0.0),
+                     (lhs.lo >= 0.0 && rhs.hi <= 0.0) || (lhs.hi <= 0.0 && rhs.lo >= 0.0));
+}
+
+Interval operator/(Interval lhs, Interval rhs) {
+    if (lhs.is_empty() || rhs.is_empty())
+        return Interval::empty();
+    if (rhs.lo <= 0.0 && rhs.hi >= 0.0 && (rhs.lo != 0.0) == (rhs.hi != 0.0))   /* 0 inside, or [0, 0] */
+        return Interval::entire();
+    /* a divisor ending at 0 approaches it from its own side */
+    double d[2] = {rhs.lo == 0.0 ? 0.0 : rhs.lo, rhs.hi == 0.0 ? -0.0 : rhs.hi};
+    double n[2] = {lhs.lo, lhs.hi};
+    double q[4];
+    for (int i = 0; i < 4; i++) {
+        q[i] = n[i / 2] == 0.0 ? 0.0 : n[i / 2] / d[i % 2];
+        if (q[i] != q[i])
+            return Interval::entire();
+    }
+    Interval result = outward(*std::min_element(q, q + 4), *std::max_element(q, q + 4));
+    return keep_sign(result, (lhs.lo >= 0.0 && rhs.lo >= 0.0) || (lhs.hi <= 0.0 && rhs.hi <= 0.0),
+                     (lhs.lo >= 0.0 && rhs.hi <= 0.0) || (lhs.hi <= 0.0 && rhs.lo >= 0.0));
+}
+
+Interval intervalPow(Interval base, Interval exponent) {
+    if (base.is_empty() || exponent.is_empty())
+        return Interval::empty();
+    if (exponent.lo == exponent.hi && exponent.lo == floor(exponent.lo) && fabs(exponent.lo) < 9007199254740992.0) {
+        /* integer power: defined for negative bases too */
+        double n = fabs(exponent.lo);
+        if (n == 0.0)
+            return Interval{1.0, 1.0};
+        Interval power;
+        if (fmod(n, 2.0) == 0.0) {
+            double lo = base.contains(0.0) ? 0.0 : std::min(fabs(base.lo), fabs(base.hi));
+            double hi = std::max(fabs(base.lo), fabs(base.hi));
+            power = keep_sign(approximated(outward(pow(lo, n), pow(hi, n)), FAST_POW_ERROR), true, false);
+        } else {
+            power = keep_sign(approximated(outward(pow(base.lo, n), pow(base.hi, n)), FAST_POW_ERROR), base.lo >= 0.0,
+                              base.hi <= 0.0);
+        }
+        return exponent.lo > 0.0 ? power : Interval{1.0, 1.0} / power;
+    }
+    if (base.lo < 0.0 && exponent.lo != exponent.hi)   /* negative bases have real powers at integer exponents */
+        return Interval::entire();
+    if (base.hi < 0.0)
+        return Interval::empty();
+    /* pow is monotonic in both arguments for non-negative bases, the extremes are at the corners */
+    double a = std::max(base.lo, 0.0);
+    double p[4] = {pow(a, exponent.lo), pow(a, exponent.hi), pow(base.hi, exponent.lo), pow(base.hi, exponent.hi)};
+    return keep_sign(approximated(outward(*std::min_element(p, p + 4), *std::max_element(p, p + 4)), FAST_POW_ERROR),
+                     true, false);
+}
+
+/**
+ * Returns whether [lo, hi] may contain a place offset + k * period for an integer k. Errs on the side of yes,
+ * with a slack covering the rounding of the division.
+ */
+static bool may_contain(double lo, double hi, double offset, double period) {
+    double slack = 1e-9 + 4 * DBL_EPSILON * (fabs(lo) + fabs(hi)) / period;
+    double k = ceil((lo - offset) / period - slack);
+    return k <= (hi - offset) / period + slack;
+}
+
+/**
+ * Encloses sin or cos, given the places of their maxima.
+ */
+static Interval periodic(Interval arg, double (*f)(double), double maximum) {
+    if (arg.is_empty())
+        return Interval::empty();
+    if (!(fabs(arg.lo) < 1e15 && fabs(arg.hi) < 1e15) || arg.hi - arg.lo >= 2 * PI)
+        return approximated(Interval{-1.0, 1.0});
+    double a = f(arg.lo), b = f(arg.hi);
+    Interval result = outward(std::min(a, b), std::max(a, b));
+    if (may_contain(arg.lo, arg.hi, maximum, 2 * PI))
+        result.hi = 1.0;
+    if (may_contain(arg.lo, arg.hi, maximum + PI, 2 * PI))
+        result.lo = -1.0;
+    result.lo = std::max(result.lo, -1.0);
+    result.hi = std::min(result.hi, 1.0);
+    return approximated(result);
+}
+
+Interval intervalSin(Interval arg) {
+    return periodic(arg, sin, PI / 2);
+}
+
+Interval intervalCos(Interval arg) {
+    return periodic(arg, cos, 0.0);
+}
+
+Interval intervalTan(Interval arg) {
+    if (arg.is_empty())
+        return Interval::empty();
+    if (!(fabs(arg.lo) < 1e15 && fabs(arg.hi) < 1e15) || arg.hi - arg.lo >= PI ||
+        may_contain(arg.lo, arg.hi, PI / 2, PI))
+        return Interval::entire();
+    return approximated(outward(tan(arg.lo), tan(arg.hi)));
+}
+
+Interval intervalAbs(Interval arg) {
+    if (arg.is_empty())
+        return Interval::empty();
+    double hi = std::max(fabs(arg.lo), fabs(arg.hi));
+    if (arg.contains(0.0))
+        return Interval{0.0, hi};
+    return Interval{std::min(fabs(arg.lo), fabs(arg.hi)), hi};
+}
+
+Interval intervalSqrt(Interval arg) {
+    if (arg.is_empty() || arg.hi < 0.0)
+        return Interval::empty();
+    return keep_sign(outward(sqrt(std::max(arg.lo, 0.0)), sqrt(arg.hi)), true, false);
+}
+
+Interval intervalLog(Interval arg) {
+    if (arg.is_empty() || arg.hi < 0.0)
+        return Interval::empty();
+    Interval result = outward(log(std::max(arg.lo, 0.0)), log(arg.hi));
+    if (arg.lo <= 0.0)
+        result.lo = -INFINITY;
+    return approximated(result);
+}
+
+Interval intervalSign(Interval arg) {
+    if (arg.is_empty())
+        return Interval::empty();
+    return Interval{arg.lo > 0.0 ? 1.0 : arg.lo < 0.0 ? -1.0 : 0.0, arg.hi > 0.0 ? 1.0 : arg.hi < 0.0 ? -1.0 : 0.0};
+}
+
+Interval intervalExp(Interval arg) {
+    if (arg.is_empty())
+        return Interval::empty();
+    return keep_sign(approximated(outward(exp(arg.lo), exp(arg.hi))), true, false);
+}
+
+Interval intervalAsin(Interval arg) {
+    if (arg.is_empty() || arg.hi < -1.0 || arg.lo > 1.0)
+        return Interval::empty();
+    double lo = std::max(arg.lo, -1.0), hi = std::min(arg.hi, 1.0);
+    return keep_sign(outward(asin(lo), asin(hi)), lo >= 0.0, hi <= 0.0);
+}
+
+Interval intervalAcos(Interval arg) {
+    if (arg.is_empty() || arg.hi < -1.0 || arg.lo > 1.0)
+        return Interval::empty();
+    return keep_sign(outward(acos(std::min(arg.hi, 1.0)), acos(std::max(arg.lo, -1.0))), true, false);
+}
+
+Interval intervalAtan(Interval arg) {
+    if (arg.is_empty())
+        return Interval::empty();
+    return keep_sign(outward(atan(arg.lo), atan(arg.hi)), arg.lo >= 0.0, arg.hi <= 0.0);
+}
+
+Interval intervalSinh(Interval arg) {
+    if (arg.is_empty())
+        return Interval::empty();
+    return keep_sign(outward(sinh(arg.lo), sinh(arg.hi)), arg.lo >= 0.0, arg.hi <= 0.0);
+}
+
+Interval intervalCosh(Interval arg) {
+    if (arg.is_empty())
+        return Interval::empty();
+    double hi = cosh(std::max(fabs(arg.lo), fabs(arg.hi)));
+    if (arg.contains(0.0))
+        return Interval{1.0, nextafter(hi, INFINITY)};
+    return keep_sign(outward(cosh(std::min(fabs(arg.lo), fabs(arg.hi))), hi), true, false);
+}
+
+Interval intervalTanh(Interval arg) {
+    if (arg.is_empty())
+        return Interval::empty();
+    return keep_sign(outward(tanh(arg.lo), tanh(arg.hi)), arg.lo >= 0.0, arg.hi <= 0.0);
+}
+
+Interval intervalFloor(Interval arg) {
+    if (arg.is_empty())
+        return Interval::empty();
+    return Interval{floor(arg.lo), floor(arg.hi)};
+}
+
+Interval intervalCeil(Interval arg) {
+    if (arg.is_empty())
+        return Interval::empty();
+    return Interval{ceil(arg.lo), ceil(arg.hi)};
+}
@@ -0,0 +1,102 @@
+#ifndef C11NHF_INTERVAL_H
+#define C11NHF_INTERVAL_H
+
+/**
+ * Closed interval of doubles, the enclosure of the values an expression takes over a range of places.
+ * Every operation rounds its bounds outwards, by one ulp, so the true result of the operation on any members of
+ * the operands lies inside even though the operations round to nearest. Library functions (pow, sin, log, ...)
+ * are assumed to be accurate to within one ulp, as glibc's are. In the FAST precision of FastMath the bounds of sin,
+ * cos, tan, exp, log and pow are widened further by the errors of its approximations, so they also enclose the
+ * values Expression::evaluate_batch() computes with them.
+ * NaN results are not enclosed, they are not values a plot shows: sqrt([-4, 4]) is [0, 2], and an operation that is
+ * undefined everywhere on its operands gives the empty interval. Infinite bounds mean the values are unbounded.
+ */
+struct Interval {
+    double lo, hi;
+
+    /**
+     * Returns the interval of all doubles.
+     * @return [-inf, inf]
+     */
+    static Interval entire();
+
+    /**
+     * Returns the interval containing nothing.
+     * @return an empty interval
+     */
+    static Interval empty();
+
+    /**
+     * Returns whether the interval contains nothing. Intervals with a NaN bound are empty.
+     * @return whether lo > hi
+     */
+    bool is_empty() const;
+
+    /**
+     * Returns whether the interval contains a value.
+     * @param value value to look for
+     * @return whether lo <= value <= hi
+     */
+    bool contains(double value) const;
+};
+
+Interval operator+(Interval lhs, Interval rhs);
+
+Interval operator-(Interval lhs, Interval rhs);
+
+Interval operator*(Interval lhs, Interval rhs);
+
+/**
+ * Divides two intervals. A divisor with 0 inside gives [-inf, inf], one with 0 at an end an interval unbounded on
+ * one side.
+ */
+Interval operator/(Interval lhs, Interval rhs);
+
+/**
+ * Encloses pow(base, exponent). Negative bases are handled for a single integer exponent; for any other exponent
+ * only the non-negative part of the base has real powers.
+ */
+Interval intervalPow(Interval base, Interval exponent);
+
+Interval intervalSin(Interval arg);
+
+Interval intervalCos(Interval arg);
+
+/**
+ * Encloses tan, [-inf, inf] if the argument may contain a pole.
+ */
+Interval intervalTan(Interval arg);
+
+Interval intervalAbs(Interval arg);
+
+Interval intervalSqrt(Interval arg);
+
+Interval intervalLog(Interval arg);
+
+Interval intervalSign(Interval arg);
+
+Interval intervalExp(Interval arg);
+
+/**
+ * Encloses asin over the part of the argument inside [-1, 1], empty if there is none. acos likewise.
+ */
+Interval intervalAsin(Interval arg);
+
+Interval intervalAcos(Interval arg);
+
+Interval intervalAtan(Interval arg);
+
+Interval intervalSinh(Interval arg);
+
+Interval intervalCosh(Interval arg);
+
+Interval intervalTanh(Interval arg);
+
+/**
+ * Encloses floor. The bounds are integers, so they are exact and not widened. ceil likewise.
+ */
+Interval intervalFloor(Interval arg);
+
+Interval intervalCeil(Interval arg);
+
+#endif //C11NHF_INTERVAL_H
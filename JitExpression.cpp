@@ -0,0 +1,280 @@
+#include <cstring>
+#include <cstdint>
+#include <initializer_list>
+#include <math.h>
+#include "JitExpression.h"
+
+#if defined(__x86_64__) && !defined(_WIN32) && (defined(__unix__) || defined(__APPLE__))
+#define C11NHF_JIT
+#include <sys/mman.h>
+#endif
+
+/**
+ * Helpers the generated code calls out to. They use the plain C calling convention, so their address can be
+ * embedded in the machine code.
+ */
+extern "C" {
+static double jit_call_function(const std::function<double(double)> *function, double x) {
+    return (*function)(x);
+}
+
+static double jit_evaluate_node(const Expression *node, double x) {
+    return node->evaluate(x);
+}
+
+static double jit_pow(double lhs, double rhs) {
+    return pow(lhs, rhs);
+}
+}
+
+/**
+ * Appends x86-64 instructions to a byte buffer. Only the handful of encodings the code generator needs are
+ * implemented; every memory operand is addressed relative to rbp with a 32 bit displacement.
+ */
+class Emitter {
+public:
+    std::vector<unsigned char> bytes;
+
+    void byte(unsigned char b) {
+        bytes.push_back(b);
+    }
+
+    void put(std::initializer_list<unsigned char> list) {
+        bytes.insert(bytes.end(), list.begin(), list.end());
+    }
+
+    void bytes_of(const void *data, std::size_t size) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        bytes.insert(bytes.end(), p, p + size);
+    }
+
+    void imm32(std::int32_t value) {
+        bytes_of(&value, sizeof value);
+    }
+
+    void imm64(std::uint64_t value) {
+        bytes_of(&value, sizeof value);
+    }
+
+    /** push rbp; mov rbp, rsp; sub rsp, frame */
+    void prologue(std::int32_t frame) {
+        byte(0x55);
+        put({0x48, 0x89, 0xE5});
+        put({0x48, 0x81, 0xEC});
+        imm32(frame);
+    }
+
+    /** leave; ret */
+    void epilogue() {
+        byte(0xC9);
+        byte(0xC3);
+    }
+
+    /** movsd xmm, [rbp + disp] */
+    void load(int xmm, std::int32_t disp) {
+        put({0xF2, 0x0F, 0x10, static_cast<unsigned char>(0x85 | (xmm << 3))});
+        imm32(disp);
+    }
+
+    /** movsd [rbp + disp], xmm */
+    void store(int xmm, std::int32_t disp) {
+        put({0xF2, 0x0F, 0x11, static_cast<unsigned char>(0x85 | (xmm << 3))});
+        imm32(disp);
+    }
+
+    /** mov rax, value; movq xmm, rax */
+    void load_constant(int xmm, double value) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof bits);
+        put({0x48, 0xB8});
+        imm64(bits);
+        put({0x66, 0x48, 0x0F, 0x6E, static_cast<unsigned char>(0xC0 | (xmm << 3))});
+    }
+
+    /** movapd xmm1, xmm0 */
+    void move_top_to_rhs() {
+        put({0x66, 0x0F, 0x28, 0xC8});
+    }
+
+    /** addsd/subsd/mulsd/divsd xmm0, xmm1, selected by the second opcode byte */
+    void arithmetic(unsigned char opcode) {
+        put({0xF2, 0x0F, opcode, 0xC1});
+    }
+
+    /** mov rdi, pointer */
+    void load_first_pointer_argument(const void *pointer) {
+        put({0x48, 0xBF});
+        imm64(reinterpret_cast<std::uintptr_t>(pointer));
+    }
+
+    /** mov rax, target; call rax */
+    void call(const void *target) {
+        put({0x48, 0xB8});
+        imm64(reinterpret_cast<std::uintptr_t>(target));
+        put({0xFF, 0xD0});
+    }
+};
+
+/**
+ * Offset of the saved variable in the frame.
+ */
+static const std::int32_t VARIABLE_SLOT = -8;
+
+/**
+ * Returns the frame offset of a stack slot of the bytecode.
+ * @param slot index of the slot, 0 being the bottom of the stack
+ * @return displacement relative to rbp
+ */
+static std::int32_t slot_offset(unsigned slot) {
+    return -16 - 8 * std::int32_t(slot);
+}
+
+/**
+ * Returns the SSE2 opcode byte of an arithmetic instruction.
+ * @param op one of ADD, SUB, MUL, DIV (or their CONST and VAR forms, normalized by the caller)
+ * @return second opcode byte of the scalar double instruction
+ */
+static unsigned char sse_opcode(CompiledExpression::OpCode op) {
+    switch (op) {
+        case CompiledExpression::ADD:
+            return 0x58;
+        case CompiledExpression::SUB:
+            return 0x5C;
+        case CompiledExpression::MUL:
+            return 0x59;
+        default:
+            return 0x5E;
+    }
+}
+
+JitExpression::JitExpression(const Expression &exp) : interpreter{exp}, code{nullptr}, code_size{0},
+                                                      function{nullptr} {
+    if (supported())
+        install(generate());
+}
+
+JitExpression::~JitExpression() {
+#ifdef C11NHF_JIT
+    if (code)
+        munmap(code, code_size);
+#endif
+}
+
+bool JitExpression::supported() {
+#ifdef C11NHF_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::vector<unsigned char> JitExpression::generate() const {
+    typedef CompiledExpression C;
+    Emitter e;
+    std::int32_t frame = 8 + 8 * std::int32_t(interpreter.get_max_depth());
+    frame = (frame + 15) & ~15;
+    e.prologue(frame);
+    e.store(0, VARIABLE_SLOT);
+    unsigned depth = 0;
+    for (const C::Instruction &ins : interpreter.get_code()) {
+        switch (ins.op) {
+            case C::PUSH_CONST:
+                if (depth > 0)
+                    e.store(0, slot_offset(depth - 1));
+                e.load_constant(0, ins.value);
+                ++depth;
+                break;
+            case C::PUSH_VAR:
+                if (depth > 0)
+                    e.store(0, slot_offset(depth - 1));
+                e.load(0, VARIABLE_SLOT);
+                ++depth;
+                break;
+            case C::ADD:
+            case C::SUB:
+            case C::MUL:
+            case C::DIV:
+                e.move_top_to_rhs();
+                e.load(0, slot_offset(depth - 2));
+                e.arithmetic(sse_opcode(ins.op));
+                --depth;
+                break;
+            case C::POW:
+                e.move_top_to_rhs();
+                e.load(0, slot_offset(depth - 2));
+                e.call(reinterpret_cast<const void *>(&jit_pow));
+                --depth;
+                break;
+            case C::ADD_CONST:
+            case C::SUB_CONST:
+            case C::MUL_CONST:
+            case C::DIV_CONST:
+                e.load_constant(1, ins.value);
+                e.arithmetic(sse_opcode(C::OpCode(ins.op - (C::ADD_CONST - C::ADD))));
+                break;
+            case C::POW_CONST:
+                e.load_constant(1, ins.value);
+                e.call(reinterpret_cast<const void *>(&jit_pow));
+                break;
+            case C::ADD_VAR:
+            case C::SUB_VAR:
+            case C::MUL_VAR:
+            case C::DIV_VAR:
+                e.load(1, VARIABLE_SLOT);
+                e.arithmetic(sse_opcode(C::OpCode(ins.op - (C::ADD_VAR - C::ADD))));
+                break;
+            case C::POW_VAR:
+                e.load(1, VARIABLE_SLOT);
+                e.call(reinterpret_cast<const void *>(&jit_pow));
+                break;
+            case C::CALL:
+                e.load_first_pointer_argument(&interpreter.get_function(ins.index));
+                e.call(reinterpret_cast<const void *>(&jit_call_function));
+                break;
+            case C::CALL_BUILTIN:   /* the argument is already in xmm0, call the builtin's plain function */
+                e.call(reinterpret_cast<const void *>(
+                        FunctionRegistry::global().get(FunctionRegistry::Builtin(ins.index)).native));
+                break;
+            case C::EVAL:
+                if (depth > 0)
+                    e.store(0, slot_offset(depth - 1));
+                e.load_first_pointer_argument(&interpreter.get_node(ins.index));
+                e.load(0, VARIABLE_SLOT);
+                e.call(reinterpret_cast<const void *>(&jit_evaluate_node));
+                ++depth;
+                break;
+        }
+    }
+    e.epilogue();
+    return e.bytes;
+}
+
+void JitExpression::install(const std::vector<unsigned char> &machine_code) {
+#ifdef C11NHF_JIT
+    void *memory = mmap(nullptr, machine_code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return;
+    std::memcpy(memory, machine_code.data(), machine_code.size());
+    if (mprotect(memory, machine_code.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, machine_code.size());
+        return;
+    }
+    code = memory;
+    code_size = machine_code.size();
+    function = reinterpret_cast<NativeFunction>(memory);
+#endif
+}
+
+JitExpression::NativeFunction JitExpression::get_function() const {
+    return function;
+}
+
+double JitExpression::evaluate(double x) const {
+    if (function)
+        return function(x);
+    return interpreter.evaluate(x);
+}
+
+const CompiledExpression &JitExpression::get_interpreter() const {
+    return interpreter;
+}
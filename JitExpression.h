@@ -0,0 +1,76 @@
+#ifndef C11NHF_JITEXPRESSION_H
+#define C11NHF_JITEXPRESSION_H
+#include <cstddef>
+#include <vector>
+#include "CompiledExpression.h"
+
+/**
+ * Native x86-64 code generated for an Expression, for long sweeps of one formula.
+ * The bytecode of a CompiledExpression is translated one instruction at a time into SSE2 scalar code, keeping
+ * the top of the stack in xmm0 and the rest of the stack in the frame of the generated function. Function
+ * builtins, pow and nodes without an instruction are called out to, so the results stay bit-identical to
+ * Expression::evaluate().
+ * Only the System V x86-64 calling convention is supported. Everywhere else, or when no executable memory can
+ * be mapped, the object silently falls back to the bytecode interpreter.
+ */
+class JitExpression {
+public:
+    typedef double (*NativeFunction)(double);
+
+    /**
+     * Compiles the expression to native code if the platform allows it.
+     * @param exp expression tree to compile, it is not referenced after the constructor returns
+     */
+    explicit JitExpression(const Expression &exp);
+
+    ~JitExpression();
+
+    JitExpression(const JitExpression &) = delete;
+
+    JitExpression &operator=(const JitExpression &) = delete;
+
+    /**
+     * Returns whether this build can generate native code at all.
+     * @return true on System V x86-64 platforms
+     */
+    static bool supported();
+
+    /**
+     * Returns the generated function. It stays valid as long as this object lives.
+     * @return pointer to the native code, nullptr if the code generation was not possible
+     */
+    NativeFunction get_function() const;
+
+    /**
+     * Evaluates the expression at place x, with the native code if there is one, with the interpreter otherwise.
+     * @param x place to evaluate the expression at
+     * @return value of the expression
+     */
+    double evaluate(double x) const;
+
+    /**
+     * Returns the interpreter the native code was generated from and falls back to.
+     * @return bytecode form of the expression
+     */
+    const CompiledExpression &get_interpreter() const;
+
+private:
+    CompiledExpression interpreter;
+    void *code;
+    std::size_t code_size;
+    NativeFunction function;
+
+    /**
+     * Translates the bytecode of the interpreter to machine code.
+     * @return the machine code of the function
+     */
+    std::vector<unsigned char> generate() const;
+
+    /**
+     * Copies the machine code to freshly mapped executable memory and sets function.
+     * @param machine_code code to install
+     */
+    void install(const std::vector<unsigned char> &machine_code);
+};
+
+#endif //C11NHF_JITEXPRESSION_H
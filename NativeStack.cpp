@@ -0,0 +1,35 @@
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+#include "NativeStack.h"
+
+std::uintptr_t NativeStack::lowest_address() {
+#if defined(_WIN32)
+    /* the stack is one reserved region, the base of the allocation the current frame lies in is its lowest page */
+    MEMORY_BASIC_INFORMATION info;
+    if (!VirtualQuery(&info, &info, sizeof info))
+        return 0;
+    return reinterpret_cast<std::uintptr_t>(info.AllocationBase);
+#elif defined(__linux__)
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0)
+        return 0;
+    void *address = nullptr;
+    size_t size = 0, guard = 0;
+    bool known = pthread_attr_getstack(&attr, &address, &size) == 0 && address;
+    if (pthread_attr_getguardsize(&attr, &guard) != 0)
+        guard = 0;
+    pthread_attr_destroy(&attr);
+    return known ? reinterpret_cast<std::uintptr_t>(address) + guard : 0;
+#elif defined(__APPLE__)
+    /* macOS reports the top of the stack, the end it grows from */
+    pthread_t self = pthread_self();
+    return reinterpret_cast<std::uintptr_t>(pthread_get_stackaddr_np(self)) - pthread_get_stacksize_np(self);
+#else
+    return 0;
+#endif
+}
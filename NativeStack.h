@@ -0,0 +1,21 @@
+#ifndef C11NHF_NATIVESTACK_H
+#define C11NHF_NATIVESTACK_H
+#include <cstdint>
+
+/**
+ * Limits of the native stack of the current thread, for the traversals that recurse while the stack allows it and
+ * continue with an explicit stack below (Expression::evaluate() and the like). Stacks are taken to grow downwards,
+ * as they do on every platform the program runs on.
+ */
+namespace NativeStack {
+
+    /**
+     * Returns the lowest address of the stack of the current thread, the end it grows towards. Queried from the
+     * system: pthread_getattr_np() on Linux, pthread_get_stackaddr_np() on macOS, VirtualQuery() on Windows.
+     * @return lowest address of the stack, guard pages excluded where the system reports them; 0 if it can't be
+     *         determined on this platform
+     */
+    std::uintptr_t lowest_address();
+}
+
+#endif //C11NHF_NATIVESTACK_H
@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <math.h>
+#include "Parser.h"
+
+ParseError::ParseError(const std::string &message, std::size_t position) :
+        std::runtime_error{message + " at position " + std::to_string(position)}, position{position} { }
+
+std::size_t ParseError::get_position() const {
+    return position;
+}
+
+VariableTable::VariableTable(std::vector<std::string> names) : names{std::move(names)} { }
+
+unsigned VariableTable::resolve(const std::string &name) {
+    int slot = find(name);
+    if (slot >= 0)
+        return unsigned(slot);
+    names.push_back(name);
+    return unsigned(names.size() - 1);
+}
+
+int VariableTable::find(const std::string &name) const {
+    for (std::size_t i = 0; i < names.size(); i++)
+        if (names[i] == name)
+            return int(i);
+    return -1;
+}
+
+std::size_t VariableTable::size() const {
+    return names.size();
+}
+
+const std::vector<std::string> &VariableTable::get_names() const {
+    return names;
+}
+
+/**
+ * Looks up a function of the registry.
+ * @throws std::invalid_argument if there is no function with that name
+ */
+static const FunctionRegistry::Entry &lookupFunction(const std::string &s) {
+    const FunctionRegistry::Entry *entry = FunctionRegistry::global().find(s);
+    if (!entry)
+        throw std::invalid_argument("Unknown function: " + s);
+    return *entry;
+}
+
+std::function<double(double)> parseFunction(const std::string &s) {
+    return lookupFunction(s).scalar;
+}
+
+std::function<double(double)> parseFunctionDerivative(const std::string &s) {
+    const FunctionRegistry::Entry *entry = FunctionRegistry::global().find(s);
+    if (!entry || !entry->derivative)
+        throw std::invalid_argument("No derivative known for function: " + s);
+    return entry->derivative;
+}
+
+std::function<Interval(Interval)> parseFunctionInterval(const std::string &s) {
+    const FunctionRegistry::Entry *entry = FunctionRegistry::global().find(s);
+    if (!entry || !entry->interval)
+        throw std::invalid_argument("No interval extension known for function: " + s);
+    return entry->interval;
+}
+
+/**
+ * Shorthand for a call of a builtin function.
+ */
+static std::unique_ptr<Expression> call(FunctionRegistry::Builtin builtin, std::unique_ptr<Expression> &&arg) {
+    return std::unique_ptr<Expression>(new Function{std::move(arg), FunctionRegistry::global().get(builtin)});
+}
+
+static std::unique_ptr<Expression> constant(double value) {
+    return std::unique_ptr<Expression>(new Constant{value});
+}
+
+/**
+ * Builds 1 - u^2, or 1 + u^2 if plus.
+ */
+static std::unique_ptr<Expression> oneAndSquare(std::unique_ptr<Expression> &&arg, bool plus) {
+    std::unique_ptr<Expression> square{new Exp{std::move(arg), constant(2.0)}};
+    if (plus)
+        return std::unique_ptr<Expression>(new Sum{constant(1.0), std::move(square)});
+    return std::unique_ptr<Expression>(new Dif{constant(1.0), std::move(square)});
+}
+
+std::unique_ptr<Expression> buildFunctionDerivative(const std::string &s, std::unique_ptr<Expression> &&arg) {
+    const FunctionRegistry::Entry *entry = FunctionRegistry::global().find(s);
+    switch (entry ? entry->builtin : FunctionRegistry::CUSTOM) {
+        case FunctionRegistry::SIN:
+            return call(FunctionRegistry::COS, std::move(arg));
+        case FunctionRegistry::COS:
+            return std::unique_ptr<Expression>(new Prod{call(FunctionRegistry::SIN, std::move(arg)), constant(-1.0)});
+        case FunctionRegistry::TAN:
+            return oneAndSquare(call(FunctionRegistry::TAN, std::move(arg)), true);
+        case FunctionRegistry::ABS:
+            return call(FunctionRegistry::SIGN, std::move(arg));
+        case FunctionRegistry::SQRT:
+            return std::unique_ptr<Expression>(new Div{constant(0.5), call(FunctionRegistry::SQRT, std::move(arg))});
+        case FunctionRegistry::LOG:
+            return std::unique_ptr<Expression>(new Div{constant(1.0), std::move(arg)});
+        case FunctionRegistry::EXP:
+            return call(FunctionRegistry::EXP, std::move(arg));
+        case FunctionRegistry::ASIN:
+            return std::unique_ptr<Expression>(new Div{constant(1.0), call(FunctionRegistry::SQRT,
+                                                                           oneAndSquare(std::move(arg), false))});
+        case FunctionRegistry::ACOS:
+            return std::unique_ptr<Expression>(new Div{constant(-1.0), call(FunctionRegistry::SQRT,
+                                                                            oneAndSquare(std::move(arg), false))});
+        case FunctionRegistry::ATAN:
+            return std::unique_ptr<Expression>(new Div{constant(1.0), oneAndSquare(std::move(arg), true)});
+        case FunctionRegistry::SINH:
+            return call(FunctionRegistry::COSH, std::move(arg));
+        case FunctionRegistry::COSH:
+            return call(FunctionRegistry::SINH, std::move(arg));
+        case FunctionRegistry::TANH:
+            return oneAndSquare(call(FunctionRegistry::TANH, std::move(arg)), false);
+        case FunctionRegistry::SIGN:
+        case FunctionRegistry::FLOOR:
+        case FunctionRegistry::CEIL:
+            return constant(0.0);
+        default:
+            throw std::invalid_argument("No derivative known for function: " + s);
+    }
+}
+
+/**
+ * Operator precedence parser working directly on the characters of the formula. The operands and the operators and
+ * groups waiting for their right hand sides are kept on explicit stacks, so formulas nested as deep as their text
+ * allows are parsed without recursion.
+ */
+class Parser {
+public:
+    /**
+     * @param variables table to resolve the variables with, nullptr to accept X only
+     */
+    Parser(const char *text, std::size_t length, VariableTable *variables) :
+            begin{text}, pos{text}, end{text + length}, variables{variables} { }
+
+    /**
+     * Parses the whole text.
+     * @return the Expression Tree
+     */
+    std::unique_ptr<Expression> parse() {
+        std::unique_ptr<Expression> exp = parse_expression();
+        skip_space();
+        if (pos != end) {
+            if (*pos == ')')
+                fail("Unmatched ')'");
+            fail(std::string("Unexpected '") + *pos + "'");
+        }
+        return exp;
+    }
+
+private:
+    /**
+     * Operator waiting for its right hand side, or an open group: a parenthesis, or a function call.
+     */
+    struct Pending {
+        char op;   /**< the operator, '(' for a group */
+        const FunctionRegistry::Entry *func;   /**< function of a call, nullptr for other entries */
+    };
+
+    const char *begin;
+    const char *pos;
+    const char *end;
+    VariableTable *variables;
+    std::vector<std::unique_ptr<Expression>> operands;
+    std::vector<Pending> pending;
+
+    [[noreturn]] void fail(const std::string &message) const {
+        throw ParseError(message, pos - begin);
+    }
+
+    void skip_space() {
+        while (pos != end && isspace(static_cast<unsigned char>(*pos)))
+            ++pos;
+    }
+
+    /**
+     * Returns the binding power of a binary operator, 0 if the character is not one.
+     */
+    static int precedence(char op) {
+        switch (op) {
+            case '+':
+            case '-':
+                return 1;
+            case '*':
+            case '/':
+                return 2;
+            case '^':
+                return 3;
+            default:
+                return 0;
+        }
+    }
+
+    static std::unique_ptr<Expression> make_operator(char op, std::unique_ptr<Expression> &&lhs,
+                                                     std::unique_ptr<Expression> &&rhs) {
+        switch (op) {
+            case '+':
+                return std::unique_ptr<Expression>(new Sum{std::move(lhs), std::move(rhs)});
+            case '-':
+                return std::unique_ptr<Expression>(new Dif{std::move(lhs), std::move(rhs)});
+            case '*':
+                return std::unique_ptr<Expression>(new Prod{std::move(lhs), std::move(rhs)});
+            case '/':
+                return std::unique_ptr<Expression>(new Div{std::move(lhs), std::move(rhs)});
+            default:
+                return std::unique_ptr<Expression>(new Exp{std::move(lhs), std::move(rhs)});
+        }
+    }
+
+    /**
+     * Applies the pending operators of the innermost group that bind at least as strong as min_precedence to the
+     * operands on the stack.
+     */
+    void apply_operators(int min_precedence) {
+        while (!pending.empty() && pending.back().op != '(' && precedence(pending.back().op) >= min_precedence) {
+            char op = pending.back().op;
+            pending.pop_back();
+            std::unique_ptr<Expression> rhs = std::move(operands.back());
+            operands.pop_back();
+            std::unique_ptr<Expression> lhs = std::move(operands.back());
+            operands.back() = make_operator(op, std::move(lhs), std::move(rhs));
+        }
+    }
+
+    /**
+     * Parses operands joined by operators, up to the first character that is neither an operand, an operator nor
+     * the ')' of an open group. An operator is applied once an operator binding as weak or weaker follows it, or
+     * only a weaker one for ^, which is right associative; that builds the tree precedence climbing does.
+     * @return the parsed subtree
+     */
+    std::unique_ptr<Expression> parse_expression() {
+        for (;;) {
+            /* an operand, after any opening parentheses and function names */
+            for (;;) {
+                skip_space();
+                if (pos == end)
+                    fail("Expected an operand");
+                char c = *pos;
+                if (c == '(') {
+                    ++pos;
+                    pending.push_back(Pending{'(', nullptr});
+                    continue;
+                }
+                if (isdigit(static_cast<unsigned char>(c)) || c == '.') {
+                    operands.push_back(parse_number());
+                    break;
+                }
+                if (!isalpha(static_cast<unsigned char>(c)))
+                    fail(std::string("Expected an operand instead of '") + c + "'");
+                const FunctionRegistry::Entry *func = nullptr;
+                std::unique_ptr<Expression> variable = parse_name(func);
+                if (variable) {
+                    operands.push_back(std::move(variable));
+                    break;
+                }
+                pending.push_back(Pending{'(', func});
+            }
+            /* the operator after it, and the closing parentheses of the groups it ends */
+            for (;;) {
+                skip_space();
+                char op = pos == end ? '\0' : *pos;
+                int prec = precedence(op);
+                if (prec != 0) {
+                    apply_operators(op == '^' ? prec + 1 : prec);
+                    ++pos;
+                    pending.push_back(Pending{op, nullptr});
+                    break;
+                }
+                apply_operators(1);
+                if (pending.empty()) {
+                    std::unique_ptr<Expression> exp = std::move(operands.back());
+                    operands.pop_back();
+                    return exp;
+                }
+                expect_closing();
+                const FunctionRegistry::Entry *func = pending.back().func;
+                pending.pop_back();
+                if (func) {
+                    std::unique_ptr<Expression> arg = std::move(operands.back());
+                    operands.back().reset(new Function{std::move(arg), *func});
+                }
+            }
+        }
+    }
+
+    std::unique_ptr<Expression> parse_number() {
+        const char *start = pos;
+        while (pos != end && (isdigit(static_cast<unsigned char>(*pos)) || *pos == '.'))
+            ++pos;
+        /* the text need not be terminated, so the digits are copied for strtod */
+        char digits[64];
+        std::size_t length = pos - start;
+        if (length >= sizeof digits) {
+            pos = start;
+            fail("Number too long");
+        }
+        std::copy(start, pos, digits);
+        digits[length] = '\0';
+        char *parsed_end;
+        double value = strtod(digits, &parsed_end);
+        if (parsed_end != digits + length) {
+            pos = start + (parsed_end - digits);
+            fail("Malformed number");
+        }
+        return std::unique_ptr<Expression>(new Constant{value});
+    }
+
+    /**
+     * Parses a variable, or the name and the opening parenthesis of a function call.
+     * @param func receives the function of a call
+     * @return the variable, nullptr for a call
+     */
+    std::unique_ptr<Expression> parse_name(const FunctionRegistry::Entry *&func) {
+        const char *start = pos;
+        while (pos != end && (isalnum(static_cast<unsigned char>(*pos)) || *pos == '_'))
+            ++pos;
+        std::string name(start, pos);
+        if (name == "X" || name == "x") {
+            if (!variables)
+                return std::unique_ptr<Expression>(new Variable{});
+            name = "x";
+        }
+        func = FunctionRegistry::global().find(name);
+        if (!func) {
+            if (variables)
+                return std::unique_ptr<Expression>(new Variable{variables->resolve(name), name});
+            pos = start;
+            fail("Unknown function '" + name + "'");
+        }
+        skip_space();
+        if (pos == end || *pos != '(')
+            fail("Expected '(' after function name");
+        ++pos;
+        return nullptr;
+    }
+
+    void expect_closing() {
+        skip_space();
+        if (pos == end || *pos != ')')
+            fail("Expected ')'");
+        ++pos;
+    }
+};
+
+std::unique_ptr<Expression> parseExpression(const char *text, std::size_t length) {
+    return Parser(text, length, nullptr).parse();
+}
+
+std::unique_ptr<Expression> parseExpression(const std::string &text) {
+    return parseExpression(text.data(), text.size());
+}
+
+std::unique_ptr<Expression> parseExpression(const char *text, std::size_t length, VariableTable &variables) {
+    return Parser(text, length, &variables).parse();
+}
+
+std::unique_ptr<Expression> parseExpression(const std::string &text, VariableTable &variables) {
+    return parseExpression(text.data(), text.size(), variables);
+}
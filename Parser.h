@@ -0,0 +1,144 @@
+#ifndef C11NHF_PARSER_H
+#define C11NHF_PARSER_H
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Expressions.h"
+
+/**
+ * Error thrown when a formula can't be parsed. Carries the position of the offending character.
+ */
+class ParseError : public std::runtime_error {
+public:
+    ParseError(const std::string &message, std::size_t position);
+
+    /**
+     * Returns the position of the error.
+     * @return index of the character the error was detected at
+     */
+    std::size_t get_position() const;
+
+private:
+    std::size_t position;
+};
+
+/**
+ * Names of the variables of formulas of several variables, the slot of a name being its index. The parser resolves
+ * the names it meets to slots, adding the new ones, so formulas parsed with the same table agree on the slots.
+ */
+class VariableTable {
+public:
+    VariableTable() = default;
+
+    /**
+     * Creates a table with variables already in place, e.g. {"x", "y"} to put x in slot 0 and y in slot 1.
+     * @param names names of the variables in the order of their slots
+     */
+    explicit VariableTable(std::vector<std::string> names);
+
+    /**
+     * Returns the slot of a variable, adding it to the table if it is new.
+     * @param name name of the variable
+     * @return slot of the variable
+     */
+    unsigned resolve(const std::string &name);
+
+    /**
+     * Returns the slot of a variable.
+     * @param name name of the variable
+     * @return slot of the variable, -1 if it is not in the table
+     */
+    int find(const std::string &name) const;
+
+    /**
+     * Returns the number of variables, the size of the value arrays of Expression::evaluate_slots().
+     * @return number of slots
+     */
+    std::size_t size() const;
+
+    /**
+     * Returns the names in the order of their slots.
+     * @return names of the variables
+     */
+    const std::vector<std::string> &get_names() const;
+
+private:
+    std::vector<std::string> names;
+};
+
+/**
+ * Ceates a new function object depending on the incoming string.
+ * The functions are the ones of FunctionRegistry::global(); register new function types there.
+ * @param s function name to be parsed
+ * @return function object, containing the parsed function
+ * @throws std::invalid_argument if there is no function with that name
+ */
+std::function<double(double)> parseFunction(const std::string &s);
+
+/**
+ * Creates the derivative of a function parseFunction() knows, the one of its registry entry.
+ * @param s function name
+ * @return function object computing the derivative
+ * @throws std::invalid_argument if the derivative of the function is not known
+ */
+std::function<double(double)> parseFunctionDerivative(const std::string &s);
+
+/**
+ * Creates the interval extension of a function parseFunction() knows, enclosing its values over an interval of
+ * arguments: the one of its registry entry.
+ * @param s function name
+ * @return function object computing the enclosure
+ * @throws std::invalid_argument if the interval extension of the function is not known
+ */
+std::function<Interval(Interval)> parseFunctionInterval(const std::string &s);
+
+/**
+ * Builds the derivative of a builtin function as an Expression Tree, for symbolic differentiation.
+ * Implement the derivative of new builtins here.
+ * @param s function name
+ * @param arg argument the derivative is taken at
+ * @return the tree of f'(arg)
+ * @throws std::invalid_argument if the derivative of the function is not known
+ */
+std::unique_ptr<Expression> buildFunctionDerivative(const std::string &s, std::unique_ptr<Expression> &&arg);
+
+/**
+ * Parses a formula and builds the Expression Tree from it in a single pass.
+ * The grammar is the usual infix one: numbers, the variable X, function calls like sin(...), parentheses and the
+ * binary operators + - * / ^, where ^ binds strongest and is right associative. Whitespace is ignored.
+ * The tokens are read directly from the text, and the tree is built by an operator precedence parser, so no
+ * intermediate token list or RPN string is created. Its stacks are explicit ones, so nesting of any depth, like
+ * thousands of parentheses or a long chain of ^, is parsed without recursion.
+ * @param text the formula
+ * @param length number of characters in text
+ * @return pointer to the Expression Tree
+ * @throws ParseError if the text is not a valid formula
+ */
+std::unique_ptr<Expression> parseExpression(const char *text, std::size_t length);
+
+/**
+ * @see parseExpression(const char *, std::size_t)
+ */
+std::unique_ptr<Expression> parseExpression(const std::string &text);
+
+/**
+ * Parses a formula of several variables. Besides the function names, every name of letters, digits and underscores
+ * starting with a letter is a variable, resolved to its slot in the table; X is the same as x.
+ * @param text the formula
+ * @param length number of characters in text
+ * @param variables table of the variables, receives the names not yet in it
+ * @return pointer to the Expression Tree
+ * @throws ParseError if the text is not a valid formula
+ * @see parseExpression(const char *, std::size_t)
+ */
+std::unique_ptr<Expression> parseExpression(const char *text, std::size_t length, VariableTable &variables);
+
+/**
+ * @see parseExpression(const char *, std::size_t, VariableTable &)
+ */
+std::unique_ptr<Expression> parseExpression(const std::string &text, VariableTable &variables);
+
+#endif //C11NHF_PARSER_H
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <math.h>
+#include "Plotter.h"
+#include "ThreadPool.h"
+
+const Color Plotter::BACKGROUND{255, 255, 255, 255};
+const Color Plotter::AXES{0, 0, 0, 255};
+const Color Plotter::CURVE{255, 0, 0, 255};
+const Color Plotter::CONTOUR{255, 255, 255, 255};
+const int Plotter::CONTOUR_LEVELS;
+
+/**
+ * Colors of the heatmap at evenly spaced points of [0, 1], from dark blue through green to yellow.
+ */
+static const Color HEAT_RAMP[] = {{68, 1, 84, 255}, {59, 82, 139, 255}, {33, 145, 140, 255}, {94, 201, 98, 255},
+                                  {253, 231, 37, 255}};
+
+/**
+ * Returns the heatmap color of t in [0, 1], interpolated between the colors of HEAT_RAMP.
+ */
+static Color heatColor(double t) {
+    const int last = int(sizeof(HEAT_RAMP) / sizeof(HEAT_RAMP[0])) - 1;
+    double position = std::max(0.0, std::min(1.0, t)) * last;
+    int i = std::min(int(position), last - 1);
+    double f = position - i;
+    const Color &a = HEAT_RAMP[i], &b = HEAT_RAMP[i + 1];
+    return Color{(unsigned char) lround(a.r + (b.r - a.r) * f), (unsigned char) lround(a.g + (b.g - a.g) * f),
+                 (unsigned char) lround(a.b + (b.b - a.b) * f), 255};
+}
+
+/**
+ * Edges of a marching squares cell crossed by the contour, two per segment, -1 after the last one, by the corners
+ * above the level (1 top left, 2 top right, 4 bottom right, 8 bottom left). Edges are 0 top, 1 right, 2 bottom and
+ * 3 left, edge e joining corners e and e + 1 (mod 4). The saddles, 5 and 10, are listed for a centre below the
+ * level; above it they take each other's segments.
+ */
+static const int CONTOUR_EDGES[16][4] = {{-1, -1, -1, -1}, {3, 0, -1, -1}, {0, 1, -1, -1}, {3, 1, -1, -1},
+                                         {1, 2, -1, -1}, {3, 0, 1, 2}, {0, 2, -1, -1}, {2, 3, -1, -1},
+                                         {2, 3, -1, -1}, {0, 2, -1, -1}, {0, 1, 2, 3}, {1, 2, -1, -1},
+                                         {3, 1, -1, -1}, {0, 1, -1, -1}, {3, 0, -1, -1}, {-1, -1, -1, -1}};
+
+/**
+ * Position of the corners of a marching squares cell, clockwise from the top left one.
+ */
+static const double CORNER_X[4] = {0.0, 1.0, 1.0, 0.0}, CORNER_Y[4] = {0.0, 0.0, 1.0, 1.0};
+
+Plotter::Plotter(std::unique_ptr<Canvas> &&canvas, double tolerance) : canvas{std::move(canvas)},
+                                                                        sampler{tolerance},
+                                                                        viewport{0.0, 0.0, 0.0, 0.0, 0, 0} { }
+
+void Plotter::plot(const Expression &exp, double x_min, double x_max, double y_min, double y_max) {
+    begin_frame(x_min, x_max, y_min, y_max);
+    for (const Polyline &line : sampler.sample(exp, viewport))
+        draw_polyline(line);
+    canvas->present();
+}
+
+bool Plotter::plot(SampleCache &cache, double x_min, double x_max, double y_min, double y_max, double budget_ms) {
+    begin_frame(x_min, x_max, y_min, y_max);
+    bool complete = cache.collect(viewport, budget_ms, cached);
+    for (const Polyline *line : cached)
+        draw_polyline(*line);
+    canvas->present();
+    return complete;
+}
+
+void Plotter::plot_heatmap(const Expression &exp, unsigned x_slot, unsigned y_slot, double x_min, double x_max,
+                           double y_min, double y_max) {
+    viewport = Viewport{x_min, x_max, y_min, y_max, canvas->get_width(), canvas->get_height()};
+    if (viewport.width <= 0 || viewport.height <= 0)
+        return;
+    std::size_t width = std::size_t(viewport.width), height = std::size_t(viewport.height);
+    values.resize(width * height);
+    image.resize(width * height);
+    parallelEvaluateGrid(exp, Grid{x_min, x_max, y_min, y_max, width, height, x_slot, y_slot}, values.data());
+
+    double lo = INFINITY, hi = -INFINITY;
+    for (double value : values)
+        if (isfinite(value)) {
+            lo = std::min(lo, value);
+            hi = std::max(hi, value);
+        }
+    /* the ramp is quantized to HEAT_STEPS colors, computed once per frame */
+    const int HEAT_STEPS = 256;
+    Color palette[HEAT_STEPS];
+    for (int k = 0; k < HEAT_STEPS; k++)
+        palette[k] = heatColor(k / double(HEAT_STEPS - 1));
+    double scale = hi > lo ? (HEAT_STEPS - 1) / (hi - lo) : 0.0;
+    for (std::size_t i = 0; i < values.size(); i++)
+        image[i] = isfinite(values[i]) ? palette[int((values[i] - lo) * scale + 0.5)] : BACKGROUND;
+    canvas->draw_image(image.data(), viewport.width, viewport.height);
+    if (hi > lo)
+        draw_contours(lo, (hi - lo) / (CONTOUR_LEVELS + 1));
+    draw_axes();
+    canvas->present();
+}
+
+Canvas &Plotter::get_canvas() const {
+    return *canvas;
+}
+
+const Viewport &Plotter::get_viewport() const {
+    return viewport;
+}
+
+void Plotter::begin_frame(double x_min, double x_max, double y_min, double y_max) {
+    viewport = Viewport{x_min, x_max, y_min, y_max, canvas->get_width(), canvas->get_height()};
+    canvas->clear(BACKGROUND);
+    draw_axes();
+}
+
+void Plotter::draw_axes() {
+    int column = int(lround(viewport.pixel_x(0.0))), row = int(lround(viewport.pixel_y(0.0)));
+    if (column >= 0 && column <= viewport.width) {
+        CanvasPoint axis[2] = {{column, 0}, {column, viewport.height}};
+        canvas->draw_lines(axis, 2, AXES);
+    }
+    if (row >= 0 && row <= viewport.height) {
+        CanvasPoint axis[2] = {{0, row}, {viewport.width, row}};
+        canvas->draw_lines(axis, 2, AXES);
+    }
+}
+
+void Plotter::draw_polyline(const Polyline &line) {
+    double top = -viewport.height, bottom = 2.0 * viewport.height;
+    for (std::size_t i = 0; i + 1 < line.size(); i++) {
+        double x1 = viewport.pixel_x(line[i].x), y1 = viewport.pixel_y(line[i].y);
+        double x2 = viewport.pixel_x(line[i + 1].x), y2 = viewport.pixel_y(line[i + 1].y);
+        if ((y1 < top && y2 < top) || (y1 > bottom && y2 > bottom))
+            continue;
+        bool clipped = false;
+        if (y1 < top || y1 > bottom) {
+            double edge = y1 < top ? top : bottom;
+            x1 += (x2 - x1) * (edge - y1) / (y2 - y1);
+            y1 = edge;
+            clipped = true;
+        }
+        if (y2 < top || y2 > bottom) {
+            double edge = y2 < top ? top : bottom;
+            x2 = x1 + (x2 - x1) * (edge - y1) / (y2 - y1);
+            y2 = edge;
+        }
+        CanvasPoint start{int(lround(x1)), int(lround(y1))}, end{int(lround(x2)), int(lround(y2))};
+        if (clipped || vertices.empty() || vertices.back().x != start.x || vertices.back().y != start.y) {
+            flush();
+            vertices.push_back(start);
+        }
+        if (end.x != vertices.back().x || end.y != vertices.back().y)
+            vertices.push_back(end);
+    }
+    flush();
+}
+
+void Plotter::flush() {
+    if (vertices.size() > 1)
+        canvas->draw_lines(vertices.data(), vertices.size(), CURVE);
+    vertices.clear();
+}
+
+void Plotter::draw_contours(double lo, double step) {
+    std::size_t width = std::size_t(viewport.width), height = std::size_t(viewport.height);
+    segments.clear();
+    for (std::size_t r = 0; r + 1 < height; r++) {
+        const double *top = &values[r * width], *bottom = top + width;
+        for (std::size_t c = 0; c + 1 < width; c++) {
+            double v[4] = {top[c], top[c + 1], bottom[c + 1], bottom[c]};
+            if (!isfinite(v[0]) || !isfinite(v[1]) || !isfinite(v[2]) || !isfinite(v[3]))
+                continue;
+            double low = std::min(std::min(v[0], v[1]), std::min(v[2], v[3]));
+            double high = std::max(std::max(v[0], v[1]), std::max(v[2], v[3]));
+            /* only the levels between the smallest and the largest corner cross the cell */
+            int first = std::max(1, int(ceil((low - lo) / step)));
+            int last = std::min(CONTOUR_LEVELS, int(floor((high - lo) / step)));
+            for (int k = first; k <= last; k++) {
+                double level = lo + k * step;
+                int index = (v[0] > level) | (v[1] > level) << 1 | (v[2] > level) << 2 | (v[3] > level) << 3;
+                bool saddle = index == 5 || index == 10;
+                if (saddle && (v[0] + v[1] + v[2] + v[3]) / 4 > level)
+                    index = 15 - index;
+                const int *edges = CONTOUR_EDGES[index];
+                for (int j = 0; j < 4 && edges[j] >= 0; j += 2) {
+                    for (int e = 0; e < 2; e++) {
+                        int a = edges[j + e], b = (a + 1) % 4;
+                        double t = (level - v[a]) / (v[b] - v[a]);
+                        double x = c + CORNER_X[a] + (CORNER_X[b] - CORNER_X[a]) * t;
+                        double y = r + CORNER_Y[a] + (CORNER_Y[b] - CORNER_Y[a]) * t;
+                        segments.push_back(CanvasPoint{int(lround(x)), int(lround(y))});
+                    }
+                }
+            }
+        }
+    }
+    if (!segments.empty())
+        canvas->draw_segments(segments.data(), segments.size(), CONTOUR);
+}
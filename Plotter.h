@@ -0,0 +1,124 @@
+#ifndef C11NHF_PLOTTER_H
+#define C11NHF_PLOTTER_H
+#include <memory>
+#include <vector>
+#include "Canvas.h"
+#include "Expressions.h"
+#include "SampleCache.h"
+#include "Sampler.h"
+
+/**
+ * Draws the graph of an expression, with the axes, on a canvas it owns. The canvas, the sampler and the vertex
+ * buffer are kept between frames, so a redraw allocates nothing once the buffer has grown, and every continuous
+ * piece of the curve goes to the canvas in a single draw_lines() call, all the contour lines of a heatmap in a single
+ * draw_segments() call. The plot always fills the canvas' current size.
+ */
+class Plotter {
+public:
+    static const Color BACKGROUND;
+    static const Color AXES;
+    static const Color CURVE;
+    static const Color CONTOUR;
+
+    /**
+     * Number of contour lines of a heatmap, at evenly spaced levels between the smallest and largest value shown.
+     */
+    static const int CONTOUR_LEVELS = 10;
+
+    /**
+     * @param canvas canvas to draw on
+     * @param tolerance sampling tolerance in pixels
+     */
+    explicit Plotter(std::unique_ptr<Canvas> &&canvas, double tolerance = 0.5);
+
+    /**
+     * Draws a frame and presents it.
+     * @param exp expression to plot
+     * @param x_min left end of the x range
+     * @param x_max right end of the x range
+     * @param y_min bottom of the y range
+     * @param y_max top of the y range
+     */
+    void plot(const Expression &exp, double x_min, double x_max, double y_min, double y_max);
+
+    /**
+     * Draws a frame from the tiles of a sample cache and presents it.
+     * @param cache cache of the expression to plot
+     * @param x_min left end of the x range
+     * @param x_max right end of the x range
+     * @param y_min bottom of the y range
+     * @param y_max top of the y range
+     * @param budget_ms time the cache may spend sampling tiles it can stand in for
+     * @return whether the frame is final; if not, some tiles were drawn from another level and the next frame
+     *         refines them
+     * @see SampleCache::collect()
+     */
+    bool plot(SampleCache &cache, double x_min, double x_max, double y_min, double y_max, double budget_ms);
+
+    /**
+     * Draws a heatmap of an expression of two variables with its contour lines, and presents it. Every pixel is
+     * evaluated at its centre, by parallelEvaluateGrid(); the values are colored from dark blue to yellow over
+     * the range of finite values in the frame, pixels where the expression isn't finite are left BACKGROUND.
+     * The contour lines are traced by marching squares between the pixel centres.
+     * @param exp expression to plot
+     * @param x_slot slot of the variable on the horizontal axis
+     * @param y_slot slot of the variable on the vertical axis
+     * @param x_min left end of the x range
+     * @param x_max right end of the x range
+     * @param y_min bottom of the y range
+     * @param y_max top of the y range
+     */
+    void plot_heatmap(const Expression &exp, unsigned x_slot, unsigned y_slot, double x_min, double x_max,
+                      double y_min, double y_max);
+
+    /**
+     * Returns the canvas the plotter draws on.
+     * @return the canvas
+     */
+    Canvas &get_canvas() const;
+
+    /**
+     * Returns the viewport of the last frame.
+     * @return the last viewport
+     */
+    const Viewport &get_viewport() const;
+
+private:
+    std::unique_ptr<Canvas> canvas;
+    Sampler sampler;
+    std::vector<CanvasPoint> vertices;
+
+    /**
+     * Ends of the contour segments of a heatmap, submitted in one draw_segments() call.
+     */
+    std::vector<CanvasPoint> segments;
+    std::vector<const Polyline *> cached;
+    std::vector<double> values;
+    std::vector<Color> image;
+    Viewport viewport;
+
+    /**
+     * Sets the viewport to the canvas' current size, clears the canvas and draws the axes.
+     */
+    void begin_frame(double x_min, double x_max, double y_min, double y_max);
+
+    void draw_axes();
+
+    /**
+     * Draws a polyline, clipped vertically to a band three times the height of the canvas, so that the
+     * coordinates fit ints while the visible part of every segment keeps its direction.
+     */
+    void draw_polyline(const Polyline &line);
+
+    /**
+     * Draws the contour lines of the values of the last heatmap, levels apart from lo.
+     */
+    void draw_contours(double lo, double step);
+
+    /**
+     * Draws the vertices collected so far as one line and empties the buffer.
+     */
+    void flush();
+};
+
+#endif //C11NHF_PLOTTER_H
@@ -0,0 +1,159 @@
+#include <math.h>
+#include "PolynomialDetector.h"
+
+const std::size_t PolynomialDetector::MAX_DEGREE;
+const std::size_t PolynomialDetector::MIN_DEGREE;
+
+/**
+ * Removes the zero coefficients of the highest degrees, keeping at least the constant term.
+ */
+static void trim(std::vector<double> &coefficients) {
+    while (coefficients.size() > 1 && coefficients.back() == 0.0)
+        coefficients.pop_back();
+}
+
+/**
+ * Computes lhs + sign * rhs into lhs.
+ */
+static void add(std::vector<double> &lhs, const std::vector<double> &rhs, double sign) {
+    if (lhs.size() < rhs.size())
+        lhs.resize(rhs.size(), 0.0);
+    for (std::size_t k = 0; k < rhs.size(); k++)
+        lhs[k] += sign * rhs[k];
+    trim(lhs);
+}
+
+/**
+ * Computes lhs * rhs into lhs.
+ * @return false if the degree of the product would exceed the limit, lhs is unchanged then
+ */
+static bool multiply(std::vector<double> &lhs, const std::vector<double> &rhs, std::size_t max_degree) {
+    if (lhs.size() + rhs.size() - 2 > max_degree)
+        return false;
+    std::vector<double> product(lhs.size() + rhs.size() - 1, 0.0);
+    for (std::size_t i = 0; i < lhs.size(); i++)
+        for (std::size_t j = 0; j < rhs.size(); j++)
+            product[i + j] += lhs[i] * rhs[j];
+    lhs.swap(product);
+    trim(lhs);
+    return true;
+}
+
+/**
+ * Returns whether the polynomial has a single non-zero term.
+ */
+static bool is_monomial(const std::vector<double> &coefficients) {
+    std::size_t terms = 0;
+    for (double c : coefficients)
+        if (c != 0.0)
+            terms++;
+    return terms <= 1;
+}
+
+void PolynomialDetector::run(std::unique_ptr<Expression> &exp) const {
+    std::vector<double> coefficients;
+    if (collect(exp, coefficients))
+        convert(exp, coefficients);
+}
+
+/**
+ * Computes the polynomial lhs op rhs into lhs.
+ * @return false if the result is not a polynomial the detector converts, lhs is unchanged then
+ */
+static bool combine(char op, std::vector<double> &lhs, const std::vector<double> &rhs) {
+    switch (op) {
+        case '+':
+            add(lhs, rhs, 1.0);
+            return true;
+        case '-':
+            add(lhs, rhs, -1.0);
+            return true;
+        case '*':
+            return (is_monomial(lhs) || is_monomial(rhs)) && multiply(lhs, rhs, PolynomialDetector::MAX_DEGREE);
+        case '/':
+            if (rhs.size() != 1 || rhs[0] == 0.0)
+                return false;
+            for (double &c : lhs)
+                c /= rhs[0];
+            return true;
+        case '^': {
+            double n = rhs[0];
+            if (rhs.size() != 1 || n < 0.0 || n != floor(n) || !is_monomial(lhs) ||
+                (lhs.size() - 1) * n > PolynomialDetector::MAX_DEGREE)
+                return false;
+            std::vector<double> base;
+            base.swap(lhs);
+            lhs.assign(1, 1.0);
+            for (unsigned k = 0; k < unsigned(n); k++)
+                multiply(lhs, base, PolynomialDetector::MAX_DEGREE);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool PolynomialDetector::collect(std::unique_ptr<Expression> &slot, std::vector<double> &coefficients) const {
+    struct Step {
+        std::unique_ptr<Expression> *slot;
+        bool operands_done;
+    };
+    struct Collected {
+        bool polynomial;
+        std::vector<double> coefficients;
+    };
+    std::vector<Step> steps{Step{&slot, false}};
+    std::vector<Collected> results;
+    while (!steps.empty()) {
+        Step step = steps.back();
+        steps.pop_back();
+        Expression *node = step.slot->get();
+        if (step.operands_done) {
+            if (Function *func = dynamic_cast<Function *>(node)) {
+                Collected &arg = results.back();
+                if (arg.polynomial)
+                    convert(func->arg, arg.coefficients);
+                arg.polynomial = false;
+                continue;
+            }
+            TwoOperand *op = static_cast<TwoOperand *>(node);
+            Collected rhs = std::move(results.back());
+            results.pop_back();
+            Collected &lhs = results.back();
+            if (lhs.polynomial && rhs.polynomial && combine(op->get_operator(), lhs.coefficients, rhs.coefficients))
+                continue;
+            if (lhs.polynomial)
+                convert(op->lhs, lhs.coefficients);
+            if (rhs.polynomial)
+                convert(op->rhs, rhs.coefficients);
+            lhs.polynomial = false;
+            continue;
+        }
+        if (const Constant *cons = dynamic_cast<const Constant *>(node)) {
+            results.push_back(Collected{true, {cons->get_value()}});
+        } else if (const Variable *var = dynamic_cast<const Variable *>(node)) {   /* only X, other variables aren't */
+            results.push_back(Collected{var->slot == 0, {0.0, 1.0}});
+        } else if (const Polynomial *poly = dynamic_cast<const Polynomial *>(node)) {
+            results.push_back(Collected{true, poly->coefficients});
+        } else if (Function *func = dynamic_cast<Function *>(node)) {
+            steps.push_back(Step{step.slot, true});
+            steps.push_back(Step{&func->arg, false});
+        } else if (TwoOperand *op = dynamic_cast<TwoOperand *>(node)) {
+            /* the left operand is collected first, its result lies below the right one's */
+            steps.push_back(Step{step.slot, true});
+            steps.push_back(Step{&op->rhs, false});
+            steps.push_back(Step{&op->lhs, false});
+        } else {
+            results.push_back(Collected{false, {}});
+        }
+    }
+    coefficients.swap(results.back().coefficients);
+    return results.back().polynomial;
+}
+
+void PolynomialDetector::convert(std::unique_ptr<Expression> &slot, std::vector<double> &coefficients) {
+    trim(coefficients);
+    if (coefficients.size() <= MIN_DEGREE || is_monomial(coefficients) || dynamic_cast<const Polynomial *>(slot.get()))
+        return;
+    slot.reset(new Polynomial{std::move(coefficients)});
+}
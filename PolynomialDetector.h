@@ -0,0 +1,54 @@
+#ifndef C11NHF_POLYNOMIALDETECTOR_H
+#define C11NHF_POLYNOMIALDETECTOR_H
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "Expressions.h"
+
+/**
+ * Optimization pass replacing polynomial subtrees by Polynomial nodes.
+ * A subtree is a polynomial if it only contains X, constants, Polynomial nodes, + - *, division by a constant, and
+ * powers with a constant non-negative integer exponent. Its coefficients are collected bottom-up, and every maximal
+ * polynomial subtree of degree MIN_DEGREE or more is replaced by a single node evaluated by Horner's method. Linear
+ * subtrees are left alone, they are not cheaper as polynomials, and so are single terms, c*X^k, which StrengthReduction
+ * turns into products.
+ * Products are only multiplied out if one of their factors is a single term, c*X^k, and powers if their base is. The
+ * expansion of (X-1)*(X-1) or (X-1)^n and the like would lose accuracy near its roots, where the factored tree
+ * doesn't, so such a product or power is kept and only its factors are converted.
+ */
+class PolynomialDetector {
+public:
+    /**
+     * Highest degree a subtree is converted up to.
+     */
+    static const std::size_t MAX_DEGREE = 64;
+
+    /**
+     * Lowest degree a subtree is converted from.
+     */
+    static const std::size_t MIN_DEGREE = 2;
+
+    /**
+     * Converts the polynomial subtrees of a tree in place.
+     * @param exp tree to optimize, replaced by its optimized form
+     */
+    void run(std::unique_ptr<Expression> &exp) const;
+
+private:
+    /**
+     * Collects the coefficients of a subtree, bottom-up with an explicit stack so trees of any depth can be run. If
+     * the subtree is not a polynomial as a whole, its maximal polynomial subtrees are converted instead.
+     * @param slot owner of the subtree
+     * @param coefficients receives the coefficients in ascending order of degree, if the subtree is a polynomial
+     * @return whether the subtree is a polynomial
+     */
+    bool collect(std::unique_ptr<Expression> &slot, std::vector<double> &coefficients) const;
+
+    /**
+     * Replaces a polynomial subtree by a Polynomial node, if its degree is at least MIN_DEGREE and it has more than
+     * one term.
+     */
+    static void convert(std::unique_ptr<Expression> &slot, std::vector<double> &coefficients);
+};
+
+#endif //C11NHF_POLYNOMIALDETECTOR_H
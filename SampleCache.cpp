@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include "SampleCache.h"
+
+const int SampleCache::TILE_PIXELS;
+const int SampleCache::BAND_PIXELS;
+const std::size_t SampleCache::MAX_TILES;
+const int SampleCache::STAND_IN_LEVELS;
+
+bool SampleCache::Key::operator==(const Key &other) const {
+    return level_x == other.level_x && level_y == other.level_y && tile == other.tile && band == other.band;
+}
+
+std::size_t SampleCache::KeyHash::operator()(const Key &key) const {
+    std::uint64_t h = std::uint64_t(key.tile) * 0x9E3779B97F4A7C15ULL;
+    h ^= std::uint64_t(key.band) + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+    h ^= (std::uint64_t(std::uint32_t(key.level_x)) << 32 | std::uint32_t(key.level_y)) * 0xC2B2AE3D27D4EB4FULL;
+    return std::size_t(h ^ (h >> 29));
+}
+
+SampleCache::SampleCache(const Expression &exp, double tolerance) : exp(exp), sampler{tolerance}, frame{0},
+                                                                   evaluations{0} { }
+
+/**
+ * Returns the milliseconds passed since a moment.
+ */
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool SampleCache::collect(const Viewport &view, double budget_ms, std::vector<const Polyline *> &lines) {
+    lines.clear();
+    frame++;
+    double scale_x = (view.x_max - view.x_min) / view.width, scale_y = (view.y_max - view.y_min) / view.height;
+    if (view.height > BAND_PIXELS / 2 || !(scale_x > 0.0) || !(scale_y > 0.0) || !isfinite(scale_x * scale_y)) {
+        direct = sampler.sample(exp, view);
+        evaluations += sampler.get_evaluations();
+        for (const Polyline &line : direct)
+            lines.push_back(&line);
+        return true;
+    }
+    evict();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    /* the finest powers of 2 not above the scales of the viewport */
+    int level_x = ilogb(scale_x), level_y = ilogb(scale_y);
+    double centre_y = (view.y_min + view.y_max) / 2;
+    Key first = key_at(level_x, level_y, view.x_min, centre_y);
+    Key last = key_at(level_x, level_y, view.x_max, centre_y);
+    bool complete = true, progress = false;
+    for (long long i = first.tile; i <= last.tile; i++) {
+        Key key{level_x, level_y, i, first.band};
+        const Tile *tile = find(key);
+        /* one tile is sampled in any case, so that repeated calls converge */
+        if (!tile && progress && elapsed_ms(start) > budget_ms && stand_in(key, centre_y, lines)) {
+            complete = false;
+            continue;
+        }
+        if (!tile) {
+            tile = &sample(key);
+            progress = true;
+        }
+        for (const Polyline &line : tile->lines)
+            lines.push_back(&line);
+    }
+    /* the neighbours are sampled ahead while the budget lasts, a pan is likely to expose them */
+    long long ahead[2] = {first.tile - 1, last.tile + 1};
+    for (long long i : ahead) {
+        Key key{level_x, level_y, i, first.band};
+        if (elapsed_ms(start) < budget_ms && !find(key))
+            sample(key);
+    }
+    return complete;
+}
+
+void SampleCache::clear() {
+    tiles.clear();
+}
+
+std::size_t SampleCache::size() const {
+    return tiles.size();
+}
+
+std::size_t SampleCache::get_evaluations() const {
+    return evaluations;
+}
+
+SampleCache::Key SampleCache::key_at(int level_x, int level_y, double x, double y) {
+    double width = TILE_PIXELS * ldexp(1.0, level_x), height = BAND_PIXELS * ldexp(1.0, level_y);
+    return Key{level_x, level_y, (long long) floor(x / width), (long long) floor(y / height)};
+}
+
+const SampleCache::Tile *SampleCache::find(const Key &key) {
+    auto found = tiles.find(key);
+    if (found == tiles.end())
+        return nullptr;
+    found->second.last_used = frame;
+    return &found->second;
+}
+
+const SampleCache::Tile &SampleCache::sample(const Key &key) {
+    double width = TILE_PIXELS * ldexp(1.0, key.level_x), height = BAND_PIXELS * ldexp(1.0, key.level_y);
+    /* the band of the tile and the bands next to it are sampled accurately */
+    Viewport view{key.tile * width, (key.tile + 1) * width, (key.band - 1) * height, (key.band + 2) * height,
+                  TILE_PIXELS, 3 * BAND_PIXELS};
+    Tile &tile = tiles[key];
+    tile.lines = sampler.sample(exp, view);
+    tile.last_used = frame;
+    evaluations += sampler.get_evaluations();
+    return tile;
+}
+
+bool SampleCache::stand_in(const Key &key, double centre_y, std::vector<const Polyline *> &lines) {
+    double x = key.tile * TILE_PIXELS * ldexp(1.0, key.level_x);
+    for (int k = 1; k <= STAND_IN_LEVELS; k++) {
+        /* one coarser tile covers this one and its neighbours, it is added once */
+        if (const Tile *coarse = find(key_at(key.level_x + k, key.level_y + k, x, centre_y))) {
+            if (coarse->lines.empty() || lines.empty() || lines.back() != &coarse->lines.back())
+                for (const Polyline &line : coarse->lines)
+                    lines.push_back(&line);
+            return true;
+        }
+        Key fine = key_at(key.level_x - k, key.level_y - k, x, centre_y);
+        std::vector<const Tile *> parts;
+        for (long long i = 0; i < (1LL << k); i++) {
+            const Tile *part = find(Key{fine.level_x, fine.level_y, fine.tile + i, fine.band});
+            if (!part)
+                break;
+            parts.push_back(part);
+        }
+        if (parts.size() == std::size_t(1LL << k)) {
+            for (const Tile *part : parts)
+                for (const Polyline &line : part->lines)
+                    lines.push_back(&line);
+            return true;
+        }
+    }
+    return false;
+}
+
+void SampleCache::evict() {
+    if (tiles.size() <= MAX_TILES)
+        return;
+    std::size_t keep = MAX_TILES * 3 / 4;
+    std::vector<std::uint64_t> ages;
+    ages.reserve(tiles.size());
+    for (const auto &entry : tiles)
+        ages.push_back(entry.second.last_used);
+    std::nth_element(ages.begin(), ages.begin() + std::ptrdiff_t(ages.size() - keep), ages.end());
+    std::uint64_t threshold = ages[ages.size() - keep];
+    for (auto it = tiles.begin(); it != tiles.end();) {
+        if (it->second.last_used < threshold)
+            it = tiles.erase(it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef C11NHF_SAMPLECACHE_H
+#define C11NHF_SAMPLECACHE_H
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Expressions.h"
+#include "Sampler.h"
+
+/**
+ * Cache of sampled curve pieces for interactive panning and zooming.
+ * The plane is cut into tiles along x, sampled separately by a Sampler and kept. A tile belongs to a resolution
+ * level, a pair of scales that are powers of 2 (units per pixel in x and in y), and is TILE_PIXELS wide at its
+ * scale. A viewport is drawn from the tiles of the finest level not coarser than its own scales, so the tolerance
+ * holds on screen, and a pan only samples the tiles it exposes.
+ * The Sampler samples the parts of the curve far above or below the viewport coarsely, so a tile is valid for a
+ * vertical band of the plane only: bands are BAND_PIXELS high, and a tile is sampled accurately over its band and
+ * the bands next to it. The band is part of the key of a tile, chosen by the centre of the viewport.
+ * After a zoom, the tiles missing at the new level are sampled within a time budget per frame; the rest are stood
+ * in for by the coarser or finer tiles of the previous levels, and refined in the following frames.
+ */
+class SampleCache {
+public:
+    /**
+     * Width of a tile at its own scale, in pixels.
+     */
+    static const int TILE_PIXELS = 256;
+
+    /**
+     * Height of a band, in pixels. Viewports at most half as high are served from the cache.
+     */
+    static const int BAND_PIXELS = 8192;
+
+    /**
+     * Number of tiles kept; the least recently used ones are dropped above it.
+     */
+    static const std::size_t MAX_TILES = 1024;
+
+    /**
+     * Number of levels searched upwards and downwards for a stand-in of a missing tile.
+     */
+    static const int STAND_IN_LEVELS = 3;
+
+    /**
+     * @param exp expression to sample, it must outlive the cache
+     * @param tolerance sampling tolerance in pixels
+     */
+    explicit SampleCache(const Expression &exp, double tolerance = 0.5);
+
+    /**
+     * Collects the curve pieces covering the x range of a viewport, sampling the tiles that are missing.
+     * A missing tile is sampled if the budget is not used up yet, if it is the first one missing, or if no other
+     * level can stand in for it.
+     * @param view viewport to cover
+     * @param budget_ms time the sampling of tiles that could be stood in for may take, in milliseconds
+     * @param lines receives the pieces, valid until the next call; pieces of adjacent tiles share their end points
+     * @return whether every piece is at the viewport's own level. If not, another call refines the picture.
+     */
+    bool collect(const Viewport &view, double budget_ms, std::vector<const Polyline *> &lines);
+
+    /**
+     * Drops every tile, e.g. after the expression has changed.
+     */
+    void clear();
+
+    /**
+     * Returns the number of tiles held.
+     * @return number of tiles
+     */
+    std::size_t size() const;
+
+    /**
+     * Returns the number of evaluations of the expression since the cache was created.
+     * @return number of evaluations
+     */
+    std::size_t get_evaluations() const;
+
+private:
+    /**
+     * Identity of a tile: its level, its position in x and its band.
+     */
+    struct Key {
+        int level_x;
+        int level_y;
+        long long tile;
+        long long band;
+
+        bool operator==(const Key &other) const;
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key &key) const;
+    };
+
+    struct Tile {
+        std::vector<Polyline> lines;
+        std::uint64_t last_used;
+    };
+
+    const Expression &exp;
+    Sampler sampler;
+    std::unordered_map<Key, Tile, KeyHash> tiles;
+    std::vector<Polyline> direct;
+    std::uint64_t frame;
+    std::size_t evaluations;
+
+    /**
+     * Returns the key of the tile at a level containing the place x, for a viewport centred at height y.
+     */
+    static Key key_at(int level_x, int level_y, double x, double y);
+
+    /**
+     * Returns a tile if it is held, marking it used.
+     */
+    const Tile *find(const Key &key);
+
+    /**
+     * Samples a tile and stores it.
+     */
+    const Tile &sample(const Key &key);
+
+    /**
+     * Adds the pieces of another level covering a tile, if it has them all.
+     * @return whether a stand-in was found
+     */
+    bool stand_in(const Key &key, double centre_y, std::vector<const Polyline *> &lines);
+
+    /**
+     * Drops the least recently used tiles if there are more than MAX_TILES.
+     */
+    void evict();
+};
+
+#endif //C11NHF_SAMPLECACHE_H
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <math.h>
+#include "Sampler.h"
+
+const int Sampler::INITIAL_SPACING;
+const int Sampler::MAX_DEPTH;
+const int Sampler::PRUNE_GROUP;
+
+double Viewport::pixel_x(double x) const {
+    return (x - x_min) / (x_max - x_min) * width;
+}
+
+double Viewport::pixel_y(double y) const {
+    return (y_max - y) / (y_max - y_min) * height;
+}
+
+double Viewport::plane_x(double column) const {
+    return x_min + column * (x_max - x_min) / width;
+}
+
+Sampler::Sampler(double tolerance) : tolerance{tolerance}, evaluations{0} { }
+
+std::vector<Polyline> Sampler::sample(const Expression &exp, const Viewport &view) {
+    std::size_t intervals = std::max(1, (view.width + INITIAL_SPACING - 1) / INITIAL_SPACING);
+    /* the end points and the midpoints of the intervals, alternating */
+    std::vector<double> xs(2 * intervals + 1), ys(2 * intervals + 1, NAN);
+    for (std::size_t i = 0; i < xs.size(); i++)
+        xs[i] = view.x_min + (view.x_max - view.x_min) * double(i) / double(2 * intervals);
+    std::vector<char> hidden(intervals, 0);
+    prune(exp, view, xs, 0, intervals, hidden);
+
+    /* only the points of the intervals that may show up are evaluated, in one batch */
+    std::vector<std::size_t> wanted;
+    for (std::size_t i = 0; i < xs.size(); i++)
+        if ((i / 2 < intervals && !hidden[i / 2]) || (i % 2 == 0 && i > 0 && !hidden[i / 2 - 1]))
+            wanted.push_back(i);
+    std::vector<double> wanted_xs(wanted.size()), wanted_ys(wanted.size());
+    for (std::size_t k = 0; k < wanted.size(); k++)
+        wanted_xs[k] = xs[wanted[k]];
+    exp.evaluate_batch(wanted_xs.data(), wanted_ys.data(), wanted.size());
+    for (std::size_t k = 0; k < wanted.size(); k++)
+        ys[wanted[k]] = wanted_ys[k];
+    evaluations = wanted.size();
+
+    std::vector<Polyline> curve(1);
+    for (std::size_t i = 0; i < xs.size(); i += 2) {
+        CurvePoint p{xs[i], ys[i]};
+        if (isfinite(p.y))
+            append(curve, p);
+        else
+            cut(curve);
+        if (i + 2 < xs.size() && hidden[i / 2])
+            cut(curve);
+        else if (i + 2 < xs.size())
+            subdivide(exp, view, p, CurvePoint{xs[i + 1], ys[i + 1]}, CurvePoint{xs[i + 2], ys[i + 2]}, 0, curve);
+    }
+    curve.erase(std::remove_if(curve.begin(), curve.end(), [](const Polyline &line) { return line.empty(); }),
+                curve.end());
+    for (Polyline &line : curve)
+        merge(line, view);
+    return curve;
+}
+
+void Sampler::prune(const Expression &exp, const Viewport &view, const std::vector<double> &xs, std::size_t first,
+                    std::size_t last, std::vector<char> &hidden) const {
+    Interval values = exp.evaluate_interval(xs[2 * first], xs[2 * last]);
+    if (values.is_empty() || values.hi < view.y_min || values.lo > view.y_max) {
+        std::fill(hidden.begin() + first, hidden.begin() + last, 1);
+        return;
+    }
+    /* an enclosure inside the viewport can't get hidden parts by halving it */
+    if (last - first < 2 * PRUNE_GROUP || (values.lo >= view.y_min && values.hi <= view.y_max))
+        return;
+    std::size_t middle = first + (last - first) / 2;
+    prune(exp, view, xs, first, middle, hidden);
+    prune(exp, view, xs, middle, last, hidden);
+}
+
+std::size_t Sampler::get_evaluations() const {
+    return evaluations;
+}
+
+/**
+ * Returns on which side of the viewport a pixel row is: -1 above, 1 below, 0 inside.
+ */
+static int side(double row, const Viewport &view) {
+    return row < 0.0 ? -1 : row > view.height ? 1 : 0;
+}
+
+/**
+ * Appends a point, or breaks the curve if the expression isn't finite there.
+ */
+static void emit(std::vector<Polyline> &curve, CurvePoint p) {
+    if (isfinite(p.y))
+        curve.back().push_back(p);
+    else if (!curve.back().empty())
+        curve.push_back(Polyline{});
+}
+
+void Sampler::subdivide(const Expression &exp, const Viewport &view, CurvePoint p0, CurvePoint mid, CurvePoint p1,
+                        int depth, std::vector<Polyline> &curve) {
+    if (!isfinite(p0.y) && !isfinite(mid.y) && !isfinite(p1.y))
+        return;
+    double row0 = view.pixel_y(p0.y), row = view.pixel_y(mid.y), row1 = view.pixel_y(p1.y);
+    if (depth == MAX_DEPTH) {
+        /* a change that doesn't shrink with the interval is a jump, not a steep slope */
+        double jump = fabs(row1 - row0), left = fabs(row - row0), right = fabs(row1 - row);
+        bool broken = jump > tolerance && std::max(left, right) > 0.75 * jump;
+        if (broken && left > right)
+            cut(curve);
+        emit(curve, mid);
+        if (broken && left <= right)
+            cut(curve);
+        return;
+    }
+    CurvePoint q0{(p0.x + mid.x) / 2, 0.0}, q1{(mid.x + p1.x) / 2, 0.0};
+    /* with the block kernels like the first pass, so in the FAST precision the whole curve uses one approximation */
+    double quarter_xs[2] = {q0.x, q1.x}, quarter_ys[2];
+    exp.evaluate_batch(quarter_xs, quarter_ys, 2);
+    q0.y = quarter_ys[0];
+    q1.y = quarter_ys[1];
+    evaluations += 2;
+    double rows[3] = {view.pixel_y(q0.y), row, view.pixel_y(q1.y)};
+    if (isfinite(row0 + rows[0] + rows[1] + rows[2] + row1)) {
+        /* the quarter points are tested too: a curve symmetric about the midpoint passes it on the chord */
+        bool flat = true, hidden = side(row0, view) != 0 && side(row1, view) == side(row0, view);
+        for (int k = 0; k < 3; k++) {
+            flat = flat && fabs(rows[k] - (row0 + (row1 - row0) * (k + 1) / 4)) <= tolerance;
+            hidden = hidden && side(rows[k], view) == side(row0, view);
+        }
+        if (flat || hidden) {
+            append(curve, q0);
+            append(curve, mid);
+            append(curve, q1);
+            return;
+        }
+    }
+    subdivide(exp, view, p0, q0, mid, depth + 1, curve);
+    emit(curve, mid);
+    subdivide(exp, view, mid, q1, p1, depth + 1, curve);
+}
+
+void Sampler::append(std::vector<Polyline> &curve, CurvePoint p) {
+    curve.back().push_back(p);
+}
+
+void Sampler::cut(std::vector<Polyline> &curve) {
+    if (!curve.back().empty())
+        curve.push_back(Polyline{});
+}
+
+void Sampler::merge(Polyline &line, const Viewport &view) const {
+    if (line.size() < 3)
+        return;
+    const double epsilon = tolerance / 4;
+    const double right_angle = 2 * atan(1.0);
+    /*
+     * Every dropped point allows the chord from the last kept point only in a cone of directions passing within
+     * epsilon of it; the cones are intersected, and a point is kept when the next one falls outside.
+     */
+    std::size_t kept = 0;
+    double ax = view.pixel_x(line[0].x), ay = view.pixel_y(line[0].y);
+    double low = -right_angle, high = right_angle;
+    for (std::size_t i = 1; i < line.size(); i++) {
+        double dx = view.pixel_x(line[i].x) - ax, dy = view.pixel_y(line[i].y) - ay;
+        double angle = atan2(dy, dx);
+        if (angle < low || angle > high) {
+            line[++kept] = line[i - 1];
+            ax = view.pixel_x(line[kept].x);
+            ay = view.pixel_y(line[kept].y);
+            low = -right_angle;
+            high = right_angle;
+            dx = view.pixel_x(line[i].x) - ax;
+            dy = view.pixel_y(line[i].y) - ay;
+            angle = atan2(dy, dx);
+        }
+        double length = hypot(dx, dy);
+        if (length > epsilon) {
+            double spread = asin(epsilon / length);
+            low = std::max(low, angle - spread);
+            high = std::min(high, angle + spread);
+        }
+    }
+    line[++kept] = line.back();
+    line.resize(kept + 1);
+}
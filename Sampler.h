@@ -0,0 +1,130 @@
+#ifndef C11NHF_SAMPLER_H
+#define C11NHF_SAMPLER_H
+#include <cstddef>
+#include <vector>
+#include "Expressions.h"
+
+/**
+ * Rectangle of the plane shown on a width x height pixel area. Pixel y grows downwards.
+ */
+struct Viewport {
+    double x_min, x_max, y_min, y_max;
+    int width, height;
+
+    /**
+     * Converts an x coordinate to a pixel column.
+     */
+    double pixel_x(double x) const;
+
+    /**
+     * Converts a y coordinate to a pixel row.
+     */
+    double pixel_y(double y) const;
+
+    /**
+     * Converts a pixel column to an x coordinate.
+     */
+    double plane_x(double column) const;
+};
+
+/**
+ * A point of a sampled curve, in plane coordinates.
+ */
+struct CurvePoint {
+    double x, y;
+};
+
+/**
+ * A continuous piece of a sampled curve.
+ */
+typedef std::vector<CurvePoint> Polyline;
+
+/**
+ * Adaptive sampler turning an expression into polylines that are accurate to a given pixel tolerance.
+ * The x range is cut into intervals of INITIAL_SPACING pixels, their ends and midpoints evaluated in one batch,
+ * then every interval is halved recursively while the curve deviates from the chord by more than the tolerance at
+ * the midpoint or at one of the quarter points. Steep and
+ * oscillating parts get dense samples, flat parts keep their few initial ones, and runs of collinear points are
+ * merged at the end.
+ * Discontinuities are detected at the finest level: an interval still spanning a large change in y whose change
+ * doesn't shrink with the halving, like the pole of tan(X), or one ending in a NaN or infinity, breaks the curve
+ * into separate polylines instead of being joined by a vertical line. Parts of the curve outside the viewport are
+ * only sampled as densely as needed to find where they enter it; initial intervals whose interval enclosure
+ * (Expression::evaluate_interval()) lies entirely above or below the viewport, or that are undefined everywhere,
+ * are not evaluated at all.
+ */
+class Sampler {
+public:
+    /**
+     * Width of the intervals the first, uniform pass samples, in pixels.
+     */
+    static const int INITIAL_SPACING = 8;
+
+    /**
+     * Number of halvings of an initial interval at most, giving intervals of 8 / 2^9 = 1/64 pixel.
+     */
+    static const int MAX_DEPTH = 9;
+
+    /**
+     * Number of initial intervals the pruning checks together at least. Checking single intervals costs more
+     * interval evaluations than the point evaluations it saves.
+     */
+    static const int PRUNE_GROUP = 2;
+
+    /**
+     * @param tolerance largest distance of the polyline from the curve, in pixels
+     */
+    explicit Sampler(double tolerance = 0.5);
+
+    /**
+     * Samples an expression over the x range of the viewport.
+     * @param exp expression to sample
+     * @param view the x range to sample and the pixel grid the tolerance is meant in
+     * @return the continuous pieces of the curve, from left to right
+     */
+    std::vector<Polyline> sample(const Expression &exp, const Viewport &view);
+
+    /**
+     * Returns the number of times the expression was evaluated by the last sample() call.
+     * @return number of evaluations
+     */
+    std::size_t get_evaluations() const;
+
+private:
+    double tolerance;
+    std::size_t evaluations;
+
+    /**
+     * Marks the initial intervals first..last-1 whose values are guaranteed to lie above or below the viewport, by
+     * evaluating the expression on intervals, halving the range as long as a part of it may be hidden.
+     * @param xs end points and midpoints of the initial intervals
+     * @param hidden receives 1 for the hidden intervals
+     */
+    void prune(const Expression &exp, const Viewport &view, const std::vector<double> &xs, std::size_t first,
+               std::size_t last, std::vector<char> &hidden) const;
+
+    /**
+     * Emits the samples inside [p0, p1], excluding the end points.
+     * @param mid the sample in the middle of the interval, already evaluated
+     * @param depth number of halvings so far
+     */
+    void subdivide(const Expression &exp, const Viewport &view, CurvePoint p0, CurvePoint mid, CurvePoint p1,
+                   int depth, std::vector<Polyline> &curve);
+
+    /**
+     * Appends a point to the current polyline, starting a new polyline after a break.
+     */
+    static void append(std::vector<Polyline> &curve, CurvePoint p);
+
+    /**
+     * Ends the current polyline, so the next point starts a new one.
+     */
+    static void cut(std::vector<Polyline> &curve);
+
+    /**
+     * Drops the points lying on the segment of their neighbours, within a fraction of the tolerance.
+     */
+    void merge(Polyline &line, const Viewport &view) const;
+};
+
+#endif //C11NHF_SAMPLER_H
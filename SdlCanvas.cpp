@@ -0,0 +1,107 @@
+#include <cstddef>
+#include <cstdlib>
+#include <stdexcept>
+#include "SdlCanvas.h"
+
+static_assert(sizeof(CanvasPoint) == sizeof(SDL_Point) && offsetof(CanvasPoint, x) == offsetof(SDL_Point, x) &&
+              offsetof(CanvasPoint, y) == offsetof(SDL_Point, y), "CanvasPoint must match SDL_Point");
+
+SdlCanvas::SdlCanvas(const std::string &title, int width, int height) : window{nullptr}, renderer{nullptr},
+                                                                        texture{nullptr}, texture_width{0},
+                                                                        texture_height{0} {
+    window = SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height,
+                              SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+    if (!window)
+        throw std::runtime_error(std::string("No window: ") + SDL_GetError());
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    if (!renderer) {
+        SDL_DestroyWindow(window);
+        throw std::runtime_error(std::string("No renderer: ") + SDL_GetError());
+    }
+}
+
+SdlCanvas::~SdlCanvas() {
+    if (texture)
+        SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+}
+
+int SdlCanvas::get_width() const {
+    int width, height;
+    SDL_GetRendererOutputSize(renderer, &width, &height);
+    return width;
+}
+
+int SdlCanvas::get_height() const {
+    int width, height;
+    SDL_GetRendererOutputSize(renderer, &width, &height);
+    return height;
+}
+
+void SdlCanvas::clear(Color color) {
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+    SDL_RenderClear(renderer);
+}
+
+void SdlCanvas::draw_lines(const CanvasPoint *points, std::size_t count, Color color) {
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+    SDL_RenderDrawLines(renderer, reinterpret_cast<const SDL_Point *>(points), int(count));
+}
+
+void SdlCanvas::draw_segments(const CanvasPoint *points, std::size_t count, Color color) {
+    SDL_Rect bounds{0, 0, get_width(), get_height()};
+    segment_points.clear();
+    for (std::size_t i = 0; i + 1 < count; i += 2) {
+        int x = points[i].x, y = points[i].y, x1 = points[i + 1].x, y1 = points[i + 1].y;
+        if (!SDL_IntersectRectAndLine(&bounds, &x, &y, &x1, &y1))
+            continue;
+        /* Bresenham */
+        int sx = x < x1 ? 1 : -1, sy = y < y1 ? 1 : -1;
+        int ex = std::abs(x1 - x), ey = -std::abs(y1 - y), error = ex + ey;
+        while (true) {
+            segment_points.push_back(SDL_Point{x, y});
+            if (x == x1 && y == y1)
+                break;
+            int twice = 2 * error;
+            if (twice >= ey) {
+                error += ey;
+                x += sx;
+            }
+            if (twice <= ex) {
+                error += ex;
+                y += sy;
+            }
+        }
+    }
+    if (segment_points.empty())
+        return;
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+    SDL_RenderDrawPoints(renderer, segment_points.data(), int(segment_points.size()));
+}
+
+void SdlCanvas::draw_image(const Color *pixels, int width, int height) {
+    if (width <= 0 || height <= 0)
+        return;
+    if (!texture || width != texture_width || height != texture_height) {
+        if (texture)
+            SDL_DestroyTexture(texture);
+        /* RGBA32 is the byte order R, G, B, A whatever the endianness, the layout of Color */
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, width, height);
+        if (!texture)
+            throw std::runtime_error(std::string("No texture: ") + SDL_GetError());
+        texture_width = width;
+        texture_height = height;
+    }
+    SDL_UpdateTexture(texture, nullptr, pixels, width * int(sizeof(Color)));
+    SDL_Rect target{0, 0, width, height};
+    SDL_RenderCopy(renderer, texture, nullptr, &target);
+}
+
+void SdlCanvas::present() {
+    SDL_RenderPresent(renderer);
+}
+
+SDL_Window *SdlCanvas::get_window() const {
+    return window;
+}
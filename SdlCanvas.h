@@ -0,0 +1,86 @@
+#ifndef C11NHF_SDLCANVAS_H
+#define C11NHF_SDLCANVAS_H
+#include <string>
+#include <vector>
+#include <SDL2/SDL.h>
+#include "Canvas.h"
+
+/**
+ * Canvas of a resizable SDL window. The window and its renderer are created once and kept for the lifetime of the object,
+ * so redrawing costs only the drawing itself. SDL has to be initialised before construction.
+ */
+class SdlCanvas : public Canvas {
+public:
+    /**
+     * Opens the window, it can be resized by the user.
+     * @param title title of the window
+     * @param width initial width in pixels
+     * @param height initial height in pixels
+     * @throws std::runtime_error if the window or the renderer can't be created
+     */
+    SdlCanvas(const std::string &title, int width, int height);
+
+    SdlCanvas(const SdlCanvas &) = delete;
+
+    SdlCanvas &operator=(const SdlCanvas &) = delete;
+
+    /**
+     * Destroys the texture and the renderer and closes the window.
+     */
+    ~SdlCanvas();
+
+    /**
+     * Returns the width of the renderer's output, the real size of the window.
+     * @see Canvas::get_width()
+     */
+    int get_width() const override;
+
+    /**
+     * @see Canvas::get_height()
+     */
+    int get_height() const override;
+
+    /**
+     * @see Canvas::clear()
+     */
+    void clear(Color color) override;
+
+    /**
+     * Submits the whole line in one SDL_RenderDrawLines call.
+     * @see Canvas::draw_lines()
+     */
+    void draw_lines(const CanvasPoint *points, std::size_t count, Color color) override;
+
+    /**
+     * SDL has no call for separate segments, so they are clipped to the window, rasterized into a buffer of points
+     * kept between frames, and the points are submitted in one SDL_RenderDrawPoints call.
+     * @see Canvas::draw_segments()
+     */
+    void draw_segments(const CanvasPoint *points, std::size_t count, Color color) override;
+
+    /**
+     * Streams the image into a texture kept between frames, recreated only when the size of the image changes.
+     * @see Canvas::draw_image()
+     */
+    void draw_image(const Color *pixels, int width, int height) override;
+
+    /**
+     * @see Canvas::present()
+     */
+    void present() override;
+
+    /**
+     * Returns the window, e.g. to match its events.
+     * @return the window of the canvas
+     */
+    SDL_Window *get_window() const;
+
+private:
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    int texture_width, texture_height;
+    std::vector<SDL_Point> segment_points;
+};
+
+#endif //C11NHF_SDLCANVAS_H
@@ -0,0 +1,386 @@
+#include <stdexcept>
+#include <cstring>
+#include <typeinfo>
+#include <utility>
+#include <math.h>
+#include "Simplifier.h"
+
+/**
+ * Upper bound of the passes, a safety net only: the rules reach their fixpoint in one pass on every tree
+ * the parser can produce, the second pass just confirms it.
+ */
+static const int MAX_PASSES = 8;
+
+/**
+ * Returns the operator of a node, 0 if it is not a TwoOperand.
+ */
+static char operator_of(const Expression *exp) {
+    return exp->shape() == Expression::Shape::BINARY ? static_cast<const TwoOperand *>(exp)->get_operator() : 0;
+}
+
+/**
+ * Returns whether the node is a Constant of the given value.
+ */
+static bool is_constant(const Expression *exp, double value) {
+    const Constant *cons = dynamic_cast<const Constant *>(exp);
+    return cons && cons->get_value() == value;
+}
+
+void Simplifier::run(std::unique_ptr<Expression> &exp) {
+    try {
+        rewrite(exp);
+        std::uint64_t hash = structure_hash(*exp);
+        for (int pass = 1; pass < MAX_PASSES; pass++) {
+            rewrite(exp);
+            std::uint64_t next = structure_hash(*exp);
+            if (next == hash)
+                break;
+            hash = next;
+        }
+    } catch (...) {
+        exp.reset();
+        release();
+        throw;
+    }
+    release();
+}
+
+void Simplifier::release() {
+    steps.clear();
+    chains.clear();
+    terms.clear();
+    sum_pool.clear();
+    dif_pool.clear();
+    prod_pool.clear();
+    div_pool.clear();
+    constant_pool.clear();
+}
+
+void Simplifier::push(Step::Action action, std::unique_ptr<Expression> *slot) {
+    steps.push_back(Step{action, slot, nullptr, false, false});
+}
+
+void Simplifier::push_collect(std::unique_ptr<Expression> &&item, bool inverted, bool simplified) {
+    steps.push_back(Step{Step::COLLECT, nullptr, std::move(item), inverted, simplified});
+}
+
+void Simplifier::rewrite(std::unique_ptr<Expression> &slot) {
+    push(Step::REWRITE, &slot);
+    while (!steps.empty()) {
+        Step &step = steps.back();
+        Step::Action action = step.action;
+        std::unique_ptr<Expression> *target = step.slot;
+        if (action == Step::COLLECT) {
+            std::unique_ptr<Expression> item = std::move(step.item);
+            bool inverted = step.inverted, simplified = step.simplified;
+            steps.pop_back();
+            collect(item, inverted, simplified);
+            continue;
+        }
+        steps.pop_back();
+        switch (action) {
+            case Step::REWRITE:
+                rewrite_step(*target);
+                break;
+            case Step::FINISH_POWER:
+                finish_power(*target);
+                break;
+            case Step::FINISH_FUNCTION:
+                finish_function(*target);
+                break;
+            case Step::FINISH_SUM:
+                finish_sum(*target);
+                break;
+            default:
+                finish_product(*target);
+                break;
+        }
+    }
+}
+
+void Simplifier::rewrite_step(std::unique_ptr<Expression> &slot) {
+    switch (operator_of(slot.get())) {
+        case '+':
+        case '-':
+            begin_chain(slot, false, false);
+            return;
+        case '*':
+        case '/':
+            begin_chain(slot, true, false);
+            return;
+        case '^': {
+            TwoOperand *op = static_cast<TwoOperand *>(slot.get());
+            push(Step::FINISH_POWER, &slot);
+            push(Step::REWRITE, &op->rhs);
+            push(Step::REWRITE, &op->lhs);
+            return;
+        }
+        case 0:
+            if (slot->shape() == Expression::Shape::CALL) {
+                Function *func = static_cast<Function *>(slot.get());
+                push(Step::FINISH_FUNCTION, &slot);
+                push(Step::REWRITE, &func->arg);
+            }
+            return;
+        default: {
+            TwoOperand *op = static_cast<TwoOperand *>(slot.get());
+            push(Step::REWRITE, &op->rhs);
+            push(Step::REWRITE, &op->lhs);
+            return;
+        }
+    }
+}
+
+void Simplifier::begin_chain(std::unique_ptr<Expression> &slot, bool multiplicative, bool simplified) {
+    chains.push_back(Chain{terms.size(), multiplicative, multiplicative ? 1.0 : 0.0, 1.0, false});
+    push(multiplicative ? Step::FINISH_PRODUCT : Step::FINISH_SUM, &slot);
+    push_collect(std::move(slot), false, simplified);
+}
+
+void Simplifier::collect(std::unique_ptr<Expression> &item, bool inverted, bool simplified) {
+    Chain &chain = chains.back();
+    char op = operator_of(item.get());
+    bool nested = chain.multiplicative ? op == '*' || op == '/' : op == '+' || op == '-';
+    if (!nested && !simplified) {   /* rewrite the term first, then collect it again */
+        push_collect(std::move(item), inverted, true);
+        push(Step::REWRITE, &steps.back().item);
+        return;
+    }
+    if (nested) {   /* nested chain: splice its terms, the left ones first */
+        TwoOperand *node = static_cast<TwoOperand *>(item.get());
+        std::unique_ptr<Expression> lhs = std::move(node->lhs), rhs = std::move(node->rhs);
+        recycle(item);
+        push_collect(std::move(rhs), op == '-' || op == '/' ? !inverted : inverted, simplified);
+        push_collect(std::move(lhs), inverted, simplified);
+        return;
+    }
+    if (Constant *cons = dynamic_cast<Constant *>(item.get())) {
+        if (!chain.multiplicative)   /* c + c = C */
+            chain.constant = inverted ? chain.constant - cons->get_value() : chain.constant + cons->get_value();
+        else if (!inverted)   /* c * c = C */
+            chain.constant *= cons->get_value();
+        else if (cons->get_value() == 0.0)
+            chain.zero_denominator = true;
+        else
+            chain.denominator *= cons->get_value();
+        recycle(item);
+        return;
+    }
+    if (!chain.multiplicative && op == '*' &&
+        is_constant(static_cast<TwoOperand *>(item.get())->rhs.get(), -1.0)) {   /* a + b * -1 = a - b */
+        TwoOperand *neg = static_cast<TwoOperand *>(item.get());
+        std::unique_ptr<Expression> inner = std::move(neg->lhs);
+        recycle(neg->rhs);
+        recycle(item);
+        push_collect(std::move(inner), !inverted, true);
+        return;
+    }
+    terms.push_back(Term{inverted, std::move(item)});
+}
+
+void Simplifier::finish_sum(std::unique_ptr<Expression> &slot) {
+    std::size_t base = chains.back().base;
+    double constant = chains.back().constant;
+    chains.pop_back();
+    std::unique_ptr<Expression> positive = join(base, false, false);
+    std::unique_ptr<Expression> negative = join(base, true, false);
+    terms.resize(base);
+    std::unique_ptr<Expression> result;
+    if (positive) {
+        result = std::move(positive);
+        if (negative)
+            result = make_operator('-', std::move(result), std::move(negative));
+        if (constant > 0.0)   /* a + 0 = a */
+            result = make_operator('+', std::move(result), make_constant(constant));
+        else if (constant < 0.0 || constant != constant)
+            result = make_operator('-', std::move(result), make_constant(-constant));
+    } else if (negative) {
+        if (constant == 0.0) {   /* 0 - a = -1 * a */
+            slot = make_operator('*', std::move(negative), make_constant(-1.0));
+            begin_chain(slot, true, true);
+            return;
+        }
+        result = make_operator('-', make_constant(constant), std::move(negative));
+    } else {
+        result = make_constant(constant);
+    }
+    slot = std::move(result);
+}
+
+void Simplifier::finish_product(std::unique_ptr<Expression> &slot) {
+    Chain chain = chains.back();
+    chains.pop_back();
+    std::size_t base = chain.base;
+    double numerator = chain.constant, denominator = chain.denominator;
+    if (numerator == 0.0) {   /* 0 * a = 0, 0 / a = 0 */
+        terms.resize(base);
+        slot = make_constant(0.0);
+        return;
+    }
+    if (chain.zero_denominator) {   /* a / 0  = ERR */
+        terms.resize(base);
+        throw std::runtime_error("Division by 0!");
+    }
+    std::unique_ptr<Expression> upper = join(base, false, true);
+    std::unique_ptr<Expression> lower = join(base, true, true);
+    terms.resize(base);
+    double quotient = numerator / denominator;
+    if (fma(quotient, denominator, -numerator) == 0.0) {   /* a * c / c = a * C, if C is exact */
+        numerator = quotient;
+        denominator = 1.0;
+    }
+    if (!upper && !lower) {
+        slot = make_constant(numerator / denominator);
+        return;
+    }
+    if (!upper)
+        upper = make_constant(numerator);
+    else if (numerator != 1.0)   /* a * 1 = a */
+        upper = make_operator('*', std::move(upper), make_constant(numerator));
+    if (lower && denominator != 1.0)
+        lower = make_operator('*', std::move(lower), make_constant(denominator));
+    else if (!lower && denominator != 1.0)
+        lower = make_constant(denominator);
+    slot = lower ? make_operator('/', std::move(upper), std::move(lower)) : std::move(upper);
+}
+
+void Simplifier::finish_power(std::unique_ptr<Expression> &slot) {
+    TwoOperand *op = static_cast<TwoOperand *>(slot.get());
+    Constant *lhs_cons = dynamic_cast<Constant *>(op->lhs.get());
+    Constant *rhs_cons = dynamic_cast<Constant *>(op->rhs.get());
+    if (lhs_cons && lhs_cons->get_value() == 1.0) {  /* 1 ^ a = 1 */
+        slot = std::move(op->lhs);
+    } else if (rhs_cons && rhs_cons->get_value() == 1.0) {  /* a ^ 1 = a */
+        slot = std::move(op->lhs);
+    } else if (rhs_cons && rhs_cons->get_value() == 0.0) {  /* a ^ 0 = 1 */
+        rhs_cons->c = 1.0;
+        slot = std::move(op->rhs);
+    } else if (lhs_cons && rhs_cons) {   /* c ^ c = C */
+        lhs_cons->c = op->do_operator(lhs_cons->get_value(), rhs_cons->get_value());
+        slot = std::move(op->lhs);
+    }
+}
+
+void Simplifier::finish_function(std::unique_ptr<Expression> &slot) {
+    Function *func = static_cast<Function *>(slot.get());
+    if (Constant *cons = dynamic_cast<Constant *>(func->arg.get())) {   /* f(c) = C */
+        cons->c = func->entry->scalar(cons->get_value());
+        slot = std::move(func->arg);
+    }
+}
+
+std::unique_ptr<Expression> Simplifier::join(std::size_t base, bool inverted, bool multiplicative) {
+    std::unique_ptr<Expression> chain;
+    for (std::size_t i = base; i < terms.size(); i++) {
+        if (terms[i].inverted != inverted || !terms[i].exp)
+            continue;
+        if (chain)
+            chain = make_operator(multiplicative ? '*' : '+', std::move(chain), std::move(terms[i].exp));
+        else
+            chain = std::move(terms[i].exp);
+    }
+    return chain;
+}
+
+/**
+ * Takes a node from a pool, or allocates one if the pool is empty.
+ */
+template<typename T>
+static std::unique_ptr<T> take(std::vector<std::unique_ptr<T>> &pool, std::unique_ptr<Expression> &&lhs,
+                               std::unique_ptr<Expression> &&rhs) {
+    if (pool.empty())
+        return std::unique_ptr<T>(new T{std::move(lhs), std::move(rhs)});
+    std::unique_ptr<T> node = std::move(pool.back());
+    pool.pop_back();
+    node->lhs = std::move(lhs);
+    node->rhs = std::move(rhs);
+    return node;
+}
+
+std::unique_ptr<Expression> Simplifier::make_operator(char op, std::unique_ptr<Expression> &&lhs,
+                                                      std::unique_ptr<Expression> &&rhs) {
+    switch (op) {
+        case '+':
+            return take(sum_pool, std::move(lhs), std::move(rhs));
+        case '-':
+            return take(dif_pool, std::move(lhs), std::move(rhs));
+        case '*':
+            return take(prod_pool, std::move(lhs), std::move(rhs));
+        default:
+            return take(div_pool, std::move(lhs), std::move(rhs));
+    }
+}
+
+std::unique_ptr<Expression> Simplifier::make_constant(double value) {
+    if (constant_pool.empty())
+        return std::unique_ptr<Expression>(new Constant{value});
+    std::unique_ptr<Constant> node = std::move(constant_pool.back());
+    constant_pool.pop_back();
+    node->c = value;
+    return std::move(node);
+}
+
+void Simplifier::recycle(std::unique_ptr<Expression> &slot) {
+    Expression *exp = slot.release();
+    const std::type_info &type = typeid(*exp);
+    if (type == typeid(Sum))
+        sum_pool.push_back(std::unique_ptr<Sum>(static_cast<Sum *>(exp)));
+    else if (type == typeid(Dif))
+        dif_pool.push_back(std::unique_ptr<Dif>(static_cast<Dif *>(exp)));
+    else if (type == typeid(Prod))
+        prod_pool.push_back(std::unique_ptr<Prod>(static_cast<Prod *>(exp)));
+    else if (type == typeid(Div))
+        div_pool.push_back(std::unique_ptr<Div>(static_cast<Div *>(exp)));
+    else if (type == typeid(Constant))
+        constant_pool.push_back(std::unique_ptr<Constant>(static_cast<Constant *>(exp)));
+    else
+        delete exp;
+}
+
+std::uint64_t Simplifier::structure_hash(const Expression &exp) {
+    /* post-order walk: a node is taken once to push its operands, and once more to combine their hashes */
+    std::vector<std::pair<const Expression *, bool>> &walk = hash_walk;
+    std::vector<std::uint64_t> &hashes = hash_values;
+    walk.push_back(std::make_pair(&exp, false));
+    while (!walk.empty()) {
+        const Expression *node = walk.back().first;
+        bool combine = walk.back().second;
+        walk.pop_back();
+        Expression::Shape shape = node->shape();
+        const TwoOperand *op = shape == Expression::Shape::BINARY ? static_cast<const TwoOperand *>(node) : nullptr;
+        const Function *func = shape == Expression::Shape::CALL ? static_cast<const Function *>(node) : nullptr;
+        if (!combine && (op || func)) {
+            walk.push_back(std::make_pair(node, true));
+            if (op) {
+                walk.push_back(std::make_pair(op->rhs.get(), false));
+                walk.push_back(std::make_pair(op->lhs.get(), false));
+            } else {
+                walk.push_back(std::make_pair(func->arg.get(), false));
+            }
+            continue;
+        }
+        std::uint64_t h;
+        if (op) {
+            std::uint64_t rhs = hashes.back();
+            hashes.pop_back();
+            h = hashes.back() * 31 + rhs;
+            hashes.pop_back();
+            h = h * 0x9E3779B97F4A7C15ULL + std::uint64_t(op->get_operator());
+        } else if (func) {
+            h = hashes.back() * 0x9E3779B97F4A7C15ULL + std::hash<std::string>()(func->entry->name);
+            hashes.pop_back();
+        } else if (const Constant *cons = dynamic_cast<const Constant *>(node)) {
+            double value = cons->get_value();
+            std::memcpy(&h, &value, sizeof h);
+            h ^= 0x5851F42D4C957F2DULL;
+        } else if (const Variable *var = dynamic_cast<const Variable *>(node)) {
+            h = 0x2545F4914F6CDD1DULL + var->slot * 0x9E3779B97F4A7C15ULL;
+        } else {
+            h = 0x27BB2EE687B0B0FDULL;
+        }
+        hashes.push_back(h ^ (h >> 31));
+    }
+    std::uint64_t hash = hashes.back();
+    hashes.pop_back();
+    return hash;
+}
@@ -0,0 +1,183 @@
+#ifndef C11NHF_SIMPLIFIER_H
+#define C11NHF_SIMPLIFIER_H
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Expressions.h"
+
+/**
+ * Rule-driven rewrite engine behind Expression::simplify(). It works on the tree in place: nodes are inspected
+ * where they are, moved between places instead of being cloned, and nodes made redundant are kept in pools and
+ * reused for the rebuilt parts, so a pass allocates nothing once its scratch buffers have grown.
+ *
+ * Chains of + and - (and of * and /) are flattened into a list of terms (factors), whatever their nesting, the
+ * constants among them are folded into one, and the chain is rebuilt left-deep with the positive terms first,
+ * the negative ones next and the folded constant last. This collapses (X+2)+3 to X+5 and 2*(3*X) to X*6. The
+ * constants of the numerator and of the denominator of a * / chain are folded into one if their quotient is exact,
+ * so 2*(3*(X*4))/8 becomes X*3, while X/3 stays a division.
+ * Besides, the rules of the original simplify() apply: a+0, a*1, a*0, 0/a, a^1, a^0, 1^a, c^c, and functions of
+ * constants are computed. A division by a constant 0 throws std::runtime_error, as before.
+ *
+ * Passes are repeated until the tree no longer changes; every pass is linear in the size of the tree. The pooled
+ * nodes are freed at the end of run(), the buffers are kept, so one Simplifier can be reused for many trees.
+ * A pass is a loop over a stack of steps rather than a recursion, so trees of any depth can be simplified, like
+ * the left-deep chain of a generated sum of a million terms.
+ */
+class Simplifier {
+public:
+    /**
+     * Simplifies the tree to a fixpoint.
+     * @param exp tree to simplify, replaced by its simplified form. If an exception is thrown, it is left empty.
+     */
+    void run(std::unique_ptr<Expression> &exp);
+
+private:
+    /**
+     * A term of a flattened chain with its sign (or a factor with its exponent's sign).
+     */
+    struct Term {
+        bool inverted;
+        std::unique_ptr<Expression> exp;
+    };
+
+    /**
+     * A step of a pass.
+     */
+    struct Step {
+        enum Action : unsigned char {
+            REWRITE,         /**< run the rules on the subtree of slot */
+            FINISH_POWER,    /**< apply the rules of ^ to slot, whose operands have been rewritten */
+            FINISH_FUNCTION, /**< apply the rule of functions to slot, whose argument has been rewritten */
+            COLLECT,         /**< move item to the terms of the innermost chain, splicing it if it is a chain */
+            FINISH_SUM,      /**< rebuild the innermost chain, a + - chain, into slot */
+            FINISH_PRODUCT   /**< rebuild the innermost chain, a * / chain, into slot */
+        } action;
+        std::unique_ptr<Expression> *slot;
+
+        /**
+         * Term to collect; the REWRITE step of a term that is to be rewritten first points here.
+         */
+        std::unique_ptr<Expression> item;
+
+        /**
+         * Sign of the term to collect.
+         */
+        bool inverted;
+
+        /**
+         * Whether the term to collect has already been rewritten.
+         */
+        bool simplified;
+    };
+
+    /**
+     * A chain whose terms are being collected.
+     */
+    struct Chain {
+        /**
+         * Index of its first term.
+         */
+        std::size_t base;
+        bool multiplicative;
+
+        /**
+         * Sum of the constants of a + - chain, product of the constants in the numerator of a * / chain.
+         */
+        double constant;
+        double denominator;
+        bool zero_denominator;
+    };
+
+    /**
+     * Steps of the pass, a deque so the items the REWRITE steps point to stay in place.
+     */
+    std::deque<Step> steps;
+    std::vector<Chain> chains;
+    std::vector<Term> terms;
+
+    /**
+     * Scratch of structure_hash(): the nodes to visit, each with whether its operands are hashed already, and the
+     * hashes of the subtrees visited.
+     */
+    std::vector<std::pair<const Expression *, bool>> hash_walk;
+    std::vector<std::uint64_t> hash_values;
+    std::vector<std::unique_ptr<Sum>> sum_pool;
+    std::vector<std::unique_ptr<Dif>> dif_pool;
+    std::vector<std::unique_ptr<Prod>> prod_pool;
+    std::vector<std::unique_ptr<Div>> div_pool;
+    std::vector<std::unique_ptr<Constant>> constant_pool;
+
+    /**
+     * Runs one bottom-up pass of the rules over a tree.
+     * @param slot owner of the tree, receives the rewritten tree
+     */
+    void rewrite(std::unique_ptr<Expression> &slot);
+
+    void push(Step::Action action, std::unique_ptr<Expression> *slot);
+
+    void push_collect(std::unique_ptr<Expression> &&item, bool inverted, bool simplified);
+
+    /**
+     * Schedules the rewrite of a subtree: chains are flattened, the operands of the other nodes rewritten first.
+     */
+    void rewrite_step(std::unique_ptr<Expression> &slot);
+
+    /**
+     * Schedules the flattening of a chain into the term list and its rebuilding into slot.
+     * @param slot owner of the chain
+     * @param multiplicative whether it is a * / chain
+     * @param simplified whether the terms have already been rewritten, only the chain itself is rebuilt then
+     */
+    void begin_chain(std::unique_ptr<Expression> &slot, bool multiplicative, bool simplified);
+
+    /**
+     * Moves a term or factor to the term list, folding the constants into the innermost chain, or schedules the
+     * terms of a nested chain.
+     * @param item chain or term, emptied
+     * @param inverted whether the term is subtracted, or the factor is in the denominator
+     * @param simplified whether the term has already been rewritten
+     */
+    void collect(std::unique_ptr<Expression> &item, bool inverted, bool simplified);
+
+    void finish_sum(std::unique_ptr<Expression> &slot);
+
+    void finish_product(std::unique_ptr<Expression> &slot);
+
+    void finish_power(std::unique_ptr<Expression> &slot);
+
+    void finish_function(std::unique_ptr<Expression> &slot);
+
+    /**
+     * Joins the terms above base to a left-deep chain of + or * nodes, and removes them from the list.
+     * @param base index of the first term to join
+     * @param inverted join the terms of this sign only
+     * @param multiplicative join with * instead of +
+     * @return the chain, nullptr if there was no such term
+     */
+    std::unique_ptr<Expression> join(std::size_t base, bool inverted, bool multiplicative);
+
+    std::unique_ptr<Expression> make_constant(double value);
+
+    std::unique_ptr<Expression> make_operator(char op, std::unique_ptr<Expression> &&lhs,
+                                              std::unique_ptr<Expression> &&rhs);
+
+    /**
+     * Moves a chain node, whose children have been moved out, to the pool of its type.
+     */
+    void recycle(std::unique_ptr<Expression> &slot);
+
+    /**
+     * Frees the pooled nodes, the terms and the steps left over, keeping the capacity of the buffers.
+     */
+    void release();
+
+    /**
+     * Hashes the structure of a tree, to detect whether a pass changed anything.
+     */
+    std::uint64_t structure_hash(const Expression &exp);
+};
+
+#endif //C11NHF_SIMPLIFIER_H
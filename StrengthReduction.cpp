@@ -0,0 +1,102 @@
+#include <vector>
+#include <math.h>
+#include "StrengthReduction.h"
+#include "Parser.h"
+
+const int StrengthReduction::MAX_POWER;
+const int StrengthReduction::MAX_EXPANSION;
+
+StrengthReduction::StrengthReduction(bool fast_math) : fast_math{fast_math} { }
+
+void StrengthReduction::run(std::unique_ptr<Expression> &exp) const {
+    /* post-order with an explicit stack: an operator is reduced once its operands are, whatever the depth */
+    struct Step {
+        std::unique_ptr<Expression> *slot;
+        bool operands_done;
+    };
+    std::vector<Step> steps{Step{&exp, false}};
+    while (!steps.empty()) {
+        Step step = steps.back();
+        steps.pop_back();
+        if (step.operands_done) {
+            char op = static_cast<TwoOperand *>(step.slot->get())->get_operator();
+            if (op == '^')
+                reduce_power(*step.slot);
+            else if (op == '/')
+                reduce_division(*step.slot);
+        } else if (Function *func = dynamic_cast<Function *>(step.slot->get())) {
+            steps.push_back(Step{&func->arg, false});
+        } else if (TwoOperand *op = dynamic_cast<TwoOperand *>(step.slot->get())) {
+            steps.push_back(Step{step.slot, true});
+            steps.push_back(Step{&op->rhs, false});
+            steps.push_back(Step{&op->lhs, false});
+        }
+    }
+}
+
+void StrengthReduction::reduce_power(std::unique_ptr<Expression> &slot) const {
+    TwoOperand *op = static_cast<TwoOperand *>(slot.get());
+    const Constant *exponent = dynamic_cast<const Constant *>(op->rhs.get());
+    if (!exponent)
+        return;
+    double n = exponent->get_value();
+    std::unique_ptr<Expression> reduced;
+    if (n == 0.5 || n == -0.5) {   /* a^0.5 = sqrt(a) */
+        reduced.reset(new Function{std::move(op->lhs), FunctionRegistry::global().get(FunctionRegistry::SQRT)});
+    } else if (n == floor(n) && fabs(n) <= MAX_POWER && n != 0.0 && n != 1.0) {   /* a^n = a*a*...*a */
+        unsigned count = unsigned(fabs(n));
+        if (count > 1 && expansion_cost(*op->lhs) * int(count) > MAX_EXPANSION)
+            return;
+        reduced = power_chain(*op->lhs, count);
+    } else {
+        return;
+    }
+    if (n < 0.0)
+        reduced.reset(new Div{std::unique_ptr<Expression>(new Constant{1.0}), std::move(reduced)});
+    slot = std::move(reduced);
+}
+
+void StrengthReduction::reduce_division(std::unique_ptr<Expression> &slot) const {
+    TwoOperand *op = static_cast<TwoOperand *>(slot.get());
+    const Constant *divisor = dynamic_cast<const Constant *>(op->rhs.get());
+    if (!divisor)
+        return;
+    double c = divisor->get_value();
+    double reciprocal = 1.0 / c;
+    if (c == 0.0 || !isfinite(c) || reciprocal == 0.0 || !isfinite(reciprocal))
+        return;
+    int exponent;
+    bool exact = fabs(frexp(c, &exponent)) == 0.5 && fabs(frexp(reciprocal, &exponent)) == 0.5;
+    if (!exact && !fast_math)
+        return;
+    slot.reset(new Prod{std::move(op->lhs), std::unique_ptr<Expression>(new Constant{reciprocal})});
+}
+
+std::unique_ptr<Expression> StrengthReduction::power_chain(const Expression &base, unsigned n) {
+    if (n == 1)
+        return std::unique_ptr<Expression>(base.clone());
+    std::unique_ptr<Expression> half = power_chain(base, n / 2);
+    std::unique_ptr<Expression> square{new Prod{std::unique_ptr<Expression>(half->clone()), std::move(half)}};
+    if (n % 2 == 0)
+        return square;
+    return std::unique_ptr<Expression>(new Prod{std::move(square), std::unique_ptr<Expression>(base.clone())});
+}
+
+int StrengthReduction::expansion_cost(const Expression &exp) {
+    /* counted with an explicit stack, which stops as soon as the count is over the limit */
+    std::vector<const Expression *> pending{&exp};
+    int cost = 0;
+    while (!pending.empty() && cost <= MAX_EXPANSION) {
+        const Expression *node = pending.back();
+        pending.pop_back();
+        cost++;
+        if (dynamic_cast<const Constant *>(node) || dynamic_cast<const Variable *>(node))
+            continue;
+        const TwoOperand *op = dynamic_cast<const TwoOperand *>(node);
+        if (!op || op->get_operator() == '^')
+            return MAX_EXPANSION + 1;
+        pending.push_back(op->rhs.get());
+        pending.push_back(op->lhs.get());
+    }
+    return cost;
+}
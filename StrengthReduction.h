@@ -0,0 +1,69 @@
+#ifndef C11NHF_STRENGTHREDUCTION_H
+#define C11NHF_STRENGTHREDUCTION_H
+#include <memory>
+#include "Expressions.h"
+
+/**
+ * Optimization pass replacing the expensive operators of a tree by cheaper equivalents:
+ * - a^n for an integer 2 <= |n| <= MAX_POWER becomes a balanced product (a*a)*(a*a)..., built by square-and-multiply,
+ *   and 1/(...) for negative n, as long as a is cheap to evaluate again (see MAX_EXPANSION). a^-1 becomes 1/a.
+ *   In a tree the base is evaluated n times; ExpressionDag shares the squares, so there it is evaluated once and
+ *   x^n costs about log2(n) multiplications.
+ * - a^0.5 becomes sqrt(a), a^-0.5 becomes 1/sqrt(a).
+ * - a/c becomes a*(1/c) if c is a power of two, since 1/c is exact then. For other constants only in fast math mode.
+ *
+ * Accuracy, measured against Expression::evaluate() of the original tree, for results in the normal range:
+ * - a^n: at most |n| ULP off, the multiplications round |n|-1 times (one more for the division) where pow rounds once.
+ * - a^0.5: identical, both are correctly rounded, except that sqrt(-0) is -0 and sqrt(-inf) is NaN where pow gives
+ *   +0 and +inf. a^-0.5 is at most 1 ULP off.
+ * - a/c with c a power of two: identical.
+ * - a/c in fast math mode: at most 2 ULP off, 1/c is rounded once more.
+ * Values of the subexpressions are not affected, so the bounds hold for the node rewritten; errors of several rewritten
+ * nodes compound like any other rounding error.
+ */
+class StrengthReduction {
+public:
+    /**
+     * Largest |n| a^n is expanded for.
+     */
+    static const int MAX_POWER = 16;
+
+    /**
+     * Largest number of base nodes an expanded power may contain, |n| * size of the base. Bases containing functions
+     * or powers are never duplicated.
+     */
+    static const int MAX_EXPANSION = 32;
+
+    /**
+     * @param fast_math whether division by any constant may be replaced by multiplication with its reciprocal
+     */
+    explicit StrengthReduction(bool fast_math = false);
+
+    /**
+     * Rewrites the tree in place.
+     * @param exp tree to optimize, replaced by its optimized form
+     */
+    void run(std::unique_ptr<Expression> &exp) const;
+
+private:
+    bool fast_math;
+
+    void reduce_power(std::unique_ptr<Expression> &slot) const;
+
+    void reduce_division(std::unique_ptr<Expression> &slot) const;
+
+    /**
+     * Builds base^n as a product tree by square-and-multiply.
+     * @param base the base, copied n times
+     * @param n exponent, at least 1
+     */
+    static std::unique_ptr<Expression> power_chain(const Expression &base, unsigned n);
+
+    /**
+     * Returns the number of nodes of a tree of + - * / nodes, variables and constants, or MAX_EXPANSION + 1 if it
+     * contains anything else.
+     */
+    static int expansion_cost(const Expression &exp);
+};
+
+#endif //C11NHF_STRENGTHREDUCTION_H
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <exception>
+#include <math.h>
+#include "ThreadPool.h"
+
+/**
+ * Pool the current thread works for, nullptr if it is not a worker.
+ */
+static thread_local const ThreadPool *worker_pool = nullptr;
+
+/**
+ * Index of the queue of the current worker.
+ */
+static thread_local unsigned worker_index = 0;
+
+ThreadPool::ThreadPool(unsigned threads) : queued{0}, next_queue{0}, stopping{false} {
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threads; i++)
+        queues.push_back(std::unique_ptr<Queue>(new Queue));
+    for (unsigned i = 0; i < threads; i++)
+        workers.push_back(std::thread(&ThreadPool::work, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+unsigned ThreadPool::size() const {
+    return unsigned(queues.size());
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    unsigned index = own_queue();
+    if (index == size())
+        index = next_queue++ % size();
+    /* counted before it is published, so the run_one() taking it can't decrement the count below zero */
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        queued++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::parallel_for(std::size_t n, std::size_t grain,
+                              const std::function<void(std::size_t, std::size_t)> &body) {
+    if (n == 0)
+        return;
+    grain = std::max<std::size_t>(grain, 1);
+    /* remaining is only changed under done_mutex, so the caller can't return while a chunk is still notifying */
+    std::atomic<std::size_t> remaining{(n + grain - 1) / grain};
+    std::mutex done_mutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+    for (std::size_t begin = 0; begin < n; begin += grain) {
+        std::size_t end = std::min(n, begin + grain);
+        submit([&, begin, end]() {
+            std::exception_ptr thrown;
+            try {
+                body(begin, end);
+            } catch (...) {
+                thrown = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (thrown && !error)
+                error = thrown;
+            if (--remaining == 0)
+                done.notify_all();
+        });
+    }
+    /* the caller runs chunks instead of blocking, so nested calls from workers can't deadlock; once the queues are
+     * empty, every chunk has been taken, and it sleeps until the last one running is done */
+    unsigned own = own_queue();
+    while (remaining > 0)
+        if (!run_one(own))
+            break;
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done.wait(lock, [&remaining]() { return remaining == 0; });
+    if (error)
+        std::rethrow_exception(error);
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+bool ThreadPool::run_one(unsigned own) {
+    std::function<void()> task;
+    if (own < size()) {
+        std::lock_guard<std::mutex> lock(queues[own]->mutex);
+        if (!queues[own]->tasks.empty()) {
+            task = std::move(queues[own]->tasks.back());
+            queues[own]->tasks.pop_back();
+        }
+    }
+    for (unsigned k = 1; !task && k <= size(); k++) {
+        Queue &victim = *queues[(own + k) % size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task)
+        return false;
+    queued--;
+    task();
+    return true;
+}
+
+void ThreadPool::work(unsigned index) {
+    worker_pool = this;
+    worker_index = index;
+    while (true) {
+        if (run_one(index))
+            continue;
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this]() { return queued > 0 || stopping; });
+        if (stopping && queued == 0)
+            return;
+    }
+}
+
+unsigned ThreadPool::own_queue() const {
+    return worker_pool == this ? worker_index : size();
+}
+
+/**
+ * Places evaluated by one evaluate_batch() call of a chunk.
+ */
+static const std::size_t PARALLEL_BLOCK = 16 * Expression::BATCH_BLOCK;
+
+/**
+ * Places per task; large enough for the scheduling to be negligible, small enough for stealing to balance the load.
+ */
+static const std::size_t PARALLEL_GRAIN = 1 << 16;
+
+void parallelEvaluate(const Expression &exp, double x_min, double x_max, double *out, std::size_t n,
+                      ThreadPool &pool) {
+    double step = n > 1 ? (x_max - x_min) / double(n - 1) : 0.0;
+    pool.parallel_for(n, PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end) {
+        double xs[PARALLEL_BLOCK];
+        for (std::size_t i = begin; i < end; i += PARALLEL_BLOCK) {
+            std::size_t count = std::min(PARALLEL_BLOCK, end - i);
+            for (std::size_t k = 0; k < count; k++)
+                xs[k] = x_min + step * double(i + k);
+            exp.evaluate_batch(xs, out + i, count);
+        }
+    });
+}
+
+std::vector<double> parallelEvaluate(const Expression &exp, double x_min, double x_max, std::size_t n,
+                                     ThreadPool &pool) {
+    std::vector<double> out(n);
+    parallelEvaluate(exp, x_min, x_max, out.data(), n, pool);
+    return out;
+}
+
+/**
+ * Number of grid points a task of parallelEvaluateGrid() evaluates at least, in whole rows.
+ */
+static const std::size_t GRID_GRAIN = 1 << 14;
+
+double Grid::x(std::size_t column) const {
+    return x_min + (double(column) + 0.5) * (x_max - x_min) / double(width);
+}
+
+double Grid::y(std::size_t row) const {
+    return y_max - (double(row) + 0.5) * (y_max - y_min) / double(height);
+}
+
+void parallelEvaluateGrid(const Expression &exp, const Grid &grid, double *out, const std::vector<double> &values,
+                          ThreadPool &pool) {
+    if (grid.width == 0 || grid.height == 0)
+        return;
+    const std::size_t block = Expression::BATCH_BLOCK;
+    std::size_t slots = std::max<std::size_t>(values.size(), std::max(grid.x_slot, grid.y_slot) + 1);
+    std::vector<double> xs(grid.width);
+    for (std::size_t c = 0; c < grid.width; c++)
+        xs[c] = grid.x(c);
+    /* the other variables keep their value over the grid, a block of copies serves every row */
+    std::vector<std::vector<double>> constants(slots);
+    for (std::size_t k = 0; k < slots; k++)
+        if (k != grid.x_slot && k != grid.y_slot)
+            constants[k].assign(block, k < values.size() ? values[k] : NAN);
+    std::size_t grain = std::max<std::size_t>(1, GRID_GRAIN / grid.width);
+    pool.parallel_for(grid.height, grain, [&](std::size_t begin, std::size_t end) {
+        double ys[Expression::BATCH_BLOCK];
+        std::vector<const double *> columns(slots);
+        for (std::size_t k = 0; k < slots; k++)
+            columns[k] = constants[k].data();
+        columns[grid.y_slot] = ys;
+        for (std::size_t row = begin; row < end; row++) {
+            std::fill(ys, ys + block, grid.y(row));
+            double *line = out + row * grid.width;
+            for (std::size_t c = 0; c < grid.width; c += block) {
+                columns[grid.x_slot] = xs.data() + c;
+                exp.evaluate_block_slots(columns.data(), line + c, std::min(block, grid.width - c));
+            }
+        }
+    });
+}
@@ -0,0 +1,157 @@
+#ifndef C11NHF_THREADPOOL_H
+#define C11NHF_THREADPOOL_H
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Expressions.h"
+
+/**
+ * Fixed set of worker threads with work stealing. Every worker has a queue of its own: it takes its tasks from the
+ * back, and when it runs out it steals from the front of the others', so the load evens out even if the tasks
+ * have very different costs. Idle workers sleep.
+ */
+class ThreadPool {
+public:
+    /**
+     * Starts the workers.
+     * @param threads number of workers, the number of processors if 0
+     */
+    explicit ThreadPool(unsigned threads = 0);
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * Runs the tasks still queued, then stops the workers.
+     */
+    ~ThreadPool();
+
+    /**
+     * Returns the number of workers.
+     * @return number of workers
+     */
+    unsigned size() const;
+
+    /**
+     * Queues a task. A task submitted from a worker goes to that worker's queue, others are spread over the queues.
+     * @param task task to run, it must not throw
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * Runs body over [0, n) cut into chunks, and returns when every chunk is done. The calling thread runs chunks
+     * too, so it can be called from a task of the pool as well; once none is left to take, it sleeps until the ones
+     * still running on the workers are done.
+     * @param n size of the range
+     * @param grain size of a chunk, the last one may be shorter
+     * @param body called with the [begin, end) of every chunk, possibly from several threads at once
+     * @throws the first exception thrown by body, after every chunk has finished
+     */
+    void parallel_for(std::size_t n, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &body);
+
+    /**
+     * Returns a pool with a worker per processor, started on first use.
+     * @return the shared pool
+     */
+    static ThreadPool &shared();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> queued;
+    std::atomic<unsigned> next_queue;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    /**
+     * Runs one task: from the back of queue own, or stolen from the front of another one.
+     * @param own index of the queue of the calling worker, or size() for a thread outside the pool
+     * @return whether a task was run
+     */
+    bool run_one(unsigned own);
+
+    void work(unsigned index);
+
+    /**
+     * Returns the index of the queue of the calling thread, or size() if it is not a worker of this pool.
+     */
+    unsigned own_queue() const;
+};
+
+/**
+ * Evaluates an expression at evenly spaced places, x_min + i * (x_max - x_min) / (n - 1) for i < n, splitting the
+ * places among the threads of a pool. Each chunk is evaluated with Expression::evaluate_batch(), so the results are
+ * bit-identical to a single-threaded evaluate_batch(), and to Expression::evaluate() in the EXACT precision of
+ * FastMath only.
+ * Every node type can be evaluated concurrently, @see Expression.
+ * @param exp expression to evaluate
+ * @param x_min first place
+ * @param x_max last place
+ * @param out array of n values receiving the results
+ * @param n number of places
+ * @param pool pool to run on
+ */
+void parallelEvaluate(const Expression &exp, double x_min, double x_max, double *out, std::size_t n,
+                      ThreadPool &pool = ThreadPool::shared());
+
+/**
+ * Evaluates an expression at n evenly spaced places of [x_min, x_max] in parallel.
+ * @see parallelEvaluate()
+ * @return the n values
+ */
+std::vector<double> parallelEvaluate(const Expression &exp, double x_min, double x_max, std::size_t n,
+                                     ThreadPool &pool = ThreadPool::shared());
+
+/**
+ * Grid of width x height points of the plane, the centres of the pixels of an image showing [x_min, x_max] x
+ * [y_min, y_max]. Row 0 is the top one, at the largest y, as on a canvas.
+ */
+struct Grid {
+    double x_min, x_max, y_min, y_max;
+    std::size_t width, height;
+
+    /**
+     * Slots of the variables varying along the rows and along the columns, they must differ.
+     */
+    unsigned x_slot, y_slot;
+
+    /**
+     * Returns the x coordinate of a column.
+     */
+    double x(std::size_t column) const;
+
+    /**
+     * Returns the y coordinate of a row.
+     */
+    double y(std::size_t row) const;
+};
+
+/**
+ * Evaluates an expression of several variables at every point of a grid, splitting the rows among the threads of a
+ * pool. Every row is evaluated in blocks with Expression::evaluate_block_slots(), the x column being computed once
+ * for all rows, so in the EXACT precision of FastMath the results are bit-identical to calling
+ * Expression::evaluate_slots() for every point.
+ * @param exp expression to evaluate
+ * @param grid the points, and the slots of the two variables
+ * @param out array of width * height values receiving the results, row by row
+ * @param values values of the other variables, indexed by their slots; the entries of the grid's slots are ignored
+ * @param pool pool to run on
+ */
+void parallelEvaluateGrid(const Expression &exp, const Grid &grid, double *out,
+                          const std::vector<double> &values = std::vector<double>(),
+                          ThreadPool &pool = ThreadPool::shared());
+
+#endif //C11NHF_THREADPOOL_H
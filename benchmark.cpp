@@ -0,0 +1,2054 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <deque>
+#include <regex>
+#include <fstream>
+#include <cstring>
+#include <thread>
+#include <pthread.h>
+#include <math.h>
+#include "Expressions.h"
+#include "Parser.h"
+#include "StrengthReduction.h"
+#include "PolynomialDetector.h"
+#include "Sampler.h"
+#include "Plotter.h"
+#include "ImageCanvas.h"
+#include "ThreadPool.h"
+#include "ChebyshevProxy.h"
+#include "ExpressionArena.h"
+#include "ExpressionDag.h"
+#include "ExpressionSet.h"
+#include "CompiledExpression.h"
+#include "CompactExpression.h"
+#include "JitExpression.h"
+#include "BatchKernels.h"
+#include "BatchRunner.h"
+#include "FastMath.h"
+#include "FloatPrecision.h"
+using namespace std;
+
+/**
+ * The shunting-yard + RPN string + regex pipeline main.cpp used before parseExpression(), and the simplify() used
+ * before the Simplifier, kept as the baselines of the parser and simplifier benchmarks.
+ */
+namespace legacy {
+/**
+ * Converts an expression, which is in raw string format to valid Reverse Polish Notation form.
+ * @param exp the string to be parsed
+ * @return the expression in RPN form
+ */
+std::string parseString(string exp) {
+    deque<string> out;
+    deque<string> opStack;
+    deque<int> parenthesisStack;
+    stringstream ss;
+    string ret;
+    bool wasChar = false;
+    bool wasFunc=false;
+    string funcName;
+    for (auto it : exp) {
+        if (!(isdigit(it) || it=='.'))
+            wasChar = false;
+        if (isdigit(it) || it=='.') {
+            if (wasChar) {
+                out.pop_back();
+                string temp = out.back();
+                out.pop_back();
+                out.push_back(temp + string(1, it));
+            } else {
+                out.push_back(string(1, it));
+            }
+            out.push_back(" ");
+            wasChar = true;
+        } else if (it == '+' || it == '-') {
+            for (auto itOut: opStack) {
+                if (!itOut.compare("+") || !itOut.compare("-") || !itOut.compare("*") || !itOut.compare("/") ||
+                    !itOut.compare("^")) {
+                    out.push_back(opStack.front());
+                    out.push_back(" ");
+                    opStack.pop_front();
+                } else
+                    break;
+            }
+            opStack.push_front(string(1, it));
+        } else if (it == '*' || it == '/') {
+            for (auto itOut: opStack)
+                if (!itOut.compare("*") || !itOut.compare("/") || !itOut.compare("^")) {
+                    out.push_back(opStack.front());
+                    out.push_back(" ");
+                    opStack.pop_front();
+                } else
+                    break;
+            opStack.push_front(string(1, it));
+        } else if (it == '^') {
+            opStack.push_front(string(1, it));
+        } else if (it == '(') {
+            if(wasFunc){
+                opStack.push_front(funcName);
+                wasFunc=false;
+                funcName.clear();
+                parenthesisStack.push_front(0);
+            }
+            opStack.push_front(string(1, it));
+            if(parenthesisStack.size()){
+                parenthesisStack.front()++;
+            }
+        } else if (it == ')') {
+            for (auto itOut: opStack)
+                if (!itOut.compare("(")) {
+                    opStack.pop_front();
+                    break;
+                }
+                else {
+                    out.push_back(opStack.front());
+                    out.push_back(" ");
+                    opStack.pop_front();
+                }
+            if(parenthesisStack.size()){
+                parenthesisStack.front()--;
+                if(parenthesisStack.front()==0){
+                    parenthesisStack.pop_front();
+                    out.push_back(opStack.front());
+                    out.push_back(" ");
+                    opStack.pop_front();
+                }
+            }
+        } else if (it == 'X') {
+            out.push_back(string(1, it));
+            out.push_back(" ");
+        } else if (it == ' ') {
+
+        } else {
+            wasFunc=true;
+            funcName.append(string(1,it));
+        }
+    }
+    for (auto it : opStack) {
+        out.push_back(it);
+        out.push_back(" ");
+    }
+    for (auto it : out)
+        ss << it;
+    ret = ss.str();
+    return ret;
+}
+
+/**
+ * String splitter function, splits a string at delim characters
+ * @param s string for splitting
+ * @param delim delimiter character
+ * @return split vector of strings
+ */
+std::vector<std::string> split(const std::string &s, char delim) {
+    std::stringstream ss(s);
+    std::string item;
+    std::vector<std::string> splitted;
+    while (std::getline(ss, item, delim))
+        splitted.push_back(item);
+    return splitted;
+}
+
+/**
+ * Gets an expression in Reverse Polish Notation, and builds an Expression Tree from it.
+ * Normal RPN evaluation, only it doesn't do any primitive calculation, just evaluates the next token, generates the
+ * required Expression, and pushes it into a stack.
+ * @param RPNExp string, in Reverse Polish Notation format.
+ * @return pointer to the Expression Tree
+ */
+std::unique_ptr<Expression> buildTree(std::string RPNExp) {
+    std::vector<std::string> RPNTokens = split(RPNExp, ' ');
+    std::deque<std::unique_ptr<Expression> > expStack;
+    for (auto item : RPNTokens) {
+        try {
+            if (std::regex_match(item, std::regex("[[:digit:]]+.?[[:digit:]]*"))) {
+                expStack.push_back(std::unique_ptr<Expression>(new Constant(atof(item.c_str()))));
+            } else if (std::regex_match(item, std::regex("[+-/*^]"))) {
+                std::unique_ptr<Expression> rhs(std::move(expStack.back()));
+                expStack.pop_back();
+                std::unique_ptr<Expression> lhs(std::move(expStack.back()));
+                expStack.pop_back();
+                switch (item.at(0)) {
+                    case '+':
+                        expStack.push_back(std::unique_ptr<Expression>(new Sum{std::move(lhs), std::move(rhs)}));
+                        break;
+                    case '*':
+                        expStack.push_back(std::unique_ptr<Expression>(new Prod{std::move(lhs), std::move(rhs)}));
+                        break;
+                    case '/':
+                        expStack.push_back(std::unique_ptr<Expression>(new Div{std::move(lhs), std::move(rhs)}));
+                        break;
+                    case '-':
+                        expStack.push_back(std::unique_ptr<Expression>(new Dif{std::move(lhs), std::move(rhs)}));
+                        break;
+                    case '^':
+                        expStack.push_back(std::unique_ptr<Expression>(new Exp{std::move(lhs), std::move(rhs)}));
+                        break;
+                }
+            } else if (std::regex_match(item, std::regex("X"))) {
+                expStack.push_back(std::unique_ptr<Expression>(new Variable{}));
+            } else{
+                try{
+                    std::function<double(double)> func{parseFunction(item)};
+                    std::unique_ptr<Expression> arg(std::move(expStack.back()));
+                    expStack.pop_back();
+                    expStack.push_back(std::unique_ptr<Expression>(new Function{std::move(arg),func,item}));
+                }catch (...){
+
+                }
+            }
+        } catch (const std::regex_error &e) {
+            cout << e.code();
+        }
+    }
+    return std::unique_ptr<Expression>(std::move(expStack.front()));
+}
+
+/**
+ * The per-node simplify() the Expression classes had before the Simplifier: every node simplifies its children
+ * into fresh copies, then applies its local rules, without looking into nested chains.
+ * @param exp the tree to simplify
+ * @return the simplified copy
+ */
+std::unique_ptr<Expression> simplify(const Expression &exp) {
+    if (const Function *func = dynamic_cast<const Function *>(&exp)) {
+        std::unique_ptr<Expression> arg_simpl{simplify(*func->arg)};
+        if (Constant *cons = dynamic_cast<Constant *>(arg_simpl.get()))
+            return std::unique_ptr<Expression>(new Constant{func->entry->scalar(cons->get_value())});
+        return std::unique_ptr<Expression>(new Function{std::move(arg_simpl), *func});
+    }
+    const TwoOperand *op = dynamic_cast<const TwoOperand *>(&exp);
+    if (!op)
+        return std::unique_ptr<Expression>(exp.clone());
+    std::unique_ptr<Expression> lhs_simpl{simplify(*op->lhs)};
+    std::unique_ptr<Expression> rhs_simpl{simplify(*op->rhs)};
+    std::unique_ptr<Constant> lhs_cons{dynamic_cast<Constant *>(lhs_simpl->clone())};
+    std::unique_ptr<Constant> rhs_cons{dynamic_cast<Constant *>(rhs_simpl->clone())};
+    bool lhs_is = bool(lhs_cons), rhs_is = bool(rhs_cons);
+    double l = lhs_is ? lhs_cons->get_value() : 0.0, r = rhs_is ? rhs_cons->get_value() : 0.0;
+    switch (op->get_operator()) {
+        case '+':
+            if (lhs_is && l == 0.0)
+                return rhs_simpl;
+            if (rhs_is && r == 0.0)
+                return lhs_simpl;
+            if (lhs_is && rhs_is)
+                return std::unique_ptr<Expression>(new Constant{l + r});
+            return std::unique_ptr<Expression>(new Sum{std::move(lhs_simpl), std::move(rhs_simpl)});
+        case '*':
+            if (lhs_is && l == 1.0)
+                return rhs_simpl;
+            if ((rhs_is && r == 0.0) || (lhs_is && l == 0.0))
+                return std::unique_ptr<Expression>(new Constant{0});
+            if (rhs_is && r == 1.0)
+                return lhs_simpl;
+            if (lhs_is && rhs_is)
+                return std::unique_ptr<Expression>(new Constant{l * r});
+            return std::unique_ptr<Expression>(new Prod{std::move(lhs_simpl), std::move(rhs_simpl)});
+        case '-':
+            if (lhs_is && l == 0.0)
+                return std::unique_ptr<Expression>(new Prod{std::move(rhs_simpl),
+                                                            std::unique_ptr<Expression>(new Constant{-1.0})});
+            if (rhs_is && r == 0.0)
+                return lhs_simpl;
+            if (lhs_is && rhs_is)
+                return std::unique_ptr<Expression>(new Constant{l - r});
+            return std::unique_ptr<Expression>(new Dif{std::move(lhs_simpl), std::move(rhs_simpl)});
+        case '/':
+            if (lhs_is && l == 0.0)
+                return std::unique_ptr<Expression>(new Constant{0.0});
+            if (rhs_is && r == 0.0)
+                throw std::runtime_error("Division by 0!");
+            if (lhs_is && rhs_is)
+                return std::unique_ptr<Expression>(new Constant{l / r});
+            return std::unique_ptr<Expression>(new Div{std::move(lhs_simpl), std::move(rhs_simpl)});
+        case '^':
+            if (lhs_is && l == 1.0)
+                return lhs_simpl;
+            if (rhs_is && r == 1.0)
+                return lhs_simpl;
+            if (rhs_is && r == 0.0)
+                return std::unique_ptr<Expression>(new Constant{1});
+            if (lhs_is && rhs_is)
+                return std::unique_ptr<Expression>(new Constant{pow(l, r)});
+            return std::unique_ptr<Expression>(new Exp{std::move(lhs_simpl), std::move(rhs_simpl)});
+        default:
+            return std::unique_ptr<Expression>(exp.clone());
+    }
+}
+}
+
+/**
+ * Number of checks that failed; main() fails if there is any.
+ */
+static int failedChecks = 0;
+
+/**
+ * Records the outcome of a check.
+ * @param passed whether the check passed
+ * @param failure text reported if it failed
+ * @return "" if the check passed, failure otherwise
+ */
+static const char *check(bool passed, const char *failure = "  MISMATCH") {
+    if (passed)
+        return "";
+    failedChecks++;
+    return failure;
+}
+
+/**
+ * Shorthand for wrapping a freshly allocated node.
+ */
+static unique_ptr<Expression> node(Expression *e) {
+    return unique_ptr<Expression>(e);
+}
+
+/**
+ * Builds the example expressions suggested in main.cpp by hand.
+ * @param names receives the signature of each expression
+ * @return the expression trees, simplified the same way main() does
+ */
+static vector<unique_ptr<Expression>> exampleExpressions(vector<string> &names) {
+    vector<unique_ptr<Expression>> exps;
+    names.push_back("X-3");
+    exps.push_back(node(new Dif{node(new Variable{}), node(new Constant{3})}));
+    names.push_back("X + 4 ^ 2 * 2 / (5 - 1)");
+    exps.push_back(node(new Sum{node(new Variable{}),
+                                node(new Div{node(new Prod{node(new Exp{node(new Constant{4}), node(new Constant{2})}),
+                                                           node(new Constant{2})}),
+                                             node(new Dif{node(new Constant{5}), node(new Constant{1})})})}));
+    names.push_back("abs(sin(X))");
+    exps.push_back(node(new Function{node(new Function{node(new Variable{}), [](double x) { return sin(x); }, "sin"}),
+                                     [](double x) { return fabs(x); }, "abs"}));
+    names.push_back("X^3 - 2*X*X + sin(X)/(X+4)");
+    exps.push_back(node(new Sum{node(new Dif{node(new Exp{node(new Variable{}), node(new Constant{3})}),
+                                             node(new Prod{node(new Prod{node(new Constant{2}), node(new Variable{})}),
+                                                           node(new Variable{})})}),
+                                node(new Div{node(new Function{node(new Variable{}), [](double x) { return sin(x); }, "sin"}),
+                                             node(new Sum{node(new Variable{}), node(new Constant{4})})})}));
+    names.push_back("(X*X+1)/(X-2)*(X+3)-X/4");
+    exps.push_back(node(new Dif{node(new Prod{node(new Div{node(new Sum{node(new Prod{node(new Variable{}), node(new Variable{})}),
+                                                                         node(new Constant{1})}),
+                                                           node(new Dif{node(new Variable{}), node(new Constant{2})})}),
+                                              node(new Sum{node(new Variable{}), node(new Constant{3})})}),
+                                node(new Div{node(new Variable{}), node(new Constant{4})})}));
+    for (auto &e : exps)
+        e = e->simplify();
+    return exps;
+}
+
+/**
+ * Counts the nodes of a tree.
+ */
+static size_t countNodes(const Expression &e) {
+    if (const TwoOperand *op = dynamic_cast<const TwoOperand *>(&e))
+        return 1 + countNodes(*op->lhs) + countNodes(*op->rhs);
+    if (const Function *f = dynamic_cast<const Function *>(&e))
+        return 1 + countNodes(*f->arg);
+    return 1;
+}
+
+/**
+ * Runs f over n samples spread over [-10, 10] and returns the time per sample.
+ * @param f callable with double(double) signature
+ * @param n number of samples
+ * @param checksum accumulates the results, so the work cannot be optimized away
+ * @return nanoseconds per sample
+ */
+template<typename F>
+static double nsPerSample(F f, size_t n, double &checksum) {
+    double step = 20.0 / n;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++)
+        checksum += f(-10.0 + i * step);
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - start).count() / n;
+}
+
+/**
+ * Compares tree evaluation with the bytecode interpreter and the native code.
+ */
+static void benchCompiled() {
+    const size_t samples = 2000000;
+    vector<string> names;
+    vector<unique_ptr<Expression>> exps = exampleExpressions(names);
+    cout << "== tree vs. bytecode vs. JIT (ns/sample) ==" << endl;
+    if (!JitExpression::supported())
+        cout << "(no JIT on this platform, the JIT column runs the interpreter)" << endl;
+    for (size_t i = 0; i < exps.size(); i++) {
+        const Expression &tree = *exps[i];
+        CompiledExpression compiled{tree};
+        JitExpression jit{tree};
+        bool identical = true;
+        for (int k = -1000; k <= 1000; k++) {
+            double x = k * 0.0137;
+            double a = tree.evaluate(x), b = compiled.evaluate(x), c = jit.evaluate(x);
+            if ((a != b && !(isnan(a) && isnan(b))) || (a != c && !(isnan(a) && isnan(c))))
+                identical = false;
+        }
+        double sumTree = 0, sumCompiled = 0, sumJit = 0;
+        double tTree = nsPerSample([&tree](double x) { return tree.evaluate(x); }, samples, sumTree);
+        double tCompiled = nsPerSample([&compiled](double x) { return compiled.evaluate(x); }, samples, sumCompiled);
+        double tJit = nsPerSample([&jit](double x) { return jit.evaluate(x); }, samples, sumJit);
+        cout << setw(28) << left << names[i] << right << fixed << setprecision(2)
+             << " tree " << setw(7) << tTree << "  bytecode " << setw(7) << tCompiled
+             << " (" << tTree / tCompiled << "x)  JIT " << setw(7) << tJit << " (" << tTree / tJit << "x)"
+             << check(identical) << endl;
+    }
+}
+
+/**
+ * Returns the time of one call of f in nanoseconds, the best of a few runs.
+ */
+template<typename F>
+static double bestOf(F f, int runs = 5) {
+    double best = 0;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        f();
+        auto end = chrono::steady_clock::now();
+        double t = chrono::duration<double, nano>(end - start).count();
+        if (r == 0 || t < best)
+            best = t;
+    }
+    return best;
+}
+
+/**
+ * Compares the per-point scalar path with evaluate_batch() on a 1M sample sweep, for every kernel level.
+ */
+static void benchBatch() {
+    const size_t samples = 1000000;
+    vector<string> names;
+    vector<unique_ptr<Expression>> exps = exampleExpressions(names);
+    vector<double> xs(samples), scalar(samples), batch(samples);
+    for (size_t i = 0; i < samples; i++)
+        xs[i] = -10.0 + 20.0 * i / samples;
+    BatchKernels::SimdLevel detected = BatchKernels::detect_level();
+    cout << "== per-point vs. evaluate_batch, 1M samples (ns/sample) ==" << endl;
+    for (size_t e = 0; e < exps.size(); e++) {
+        const Expression &tree = *exps[e];
+        double tScalar = bestOf([&]() {
+            for (size_t i = 0; i < samples; i++)
+                scalar[i] = tree.evaluate(xs[i]);
+        }) / samples;
+        cout << setw(28) << left << names[e] << right << fixed << setprecision(2) << " scalar " << setw(6) << tScalar;
+        for (int level = 0; level <= int(detected); level++) {
+            BatchKernels::set_level(BatchKernels::SimdLevel(level));
+            double tBatch = bestOf([&]() { tree.evaluate_batch(xs.data(), batch.data(), samples); }) / samples;
+            bool identical = true;
+            for (size_t i = 0; i < samples; i++)
+                if (scalar[i] != batch[i] && !(isnan(scalar[i]) && isnan(batch[i])))
+                    identical = false;
+            cout << "  " << BatchKernels::level_name(BatchKernels::SimdLevel(level)) << " " << setw(6) << tBatch
+                 << " (" << tScalar / tBatch << "x)" << check(identical, " MISMATCH");
+        }
+        cout << endl;
+        BatchKernels::set_level(detected);
+    }
+}
+
+/**
+ * Compares the parse throughput of parseExpression() with the legacy pipeline.
+ */
+static void benchParser() {
+    const vector<string> formulas = {
+            "X-3", "X+4^2*2/(5-1)", "abs(sin(X))", "X^3-2*X*X+sin(X)/(X+4)", "(X*X+1)/(X-2)*(X+3)-X/4",
+            "cos(X)*sin(X)+tan(X/2)-3.25*X^2", "((X+1)*(X+2)*(X+3)*(X+4))/(X^2+10)"
+    };
+    const int legacyRounds = 20, rounds = 2000;
+    size_t checksum = 0;
+    double tLegacy = bestOf([&]() {
+        for (int r = 0; r < legacyRounds; r++)
+            for (const string &f : formulas)
+                checksum += legacy::buildTree(legacy::parseString(f)) != nullptr;
+    }, 3) / legacyRounds;
+    double tParser = bestOf([&]() {
+        for (int r = 0; r < rounds; r++)
+            for (const string &f : formulas)
+                checksum += parseExpression(f) != nullptr;
+    }, 3) / rounds;
+    cout << "== parse throughput (formulas/s) ==" << endl << fixed << setprecision(0)
+         << "legacy parseString+buildTree " << setw(10) << formulas.size() / tLegacy * 1e9
+         << "  parseExpression " << setw(10) << formulas.size() / tParser * 1e9
+         << setprecision(1) << "  (" << tLegacy / tParser << "x)" << endl;
+    for (const string &f : formulas) {
+        ostringstream a, b;
+        legacy::buildTree(legacy::parseString(f))->print(a);
+        parseExpression(f)->print(b);
+        if (a.str() != b.str()) {
+            failedChecks++;
+            cout << "MISMATCH " << f << ": " << a.str() << " vs. " << b.str() << endl;
+        }
+    }
+}
+
+/**
+ * Small deterministic generator, so every run builds the same trees.
+ */
+struct Lcg {
+    unsigned long long state;
+
+    unsigned next(unsigned bound) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return unsigned(state >> 33) % bound;
+    }
+};
+
+/**
+ * Generates a random balanced tree of about nodes nodes, with plenty of foldable constants and neutral elements.
+ */
+static unique_ptr<Expression> randomTree(Lcg &rng, size_t nodes) {
+    if (nodes <= 1) {
+        switch (rng.next(4)) {
+            case 0:
+                return node(new Constant{double(rng.next(5))});
+            case 1:
+                return node(new Constant{1.0});
+            default:
+                return node(new Variable{});
+        }
+    }
+    if (rng.next(8) == 0)
+        return node(new Function{randomTree(rng, nodes - 1), FunctionRegistry::global().get(FunctionRegistry::SIN)});
+    size_t left = (nodes - 1) / 2;
+    unique_ptr<Expression> lhs = randomTree(rng, left);
+    unique_ptr<Expression> rhs = randomTree(rng, nodes - 1 - left);
+    switch (rng.next(4)) {
+        case 0:
+            return node(new Sum{move(lhs), move(rhs)});
+        case 1:
+            return node(new Dif{move(lhs), move(rhs)});
+        case 2:
+            return node(new Prod{move(lhs), move(rhs)});
+        default:
+            return node(new Sum{move(lhs), node(new Prod{move(rhs), node(new Constant{0.5})})});
+    }
+}
+
+/**
+ * Returns the resident set size of the process in bytes, 0 where it can't be queried.
+ */
+static size_t residentBytes() {
+    ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (statm >> pages >> resident)
+        return resident * 4096;
+    return 0;
+}
+
+/**
+ * Compares building, simplifying and dropping a large generated tree on the heap and in an ExpressionArena.
+ */
+static void benchArena() {
+    const size_t nodes = 200000;
+    cout << "== heap vs. arena, " << nodes << " node tree (ms, MiB resident growth) ==" << endl;
+    for (int useArena = 0; useArena <= 1; useArena++) {
+        unique_ptr<ExpressionArena> arena{useArena ? new ExpressionArena : nullptr};
+        unique_ptr<ExpressionArena::Scope> scope{useArena ? new ExpressionArena::Scope{*arena} : nullptr};
+        size_t rssBefore = residentBytes();
+        Lcg rng{42};
+        unique_ptr<Expression> tree, simplified;
+        double tBuild = bestOf([&]() { tree = randomTree(rng, nodes); }, 1);
+        double tSimplify = bestOf([&]() { simplified = tree->simplify(); }, 1);
+        size_t rssAfter = residentBytes();
+        double tFree = bestOf([&]() {
+            if (useArena) {
+                tree.release();
+                simplified.release();
+                scope.reset();
+                arena.reset();
+            } else {
+                tree.reset();
+                simplified.reset();
+            }
+        }, 1);
+        cout << (useArena ? "arena" : "heap ") << fixed << setprecision(2)
+             << "  build " << setw(7) << tBuild / 1e6 << "  simplify " << setw(7) << tSimplify / 1e6
+             << "  free " << setw(7) << tFree / 1e6
+             << "  resident +" << setw(6) << (rssAfter - rssBefore) / 1048576.0 << endl;
+    }
+}
+
+/**
+ * Compares the tree with its hash-consed DAG on formulas with repeated subexpressions.
+ */
+static void benchDag() {
+    vector<string> formulas = {"sin(X)*sin(X)+sin(X)"};
+    string generated;
+    for (int k = 1; k <= 12; k++) {
+        if (k > 1)
+            generated += "+";
+        generated += "sin(X)*cos(X)/(X*X+" + to_string(k % 3 + 1) + ")-abs(sin(X)+cos(X))*(X*X+1)";
+    }
+    formulas.push_back(generated);
+    const size_t samples = 200000;
+    vector<double> xs(samples), out(samples);
+    for (size_t i = 0; i < samples; i++)
+        xs[i] = -10.0 + 20.0 * i / samples;
+    cout << "== tree vs. hash-consed DAG (ns/sample) ==" << endl;
+    for (const string &f : formulas) {
+        unique_ptr<Expression> tree = parseExpression(f);
+        ExpressionDag dag{*tree};
+        bool identical = true;
+        for (size_t i = 0; i < samples; i += 97) {
+            double a = tree->evaluate(xs[i]), b = dag.evaluate(xs[i]);
+            if (a != b && !(isnan(a) && isnan(b)))
+                identical = false;
+        }
+        double tTree = bestOf([&]() {
+            for (size_t i = 0; i < samples; i++)
+                out[i] = tree->evaluate(xs[i]);
+        }) / samples;
+        double tDag = bestOf([&]() {
+            for (size_t i = 0; i < samples; i++)
+                out[i] = dag.evaluate(xs[i]);
+        }) / samples;
+        double tTreeBatch = bestOf([&]() { tree->evaluate_batch(xs.data(), out.data(), samples); }) / samples;
+        double tDagBatch = bestOf([&]() { dag.evaluate_batch(xs.data(), out.data(), samples); }) / samples;
+        cout << (f.size() > 28 ? f.substr(0, 25) + "..." : f) << endl << fixed << setprecision(2)
+             << "  nodes " << countNodes(*tree) << " -> " << dag.size()
+             << "  tree " << tTree << "  DAG " << tDag << " (" << tTree / tDag << "x)"
+             << "  tree batch " << tTreeBatch << "  DAG batch " << tDagBatch << " (" << tTreeBatch / tDagBatch << "x)"
+             << check(identical) << endl;
+    }
+    /* a tree added after a bigger one only evaluates the nodes it reaches */
+    unique_ptr<Expression> big = parseExpression(generated), small = parseExpression("sin(X)*X+1");
+    ExpressionDag shared{*big};
+    shared.add(*small);
+    small->evaluate_batch(xs.data(), out.data(), samples);
+    vector<double> dagOut(samples);
+    shared.evaluate_batch(xs.data(), dagOut.data(), samples);
+    bool identical = true;
+    for (size_t i = 0; i < samples; i++)
+        if (out[i] != dagOut[i] || (i % 97 == 0 && shared.evaluate(xs[i]) != small->evaluate(xs[i])))
+            identical = false;
+    double tSmall = bestOf([&]() {
+        for (size_t i = 0; i < samples; i++)
+            out[i] = shared.evaluate(xs[i]);
+    }) / samples;
+    cout << "sin(X)*X+1 added after the generated formula: " << shared.size() << " nodes, DAG " << tSmall
+         << check(identical) << endl;
+}
+
+/**
+ * Compares the per-node simplify() with the Simplifier: size of the result, time to simplify, time to evaluate.
+ */
+static void benchSimplify() {
+    vector<string> formulas = {"X + 4 ^ 2 * 2 / (5 - 1)", "(X+2)+3-1", "2*(3*(X*4))/8",
+                               "X^3 - 2*X*X + sin(X)/(X+4) + 2*3 - (1-X)*0.5*4"};
+    vector<pair<string, unique_ptr<Expression>>> trees;
+    for (const string &f : formulas)
+        trees.push_back(make_pair(f, parseExpression(f)));
+    Lcg rng{7};
+    trees.push_back(make_pair(string("random tree, 20000 nodes"), randomTree(rng, 20000)));
+    const size_t samples = 200000;
+    vector<double> xs(samples), out(samples);
+    for (size_t i = 0; i < samples; i++)
+        xs[i] = -10.0 + 20.0 * i / samples;
+    cout << "== per-node simplify vs. Simplifier (nodes, us/simplify, ns/sample) ==" << endl;
+    for (auto &entry : trees) {
+        const Expression &tree = *entry.second;
+        unique_ptr<Expression> before = legacy::simplify(tree), after = tree.simplify();
+        double tBefore = bestOf([&]() { legacy::simplify(tree); }, 3);
+        double tAfter = bestOf([&]() { tree.simplify(); }, 3);
+        double eBefore = bestOf([&]() { before->evaluate_batch(xs.data(), out.data(), samples); }, 3) / samples;
+        double eAfter = bestOf([&]() { after->evaluate_batch(xs.data(), out.data(), samples); }, 3) / samples;
+        double a = before->evaluate(1.25), b = after->evaluate(1.25);
+        /* the constants of the numerator and the denominator fold into one: X*3 */
+        bool folded = entry.first != "2*(3*(X*4))/8" || countNodes(*after) == 3;
+        cout << entry.first << endl << fixed << setprecision(2)
+             << "  nodes " << countNodes(tree) << " -> " << countNodes(*before) << " / " << countNodes(*after)
+             << "  simplify " << tBefore / 1e3 << " / " << tAfter / 1e3
+             << "  evaluate " << eBefore << " / " << eAfter
+             << check(fabs(a - b) <= 1e-9 * fabs(a)) << check(folded, "  NOT FOLDED") << endl;
+    }
+}
+
+/**
+ * Returns the distance of two doubles in units in the last place, 0 if both are NaN.
+ */
+static double ulpDistance(double a, double b) {
+    if (isnan(a) || isnan(b))
+        return isnan(a) && isnan(b) ? 0.0 : INFINITY;
+    long long ia, ib;
+    memcpy(&ia, &a, sizeof a);
+    memcpy(&ib, &b, sizeof b);
+    if (ia < 0)
+        ia = (long long) (0x8000000000000000ULL - (unsigned long long) ia);
+    if (ib < 0)
+        ib = (long long) (0x8000000000000000ULL - (unsigned long long) ib);
+    return double(ia > ib ? ia - ib : ib - ia);
+}
+
+/**
+ * Compares trees before and after StrengthReduction: evaluation time and the largest error in ULP.
+ */
+static void benchStrength() {
+    vector<string> formulas = {"X^3", "X^16", "X/3", "X^2+X^3", "(X*X+1)^4-X^0.5", "X^(0-2)+X/3+X/4", "(X+1)^3/(X-1)^2*X^16"};
+    const size_t samples = 200000;
+    vector<double> xs(samples), out(samples), reference(samples);
+    for (size_t i = 0; i < samples; i++)
+        xs[i] = 0.01 + 10.0 * i / samples;
+    cout << "== strength reduction (ns/sample, max ULP error) ==" << endl;
+    for (const string &f : formulas) {
+        unique_ptr<Expression> tree = parseExpression(f)->simplify();
+        tree->evaluate_batch(xs.data(), reference.data(), samples);
+        double tTree = bestOf([&]() { tree->evaluate_batch(xs.data(), out.data(), samples); }) / samples;
+        cout << f << endl << fixed << setprecision(2) << "  pow/div " << tTree;
+        for (int fastMath = 0; fastMath <= 1; fastMath++) {
+            unique_ptr<Expression> reduced{tree->clone()};
+            StrengthReduction(fastMath != 0).run(reduced);
+            ExpressionDag dag{*reduced};
+            double tReduced = bestOf([&]() { reduced->evaluate_batch(xs.data(), out.data(), samples); }) / samples;
+            double tDag = bestOf([&]() { dag.evaluate_batch(xs.data(), out.data(), samples); }) / samples;
+            double ulps = 0.0;
+            for (size_t i = 0; i < samples; i++)
+                ulps = max(ulps, ulpDistance(reference[i], reduced->evaluate(xs[i])));
+            cout << (fastMath ? "  fast math " : "  reduced ") << tReduced << " (DAG " << tDag << ", "
+                 << setprecision(0) << ulps << " ULP)" << setprecision(2);
+        }
+        cout << endl;
+    }
+}
+
+/**
+ * Compares polynomials written out as trees with their Polynomial nodes: time and the largest relative error
+ * against a long double evaluation.
+ */
+static void benchPolynomial() {
+    const size_t samples = 200000;
+    vector<double> xs(samples), out(samples);
+    for (size_t i = 0; i < samples; i++)
+        xs[i] = -1.5 + 3.0 * i / samples;
+    cout << "== polynomial trees vs. Horner, " << BatchKernels::level_name(BatchKernels::active_level())
+         << " (ns/sample, max relative error) ==" << endl;
+    for (int degree = 5; degree <= 20; degree += 5) {
+        vector<double> coefficients;
+        string formula;
+        for (int k = degree; k >= 0; k--) {
+            double c = (k % 7 + 1) / 8.0;
+            bool negative = (degree - k) % 2 == 1;
+            coefficients.insert(coefficients.begin(), negative ? -c : c);
+            formula += (k == degree ? "" : negative ? "-" : "+") + to_string(c) + "*X^" + to_string(k);
+        }
+        unique_ptr<Expression> tree = parseExpression(formula)->simplify();
+        unique_ptr<Expression> reduced{tree->clone()};
+        StrengthReduction().run(reduced);
+        unique_ptr<Expression> poly{tree->clone()};
+        PolynomialDetector().run(poly);
+        auto error = [&](const Expression &e) {
+            double worst = 0.0;
+            for (size_t i = 0; i < samples; i += 7) {
+                long double exact = 0.0L;
+                for (size_t k = coefficients.size(); k-- > 0;)
+                    exact = exact * xs[i] + coefficients[k];
+                if (exact != 0.0L)
+                    worst = max(worst, double(fabsl((e.evaluate(xs[i]) - exact) / exact)));
+            }
+            return worst;
+        };
+        double tTree = bestOf([&]() { tree->evaluate_batch(xs.data(), out.data(), samples); }) / samples;
+        double tReduced = bestOf([&]() { reduced->evaluate_batch(xs.data(), out.data(), samples); }) / samples;
+        double tScalar = bestOf([&]() {
+            for (size_t i = 0; i < samples; i++)
+                out[i] = poly->evaluate(xs[i]);
+        }) / samples;
+        double tBatch = bestOf([&]() { poly->evaluate_batch(xs.data(), out.data(), samples); }) / samples;
+        cout << "degree " << degree << check(dynamic_cast<Polynomial *>(poly.get()), "  NOT DETECTED") << endl
+             << fixed << setprecision(2) << "  tree " << tTree << "  strength reduced " << tReduced
+             << "  Horner " << tScalar << "  Horner batch " << tBatch << " (" << tTree / tBatch << "x)"
+             << scientific << setprecision(1) << "  error tree " << error(*tree) << " Horner " << error(*poly)
+             << endl;
+    }
+}
+
+/**
+ * Newton's method from x0, with the derivative supplied by step, which returns f(x) / f'(x).
+ * @return the root found, after at most 50 iterations
+ */
+template<typename F>
+static double newton(F step, double x0, int &iterations) {
+    double x = x0;
+    for (iterations = 1; iterations <= 50; iterations++) {
+        double delta = step(x);
+        x -= delta;
+        if (fabs(delta) <= 1e-12 * max(1.0, fabs(x)))
+            break;
+    }
+    return x;
+}
+
+/**
+ * Compares Newton iterations with a finite difference derivative, a symbolic derivative and dual numbers.
+ */
+static void benchNewton() {
+    vector<string> formulas = {"X^3-2*X-5", "cos(X)-X", "X*sin(X)-1+X^2/10"};
+    const int starts = 2000;
+    cout << "== Newton's method: finite differences vs. derive() vs. evaluate_with_derivative() "
+            "(ns/solve, iterations, root) ==" << endl;
+    for (const string &f : formulas) {
+        unique_ptr<Expression> exp = parseExpression(f)->simplify();
+        unique_ptr<Expression> derivative = exp->derive();
+        int iterations = 0;
+        double root = 0.0, sink = 0.0;
+        auto run = [&](const char *label, function<double(double)> step) {
+            double t = bestOf([&]() {
+                for (int i = 0; i < starts; i++) {
+                    root = newton(step, 1.0 + i * 1e-4, iterations);
+                    sink += root;
+                }
+            }) / starts;
+            cout << "  " << label << " " << fixed << setprecision(1) << setw(7) << t << " " << setw(2) << iterations
+                 << " " << setprecision(12) << root;
+        };
+        cout << f << endl;
+        run("finite differences", [&](double x) {
+            const double h = 1e-6;
+            double d = (exp->evaluate(x + h) - exp->evaluate(x - h)) / (2 * h);
+            return exp->evaluate(x) / d;
+        });
+        run("  derive()", [&](double x) { return exp->evaluate(x) / derivative->evaluate(x); });
+        run("  dual", [&](double x) {
+            Dual d = exp->evaluate_with_derivative(x);
+            return d.value / d.derivative;
+        });
+        const double h = 1e-6;
+        double exact = derivative->evaluate(root);
+        double fd = (exp->evaluate(root + h) - exp->evaluate(root - h)) / (2 * h);
+        cout << endl << "  relative error of f'(root): finite differences " << scientific << setprecision(1)
+             << fabs(fd - exact) / fabs(exact) << "  dual "
+             << fabs(exp->evaluate_with_derivative(root).derivative - exact) / fabs(exact)
+             << (sink == 0.0 ? " " : "") << endl;
+    }
+}
+
+/**
+ * Measures how far a set of polylines is from the curve: the largest distance, in pixels, of a densely sampled
+ * point of the curve from the segment drawn over it. Rows are clamped to a band around the screen, so only visible
+ * errors count, and places in the gaps between polylines are skipped.
+ * @param connectorRows receives the largest row span of a segment crossing a place where the curve is not finite or
+ *        jumps across the whole screen, i.e. of a false vertical connector; 0 if there is none
+ */
+static double polylineError(const Expression &exp, const vector<Polyline> &curve, const Viewport &view,
+                            double &connectorRows) {
+    double worst = 0.0;
+    connectorRows = 0.0;
+    auto clampRow = [&](double y) { return max(-1.0, min(double(view.height) + 1.0, view.pixel_y(y))); };
+    for (const Polyline &line : curve) {
+        for (size_t i = 0; i + 1 < line.size(); i++) {
+            double ax = view.pixel_x(line[i].x), ay = clampRow(line[i].y);
+            double bx = view.pixel_x(line[i + 1].x), by = clampRow(line[i + 1].y);
+            double length = hypot(bx - ax, by - ay);
+            int steps = max(2, int((bx - ax) * 64));
+            for (int k = 1; k < steps; k++) {
+                double x = line[i].x + (line[i + 1].x - line[i].x) * k / steps, y = exp.evaluate(x);
+                double px = view.pixel_x(x), py = clampRow(y);
+                double free = view.pixel_y(line[i].y) + (view.pixel_y(line[i + 1].y) - view.pixel_y(line[i].y)) * k / steps;
+                if (!isfinite(y) || fabs(view.pixel_y(y) - free) > 2 * view.height) {
+                    connectorRows = max(connectorRows, fabs(by - ay));
+                    continue;
+                }
+                double d = length == 0.0 ? 0.0 : fabs((bx - ax) * (ay - py) - (ax - px) * (by - ay)) / length;
+                worst = max(worst, d);
+            }
+        }
+    }
+    return worst;
+}
+
+/**
+ * Compares the old sampling, one point per pixel column joined by lines, with the adaptive Sampler.
+ */
+static void benchSampler() {
+    vector<string> formulas = {"X/2+1", "sin(X)", "X^3/50-X", "abs(X)-3", "sqrt(X)*3", "tan(X)", "sin(1/X)*5",
+                               "sin(X*10)*5"};
+    Viewport view{-10.0, 10.0, -10.0, 10.0, 600, 600};
+    cout << "== per-column vs. adaptive sampling, 600x600 (evaluations, max error px, false connector px, us) =="
+         << endl;
+    for (const string &f : formulas) {
+        unique_ptr<Expression> exp = parseExpression(f)->simplify();
+        vector<double> xs(view.width), ys(view.width);
+        vector<Polyline> columns(1);
+        double tColumns = bestOf([&]() {
+            for (int i = 0; i < view.width; i++)
+                xs[i] = view.plane_x(i);
+            exp->evaluate_batch(xs.data(), ys.data(), xs.size());
+            columns[0].clear();
+            for (int i = 0; i < view.width; i++)
+                columns[0].push_back(CurvePoint{xs[i], ys[i]});
+        });
+        Sampler sampler;
+        vector<Polyline> adaptive;
+        double tAdaptive = bestOf([&]() { adaptive = sampler.sample(*exp, view); });
+        size_t points = 0;
+        for (const Polyline &line : adaptive)
+            points += line.size();
+        double connectorColumns, connectorAdaptive;
+        double errorColumns = polylineError(*exp, columns, view, connectorColumns);
+        double errorAdaptive = polylineError(*exp, adaptive, view, connectorAdaptive);
+        cout << left << setw(14) << f << right << fixed << setprecision(1)
+             << "  columns " << setw(5) << view.width << " " << setw(6) << errorColumns << " " << setw(5)
+             << connectorColumns << " " << setw(6) << tColumns / 1e3
+             << "  adaptive " << setw(5) << sampler.get_evaluations() << " " << setw(6) << errorAdaptive << " "
+             << setw(5) << connectorAdaptive << " " << setw(6) << tAdaptive / 1e3
+             << "  (" << adaptive.size() << " polylines, " << points << " points)" << endl;
+    }
+}
+
+/**
+ * Measures whole frames of the Plotter on the headless canvas: sampling, clipping and rasterizing.
+ */
+static void benchPlotter() {
+    vector<string> formulas = {"X/2+1", "sin(X)", "tan(X)", "sin(1/X)*5", "sin(X*10)*5"};
+    const int width = 800, height = 600;
+    cout << "== Plotter frames on an " << width << "x" << height << " ImageCanvas (frame us, sampling us) ==" << endl;
+    ImageCanvas *image = new ImageCanvas(width, height);
+    Plotter plotter{unique_ptr<Canvas>(image)};
+    for (const string &f : formulas) {
+        unique_ptr<Expression> exp = parseExpression(f)->simplify();
+        double tFrame = bestOf([&]() { plotter.plot(*exp, -10.0, 10.0, -10.0, 10.0); }, 20);
+        Sampler sampler;
+        double tSample = bestOf([&]() { sampler.sample(*exp, plotter.get_viewport()); }, 20);
+        cout << left << setw(14) << f << right << fixed << setprecision(1) << setw(8) << tFrame / 1e3 << setw(8)
+             << tSample / 1e3 << "  (" << setprecision(0) << 1e9 / tFrame << " frames/s)" << endl;
+    }
+}
+
+/**
+ * Simulates interaction with the Plotter on the headless canvas: a pan of 4 pixels per frame, then zooming in and
+ * out by wheel steps, drawn with fresh sampling and from a SampleCache.
+ */
+static void benchSampleCache() {
+    vector<string> formulas = {"sin(X)", "sin(X)*cos(X*3)+sqrt(abs(X))*sin(X*X/7)+log(abs(X)+1)"};
+    const int width = 800, height = 600, frames = 120;
+    cout << "== pan / zoom, " << frames << " frames each (evaluations, max frame us, mean frame us) ==" << endl;
+    for (const string &f : formulas) {
+        unique_ptr<Expression> exp = parseExpression(f)->simplify();
+        for (int cached = 0; cached < 2; cached++) {
+            Plotter plotter{unique_ptr<Canvas>(new ImageCanvas(width, height))};
+            SampleCache cache(*exp);
+            Sampler counter;
+            size_t evaluations = 0;
+            auto frame = [&](double x_min, double x_max, double y_min, double y_max) {
+                auto start = chrono::steady_clock::now();
+                if (cached) {
+                    plotter.plot(cache, x_min, x_max, y_min, y_max, 8.0);
+                } else {
+                    plotter.plot(*exp, x_min, x_max, y_min, y_max);
+                    counter.sample(*exp, plotter.get_viewport());
+                    evaluations += counter.get_evaluations();
+                }
+                return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            };
+            double worstPan = 0, totalPan = 0, worstZoom = 0, totalZoom = 0;
+            double shift = 4 * 20.0 / width;
+            frame(-10.0, 10.0, -7.5, 7.5);
+            for (int i = 1; i <= frames; i++) {
+                double t = frame(-10.0 + i * shift, 10.0 + i * shift, -7.5, 7.5);
+                worstPan = max(worstPan, t);
+                totalPan += t;
+            }
+            size_t panEvaluations = cached ? cache.get_evaluations() : evaluations;
+            double scale = 1.0;
+            for (int i = 1; i <= frames; i++) {
+                scale *= i <= frames / 2 ? 1 / 1.25 : 1.25;
+                double t = frame(-10.0 * scale, 10.0 * scale, -7.5 * scale, 7.5 * scale);
+                worstZoom = max(worstZoom, t);
+                totalZoom += t;
+            }
+            size_t zoomEvaluations = (cached ? cache.get_evaluations() : evaluations) - panEvaluations;
+            cout << (cached ? "  cached " : "  fresh  ") << left << setw(22) << f.substr(0, 20) << right << fixed
+                 << setprecision(0) << "  pan " << setw(8) << panEvaluations << setw(8) << worstPan << setw(7)
+                 << totalPan / frames << "  zoom " << setw(8) << zoomEvaluations << setw(8) << worstZoom << setw(7)
+                 << totalZoom / frames << endl;
+        }
+    }
+}
+
+/**
+ * Turns the Function nodes of a tree into calls of their bare functors, the way every function was called before
+ * the FunctionRegistry.
+ */
+static void bareFunctions(unique_ptr<Expression> &exp) {
+    if (Function *func = dynamic_cast<Function *>(exp.get())) {
+        bareFunctions(func->arg);
+        exp.reset(new Function{move(func->arg), func->entry->scalar, func->entry->name});
+    } else if (TwoOperand *op = dynamic_cast<TwoOperand *>(exp.get())) {
+        bareFunctions(op->lhs);
+        bareFunctions(op->rhs);
+    }
+}
+
+static bool sameValue(double a, double b) {
+    return a == b || (isnan(a) && isnan(b));
+}
+
+/**
+ * Checks that parallelEvaluate() gives the bits of the single-threaded evaluation for every node type, on a pool
+ * with more workers than processors, then measures its scaling on a 10M sample sweep. The functions are checked
+ * as builtins, as a registered std::function with state, and as the bare std::function functors of Function.
+ */
+static void benchParallel() {
+    vector<string> formulas = {"X", "X+2", "X-2", "X*3", "X/3", "X^2.5", "sin(X)", "cos(X)", "tan(X)", "abs(X)",
+                               "sqrt(X)", "log(X)", "sign(X)", "X^3-X*2+1",
+                               "parallel_ramp(X)*sin(X)+parallel_ramp(X-1)", "sin(X)*cos(X*3)+sqrt(abs(X))/(X^2+1)"};
+    FunctionRegistry &registry = FunctionRegistry::global();
+    if (!registry.find("parallel_ramp")) {
+        double slope = 0.5;
+        registry.add("parallel_ramp", [slope](double x) { return x > 0.0 ? x * slope : 0.0; });
+    }
+    const size_t checked = 1000003;
+    cout << "== parallelEvaluate and evaluate(): bit-identical to one thread on 8 workers ==" << endl;
+    {
+        ThreadPool pool(8);
+        bool all = true;
+        vector<double> xs(checked), serial(checked), parallel(checked);
+        double step = 20.0 / double(checked - 1);
+        for (size_t i = 0; i < checked; i++)
+            xs[i] = -10.0 + step * double(i);
+        for (const string &f : formulas) {
+            unique_ptr<Expression> exp = parseExpression(f)->simplify();
+            PolynomialDetector().run(exp);
+            StrengthReduction().run(exp);
+            unique_ptr<Expression> bare{exp->clone()};
+            bareFunctions(bare);
+            for (const Expression *variant : {exp.get(), bare.get()}) {
+                variant->evaluate_batch(xs.data(), serial.data(), checked);
+                parallelEvaluate(*variant, -10.0, 10.0, parallel.data(), checked, pool);
+                bool same = memcmp(serial.data(), parallel.data(), checked * sizeof(double)) == 0;
+                for (size_t i = 0; i < checked; i++)
+                    serial[i] = variant->evaluate(xs[i]);
+                pool.parallel_for(checked, 1 << 14, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++)
+                        parallel[i] = variant->evaluate(xs[i]);
+                });
+                same = same && memcmp(serial.data(), parallel.data(), checked * sizeof(double)) == 0;
+                all = all && same;
+                if (!same) {
+                    failedChecks++;
+                    cout << "  MISMATCH " << f << (variant == bare.get() ? " with bare functors" : "") << endl;
+                }
+            }
+        }
+        cout << "  " << formulas.size() << " expressions, batch and scalar, builtins and bare functors, "
+             << (all ? "all identical" : "mismatches found") << endl;
+    }
+
+    const size_t samples = 10000000;
+    unique_ptr<Expression> exp = parseExpression(formulas.back())->simplify();
+    unsigned processors = max(1u, thread::hardware_concurrency());
+    cout << "== parallelEvaluate, " << samples << " samples, " << processors << " processors (ms, speedup) ==" << endl;
+    vector<double> out(samples);
+    double single = 0;
+    for (unsigned threads = 1; threads <= max(4u, processors); threads *= 2) {
+        ThreadPool pool(threads);
+        double t = bestOf([&]() { parallelEvaluate(*exp, -10.0, 10.0, out.data(), samples, pool); }, 3);
+        if (threads == 1)
+            single = t;
+        cout << "  " << setw(3) << threads << " threads " << fixed << setprecision(1) << setw(8) << t / 1e6
+             << setprecision(2) << setw(7) << single / t << "x" << endl;
+    }
+}
+
+/**
+ * Hides the interval extension of an expression, so the Sampler can't prune anything: the baseline of benchInterval.
+ */
+class Opaque final : public Expression {
+public:
+    unique_ptr<Expression> inner;
+
+    Opaque(unique_ptr<Expression> &&inner) : inner{move(inner)} { }
+
+    virtual double evaluate(double x) const override { return inner->evaluate(x); }
+
+    virtual void evaluate_block(const double *xs, double *out, size_t n) const override {
+        inner->evaluate_block(xs, out, n);
+    }
+
+    virtual Dual evaluate_with_derivative(double x) const override { return inner->evaluate_with_derivative(x); }
+
+    virtual Interval evaluate_interval(double, double) const override { return Interval::entire(); }
+
+    virtual unique_ptr<Expression> differentiate() const override { return inner->differentiate(); }
+
+    virtual void print(ostream &os) const override { inner->print(os); }
+
+    virtual Opaque *clone() const override { return new Opaque{unique_ptr<Expression>(inner->clone())}; }
+};
+
+/**
+ * Checks that evaluate_interval() encloses evaluate() for every node type and builtin on random ranges of widths
+ * from 1e-12 to 20, then measures how much sampling the interval pruning saves on curves that are mostly off-screen,
+ * and what it costs on ordinary ones.
+ */
+static void benchInterval() {
+    vector<string> checked = {"X+3", "X-3", "X*X", "X*3-X", "1/X", "(X-1)/(X+1)", "X^2", "X^3", "X^(0-1)", "X^(0-2)",
+                              "X^0.5", "X^X", "2^X", "(X*X)^(X/4)", "sin(X)", "cos(X*3)", "tan(X)", "tan(X*7)",
+                              "abs(X)", "sqrt(X)", "sqrt(X-1)", "log(X)", "log(abs(X))", "sign(X)", "sign(X)/X",
+                              "sin(1/X)*5", "X^3-X*2+1", "sin(X)*cos(X*3)+sqrt(abs(X))/(X^2+1)"};
+    cout << "== evaluate_interval encloses evaluate (ranges, samples, violations) ==" << endl;
+    Lcg rng{12345};
+    size_t ranges = 0, samples = 0, violations = 0;
+    for (const string &f : checked) {
+        vector<unique_ptr<Expression>> variants;
+        variants.push_back(parseExpression(f));
+        variants.push_back(variants[0]->simplify());
+        PolynomialDetector().run(variants[1]);
+        for (const unique_ptr<Expression> &exp : variants) {
+            for (int r = 0; r < 2000; r++) {
+                double width = pow(10.0, -12.0 + 13.3 * rng.next(1000000) / 1e6);
+                double lo = -10.0 + (20.0 - width) * rng.next(1000000) / 1e6, hi = lo + width;
+                Interval enclosure = exp->evaluate_interval(lo, hi);
+                ranges++;
+                for (int k = 0; k <= 64; k++) {
+                    double x = k == 64 ? hi : lo + width * rng.next(1000000) / 1e6;
+                    double y = exp->evaluate(x);
+                    samples++;
+                    if (isfinite(y) && !enclosure.contains(y)) {
+                        if (violations++ < 5) {
+                            cout << "  VIOLATION ";
+                            exp->print(cout);
+                            cout << " at " << setprecision(17) << x << " = " << y << " not in [" << enclosure.lo
+                                 << ", " << enclosure.hi << "]" << endl;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    cout << "  " << ranges << " ranges, " << samples << " samples, " << violations << " violations"
+         << check(violations == 0, "  UNSOUND") << endl;
+
+    vector<string> formulas = {"X^3/1000", "X^8/1000000", "sin(X)*X^2", "sqrt(X)", "log(X)", "X/2+1", "sin(X)",
+                               "tan(X)", "sin(X*10)*5"};
+    Viewport view{-100.0, 100.0, -10.0, 10.0, 800, 600};
+    cout << "== Sampler on [-100, 100] x [-10, 10], 800x600 without and with pruning (evaluations, us) ==" << endl;
+    for (const string &f : formulas) {
+        unique_ptr<Expression> exp = parseExpression(f)->simplify();
+        PolynomialDetector().run(exp);
+        Opaque opaque{unique_ptr<Expression>(exp->clone())};
+        Sampler sampler;
+        double tPlain = bestOf([&]() { sampler.sample(opaque, view); }, 20);
+        size_t plain = sampler.get_evaluations();
+        double tPruned = bestOf([&]() { sampler.sample(*exp, view); }, 20);
+        cout << left << setw(14) << f << right << fixed << setprecision(1) << setw(7) << plain << setw(8)
+             << tPlain / 1e3 << "  " << setw(7) << sampler.get_evaluations() << setw(8) << tPruned / 1e3 << endl;
+    }
+}
+
+/**
+ * Fits ChebyshevProxy objects over [-10, 10] and compares them with the tree: the pieces, the reported and the true
+ * largest error on a dense sweep, and the evaluation speed.
+ */
+static void benchChebyshev() {
+    vector<string> formulas = {"sin(X)", "sin(X)*cos(X*3)", "sin(X)/(X^2+1)+cos(X/3)*2",
+                               "sin(X)*cos(X*3)+sqrt(abs(X))*sin(X*X/7)+log(abs(X)+1)", "tan(X)", "sign(X)*X"};
+    const double tolerance = 1e-9;
+    const size_t samples = 1000000;
+    vector<double> xs(samples), exact(samples), approx(samples);
+    for (size_t i = 0; i < samples; i++)
+        xs[i] = -10.0 + 20.0 * double(i) / double(samples - 1);
+    cout << "== tree vs. ChebyshevProxy, tolerance " << tolerance
+         << " (pieces, fallbacks, max degree, fit ms, reported / true max error, ns/sample) ==" << endl;
+    for (const string &f : formulas) {
+        unique_ptr<Expression> exp = parseExpression(f)->simplify();
+        PolynomialDetector().run(exp);
+        StrengthReduction().run(exp);
+        unique_ptr<ChebyshevProxy> proxy;
+        double tFit = bestOf([&]() { proxy.reset(new ChebyshevProxy(*exp, -10.0, 10.0, tolerance)); }, 3);
+        size_t fallbacks = 0, degree = 0;
+        for (const ChebyshevProxy::Piece &piece : proxy->get_pieces()) {
+            fallbacks += piece.coefficients.empty();
+            degree = max(degree, piece.coefficients.size() ? piece.coefficients.size() - 1 : 0);
+        }
+        double tTree = bestOf([&]() { exp->evaluate_batch(xs.data(), exact.data(), samples); }, 3);
+        double tProxy = bestOf([&]() { proxy->evaluate_batch(xs.data(), approx.data(), samples); }, 3);
+        double checksum = 0;
+        double tScalar = nsPerSample([&](double x) { return proxy->evaluate(x); }, samples, checksum);
+        double error = 0;
+        bool identical = true;
+        for (size_t i = 0; i < samples; i += 7)
+            identical = identical && (proxy->evaluate(xs[i]) == approx[i] || approx[i] != approx[i]);
+        for (size_t i = 0; i < samples; i++)
+            if (isfinite(exact[i]))
+                error = max(error, fabs(exact[i] - approx[i]));
+        cout << f << endl << "  " << proxy->get_pieces().size() << " pieces, " << fallbacks << " fallbacks, degree "
+             << degree << ", fit " << fixed << setprecision(2) << tFit / 1e6 << " ms, error " << scientific
+             << setprecision(1) << proxy->get_max_error() << " / " << error << fixed << setprecision(2)
+             << "  tree batch " << tTree / samples << "  proxy batch " << tProxy / samples << " ("
+             << tTree / tProxy << "x)  proxy scalar " << tScalar << check(identical, "  SCALAR MISMATCH") << endl;
+    }
+}
+
+/**
+ * Checks formulas of several variables, x and y on a grid, with every pass of the pipeline run on them: the slots
+ * the parser gives, and that evaluate_block_slots() and parallelEvaluateGrid() are bit-identical to
+ * evaluate_slots(). Then times the grid evaluation and a heatmap frame.
+ */
+static void benchGrid() {
+    vector<string> formulas = {"sin(x)*cos(y)", "x^2+y^2", "x*y-y*x+x", "sqrt(x*x+y*y)", "(x+y)^3/(x-y)",
+                               "sin(x*y)/(1+abs(t))+y^2*x-x^3", "log(x)*tan(y/3)"};
+    cout << "== formulas of x and y (slots, scalar vs. block vs. grid mismatches) ==" << endl;
+    Grid grid{-5.0, 5.0, -4.0, 4.0, 401, 301, 0, 1};
+    for (const string &f : formulas) {
+        VariableTable variables({"x"});
+        unique_ptr<Expression> exp = parseExpression(f, variables)->simplify();
+        PolynomialDetector().run(exp);
+        StrengthReduction().run(exp);
+        vector<double> values(variables.size(), 0.5), out(grid.width * grid.height);
+        parallelEvaluateGrid(*exp, grid, out.data(), values);
+        size_t mismatches = 0;
+        vector<double> point(values);
+        for (size_t r = 0; r < grid.height; r++)
+            for (size_t c = 0; c < grid.width; c++) {
+                point[0] = grid.x(c);
+                point[1] = grid.y(r);
+                double expected = exp->evaluate_slots(point.data()), actual = out[r * grid.width + c];
+                if (expected != actual && !(isnan(expected) && isnan(actual)))
+                    mismatches++;
+            }
+        cout << "  " << left << setw(32) << f << right;
+        for (size_t k = 0; k < variables.size(); k++)
+            cout << variables.get_names()[k] << "=" << variables.find(variables.get_names()[k]) << " ";
+        exp->print(cout);
+        cout << "  " << mismatches << " mismatches" << endl;
+    }
+
+    VariableTable variables({"x"});
+    unique_ptr<Expression> exp = parseExpression("sin(x)*cos(y)+x*y/10", variables)->simplify();
+    const size_t width = 800, height = 600;
+    vector<double> out(width * height);
+    Grid frame{-10.0, 10.0, -7.5, 7.5, width, height, 0, 1};
+    cout << "== sin(x)*cos(y)+x*y/10 on 800x600 (ns/point) ==" << endl;
+    double tScalar = bestOf([&]() {
+        double point[2];
+        for (size_t r = 0; r < height; r++) {
+            point[1] = frame.y(r);
+            for (size_t c = 0; c < width; c++) {
+                point[0] = frame.x(c);
+                out[r * width + c] = exp->evaluate_slots(point);
+            }
+        }
+    }, 3);
+    ThreadPool single{1};
+    double tSingle = bestOf([&]() { parallelEvaluateGrid(*exp, frame, out.data(), vector<double>(), single); }, 3);
+    double tShared = bestOf([&]() { parallelEvaluateGrid(*exp, frame, out.data()); }, 3);
+    Plotter plotter{unique_ptr<Canvas>(new ImageCanvas{int(width), int(height)})};
+    double tHeatmap = bestOf([&]() { plotter.plot_heatmap(*exp, 0, 1, -10.0, 10.0, -7.5, 7.5); }, 3);
+    double points = double(width * height);
+    cout << fixed << setprecision(2) << "  scalar " << tScalar / points << "  grid, 1 thread " << tSingle / points
+         << " (" << tScalar / tSingle << "x)  grid, " << ThreadPool::shared().size() << " threads "
+         << tShared / points << " (" << tScalar / tShared << "x)  heatmap frame " << tHeatmap / 1e6 << " ms"
+         << endl;
+}
+
+/**
+ * Evaluates sets of formulas over 200000 places one by one and as an ExpressionSet: a family of 24 related formulas
+ * sharing sin(X), cos(X) and X*X, and 64 unrelated random trees. Checks that every column is bit-identical to its
+ * formula's own evaluate_batch().
+ */
+static void benchExpressionSet() {
+    vector<unique_ptr<Expression>> family, random;
+    for (int k = 1; k <= 24; k++) {
+        string c = to_string(k);
+        family.push_back(parseExpression("sin(X)*" + c + "+cos(X)^2/(X*X+" + c + ")-sin(X)*cos(X)/" + c +
+                                         (k % 2 ? "+sqrt(abs(X))" : "-X*X*" + c)));
+    }
+    Lcg rng{777};
+    for (int k = 0; k < 64; k++)
+        random.push_back(randomTree(rng, 200));
+    const size_t samples = 200000;
+    vector<double> xs(samples);
+    for (size_t i = 0; i < samples; i++)
+        xs[i] = -10.0 + 20.0 * i / samples;
+    cout << "== one by one vs. ExpressionSet, 200000 places (ns/place, all formulas) ==" << endl;
+    vector<pair<string, vector<unique_ptr<Expression>> *>> sets = {{"24 related formulas", &family},
+                                                                   {"64 random trees", &random}};
+    for (auto &named : sets) {
+        vector<unique_ptr<Expression>> &exps = *named.second;
+        vector<const Expression *> pointers;
+        size_t nodes = 0;
+        for (const unique_ptr<Expression> &exp : exps) {
+            pointers.push_back(exp.get());
+            nodes += countNodes(*exp);
+        }
+        ExpressionSet set{pointers};
+        vector<vector<double>> expected(exps.size(), vector<double>(samples)), actual = expected;
+        vector<double *> columns;
+        for (vector<double> &column : actual)
+            columns.push_back(column.data());
+        double tSeparate = bestOf([&]() {
+            for (size_t k = 0; k < exps.size(); k++)
+                exps[k]->evaluate_batch(xs.data(), expected[k].data(), samples);
+        }, 3) / samples;
+        double tSet = bestOf([&]() { set.evaluate_batch(xs.data(), samples, columns.data()); }, 3) / samples;
+        size_t mismatches = 0;
+        for (size_t k = 0; k < exps.size(); k++)
+            for (size_t i = 0; i < samples; i++)
+                if (expected[k][i] != actual[k][i] && !(isnan(expected[k][i]) && isnan(actual[k][i])))
+                    mismatches++;
+        vector<double> single(exps.size());
+        set.evaluate(xs[1234], single.data());
+        for (size_t k = 0; k < exps.size(); k++)
+            if (single[k] != expected[k][1234] && !(isnan(single[k]) && isnan(expected[k][1234])))
+                mismatches++;
+        cout << named.first << endl << fixed << setprecision(2) << "  nodes " << nodes << " -> " << set.node_count()
+             << ", " << set.buffer_count() << " buffers  one by one " << tSeparate << "  set " << tSet << " ("
+             << tSeparate / tSet << "x)" << check(mismatches == 0) << endl;
+    }
+}
+
+/**
+ * Stream buffer that throws away what is written, counting the bytes.
+ */
+class CountingBuffer : public streambuf {
+public:
+    size_t bytes = 0;
+
+protected:
+    streamsize xsputn(const char *, streamsize n) override {
+        bytes += size_t(n);
+        return n;
+    }
+
+    int overflow(int c) override {
+        bytes++;
+        return c;
+    }
+};
+
+/**
+ * Stream buffer producing lines lazily: formula i of a fixed cycle of formulas with changing constants, so
+ * arbitrarily long inputs take no memory.
+ */
+class FormulaSource : public streambuf {
+public:
+    explicit FormulaSource(size_t lines) : remaining{lines} { }
+
+protected:
+    int underflow() override {
+        if (remaining == 0)
+            return traits_type::eof();
+        static const char *const templates[] = {"sin(X)*%d+X^2/%d", "(X*X+%d)/(X-%d)*(X+3)-X/4", "abs(sin(X*%d))+%d",
+                                                "X^3-%d*X*X+sin(X)/(X+%d)", "sqrt(abs(X))*cos(X/%d)-log(X+%d)",
+                                                "# comment %d %d", "X*%d+(", "tan(X/%d)*%d"};
+        size_t i = counter++;
+        int length = snprintf(line, sizeof line, templates[i % 8], int(i % 7 + 1), int(i % 5 + 2));
+        line[length] = '\n';
+        setg(line, line, line + length + 1);
+        remaining--;
+        return traits_type::to_int_type(line[0]);
+    }
+
+private:
+    size_t remaining, counter = 0;
+    char line[128];
+};
+
+/**
+ * Runs BatchRunner over generated inputs: checks that the output doesn't depend on the number of threads, then
+ * measures the throughput on 100k lines and the memory growth from 100k to 200k lines.
+ */
+static void benchBatchRunner() {
+    cout << "== BatchRunner (formulas/s, MB of output, resident MB growth) ==" << endl;
+    BatchOptions options;
+    options.samples = 11;
+    string reference;
+    for (unsigned threads : {1u, 3u}) {
+        for (BatchOptions::Format format : {BatchOptions::CSV, BatchOptions::BINARY}) {
+            options.threads = threads;
+            options.format = format;
+            FormulaSource source{5000};
+            istream in{&source};
+            ostringstream out, errors;
+            BatchRunner{options}.run(in, out, &errors);
+            if (format == BatchOptions::CSV && threads == 1)
+                reference = out.str() + errors.str();
+            else if (format == BatchOptions::CSV)
+                cout << check(out.str() + errors.str() == reference, "  OUTPUT DEPENDS ON THE THREADS\n");
+        }
+    }
+    cout << "  " << reference.substr(0, reference.find('\n', reference.find('\n') + 1) + 1);
+    /* a registered function throwing something else than a std::exception fails its formula only */
+    if (!FunctionRegistry::global().find("batch_throwing"))
+        FunctionRegistry::global().add("batch_throwing", [](double x) -> double { throw int(x); });
+    {
+        istringstream in{"X+1\nbatch_throwing(X)\nsin(\nX*2\n"};
+        ostringstream out, errors;
+        options.threads = 2;
+        options.format = BatchOptions::CSV;
+        BatchStats stats = BatchRunner{options}.run(in, out, &errors);
+        string text = errors.str();
+        size_t first = text.find('\n');
+        cout << "  " << stats.failed << " of " << stats.formulas << " failed: " << text.substr(0, first) << " / "
+             << text.substr(first + 1, text.size() - first - 2)
+             << check(stats.failed == 2 && text.find("line 2: ") == 0 &&
+                      text.find("line 3, column ", first) == first + 1) << endl;
+    }
+
+    for (BatchOptions::Format format : {BatchOptions::CSV, BatchOptions::BINARY}) {
+        for (size_t samples : {size_t(11), size_t(101)}) {
+            options.threads = 0;
+            options.format = format;
+            options.samples = samples;
+            size_t before = residentBytes(), growth[2];
+            double seconds = 0;
+            BatchStats stats{0, 0};
+            CountingBuffer counter;
+            size_t index = 0;
+            for (size_t lines : {size_t(100000), size_t(200000)}) {
+                FormulaSource source{lines};
+                istream in{&source};
+                ostream out{&counter};
+                ostream errors{&counter};
+                auto start = chrono::steady_clock::now();
+                stats = BatchRunner{options}.run(in, out, &errors);
+                if (lines == 100000)
+                    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                growth[index++] = residentBytes() - before;
+            }
+            cout << "  " << (format == BatchOptions::CSV ? "CSV   " : "binary") << " " << setw(3) << samples
+                 << " samples  " << fixed << setprecision(0) << setw(8) << 100000 / seconds << " formulas/s  "
+                 << setprecision(1) << counter.bytes / 1e6 << " MB  " << stats.failed << " of " << stats.formulas
+                 << " failed  resident +" << growth[0] / 1e6 << " / +" << growth[1] / 1e6 << " MB" << endl;
+        }
+    }
+}
+
+/**
+ * Compares random trees of 2^18 nodes with their CompactExpression: memory per node, conversion both ways, print,
+ * evaluation and simplification, checking that the round trip is lossless and the values bit-identical.
+ */
+static void benchCompact() {
+    cout << "== tree vs. CompactExpression, random tree of 2^18 nodes ==" << endl;
+    Lcg rng{2024};
+    size_t before = residentBytes();
+    unique_ptr<Expression> tree = randomTree(rng, 1 << 18);
+    size_t treeBytes = residentBytes() - before, nodes = countNodes(*tree);
+    unique_ptr<CompactExpression> compact;
+    double tBuild = bestOf([&]() { compact.reset(new CompactExpression{*tree}); }, 3);
+    unique_ptr<Expression> back;
+    double tBack = bestOf([&]() { back = compact->to_expression(); }, 3);
+    ostringstream treeText, compactText, backText;
+    double tPrintTree = bestOf([&]() {
+        treeText.str("");
+        tree->print(treeText);
+    }, 3);
+    double tPrintCompact = bestOf([&]() {
+        compactText.str("");
+        compact->print(compactText);
+    }, 3);
+    back->print(backText);
+    bool lossless = treeText.str() == compactText.str() && treeText.str() == backText.str();
+
+    const size_t samples = 4096;
+    vector<double> xs(samples), a(samples), b(samples), c(samples);
+    for (size_t i = 0; i < samples; i++)
+        xs[i] = -2.0 + 4.0 * i / samples;
+    double tTreeBatch = bestOf([&]() { tree->evaluate_batch(xs.data(), a.data(), samples); }, 3) / samples;
+    double tCompactBatch = bestOf([&]() { compact->evaluate_batch(xs.data(), b.data(), samples); }, 3) / samples;
+    double tTree = bestOf([&]() {
+        for (size_t i = 0; i < 64; i++)
+            c[i] = tree->evaluate(xs[i * 64]);
+    }, 3) / 64;
+    double tCompact = bestOf([&]() {
+        for (size_t i = 0; i < 64; i++)
+            c[i] = compact->evaluate(xs[i * 64]);
+    }, 3) / 64;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < samples; i++) {
+        double scalar = i % 64 == 0 ? compact->evaluate(xs[i]) : b[i];
+        if ((a[i] != b[i] && !(isnan(a[i]) && isnan(b[i]))) || (scalar != b[i] && !(isnan(scalar) && isnan(b[i]))))
+            mismatches++;
+    }
+
+    unique_ptr<Expression> simplifiedTree;
+    double tSimplifyTree = bestOf([&]() { simplifiedTree = tree->simplify(); }, 3);
+    unique_ptr<CompactExpression> simplified;
+    double tSimplifyCompact = bestOf([&]() { simplified.reset(new CompactExpression{compact->simplify()}); }, 3);
+    unique_ptr<Expression> simplifiedBack = simplified->to_expression();
+    simplified->evaluate_batch(xs.data(), b.data(), samples);
+    simplifiedBack->evaluate_batch(xs.data(), a.data(), samples);
+    for (size_t i = 0; i < samples; i++)
+        if (a[i] != b[i] && !(isnan(a[i]) && isnan(b[i])))
+            mismatches++;
+
+    cout << fixed << setprecision(1) << "  " << nodes << " nodes, tree " << double(treeBytes) / nodes
+         << " B/node, compact " << double(compact->node_bytes()) / nodes << " B/node ("
+         << double(treeBytes) / compact->node_bytes() << "x)" << endl
+         << setprecision(2) << "  build " << tBuild / 1e6 << " ms, back to tree " << tBack / 1e6 << " ms, print tree "
+         << tPrintTree / 1e6 << " ms / compact " << tPrintCompact / 1e6 << " ms"
+         << check(lossless, "  ROUND TRIP DIFFERS") << endl
+         << "  evaluate tree " << tTree / 1e6 << " ms / compact " << tCompact / 1e6 << " ms, batch tree "
+         << tTreeBatch / 1e3 << " us/place / compact " << tCompactBatch / 1e3 << " us/place"
+         << check(mismatches == 0) << endl
+         << "  simplify tree " << tSimplifyTree / 1e6 << " ms -> " << countNodes(*simplifiedTree)
+         << " nodes, compact " << tSimplifyCompact / 1e6 << " ms -> " << simplified->size() << " nodes" << endl;
+}
+
+/**
+ * Compares the enum-dispatched builtins with calls through std::function, and checks the new builtins' values,
+ * derivatives and interval extensions, and registered batch functions.
+ */
+static void benchFunctions() {
+    cout << "== FunctionRegistry: builtins by switch vs. std::function ==" << endl;
+    const size_t samples = 1 << 16;
+    vector<double> xs(samples), a(samples), b(samples);
+    for (size_t i = 0; i < samples; i++)
+        xs[i] = -0.99 + 1.98 * i / samples;
+    const char *formulas[] = {"abs(x)*sign(x)+floor(3*x)-ceil(2*x)", "sqrt(abs(x))+abs(x-0.5)*2",
+                              "sin(x)*exp(0-x^2/4)+atan(x)", "asin(x)+acos(x)+tanh(x)-sinh(x)*cosh(x)"};
+    size_t mismatches = 0;
+    for (const char *formula : formulas) {
+        unique_ptr<Expression> exp = parseExpression(formula);
+        unique_ptr<Expression> bare{exp->clone()};
+        bareFunctions(bare);
+        double tBuiltin = bestOf([&]() { exp->evaluate_batch(xs.data(), a.data(), samples); }) / samples;
+        double tBare = bestOf([&]() { bare->evaluate_batch(xs.data(), b.data(), samples); }) / samples;
+        CompiledExpression compiled{*exp};
+        JitExpression jit{*exp};
+        double sumTree = 0, sumBare = 0, sumJit = 0;
+        double tTree = nsPerSample([&exp](double x) { return exp->evaluate(x / 10.0); }, samples, sumTree);
+        double tTreeBare = nsPerSample([&bare](double x) { return bare->evaluate(x / 10.0); }, samples, sumBare);
+        double tJit = nsPerSample([&jit](double x) { return jit.evaluate(x / 10.0); }, samples, sumJit);
+        for (size_t i = 0; i < samples; i++)
+            if (!sameValue(a[i], b[i]) || (i % 64 == 0 && (!sameValue(a[i], exp->evaluate(xs[i])) ||
+                                                           !sameValue(a[i], compiled.evaluate(xs[i])) ||
+                                                           !sameValue(a[i], jit.evaluate(xs[i])))))
+                mismatches++;
+        cout << "  " << setw(40) << left << formula << right << fixed << setprecision(2) << " batch " << tBuiltin
+             << " / " << tBare << " ns (" << tBare / tBuiltin << "x), evaluate " << tTree << " / " << tTreeBare
+             << " ns (" << tTreeBare / tTree << "x), JIT " << tJit << " ns" << endl;
+    }
+
+    struct Reference {
+        const char *name;
+        double (*f)(double);
+        double (*derivative)(double);
+    };
+    const Reference references[] = {
+            {"exp",   [](double x) { return exp(x); },   [](double x) { return exp(x); }},
+            {"asin",  [](double x) { return asin(x); },  [](double x) { return 1.0 / sqrt(1.0 - x * x); }},
+            {"acos",  [](double x) { return acos(x); },  [](double x) { return -1.0 / sqrt(1.0 - x * x); }},
+            {"atan",  [](double x) { return atan(x); },  [](double x) { return 1.0 / (1.0 + x * x); }},
+            {"sinh",  [](double x) { return sinh(x); },  [](double x) { return cosh(x); }},
+            {"cosh",  [](double x) { return cosh(x); },  [](double x) { return sinh(x); }},
+            {"tanh",  [](double x) { return tanh(x); },  [](double x) { return 1.0 - tanh(x) * tanh(x); }},
+            {"floor", [](double x) { return floor(x); }, [](double) { return 0.0; }},
+            {"ceil",  [](double x) { return ceil(x); },  [](double) { return 0.0; }}
+    };
+    Lcg rng{7};
+    size_t wrongValues = 0, wrongDerivatives = 0, unsound = 0;
+    for (const Reference &ref : references) {
+        unique_ptr<Expression> exp = parseExpression(string(ref.name) + "(x)");
+        unique_ptr<Expression> derivative = exp->derive();
+        for (int k = -90; k <= 90; k++) {
+            double x = k * 0.0107;
+            if (!sameValue(exp->evaluate(x), ref.f(x)))
+                wrongValues++;
+            double exact = ref.derivative(x);
+            if (fabs(derivative->evaluate(x) - exact) > 1e-12 * (1.0 + fabs(exact)) ||
+                fabs(exp->evaluate_with_derivative(x).derivative - exact) > 1e-12 * (1.0 + fabs(exact)))
+                wrongDerivatives++;
+        }
+        for (int k = 0; k < 2000; k++) {
+            double lo = rng.next(6000) / 1000.0 - 3.0, hi = lo + rng.next(2000) / 1000.0;
+            Interval enclosure = exp->evaluate_interval(lo, hi);
+            for (int j = 0; j <= 16; j++) {
+                double value = ref.f(lo + (hi - lo) * j / 16);
+                if (!isnan(value) && !enclosure.contains(value))
+                    unsound++;
+            }
+        }
+    }
+
+    FunctionRegistry &registry = FunctionRegistry::global();
+    if (!registry.find("gauss")) {
+        registry.add("gauss", [](double x) { return exp(-x * x); }, [](const double *in, double *out, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                out[i] = -in[i] * in[i];
+            FunctionRegistry::evaluate_block(FunctionRegistry::EXP, out, n);
+        });
+        registry.add("gauss_scalar", [](double x) { return exp(-x * x); });
+    }
+    unique_ptr<Expression> batched = parseExpression("gauss(x)*3+gauss(x-1)");
+    unique_ptr<Expression> scalar = parseExpression("gauss_scalar(x)*3+gauss_scalar(x-1)");
+    double tBatched = bestOf([&]() { batched->evaluate_batch(xs.data(), a.data(), samples); }) / samples;
+    double tScalar = bestOf([&]() { scalar->evaluate_batch(xs.data(), b.data(), samples); }) / samples;
+    ExpressionSet set{{batched.get(), scalar.get()}};
+    vector<double> c(samples), d(samples);
+    double *columns[] = {c.data(), d.data()};
+    set.evaluate_batch(xs.data(), samples, columns);
+    CompactExpression compact{*batched};
+    vector<double> e(samples);
+    compact.evaluate_batch(xs.data(), e.data(), samples);
+    bool custom = true;
+    for (size_t i = 0; i < samples; i++)
+        custom = custom && a[i] == b[i] && a[i] == c[i] && a[i] == d[i] && a[i] == e[i];
+    bool rejected = false;
+    try {
+        registry.add("sin", [](double x) { return x; });
+    } catch (const invalid_argument &) {
+        rejected = true;
+    }
+    cout << "  new builtins: " << wrongValues << " wrong values, " << wrongDerivatives << " wrong derivatives, "
+         << unsound << " values outside their enclosures" << check(mismatches == 0) << endl
+         << "  registered gauss(): batch " << tBatched << " ns, scalar only " << tScalar << " ns ("
+         << tScalar / tBatched << "x)" << check(custom)
+         << check(rejected, "  DUPLICATE NAME ACCEPTED") << endl;
+}
+
+/**
+ * Distance of a result from the reference in units in the last place of the reference, 0 if both are the same
+ * special value, infinite if only one of them is.
+ */
+static double ulpError(double value, double reference) {
+    if (value == reference || (isnan(value) && isnan(reference)))
+        return 0.0;
+    if (!isfinite(value) || !isfinite(reference))
+        return INFINITY;
+    int exponent;
+    frexp(reference, &exponent);
+    return fabs(value - reference) / ldexp(1.0, max(exponent - 53, -1074));
+}
+
+/**
+ * Checks the approximations of FastMath against libm and against the errors FastMath.h documents, their agreement
+ * across the instruction set levels, that the interval extensions enclose their values, and the speed of the batch
+ * evaluation of transcendental-heavy formulas in both precisions.
+ */
+static void benchFastMath() {
+    cout << "== FastMath: exact vs. fast precision ==" << endl;
+    struct Approximation {
+        const char *name;
+        double (*fast)(double);
+        double (*exact)(double);
+        bool positive;
+        double documented;   /* ulp */
+    };
+    const Approximation approximations[] = {
+            {"sin", FastMath::fast_sin, [](double x) { return sin(x); }, false, 2.0},
+            {"cos", FastMath::fast_cos, [](double x) { return cos(x); }, false, 2.0},
+            {"tan", FastMath::fast_tan, [](double x) { return tan(x); }, false, 3.0},
+            {"exp", FastMath::fast_exp, [](double x) { return exp(x); }, false, 1.0},
+            {"log", FastMath::fast_log, [](double x) { return log(x); }, true, 2.0}
+    };
+    Lcg rng{99};
+    auto random_bits = [&rng]() {
+        unsigned long long bits = (unsigned long long) rng.next(1u << 31) << 33 ^ (unsigned long long) rng.next(1u << 31) << 2 ^ rng.next(4);
+        double x;
+        memcpy(&x, &bits, sizeof x);
+        return x;
+    };
+    cout << "  max error over 10^6 arguments:";
+    for (const Approximation &f : approximations) {
+        double worst = 0.0;
+        for (int i = 0; i < 1000000; i++) {
+            double x = random_bits();   /* every exponent, so the whole range */
+            if (i % 2)   /* the range that matters for plots */
+                x = ldexp(double(rng.next(1u << 30)) / (1u << 30), int(rng.next(12)) - 4) * (rng.next(2) ? 1.0 : -1.0);
+            if (f.positive)
+                x = fabs(x);
+            worst = max(worst, ulpError(f.fast(x), f.exact(x)));
+        }
+        cout << " " << f.name << " " << worst << " ulp" << check(worst <= f.documented, " ABOVE DOCUMENTED");
+    }
+    double worstPow = 0.0;
+    for (int i = 0; i < 1000000; i++) {
+        double a = rng.next(40000) / 1000.0 - 20.0, b = rng.next(40000) / 1000.0 - 20.0;
+        if (i % 3 == 0)
+            b = floor(b);
+        worstPow = max(worstPow, ulpError(FastMath::fast_pow(a, b), pow(a, b)) / (fabs(b * log(fabs(a))) + 4.0));
+    }
+    /* the documented bound, (|b log a| + 4) * 2^-51, is 2 * (|b log a| + 4) ulp */
+    cout << ", pow " << worstPow << " * (|b log a| + 4) ulp" << check(worstPow <= 2.0, " ABOVE DOCUMENTED") << endl;
+
+    const char *formulas[] = {"sin(x)*cos(2*x)+tan(x/3)", "exp(sin(x))*log(x^2+1)", "sin(x)^2+cos(x)^2-x^1.5",
+                              "sin(cos(sin(x)))"};
+    const size_t samples = 1 << 16;
+    vector<double> xs(samples), exact(samples), fast(samples), level(samples);
+    for (size_t i = 0; i < samples; i++)
+        xs[i] = 0.001 + 20.0 * i / samples;
+    BatchKernels::SimdLevel detected = BatchKernels::detect_level();
+    for (const char *formula : formulas) {
+        unique_ptr<Expression> exp = parseExpression(formula);
+        FastMath::set_precision(FastMath::Precision::EXACT);
+        double tExact = bestOf([&]() { exp->evaluate_batch(xs.data(), exact.data(), samples); }) / samples;
+        FastMath::set_precision(FastMath::Precision::FAST);
+        double tFast = bestOf([&]() { exp->evaluate_batch(xs.data(), fast.data(), samples); }) / samples;
+        double worst = 0.0;
+        for (size_t i = 0; i < samples; i++)
+            worst = max(worst, fabs(fast[i] - exact[i]) / max(1.0, fabs(exact[i])));
+        bool identical = true;
+        for (int l = int(BatchKernels::SimdLevel::SCALAR); l <= int(detected); l++) {
+            BatchKernels::set_level(BatchKernels::SimdLevel(l));
+            exp->evaluate_batch(xs.data(), level.data(), samples);
+            identical = identical && memcmp(level.data(), fast.data(), samples * sizeof(double)) == 0;
+        }
+        BatchKernels::set_level(detected);
+        /* the enclosures the Sampler prunes with must hold the approximated values too */
+        bool enclosed = true;
+        for (size_t i = 0; i < samples; i += 64) {
+            Interval values = exp->evaluate_interval(xs[i], xs[min(i + 63, samples - 1)]);
+            for (size_t k = i; k < min(i + 64, samples); k++) {
+                bool inside = values.contains(fast[k]) && exp->evaluate_interval(xs[k], xs[k]).contains(fast[k]);
+                enclosed = enclosed && (!isfinite(fast[k]) || inside);
+            }
+        }
+        FastMath::set_precision(FastMath::Precision::EXACT);
+        cout << "  " << setw(26) << left << formula << right << fixed << setprecision(2) << " exact " << tExact
+             << " ns, fast " << tFast << " ns (" << tExact / tFast << "x), error " << scientific << setprecision(1)
+             << worst << defaultfloat << check(identical, "  LEVELS DIFFER") << check(enclosed, "  UNSOUND") << endl;
+    }
+}
+
+static void benchFloat() {
+    cout << "== Single precision evaluation ==" << endl;
+    const char *formulas[] = {"x*x-3*x+2", "sin(x)*cos(2*x)+tan(x/3)", "exp(sin(x))*log(x^2+1)",
+                              "sqrt(abs(x))*atan(x)-x^1.5"};
+    const size_t samples = 1 << 16;
+    vector<double> xs(samples), values(samples);
+    vector<float> xs_float(samples), values_float(samples);
+    for (size_t i = 0; i < samples; i++) {
+        xs[i] = 0.001 + 20.0 * i / samples;
+        xs_float[i] = float(xs[i]);
+    }
+    for (const char *formula : formulas) {
+        unique_ptr<Expression> exp = parseExpression(formula);
+        double tDouble = bestOf([&]() { exp->evaluate_batch(xs.data(), values.data(), samples); }) / samples;
+        double tFloat = bestOf([&]() { exp->evaluate_batch(xs_float.data(), values_float.data(), samples); }) / samples;
+        size_t wrong = 0;
+        for (size_t i = 0; i < samples; i++) {
+            float scalar = exp->evaluate_as<float>(xs_float[i]);
+            wrong += memcmp(&scalar, &values_float[i], sizeof scalar) != 0;
+        }
+        FloatPrecisionReport report = checkFloatPrecision(*exp, 0.001, 20.0);
+        cout << "  " << setw(28) << left << formula << right << fixed << setprecision(2) << " double " << tDouble
+             << " ns, float " << tFloat << " ns (" << tDouble / tFloat << "x), relative error " << scientific
+             << setprecision(1) << report.relative_error << defaultfloat << check(wrong == 0) << endl;
+    }
+
+    struct Case {
+        const char *formula;
+        double lo, hi;
+        bool safe;
+    };
+    const Case cases[] = {
+            {"sin(x)*x", -10.0, 10.0, true},
+            {"x^3-2*x", -2.0, 2.0, true},
+            {"log(x)", 0.001, 100.0, true},
+            {"x", 1e6, 1e6 + 1.0, false},             /* the places themselves round */
+            {"(x+1)^2-x^2-2*x", 1e3, 1e4, false},     /* cancellation */
+            {"exp(x)", 0.0, 200.0, false},            /* float overflows */
+            {"sqrt(x-1)", 0.0, 1.0 + 1e-9, false}     /* the last place rounds to 1 in float */
+    };
+    for (const Case &c : cases) {
+        unique_ptr<Expression> exp = parseExpression(c.formula);
+        FloatPrecisionReport report = checkFloatPrecision(*exp, c.lo, c.hi);
+        cout << "  " << setw(18) << left << c.formula << right << setprecision(10) << " on [" << c.lo << ", " << c.hi << "]: "
+             << (report.safe ? "float is safe" : "use double") << ", relative error " << scientific << setprecision(1)
+             << report.relative_error << defaultfloat << setprecision(6) << ", " << report.mismatches << " mismatches"
+             << check(report.safe == c.safe) << endl;
+    }
+}
+
+/**
+ * The recursive traversals the explicit-stack ones of Expressions.cpp replaced, for comparison.
+ */
+static double recursiveEvaluate(const Expression &e, double x) {
+    switch (e.shape()) {
+        case Expression::Shape::BINARY: {
+            const TwoOperand &op = static_cast<const TwoOperand &>(e);
+            return op.do_operator(recursiveEvaluate(*op.lhs, x), recursiveEvaluate(*op.rhs, x));
+        }
+        case Expression::Shape::CALL: {
+            const Function &func = static_cast<const Function &>(e);
+            double value = recursiveEvaluate(*func.arg, x);
+            return func.builtin != FunctionRegistry::CUSTOM ? FunctionRegistry::evaluate(func.builtin, value) :
+                   func.entry->scalar(value);
+        }
+        default:
+            return e.evaluate(x);
+    }
+}
+
+static void recursivePrint(const Expression &e, ostream &os) {
+    switch (e.shape()) {
+        case Expression::Shape::BINARY: {
+            const TwoOperand &op = static_cast<const TwoOperand &>(e);
+            os << '(';
+            recursivePrint(*op.lhs, os);
+            os << op.get_operator();
+            recursivePrint(*op.rhs, os);
+            os << ')';
+            break;
+        }
+        case Expression::Shape::CALL: {
+            const Function &func = static_cast<const Function &>(e);
+            os << func.entry->name << '(';
+            recursivePrint(*func.arg, os);
+            os << ')';
+            break;
+        }
+        default:
+            e.print(os);
+    }
+}
+
+static unique_ptr<Expression> recursiveClone(const Expression &e) {
+    switch (e.shape()) {
+        case Expression::Shape::BINARY: {
+            const TwoOperand &op = static_cast<const TwoOperand &>(e);
+            unique_ptr<Expression> lhs = recursiveClone(*op.lhs), rhs = recursiveClone(*op.rhs);
+            switch (op.get_operator()) {
+                case '+':
+                    return node(new Sum{move(lhs), move(rhs)});
+                case '-':
+                    return node(new Dif{move(lhs), move(rhs)});
+                case '*':
+                    return node(new Prod{move(lhs), move(rhs)});
+                case '/':
+                    return node(new Div{move(lhs), move(rhs)});
+                default:
+                    return node(new Exp{move(lhs), move(rhs)});
+            }
+        }
+        case Expression::Shape::CALL: {
+            const Function &func = static_cast<const Function &>(e);
+            return node(new Function{recursiveClone(*func.arg), func});
+        }
+        default:
+            return unique_ptr<Expression>(e.clone());
+    }
+}
+
+/**
+ * Runs f on a thread with a native stack of the given size.
+ */
+template<typename F>
+static void runWithStack(size_t bytes, F f) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, bytes);
+    pthread_t thread;
+    auto body = [](void *arg) -> void * {
+        (*static_cast<F *>(arg))();
+        return nullptr;
+    };
+    if (pthread_create(&thread, &attr, body, &f) == 0)
+        pthread_join(thread, nullptr);
+    else
+        f();
+    pthread_attr_destroy(&attr);
+}
+
+static void benchDeep() {
+    cout << "== Explicit-stack traversals ==" << endl;
+    Lcg rng{2024};
+    vector<unique_ptr<Expression>> trees;
+    for (int i = 0; i < 200; i++)
+        trees.push_back(randomTree(rng, 1000));
+    size_t nodes = 0;
+    for (const unique_ptr<Expression> &tree : trees)
+        nodes += countNodes(*tree);
+    size_t wrong = 0;
+    double sink = 0.0;
+    double tRecursive = bestOf([&]() {
+        for (const unique_ptr<Expression> &tree : trees)
+            sink += recursiveEvaluate(*tree, 0.75);
+    });
+    double tIterative = bestOf([&]() {
+        for (const unique_ptr<Expression> &tree : trees)
+            sink += tree->evaluate(0.75);
+    });
+    for (const unique_ptr<Expression> &tree : trees)
+        wrong += !sameValue(tree->evaluate(0.75), recursiveEvaluate(*tree, 0.75));
+    cout << "  random trees of 1000 nodes, evaluate: recursive " << fixed << setprecision(2) << tRecursive / nodes
+         << " ns, explicit stack " << tIterative / nodes << " ns per node (" << tRecursive / tIterative << "x)"
+         << endl;
+    tRecursive = bestOf([&]() {
+        for (const unique_ptr<Expression> &tree : trees) {
+            ostringstream os;
+            recursivePrint(*tree, os);
+            sink += double(os.tellp());
+        }
+    });
+    tIterative = bestOf([&]() {
+        for (const unique_ptr<Expression> &tree : trees) {
+            ostringstream os;
+            tree->print(os);
+            sink += double(os.tellp());
+        }
+    });
+    for (const unique_ptr<Expression> &tree : trees) {
+        ostringstream recursive, iterative;
+        recursivePrint(*tree, recursive);
+        tree->print(iterative);
+        wrong += recursive.str() != iterative.str();
+    }
+    cout << "  random trees of 1000 nodes, print: recursive " << tRecursive / nodes << " ns, explicit stack "
+         << tIterative / nodes << " ns per node (" << tRecursive / tIterative << "x)" << endl;
+    tRecursive = bestOf([&]() {
+        for (const unique_ptr<Expression> &tree : trees)
+            sink += double(recursiveClone(*tree) != nullptr);
+    });
+    tIterative = bestOf([&]() {
+        for (const unique_ptr<Expression> &tree : trees)
+            sink += double(unique_ptr<Expression>(tree->clone()) != nullptr);
+    });
+    cout << "  random trees of 1000 nodes, clone and destroy: recursive " << tRecursive / nodes
+         << " ns, explicit stack " << tIterative / nodes << " ns per node (" << tRecursive / tIterative << "x)"
+         << defaultfloat << check(wrong == 0) << endl;
+
+    /* a generated sum of a million terms, and a million nested calls, on a 256 KiB native stack */
+    runWithStack(256 * 1024, [&]() {
+        const size_t terms = 1000000;
+        unique_ptr<Expression> sum = node(new Variable{});
+        double expected = 0.75;
+        for (size_t i = 1; i < terms; i++) {
+            double k = double(i % 7);
+            sum = node(new Sum{move(sum), node(new Prod{node(new Variable{}), node(new Constant{k})})});
+            expected += 0.75 * k;
+        }
+        unique_ptr<Expression> calls = node(new Variable{});
+        for (size_t i = 0; i < terms; i++)
+            calls = node(new Function{move(calls), FunctionRegistry::global().get(FunctionRegistry::SIN)});
+        double value = 0.0, nested = 0.0;
+        size_t printed = 0;
+        unique_ptr<Expression> copy, simplified;
+        auto start = chrono::steady_clock::now();
+        auto lap = [&start]() {
+            auto now = chrono::steady_clock::now();
+            double ms = chrono::duration<double, milli>(now - start).count();
+            start = now;
+            return ms;
+        };
+        value = sum->evaluate(0.75);
+        nested = calls->evaluate(0.75);
+        double tEvaluate = lap();
+        ostringstream os;
+        sum->print(os);
+        calls->print(os);
+        printed = size_t(os.tellp());
+        double tPrint = lap();
+        copy.reset(sum->clone());
+        copy.reset(calls->clone());
+        double tClone = lap();
+        simplified = sum->simplify();
+        double simplifiedValue = simplified->evaluate(0.75);
+        simplified = calls->simplify();
+        double tSimplify = lap();
+        double compactValue = CompactExpression{*sum}.evaluate(0.75);
+        double compactNested = CompactExpression{*calls}.evaluate(0.75);
+        double tCompact = lap();
+        copy.reset();
+        simplified.reset();
+        sum.reset();
+        calls.reset();
+        double tDestroy = lap();
+        double reference = 0.75;
+        for (size_t i = 0; i < terms; i++)
+            reference = sin(reference);
+        bool correct = fabs(value - expected) <= 1e-9 * expected && fabs(simplifiedValue - expected) <= 1e-9 * expected
+                       && nested == reference && fabs(compactValue - expected) <= 1e-9 * expected &&
+                       compactNested == reference;
+        cout << "  depth 10^6 on a 256 KiB stack: evaluate " << fixed << setprecision(1) << tEvaluate
+             << " ms, print " << tPrint << " ms (" << printed / 1000000 << " MB), clone " << tClone
+             << " ms, simplify " << tSimplify << " ms, to CompactExpression and evaluate " << tCompact
+             << " ms, destroy " << tDestroy << " ms" << defaultfloat
+             << check(correct) << endl;
+    });
+
+    /* formulas read from text like main() and --batch get them, through their pipeline, on a 256 KiB native stack */
+    runWithStack(256 * 1024, [&]() {
+        const size_t depth = 100000;
+        string sines = "sin(X)", parentheses = string(depth, '(') + "X" + string(depth, ')'), powers = "X", calls, sums;
+        for (size_t k = 2; k <= 2 * depth; k++)
+            sines += "+sin(X*" + to_string(k) + ")";
+        for (size_t i = 0; i < depth; i++) {
+            powers += "^1";
+            calls += "sin(";
+            sums += "X+(";
+        }
+        calls += "X" + string(depth, ')');
+        sums += "X" + string(depth, ')');
+        struct Formula {
+            const string &text;
+            function<double(double)> expected;
+        };
+        const Formula formulas[] = {
+                {sines, [](double x) {
+                    double sum = 0.0;
+                    for (size_t k = 1; k <= 2 * depth; k++)
+                        sum += sin(double(k) * x);
+                    return sum;
+                }},
+                {parentheses, [](double x) { return x; }},
+                {powers, [](double x) { return x; }},
+                {calls, [](double x) {
+                    for (size_t i = 0; i < depth; i++)
+                        x = sin(x);
+                    return x;
+                }},
+                {sums, [](double x) { return double(depth + 1) * x; }}
+        };
+        const size_t n = 64;
+        vector<double> xs(n), ys(n);
+        for (size_t i = 0; i < n; i++)
+            xs[i] = 0.5 + 0.5 * double(i) / (n - 1);
+        bool correct = true;
+        auto start = chrono::steady_clock::now();
+        for (const Formula &formula : formulas) {
+            unique_ptr<Expression> exp = parseExpression(formula.text)->simplify();
+            PolynomialDetector().run(exp);
+            StrengthReduction().run(exp);
+            exp->evaluate_batch(xs.data(), ys.data(), n);
+            Interval range = exp->evaluate_interval(xs[0], xs[n - 1]);
+            for (size_t i = 0; i < n; i++) {
+                double expected = formula.expected(xs[i]);
+                correct = correct && sameValue(ys[i], exp->evaluate(xs[i])) && range.contains(ys[i]) &&
+                          fabs(ys[i] - expected) <= 1e-9 * max(1.0, fabs(expected));
+            }
+        }
+        double tPipeline = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "  parsed depth 10^5 (sum of 2*10^5 sines, parentheses, ^ chain, calls, right-nested sum) on a 256 KiB "
+             << "stack: parse, optimize, evaluate_batch, evaluate_interval " << fixed << setprecision(1) << tPipeline
+             << " ms" << defaultfloat << check(correct) << endl;
+    });
+    if (sink == 1.0)
+        cout << "";
+}
+
+int main() {
+    benchCompiled();
+    benchBatch();
+    benchParser();
+    benchArena();
+    benchDag();
+    benchSimplify();
+    benchStrength();
+    benchPolynomial();
+    benchNewton();
+    benchSampler();
+    benchPlotter();
+    benchSampleCache();
+    benchParallel();
+    benchInterval();
+    benchChebyshev();
+    benchGrid();
+    benchExpressionSet();
+    benchBatchRunner();
+    benchCompact();
+    benchFunctions();
+    benchFastMath();
+    benchFloat();
+    benchDeep();
+    if (failedChecks)
+        cout << failedChecks << " checks failed" << endl;
+    return failedChecks ? 1 : 0;
+}
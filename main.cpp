@@ -1,244 +1,168 @@
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include "BatchRunner.h"
 #include "Expressions.h"
+#include "FastMath.h"
+#include "Parser.h"
+#include "PolynomialDetector.h"
+#include "Plotter.h"
+#include "SampleCache.h"
+#include "SdlCanvas.h"
+#include "StrengthReduction.h"
 #include <SDL2/SDL.h>
-#include <sstream>
-#include <deque>
-#include <vector>
-#include <regex>
+#include <math.h>
 using namespace std;
 
 /**
- * Converts an expression, which is in raw string format to valid Reverse Polish Notation form.
- * @param exp the string to be parsed
- * @return the expression in RPN form
+ * Least time between two frames, in milliseconds, limiting redraws to about 60 per second while events stream in.
  */
-std::string parseString(string exp) {
-    deque<string> out;
-    deque<string> opStack;
-    deque<int> parenthesisStack;
-    stringstream ss;
-    string ret;
-    bool wasChar = false;
-    bool wasFunc=false;
-    string funcName;
-    for (auto it : exp) {
-        if (!(isdigit(it) || it=='.'))
-            wasChar = false;
-        if (isdigit(it) || it=='.') {
-            if (wasChar) {
-                out.pop_back();
-                string temp = out.back();
-                out.pop_back();
-                out.push_back(temp + string(1, it));
-            } else {
-                out.push_back(string(1, it));
-            }
-            out.push_back(" ");
-            wasChar = true;
-        } else if (it == '+' || it == '-') {
-            for (auto itOut: opStack) {
-                if (!itOut.compare("+") || !itOut.compare("-") || !itOut.compare("*") || !itOut.compare("/") ||
-                    !itOut.compare("^")) {
-                    out.push_back(opStack.front());
-                    out.push_back(" ");
-                    opStack.pop_front();
-                } else
-                    break;
-            }
-            opStack.push_front(string(1, it));
-        } else if (it == '*' || it == '/') {
-            for (auto itOut: opStack)
-                if (!itOut.compare("*") || !itOut.compare("/") || !itOut.compare("^")) {
-                    out.push_back(opStack.front());
-                    out.push_back(" ");
-                    opStack.pop_front();
-                } else
-                    break;
-            opStack.push_front(string(1, it));
-        } else if (it == '^') {
-            opStack.push_front(string(1, it));
-        } else if (it == '(') {
-            if(wasFunc){
-                opStack.push_front(funcName);
-                wasFunc=false;
-                funcName.clear();
-                parenthesisStack.push_front(0);
-            }
-            opStack.push_front(string(1, it));
-            if(parenthesisStack.size()){
-                parenthesisStack.front()++;
-            }
-        } else if (it == ')') {
-            for (auto itOut: opStack)
-                if (!itOut.compare("(")) {
-                    opStack.pop_front();
-                    break;
-                }
-                else {
-                    out.push_back(opStack.front());
-                    out.push_back(" ");
-                    opStack.pop_front();
-                }
-            if(parenthesisStack.size()){
-                parenthesisStack.front()--;
-                if(parenthesisStack.front()==0){
-                    parenthesisStack.pop_front();
-                    out.push_back(opStack.front());
-                    out.push_back(" ");
-                    opStack.pop_front();
-                }
-            }
-        } else if (it == 'X') {
-            out.push_back(string(1, it));
-            out.push_back(" ");
-        } else if (it == ' ') {
-
-        } else {
-            wasFunc=true;
-            funcName.append(string(1,it));
-        }
-    }
-    for (auto it : opStack) {
-        out.push_back(it);
-        out.push_back(" ");
-    }
-    for (auto it : out)
-        ss << it;
-    ret = ss.str();
-    return ret;
-}
+const Uint32 FRAME_MS=16;
 
 /**
- * String splitter function, splits a string at delim characters
- * @param s string for splitting
- * @param delim delimiter character
- * @return split vector of strings
+ * Time a frame may spend sampling tiles that a coarser or finer level can stand in for, in milliseconds.
  */
-std::vector<std::string> split(const std::string &s, char delim) {
-    std::stringstream ss(s);
-    std::string item;
-    std::vector<std::string> splitted;
-    while (std::getline(ss, item, delim))
-        splitted.push_back(item);
-    return splitted;
-}
+const double SAMPLING_BUDGET_MS=8.0;
 
 /**
- * Ceates a new function object depending on the incoming string.
- * Implement new function types here.
- * @param s function name to be parsed
- * @return function object, containing the parsed function
+ * Factor the ranges are scaled by per notch of the mouse wheel.
  */
-std::function<double(double)> parseFunction(const std::string &s) {
-    if (!s.compare("sin")){
-        return [](double x){return sin(x);};
-    }else if(!s.compare("cos")){
-        return [](double x){return cos(x);};
-    }else if(!s.compare("tan")){
-        return [](double x){return tan(x);};
-    }else if(!s.compare("abs")){
-        return [](double x){return abs(x);};
-    }else{
-        throw -2;
-    }
+const double ZOOM_STEP=1.25;
 
-}
 /**
- * Gets an expression in Reverse Polish Notation, and builds an Expression Tree from it.
- * Normal RPN evaluation, only it doesn't do any primitive calculation, just evaluates the next token, generates the
- * required Expression, and pushes it into a stack.
- * @param RPNExp string, in Reverse Polish Notation format.
- * @return pointer to the Expression Tree
+ * Runs the event loop of the window until it is closed.
+ * The loop sleeps in SDL_WaitEvent while nothing has to be redrawn, so an idle plot uses no CPU. Events that
+ * invalidate the picture only mark it dirty; a dirty frame is drawn once the events pending have been handled and
+ * at least FRAME_MS has passed since the last frame, so a burst of events, like a resize, costs one redraw per frame.
+ * Events queued while the frame interval elapsed are polled before drawing, so they are part of the frame.
+ * The mouse wheel zooms around the cursor, dragging with the left button pans. The curve is drawn from a tiled
+ * sample cache: a pan samples only the strips it exposes, and after a zoom the previous level is shown while the
+ * new one is sampled over the next frames. An expression of two variables is drawn as a heatmap instead, the variable
+ * in slot 0 on the horizontal axis and the one in slot 1 on the vertical one.
+ * @param plotter the plotter of the window
+ * @param exp the expression to draw
+ * @param maxX max X value to draw initially
+ * @param maxY max Y value to draw initially
+ * @param heatmap whether to draw a heatmap of the two variables instead of a curve
  */
-std::unique_ptr<Expression> buildTree(std::string RPNExp) {
-    std::vector<std::string> RPNTokens = split(RPNExp, ' ');
-    std::deque<std::unique_ptr<Expression> > expStack;
-    for (auto item : RPNTokens) {
-        try {
-            if (std::regex_match(item, std::regex("[[:digit:]]+.?[[:digit:]]*"))) {
-                expStack.push_back(std::unique_ptr<Expression>(new Constant(atof(item.c_str()))));
-            } else if (std::regex_match(item, std::regex("[+-/*^]"))) {
-                std::unique_ptr<Expression> rhs(std::move(expStack.back()));
-                expStack.pop_back();
-                std::unique_ptr<Expression> lhs(std::move(expStack.back()));
-                expStack.pop_back();
-                switch (item.at(0)) {
-                    case '+':
-                        expStack.push_back(std::unique_ptr<Expression>(new Sum{std::move(lhs), std::move(rhs)}));
-                        break;
-                    case '*':
-                        expStack.push_back(std::unique_ptr<Expression>(new Prod{std::move(lhs), std::move(rhs)}));
-                        break;
-                    case '/':
-                        expStack.push_back(std::unique_ptr<Expression>(new Div{std::move(lhs), std::move(rhs)}));
-                        break;
-                    case '-':
-                        expStack.push_back(std::unique_ptr<Expression>(new Dif{std::move(lhs), std::move(rhs)}));
-                        break;
-                    case '^':
-                        expStack.push_back(std::unique_ptr<Expression>(new Exp{std::move(lhs), std::move(rhs)}));
-                        break;
-                }
-            } else if (std::regex_match(item, std::regex("X"))) {
-                expStack.push_back(std::unique_ptr<Expression>(new Variable{}));
-            } else{
-                try{
-                    std::function<double(double)> func{parseFunction(item)};
-                    std::unique_ptr<Expression> arg(std::move(expStack.back()));
-                    expStack.pop_back();
-                    expStack.push_back(std::unique_ptr<Expression>(new Function{std::move(arg),func,item}));
-                }catch (...){
-
-                }
+void runEventLoop(Plotter& plotter, const Expression& exp, double maxX, double maxY, bool heatmap){
+    SampleCache cache(exp);
+    double xMin=-maxX, xMax=maxX, yMin=-maxY, yMax=maxY;
+    bool dirty=true;
+    Uint32 lastFrame=0;
+    while(true){
+        SDL_Event e;
+        bool received;
+        if(!dirty){
+            if(!SDL_WaitEvent(&e))
+                return;
+            received=true;
+        }else{
+            Uint32 elapsed=SDL_GetTicks()-lastFrame;
+            received=elapsed<FRAME_MS ? SDL_WaitEventTimeout(&e,int(FRAME_MS-elapsed))!=0 : SDL_PollEvent(&e)!=0;
+        }
+        if(received){
+            const Viewport& view=plotter.get_viewport();
+            if(e.type==SDL_QUIT)
+                return;
+            if(e.type==SDL_WINDOWEVENT && (e.window.event==SDL_WINDOWEVENT_EXPOSED ||
+                                           e.window.event==SDL_WINDOWEVENT_SIZE_CHANGED))
+                dirty=true;
+            if(e.type==SDL_MOUSEWHEEL && e.wheel.y!=0 && view.width>0 && view.height>0){
+                int mouseX,mouseY;
+                SDL_GetMouseState(&mouseX,&mouseY);
+                double factor=pow(ZOOM_STEP,-e.wheel.y);
+                double x=view.plane_x(mouseX), y=yMax-mouseY*(yMax-yMin)/view.height;
+                xMin=x+(xMin-x)*factor;
+                xMax=x+(xMax-x)*factor;
+                yMin=y+(yMin-y)*factor;
+                yMax=y+(yMax-y)*factor;
+                dirty=true;
+            }
+            if(e.type==SDL_MOUSEMOTION && (e.motion.state&SDL_BUTTON_LMASK) && view.width>0 && view.height>0){
+                double dx=e.motion.xrel*(xMax-xMin)/view.width, dy=e.motion.yrel*(yMax-yMin)/view.height;
+                xMin-=dx;
+                xMax-=dx;
+                yMin+=dy;
+                yMax+=dy;
+                dirty=true;
             }
-        } catch (std::regex_error e) {
-            cout << e.code();
+            continue;
+        }
+        if(heatmap){
+            plotter.plot_heatmap(exp,0,1,xMin,xMax,yMin,yMax);
+            dirty=false;
+        }else{
+            dirty=!plotter.plot(cache,xMin,xMax,yMin,yMax,SAMPLING_BUDGET_MS);
         }
+        lastFrame=SDL_GetTicks();
     }
-    return std::unique_ptr<Expression>(std::move(expStack.front()));
 }
 
 /**
- * Function to draw the Expression.
- * Clears the screen, draws the axes, then draws the function.
- * @param window pointer to the SDL window
- * @param exp pointer to the Expression Tree
- * @param maxX max X value to draw
- * @param maxY max Y value to draw
+ * Runs the headless batch mode: evaluates the formulas of a file, or of the standard input, one per line, and writes
+ * their values in input order. Errors and the totals go to the standard error. --fast-math also selects the FAST
+ * precision of FastMath.
+ * Usage: --batch [--from A] [--to B] [--samples N] [--format csv|binary] [--threads N] [--output FILE]
+ *        [--fast-math] [FILE | -]
+ * @param args the arguments after the program name
+ * @return exit code of the program
  */
-void drawFunction(SDL_Window * window, shared_ptr<Expression> exp,int maxX,int maxY){
-
-    SDL_Surface* screenSurface = SDL_GetWindowSurface(window);
-    SDL_Renderer* renderer=SDL_CreateRenderer(window,-1,SDL_RENDERER_ACCELERATED);
-
-    int screenw,screenh;
-    screenw=screenSurface->w;
-    screenh=screenSurface->h;
-
-    SDL_RenderClear(renderer);
-    SDL_SetRenderDrawColor(renderer,255,255,255,0);
-    SDL_Rect rectangle;
-    rectangle.x=rectangle.y=0;
-    rectangle.w=rectangle.h=600;
-
-    SDL_RenderFillRect(renderer,&rectangle);
-    SDL_SetRenderDrawColor(renderer,0,0,0,0);
-    SDL_RenderDrawLine(renderer,screenw/2,0,screenw/2,screenh);
-    SDL_RenderDrawLine(renderer,0,screenh/2,screenw,screenh/2);
-    SDL_SetRenderDrawColor(renderer,255,0,0,0);
-
-    double ratiox=screenw/(maxX*2);
-    double ratioy=screenh/(maxY*2);
-
-    for(int i=1;i<screenw;i++){
-        int x1,x2,y1,y2;
-        x1=i-1;
-        x2=i;
-        y1=screenh-(exp->evaluate(x1/ratiox-maxX)+maxY)*ratioy;
-        y2=screenh-(exp->evaluate(x2/ratiox-maxX)+maxY)*ratioy;
-        SDL_RenderDrawLine(renderer,x1,y1,x2,y2);
+int runBatch(const vector<string>& args){
+    BatchOptions options;
+    string input="-", output="-";
+    try{
+        for(size_t i=0;i<args.size();i++){
+            const string& arg=args[i];
+            bool hasValue=i+1<args.size();
+            if(arg=="--batch"){
+            }else if(arg=="--fast-math"){
+                options.fast_math=true;
+                FastMath::set_precision(FastMath::Precision::FAST);
+            }else if(arg=="--from" && hasValue){
+                options.x_min=stod(args[++i]);
+            }else if(arg=="--to" && hasValue){
+                options.x_max=stod(args[++i]);
+            }else if(arg=="--samples" && hasValue){
+                options.samples=stoul(args[++i]);
+            }else if(arg=="--threads" && hasValue){
+                options.threads=unsigned(stoul(args[++i]));
+            }else if(arg=="--output" && hasValue){
+                output=args[++i];
+            }else if(arg=="--format" && hasValue && (args[i+1]=="csv" || args[i+1]=="binary")){
+                options.format=args[++i]=="csv" ? BatchOptions::CSV : BatchOptions::BINARY;
+            }else if(arg=="-" || arg.compare(0,2,"--")!=0){
+                input=arg;
+            }else{
+                throw invalid_argument("Unknown or incomplete option: "+arg);
+            }
+        }
+        BatchRunner runner{options};
+        ifstream inFile;
+        ofstream outFile;
+        if(input!="-"){
+            inFile.open(input);
+            if(!inFile)
+                throw runtime_error("Can't open "+input);
+        }
+        if(output!="-"){
+            outFile.open(output,ios::binary);
+            if(!outFile)
+                throw runtime_error("Can't create "+output);
+        }
+        ios::sync_with_stdio(false);
+        auto start=chrono::steady_clock::now();
+        BatchStats stats=runner.run(input=="-" ? cin : inFile, output=="-" ? cout : outFile, &cerr);
+        double seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        cerr<<stats.formulas<<" formulas, "<<stats.failed<<" failed, "<<seconds<<" s, "
+            <<(seconds>0 ? stats.formulas/seconds : 0.0)<<" formulas/s"<<endl;
+        return stats.failed ? 2 : 0;
+    }catch(exception& err){
+        cerr<<err.what()<<endl
+            <<"Usage: --batch [--from A] [--to B] [--samples N] [--format csv|binary] [--threads N]"
+              " [--output FILE] [--fast-math] [FILE | -]"<<endl;
+        return 1;
     }
-    SDL_RenderPresent(renderer);
 }
 
 int main(int argc, char *argv[]) {
@@ -246,7 +170,18 @@ int main(int argc, char *argv[]) {
     //Functions you could try with:
     //X-3
     //X + 4 ^ 2 * 2 / (5 - 1)
-    //abs((sin(X))
+    //abs(sin(X))
+    //sin(x)*cos(y) - a second variable, of any name, draws a heatmap with contour lines
+    //Start with --fast-math to let divisions by constants become multiplications, and to plot sin, cos, tan, exp, log
+    //and ^ with the approximations of FastMath.
+    //Start with --batch to evaluate a file of formulas without a window, see runBatch().
+    vector<string> args(argv + 1, argv + argc);
+    for (const string& arg : args)
+        if (arg == "--batch")
+            return runBatch(args);
+    bool fastMath = argc > 1 && string(argv[1]) == "--fast-math";
+    if (fastMath)
+        FastMath::set_precision(FastMath::Precision::FAST);
     int maxX,maxY;
     string func;
     cout<< "Maximum az X tengelyen?: ";
@@ -254,49 +189,38 @@ int main(int argc, char *argv[]) {
     cout<< "Maximum az Y tengelyen?: ";
     cin>>maxY;
     cout<<"Kirajzolando fuggveny?: ";
-    cin>>func;
-
-    //string s = parseString("X + 4 ^ 2 * 2 / (5 - 1) ");
-    //string s2 = parseString("abs(sin(X))");
-
-    std::shared_ptr<Expression> e = buildTree(parseString(func));
-    std::shared_ptr<Expression> esimpl=e->simplify();
-    //The window we'll be rendering to
-    SDL_Window *window = NULL;
-
-    //The surface contained by the window
-    SDL_Surface *screenSurface = NULL;
-
-    SDL_Renderer *renderer=NULL;
+    getline(cin>>ws,func);
+
+    std::shared_ptr<Expression> e;
+    VariableTable variables({"x"});
+    try{
+        e=parseExpression(func,variables);
+    }catch (ParseError& err){
+        cout<<func<<endl<<string(err.get_position(),' ')<<'^'<<endl<<err.what()<<endl;
+        return 1;
+    }
+    if(variables.size()>2){
+        cout<<"Legfeljebb ket valtozo lehet: x es "<<variables.get_names()[1]<<endl;
+        return 1;
+    }
+    std::unique_ptr<Expression> optimized=e->simplify();
+    PolynomialDetector().run(optimized);
+    StrengthReduction(fastMath).run(optimized);
     //Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         cout << "SDL could not initialize!";
     }
     else {
-        //Create window
-        window = SDL_CreateWindow("Function drawer", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 600, 600,
-                                  SDL_WINDOW_SHOWN);
-        if (window == NULL) {
-            cout << "No window" << endl;
+        try {
+            //The window we'll be rendering to, drawn by the plotter
+            Plotter plotter{std::unique_ptr<Canvas>(new SdlCanvas{"Function drawer", 600, 600})};
+            runEventLoop(plotter, *optimized, maxX, maxY, variables.size()==2);
+        } catch (std::runtime_error& err) {
+            cout << err.what() << endl;
         }
-        else {
 
-            drawFunction(window,esimpl,maxX,maxY);
-            while (1) {
-                SDL_Event e;
-                if (SDL_PollEvent(&e)) {
-                    if (e.type == SDL_QUIT) {
-                        break;
-                    }
-                }
-            }
-
-            //Destroy window
-            SDL_DestroyWindow(window);
-
-            //Quit SDL subsystems
-            SDL_Quit();
-        }
+        //Quit SDL subsystems
+        SDL_Quit();
     }
 
 